@@ -0,0 +1,307 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct AsyncCacheStatistics
+{
+	//Requests answered with an object that was already there
+	uint64_t mHitCount = 0;
+
+	//Objects created (on the calling thread or in the background)
+	uint64_t mCreatedCount = 0;
+
+	//Objects created by the background threads
+	uint64_t mBackgroundCreatedCount = 0;
+
+	//Requests for an object already being created, that didn't start another creation
+	uint64_t mDeduplicatedCount = 0;
+
+	//Request() calls that got the fallback because the object wasn't ready
+	uint64_t mFallbackCount = 0;
+
+	uint64_t mFailedCount = 0;
+
+	double mTotalCreateMs = 0.0;
+
+	double mMaxCreateMs = 0.0;
+};
+
+/*
+	Cache of expensive objects (pipeline states, root signatures ...) keyed by a 64 bit hash of whatever describes them,
+	where every object is created exactly once however many threads ask for it at the same time.
+
+	- GetOrCreate() blocks until the object exists: it creates it on the calling thread, or waits for the thread that is
+	  already creating it. An object still queued for the background is taken off the queue and created right away.
+	- Request() never blocks: it returns the object if it's ready, otherwise it queues its creation on the background
+	  threads (once) and returns the fallback the caller provided, e.g. a simpler pipeline to draw with in the meantime.
+	  MakeCreate is only called when the creation is queued: a queued create function runs after Request() returned, so
+	  it must own everything it reads, and copying that is best left to the one request that needs it.
+
+	An exception thrown by a create function is handed to the GetOrCreate() callers of that key; Request() keeps
+	returning the fallback for it.
+*/
+template <typename ValueType>
+class AsyncCache
+{
+public:
+
+	typedef std::function<ValueType()> CreateFunction;
+
+	explicit AsyncCache(uint32_t BackgroundThreadCount = 1)
+	{
+		if (BackgroundThreadCount == 0)
+		{
+			throw std::invalid_argument("AsyncCache needs at least one background thread");
+		}
+
+		mThreads.reserve(BackgroundThreadCount);
+		for (uint32_t i = 0; i < BackgroundThreadCount; ++i)
+		{
+			mThreads.emplace_back([this]() { BackgroundLoop(); });
+		}
+	}
+
+	//Queued creations that haven't started are dropped, the ones running are waited for
+	~AsyncCache()
+	{
+		{
+			std::lock_guard<std::mutex> Lock(mMutex);
+			mQuitting = true;
+		}
+		mQueueChanged.notify_all();
+
+		for (auto& Thread : mThreads)
+		{
+			Thread.join();
+		}
+	}
+
+	AsyncCache(const AsyncCache&) = delete;
+	AsyncCache& operator=(const AsyncCache&) = delete;
+
+	//The object if it's ready, without creating anything
+	bool TryGet(uint64_t Key, ValueType& Value)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		auto It = mEntries.find(Key);
+		if (It == mEntries.end() || It->second.mState != State::Ready)
+		{
+			return false;
+		}
+		++mStatistics.mHitCount;
+		Value = It->second.mValue;
+		return true;
+	}
+
+	ValueType GetOrCreate(uint64_t Key, const CreateFunction& Create)
+	{
+		std::unique_lock<std::mutex> Lock(mMutex);
+
+		Entry& Found = mEntries[Key];
+		switch (Found.mState)
+		{
+		case State::Ready:
+			++mStatistics.mHitCount;
+			return Found.mValue;
+
+		case State::Failed:
+			std::rethrow_exception(Found.mError);
+
+		case State::Creating:
+		{
+			++mStatistics.mDeduplicatedCount;
+			mCreated.wait(Lock, [this, Key]() { return mEntries[Key].mState != State::Creating; });
+			const Entry& Done = mEntries[Key];
+			if (Done.mState == State::Failed)
+			{
+				std::rethrow_exception(Done.mError);
+			}
+			return Done.mValue;
+		}
+
+		case State::Queued:
+		{
+			//Don't wait for the background to get to it, the background thread will skip it
+			++mStatistics.mDeduplicatedCount;
+			CreateFunction QueuedCreate = std::move(Found.mCreate);
+			return CreateEntry(Lock, Key, QueuedCreate, false);
+		}
+
+		default:
+			return CreateEntry(Lock, Key, Create, false);
+		}
+	}
+
+	ValueType Request(uint64_t Key, const std::function<CreateFunction()>& MakeCreate, const ValueType& Fallback)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+
+		Entry& Found = mEntries[Key];
+		switch (Found.mState)
+		{
+		case State::Ready:
+			++mStatistics.mHitCount;
+			return Found.mValue;
+
+		case State::Missing:
+			Found.mState = State::Queued;
+			Found.mCreate = MakeCreate();
+			mQueue.push_back(Key);
+			mQueueChanged.notify_one();
+			break;
+
+		default:
+			break;
+		}
+
+		++mStatistics.mFallbackCount;
+		return Fallback;
+	}
+
+	//Wait until every queued creation is done
+	void WaitIdle()
+	{
+		std::unique_lock<std::mutex> Lock(mMutex);
+		mCreated.wait(Lock, [this]() { return mQueue.empty() && mRunningCount == 0; });
+	}
+
+	//Objects queued or being created
+	size_t GetPendingCount()
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		return mQueue.size() + mRunningCount;
+	}
+
+	AsyncCacheStatistics GetStatistics()
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		return mStatistics;
+	}
+
+private:
+
+	enum class State
+	{
+		Missing,
+		Queued,
+		Creating,
+		Ready,
+		Failed
+	};
+
+	struct Entry
+	{
+		State mState = State::Missing;
+
+		ValueType mValue{};
+
+		//Only while Queued
+		CreateFunction mCreate;
+
+		std::exception_ptr mError;
+	};
+
+	//Called with the lock held, releases it while Create runs
+	ValueType CreateEntry(std::unique_lock<std::mutex>& Lock, uint64_t Key, const CreateFunction& Create, bool Background)
+	{
+		mEntries[Key].mState = State::Creating;
+		++mRunningCount;
+		Lock.unlock();
+
+		ValueType Value{};
+		std::exception_ptr Error;
+		const auto Start = std::chrono::high_resolution_clock::now();
+		try
+		{
+			Value = Create();
+		}
+		catch (...)
+		{
+			Error = std::current_exception();
+		}
+		const double Ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - Start).count();
+
+		Lock.lock();
+		--mRunningCount;
+
+		Entry& Done = mEntries[Key];
+		if (Error)
+		{
+			Done.mState = State::Failed;
+			Done.mError = Error;
+			++mStatistics.mFailedCount;
+		}
+		else
+		{
+			Done.mState = State::Ready;
+			Done.mValue = Value;
+			++mStatistics.mCreatedCount;
+			mStatistics.mBackgroundCreatedCount += Background ? 1 : 0;
+			mStatistics.mTotalCreateMs += Ms;
+			mStatistics.mMaxCreateMs = Ms > mStatistics.mMaxCreateMs ? Ms : mStatistics.mMaxCreateMs;
+		}
+		mCreated.notify_all();
+
+		if (Error && !Background)
+		{
+			std::rethrow_exception(Error);
+		}
+		return Value;
+	}
+
+	void BackgroundLoop()
+	{
+		std::unique_lock<std::mutex> Lock(mMutex);
+		while (true)
+		{
+			mQueueChanged.wait(Lock, [this]() { return mQuitting || !mQueue.empty(); });
+			if (mQuitting)
+			{
+				return;
+			}
+
+			const uint64_t Key = mQueue.front();
+			mQueue.pop_front();
+
+			//GetOrCreate() may have taken it already
+			Entry& Found = mEntries[Key];
+			if (Found.mState != State::Queued)
+			{
+				mCreated.notify_all();
+				continue;
+			}
+
+			CreateFunction Create = std::move(Found.mCreate);
+			CreateEntry(Lock, Key, Create, true);
+		}
+	}
+
+	std::mutex mMutex;
+
+	//Signaled when a creation completes
+	std::condition_variable mCreated;
+
+	std::condition_variable mQueueChanged;
+
+	std::unordered_map<uint64_t, Entry> mEntries;
+
+	std::deque<uint64_t> mQueue;
+
+	uint32_t mRunningCount = 0;
+
+	bool mQuitting = false;
+
+	std::vector<std::thread> mThreads;
+
+	AsyncCacheStatistics mStatistics;
+};
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+/*
+	Buddy allocator over an abstract range of [0, Size) bytes. It never touches memory itself, it only hands out
+	offsets, so it can manage a VkDeviceMemory block, a D3D12 heap or anything else that is addressed by offset.
+
+	The range is split recursively in halves: level 0 is the whole range, level L is made of blocks of Size >> L bytes.
+	Every block is aligned to its own size, so any power of two alignment up to the block size comes for free.
+	Freeing a block merges it back with its buddy whenever the buddy is free too, which keeps external fragmentation
+	bounded; the price is internal fragmentation (requests are rounded up to the next power of two).
+*/
+class BuddyAllocator
+{
+public:
+
+	static constexpr uint64_t kInvalidOffset = ~0ull;
+
+	BuddyAllocator() = default;
+
+	//Size and MinBlockSize must be powers of two
+	BuddyAllocator(uint64_t Size, uint64_t MinBlockSize)
+	{
+		Reset(Size, MinBlockSize);
+	}
+
+	void Reset(uint64_t Size, uint64_t MinBlockSize)
+	{
+		if (!IsPowerOfTwo(Size) || !IsPowerOfTwo(MinBlockSize) || MinBlockSize > Size)
+		{
+			throw std::runtime_error("Buddy allocator sizes must be powers of two!");
+		}
+
+		mSize = Size;
+		mMinBlockSize = MinBlockSize;
+		mUsedSize = 0;
+
+		uint32_t LevelCount = 1;
+		while ((Size >> (LevelCount - 1)) > MinBlockSize)
+		{
+			++LevelCount;
+		}
+
+		mFreeBlocks.assign(LevelCount, {});
+		mFreeBlocks[0].insert(0);
+		mAllocatedLevels.clear();
+	}
+
+	//Returns the offset of a block of at least Size bytes aligned to Alignment (a power of two), or kInvalidOffset if there's no room
+	uint64_t Allocate(uint64_t Size, uint64_t Alignment = 1)
+	{
+		if (Size == 0 || Size > mSize || Alignment > mSize)
+		{
+			return kInvalidOffset;
+		}
+
+		//Blocks are aligned to their own size, so asking for a block at least as big as the alignment is enough
+		const uint32_t Level = GetLevel(std::max(Size, Alignment));
+
+		//Find the smallest free block that fits
+		int32_t SourceLevel = static_cast<int32_t>(Level);
+		while (SourceLevel >= 0 && mFreeBlocks[SourceLevel].empty())
+		{
+			--SourceLevel;
+		}
+		if (SourceLevel < 0)
+		{
+			return kInvalidOffset;
+		}
+
+		//Lowest offsets first: it keeps the allocations packed at the beginning of the range
+		uint64_t Offset = *mFreeBlocks[SourceLevel].begin();
+		mFreeBlocks[SourceLevel].erase(mFreeBlocks[SourceLevel].begin());
+
+		//Split it down to the requested level, putting the upper halves back in the free lists
+		for (uint32_t Split = static_cast<uint32_t>(SourceLevel) + 1; Split <= Level; ++Split)
+		{
+			mFreeBlocks[Split].insert(Offset + GetBlockSize(Split));
+		}
+
+		mAllocatedLevels.emplace(Offset, Level);
+		mUsedSize += GetBlockSize(Level);
+		return Offset;
+	}
+
+	void Free(uint64_t Offset)
+	{
+		auto It = mAllocatedLevels.find(Offset);
+		if (It == mAllocatedLevels.end())
+		{
+			throw std::runtime_error("Buddy allocator: freeing an offset that was never allocated!");
+		}
+
+		uint32_t Level = It->second;
+		mAllocatedLevels.erase(It);
+		mUsedSize -= GetBlockSize(Level);
+
+		//Merge with the buddy as long as it's free
+		while (Level > 0)
+		{
+			const uint64_t Buddy = Offset ^ GetBlockSize(Level);
+			auto BuddyIt = mFreeBlocks[Level].find(Buddy);
+			if (BuddyIt == mFreeBlocks[Level].end())
+			{
+				break;
+			}
+			mFreeBlocks[Level].erase(BuddyIt);
+			Offset = std::min(Offset, Buddy);
+			--Level;
+		}
+		mFreeBlocks[Level].insert(Offset);
+	}
+
+	//Size of the block that actually backs an allocation of Size bytes (what it really costs)
+	uint64_t GetAllocationSize(uint64_t Size, uint64_t Alignment = 1) const
+	{
+		return GetBlockSize(GetLevel(std::max(Size, Alignment)));
+	}
+
+	uint64_t GetSize() const
+	{
+		return mSize;
+	}
+
+	//Bytes taken by live blocks (including the rounding up to powers of two)
+	uint64_t GetUsedSize() const
+	{
+		return mUsedSize;
+	}
+
+	uint32_t GetAllocationCount() const
+	{
+		return static_cast<uint32_t>(mAllocatedLevels.size());
+	}
+
+	bool IsEmpty() const
+	{
+		return mAllocatedLevels.empty();
+	}
+
+	//Biggest allocation that would currently succeed
+	uint64_t GetLargestFreeBlock() const
+	{
+		for (uint32_t Level = 0; Level < mFreeBlocks.size(); ++Level)
+		{
+			if (!mFreeBlocks[Level].empty())
+			{
+				return GetBlockSize(Level);
+			}
+		}
+		return 0;
+	}
+
+	static bool IsPowerOfTwo(uint64_t Value)
+	{
+		return Value != 0 && (Value & (Value - 1)) == 0;
+	}
+
+	static uint64_t NextPowerOfTwo(uint64_t Value)
+	{
+		uint64_t Result = 1;
+		while (Result < Value)
+		{
+			Result <<= 1;
+		}
+		return Result;
+	}
+
+private:
+
+	uint64_t GetBlockSize(uint32_t Level) const
+	{
+		return mSize >> Level;
+	}
+
+	//Deepest level whose blocks can still hold Size bytes
+	uint32_t GetLevel(uint64_t Size) const
+	{
+		uint32_t Level = static_cast<uint32_t>(mFreeBlocks.size()) - 1;
+		while (Level > 0 && GetBlockSize(Level) < Size)
+		{
+			--Level;
+		}
+		return Level;
+	}
+
+	uint64_t mSize = 0;
+
+	uint64_t mMinBlockSize = 0;
+
+	uint64_t mUsedSize = 0;
+
+	//Free block offsets per level
+	std::vector<std::set<uint64_t>> mFreeBlocks;
+
+	//Level of every live allocation, keyed by offset
+	std::unordered_map<uint64_t, uint32_t> mAllocatedLevels;
+};
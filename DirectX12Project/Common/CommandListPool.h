@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "GpuFence.h"
+#include "TaskSystem.h"
+
+struct CommandListPoolStatistics
+{
+	uint64_t mAllocatorsCreated = 0;
+
+	uint64_t mAllocatorsReused = 0;
+
+	uint64_t mCommandListsCreated = 0;
+
+	uint64_t mCommandListsReused = 0;
+};
+
+/*
+	Per thread pools of command allocators and command lists, recycled with the frame fence.
+
+	An allocator owns the memory of every command recorded through it, so it can only be reset once the GPU has executed
+	all of them, and only one command list may record into it at a time. Giving every thread its own allocators avoids
+	any locking while recording; retiring them with the fence value of the frame that used them, and reusing them only
+	once the fence got there, avoids any wait. A command list instead can be reset as soon as it has been submitted.
+
+	The device is abstracted by DeviceType so the recycling can run without a GPU. It must provide:
+
+		typedef ... AllocatorHandle;
+		typedef ... CommandListHandle;
+		AllocatorHandle CreateAllocator();
+		CommandListHandle CreateCommandList(AllocatorHandle Allocator);    //created closed
+		void ResetAllocator(AllocatorHandle Allocator);
+		void ResetCommandList(CommandListHandle CommandList, AllocatorHandle Allocator);
+		void CloseCommandList(CommandListHandle CommandList);
+
+	Usage, once per frame:
+
+		Pool.BeginFrame(FenceValueSignaledAtTheEndOfTheFrame);
+		auto CommandLists = Pool.Record(Tasks, TaskCount, [](uint32_t Task, CommandListHandle CommandList) { ... });
+		... execute CommandLists, in order, in a single batch ...
+		Pool.EndFrame();
+*/
+template <typename DeviceType>
+class CommandListPool
+{
+public:
+
+	typedef typename DeviceType::AllocatorHandle AllocatorHandle;
+	typedef typename DeviceType::CommandListHandle CommandListHandle;
+
+	CommandListPool(DeviceType& Device, IGpuFence& Fence, uint32_t ThreadCount)
+		: mDevice(Device), mFence(Fence)
+	{
+		if (ThreadCount == 0)
+		{
+			throw std::invalid_argument("CommandListPool needs at least one thread");
+		}
+
+		//Separate allocations, so that threads don't share cache lines while recording
+		mThreads.reserve(ThreadCount);
+		for (uint32_t i = 0; i < ThreadCount; ++i)
+		{
+			mThreads.emplace_back(new ThreadPool());
+		}
+	}
+
+	CommandListPool(const CommandListPool&) = delete;
+	CommandListPool& operator=(const CommandListPool&) = delete;
+
+	uint32_t GetThreadCount() const
+	{
+		return static_cast<uint32_t>(mThreads.size());
+	}
+
+	//Everything recorded until EndFrame() is submitted before the fence gets signaled with FenceValue
+	void BeginFrame(uint64_t FenceValue)
+	{
+		if (mFrameActive)
+		{
+			throw std::logic_error("CommandListPool::BeginFrame called twice without EndFrame");
+		}
+		mFrameActive = true;
+		mFrameFenceValue = FenceValue;
+
+		//One fence read per frame rather than one per allocator
+		mCompletedFenceValue = mFence.GetCompletedValue();
+	}
+
+	//Command list ready to record for ThreadIndex. Lists from the same thread share its allocator for this frame, so
+	//the previous one must be closed first.
+	CommandListHandle Acquire(uint32_t ThreadIndex)
+	{
+		if (!mFrameActive)
+		{
+			throw std::logic_error("CommandListPool::Acquire called outside of a frame");
+		}
+
+		ThreadPool& Thread = *mThreads.at(ThreadIndex);
+		if (!Thread.mHasAllocator)
+		{
+			Thread.mAllocator = AcquireAllocator(Thread);
+			Thread.mHasAllocator = true;
+		}
+
+		CommandListHandle CommandList;
+		if (!Thread.mFreeCommandLists.empty())
+		{
+			CommandList = Thread.mFreeCommandLists.back();
+			Thread.mFreeCommandLists.pop_back();
+			mDevice.ResetCommandList(CommandList, Thread.mAllocator);
+			++Thread.mStatistics.mCommandListsReused;
+		}
+		else
+		{
+			//New command lists come out closed, reset them like recycled ones so they start in the same state
+			CommandList = mDevice.CreateCommandList(Thread.mAllocator);
+			mDevice.ResetCommandList(CommandList, Thread.mAllocator);
+			++Thread.mStatistics.mCommandListsCreated;
+		}
+
+		Thread.mUsedCommandLists.push_back(CommandList);
+		return CommandList;
+	}
+
+	//Record Task(0) ... Task(TaskCount - 1) on the task system, each into its own command list from the pool of the
+	//thread that runs it. The lists come back closed and in task order, whichever thread recorded them.
+	std::vector<CommandListHandle> Record(TaskSystem& Tasks, uint32_t TaskCount, const std::function<void(uint32_t, CommandListHandle)>& Task)
+	{
+		if (Tasks.GetThreadCount() > GetThreadCount())
+		{
+			throw std::invalid_argument("CommandListPool has fewer thread pools than the task system has threads");
+		}
+
+		std::vector<CommandListHandle> CommandLists(TaskCount);
+		Tasks.ParallelFor(TaskCount, [&](uint32_t TaskIndex)
+		{
+			const uint32_t ThreadIndex = TaskSystem::GetCurrentThreadIndex();
+			CommandListHandle CommandList = Acquire(ThreadIndex);
+			Task(TaskIndex, CommandList);
+			mDevice.CloseCommandList(CommandList);
+			CommandLists[TaskIndex] = CommandList;
+		});
+		return CommandLists;
+	}
+
+	//The command lists of the frame have been submitted: they can be reset right away, the allocators once the GPU
+	//reaches the frame fence value
+	void EndFrame()
+	{
+		if (!mFrameActive)
+		{
+			throw std::logic_error("CommandListPool::EndFrame called without BeginFrame");
+		}
+		mFrameActive = false;
+
+		for (auto& Thread : mThreads)
+		{
+			if (Thread->mHasAllocator)
+			{
+				Thread->mRetiredAllocators.push_back({ Thread->mAllocator, mFrameFenceValue });
+				Thread->mHasAllocator = false;
+			}
+
+			Thread->mFreeCommandLists.insert(Thread->mFreeCommandLists.end(), Thread->mUsedCommandLists.begin(), Thread->mUsedCommandLists.end());
+			Thread->mUsedCommandLists.clear();
+		}
+	}
+
+	//Sum over all threads. Only call between frames.
+	CommandListPoolStatistics GetStatistics() const
+	{
+		CommandListPoolStatistics Statistics;
+		for (const auto& Thread : mThreads)
+		{
+			Statistics.mAllocatorsCreated += Thread->mStatistics.mAllocatorsCreated;
+			Statistics.mAllocatorsReused += Thread->mStatistics.mAllocatorsReused;
+			Statistics.mCommandListsCreated += Thread->mStatistics.mCommandListsCreated;
+			Statistics.mCommandListsReused += Thread->mStatistics.mCommandListsReused;
+		}
+		return Statistics;
+	}
+
+private:
+
+	struct RetiredAllocator
+	{
+		AllocatorHandle mAllocator;
+
+		//Fence value of the last frame that recorded into it
+		uint64_t mFenceValue;
+	};
+
+	struct ThreadPool
+	{
+		//Allocator of the current frame
+		AllocatorHandle mAllocator{};
+
+		bool mHasAllocator = false;
+
+		//Oldest first: frames complete in order, so only the front needs checking
+		std::deque<RetiredAllocator> mRetiredAllocators;
+
+		std::vector<CommandListHandle> mFreeCommandLists;
+
+		std::vector<CommandListHandle> mUsedCommandLists;
+
+		CommandListPoolStatistics mStatistics;
+	};
+
+	AllocatorHandle AcquireAllocator(ThreadPool& Thread)
+	{
+		if (!Thread.mRetiredAllocators.empty() && Thread.mRetiredAllocators.front().mFenceValue <= mCompletedFenceValue)
+		{
+			AllocatorHandle Allocator = Thread.mRetiredAllocators.front().mAllocator;
+			Thread.mRetiredAllocators.pop_front();
+			mDevice.ResetAllocator(Allocator);
+			++Thread.mStatistics.mAllocatorsReused;
+			return Allocator;
+		}
+
+		//The GPU is still using all of them: grow rather than wait. Bounded by the number of frames in flight.
+		++Thread.mStatistics.mAllocatorsCreated;
+		return mDevice.CreateAllocator();
+	}
+
+	DeviceType& mDevice;
+
+	IGpuFence& mFence;
+
+	std::vector<std::unique_ptr<ThreadPool>> mThreads;
+
+	bool mFrameActive = false;
+
+	uint64_t mFrameFenceValue = 0;
+
+	uint64_t mCompletedFenceValue = 0;
+};
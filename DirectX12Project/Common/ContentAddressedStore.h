@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "Hash.h"
+
+/*
+	A local directory of files named after a hash of everything that went into producing them (compiled shaders ...).
+
+	Nothing ever needs invalidating: different inputs make a different key, so a different file, and an entry that
+	exists is always the right one. Entries are written to a temporary file and renamed, so a crash, or two threads or
+	processes producing the same entry at the same time, never leave a half written file behind; whoever renames last
+	wins, and both wrote the same bytes anyway.
+*/
+class ContentAddressedStore
+{
+public:
+
+	ContentAddressedStore(const std::string& Directory, const std::string& Extension)
+		: mDirectory(Directory), mExtension(Extension)
+	{
+	}
+
+	const std::string& GetDirectory() const
+	{
+		return mDirectory;
+	}
+
+	std::string GetPath(uint64_t Key) const
+	{
+		return mDirectory + "/" + HashToString(Key) + mExtension;
+	}
+
+	bool Contains(uint64_t Key) const
+	{
+		std::ifstream File(GetPath(Key), std::ios::binary);
+		return File.is_open();
+	}
+
+	bool Load(uint64_t Key, std::vector<char>& Data) const
+	{
+		std::ifstream File(GetPath(Key), std::ios::ate | std::ios::binary);
+		if (!File.is_open())
+		{
+			return false;
+		}
+
+		Data.resize(static_cast<size_t>(File.tellg()));
+		File.seekg(0);
+		return static_cast<bool>(File.read(Data.data(), Data.size()));
+	}
+
+	//Returns false if the entry couldn't be written (the caller still has the data, it just won't be cached)
+	bool Store(uint64_t Key, const void* Data, size_t Size) const
+	{
+		MakeDirectory();
+
+		const std::string Path = GetPath(Key);
+		const std::string TempPath = Path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+		{
+			std::ofstream File(TempPath, std::ios::binary | std::ios::trunc);
+			if (!File.is_open())
+			{
+				return false;
+			}
+			File.write(static_cast<const char*>(Data), Size);
+			if (!File.good())
+			{
+				File.close();
+				std::remove(TempPath.c_str());
+				return false;
+			}
+		}
+
+		//std::rename doesn't replace an existing file on Windows: if it's there, someone stored the same content already
+		if (std::rename(TempPath.c_str(), Path.c_str()) != 0)
+		{
+			std::remove(TempPath.c_str());
+			return Contains(Key);
+		}
+		return true;
+	}
+
+private:
+
+	void MakeDirectory() const
+	{
+#ifdef _WIN32
+		_mkdir(mDirectory.c_str());
+#else
+		mkdir(mDirectory.c_str(), 0755);
+#endif
+	}
+
+	std::string mDirectory;
+
+	std::string mExtension;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+
+/*
+	Destroys GPU objects only once the GPU can't be using them anymore.
+
+	Every deletion is tagged with a GPU progress value: a frame number, a fence value, a timeline semaphore value ...
+	whatever monotonically increasing counter the renderer uses. Collect() is called with the last value known to be
+	completed (e.g. after waiting on a frame fence) and runs every deletion tagged with a value up to that point.
+	No device wide wait is ever needed, which is what lets things like swap chain recreation happen without stalling.
+*/
+class DeferredDeletionQueue
+{
+public:
+
+	DeferredDeletionQueue() = default;
+
+	~DeferredDeletionQueue() = default;
+
+	DeferredDeletionQueue(const DeferredDeletionQueue&) = delete;
+	DeferredDeletionQueue& operator=(const DeferredDeletionQueue&) = delete;
+
+	//Deleter runs once the GPU has completed RetireValue. Values must be enqueued in non decreasing order.
+	void Enqueue(uint64_t RetireValue, std::function<void()> Deleter)
+	{
+		mEntries.emplace_back(RetireValue, std::move(Deleter));
+	}
+
+	//Run the deletions whose retire value is <= CompletedValue
+	void Collect(uint64_t CompletedValue)
+	{
+		while (!mEntries.empty() && mEntries.front().first <= CompletedValue)
+		{
+			//Pop before running so that a throwing deleter doesn't get run twice
+			std::function<void()> Deleter = std::move(mEntries.front().second);
+			mEntries.pop_front();
+			Deleter();
+		}
+	}
+
+	//Run everything regardless of GPU progress (the device must be idle)
+	void Flush()
+	{
+		Collect(~0ull);
+	}
+
+	size_t GetPendingCount() const
+	{
+		return mEntries.size();
+	}
+
+private:
+
+	std::deque<std::pair<uint64_t, std::function<void()>>> mEntries;
+};
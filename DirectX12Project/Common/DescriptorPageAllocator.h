@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+//Count contiguous descriptors at Offset in page Page
+struct DescriptorRange
+{
+	static constexpr uint32_t kInvalidPage = ~0u;
+
+	uint32_t mPage = kInvalidPage;
+
+	uint32_t mOffset = 0;
+
+	uint32_t mCount = 0;
+
+	bool IsValid() const
+	{
+		return mPage != kInvalidPage;
+	}
+};
+
+struct DescriptorPageStatistics
+{
+	uint32_t mPageCount = 0;
+
+	//Descriptors handed out and not freed yet
+	uint32_t mAllocatedCount = 0;
+
+	//Descriptors freed but waiting for the GPU to retire them
+	uint32_t mPendingFreeCount = 0;
+
+	uint64_t mTotalAllocations = 0;
+
+	uint64_t mTotalFrees = 0;
+};
+
+/*
+	Bookkeeping of descriptor heaps split in pages of a fixed number of descriptors (D3D12 CPU only heaps, or any other
+	array of descriptors addressed by index). It never touches a heap: a new page is announced through the CreatePage
+	callback, and ranges are (page, offset, count).
+
+	Every page keeps a free list of ranges sorted by offset, merged with their neighbours on free, so that the common
+	single descriptor allocations don't fragment the page. Pages remember how many descriptors they have left, so full
+	pages are skipped without looking at their free list.
+
+	A view may still be referenced by commands in flight (or by a shader visible copy of it), so Free() takes the fence
+	value of the last frame that can use it and the range only goes back to the free list in Retire().
+*/
+class DescriptorPageAllocator
+{
+public:
+
+	DescriptorPageAllocator(uint32_t DescriptorsPerPage, std::function<void(uint32_t)> CreatePage)
+		: mDescriptorsPerPage(DescriptorsPerPage), mCreatePage(std::move(CreatePage))
+	{
+		if (DescriptorsPerPage == 0)
+		{
+			throw std::invalid_argument("DescriptorPageAllocator pages can't be empty");
+		}
+	}
+
+	DescriptorPageAllocator(const DescriptorPageAllocator&) = delete;
+	DescriptorPageAllocator& operator=(const DescriptorPageAllocator&) = delete;
+
+	uint32_t GetDescriptorsPerPage() const
+	{
+		return mDescriptorsPerPage;
+	}
+
+	uint32_t GetPageCount() const
+	{
+		return static_cast<uint32_t>(mPages.size());
+	}
+
+	//Count contiguous descriptors, from the first page that has room (a new page if none has)
+	DescriptorRange Allocate(uint32_t Count)
+	{
+		if (Count == 0 || Count > mDescriptorsPerPage)
+		{
+			throw std::invalid_argument("Descriptor range doesn't fit in a page");
+		}
+
+		for (uint32_t PageIndex = 0; PageIndex < mPages.size(); ++PageIndex)
+		{
+			if (mPages[PageIndex].mFreeCount < Count)
+			{
+				continue;
+			}
+
+			DescriptorRange Range;
+			if (AllocateFromPage(PageIndex, Count, Range))
+			{
+				return Range;
+			}
+		}
+
+		const uint32_t PageIndex = static_cast<uint32_t>(mPages.size());
+		mPages.emplace_back();
+		mPages.back().mFreeRanges[0] = mDescriptorsPerPage;
+		mPages.back().mFreeCount = mDescriptorsPerPage;
+		mCreatePage(PageIndex);
+
+		DescriptorRange Range;
+		AllocateFromPage(PageIndex, Count, Range);
+		return Range;
+	}
+
+	//The range can be reused once the GPU reaches FenceValue (values must not decrease)
+	void Free(const DescriptorRange& Range, uint64_t FenceValue)
+	{
+		if (!Range.IsValid())
+		{
+			return;
+		}
+		mPendingFrees.push_back({ Range, FenceValue });
+		mStatistics.mPendingFreeCount += Range.mCount;
+	}
+
+	//The range isn't referenced by anything in flight
+	void FreeImmediately(const DescriptorRange& Range)
+	{
+		if (!Range.IsValid())
+		{
+			return;
+		}
+		ReleaseRange(Range);
+	}
+
+	//Give back the ranges freed by the frames the GPU has completed
+	void Retire(uint64_t CompletedValue)
+	{
+		while (!mPendingFrees.empty() && mPendingFrees.front().mFenceValue <= CompletedValue)
+		{
+			mStatistics.mPendingFreeCount -= mPendingFrees.front().mRange.mCount;
+			ReleaseRange(mPendingFrees.front().mRange);
+			mPendingFrees.pop_front();
+		}
+	}
+
+	DescriptorPageStatistics GetStatistics() const
+	{
+		DescriptorPageStatistics Statistics = mStatistics;
+		Statistics.mPageCount = GetPageCount();
+		return Statistics;
+	}
+
+private:
+
+	struct Page
+	{
+		//Offset -> count, no two adjacent ranges
+		std::map<uint32_t, uint32_t> mFreeRanges;
+
+		uint32_t mFreeCount = 0;
+	};
+
+	struct PendingFree
+	{
+		DescriptorRange mRange;
+
+		uint64_t mFenceValue;
+	};
+
+	bool AllocateFromPage(uint32_t PageIndex, uint32_t Count, DescriptorRange& Range)
+	{
+		Page& CurrentPage = mPages[PageIndex];
+
+		//First fit: keeps allocations packed at the beginning of the page
+		for (auto It = CurrentPage.mFreeRanges.begin(); It != CurrentPage.mFreeRanges.end(); ++It)
+		{
+			if (It->second < Count)
+			{
+				continue;
+			}
+
+			const uint32_t Offset = It->first;
+			const uint32_t Remaining = It->second - Count;
+			CurrentPage.mFreeRanges.erase(It);
+			if (Remaining > 0)
+			{
+				CurrentPage.mFreeRanges[Offset + Count] = Remaining;
+			}
+			CurrentPage.mFreeCount -= Count;
+
+			Range.mPage = PageIndex;
+			Range.mOffset = Offset;
+			Range.mCount = Count;
+
+			mStatistics.mAllocatedCount += Count;
+			++mStatistics.mTotalAllocations;
+			return true;
+		}
+		return false;
+	}
+
+	void ReleaseRange(const DescriptorRange& Range)
+	{
+		Page& CurrentPage = mPages.at(Range.mPage);
+
+		uint32_t Offset = Range.mOffset;
+		uint32_t Count = Range.mCount;
+
+		//Merge with the free range right after
+		auto Next = CurrentPage.mFreeRanges.lower_bound(Offset);
+		if (Next != CurrentPage.mFreeRanges.end() && Next->first == Offset + Count)
+		{
+			Count += Next->second;
+			Next = CurrentPage.mFreeRanges.erase(Next);
+		}
+
+		//And with the one right before
+		if (Next != CurrentPage.mFreeRanges.begin())
+		{
+			auto Previous = std::prev(Next);
+			if (Previous->first + Previous->second == Offset)
+			{
+				Offset = Previous->first;
+				Count += Previous->second;
+				CurrentPage.mFreeRanges.erase(Previous);
+			}
+		}
+
+		CurrentPage.mFreeRanges[Offset] = Count;
+		CurrentPage.mFreeCount += Range.mCount;
+
+		mStatistics.mAllocatedCount -= Range.mCount;
+		++mStatistics.mTotalFrees;
+	}
+
+	uint32_t mDescriptorsPerPage;
+
+	std::function<void(uint32_t)> mCreatePage;
+
+	std::vector<Page> mPages;
+
+	std::deque<PendingFree> mPendingFrees;
+
+	DescriptorPageStatistics mStatistics;
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+	Watches the files of a directory (not its subdirectories) from a background thread and collects the ones that get
+	written, created or renamed into it: inotify on Linux, ReadDirectoryChangesW on Windows.
+
+	Editors save in several steps (truncate then write, or write a temporary file and rename it over the original), so a
+	file is only listed once until PollChanges() picks it up. PollChanges() never blocks.
+*/
+class FileWatcher
+{
+public:
+
+	//How often the watching thread checks whether it must quit
+	static constexpr uint32_t kQuitPollMs = 100;
+
+	explicit FileWatcher(const std::string& Directory)
+		: mDirectory(Directory)
+	{
+#if defined(_WIN32)
+		mDirectoryHandle = CreateFileA(Directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+		if (mDirectoryHandle == INVALID_HANDLE_VALUE)
+		{
+			throw std::runtime_error("Failed to watch directory " + Directory);
+		}
+		mEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+#else
+		mInotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (mInotify < 0 || inotify_add_watch(mInotify, Directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+		{
+			if (mInotify >= 0)
+			{
+				close(mInotify);
+			}
+			throw std::runtime_error("Failed to watch directory " + Directory);
+		}
+#endif
+		mThread = std::thread([this]() { WatchLoop(); });
+	}
+
+	~FileWatcher()
+	{
+		mQuitting = true;
+		mThread.join();
+
+#if defined(_WIN32)
+		CloseHandle(mEvent);
+		CloseHandle(mDirectoryHandle);
+#else
+		close(mInotify);
+#endif
+	}
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	//Files changed since the last call, as Directory/Name
+	std::vector<std::string> PollChanges()
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		std::vector<std::string> Changes;
+		Changes.swap(mChanges);
+		return Changes;
+	}
+
+private:
+
+	void AddChange(const std::string& Name)
+	{
+		const std::string Path = mDirectory + "/" + Name;
+
+		std::lock_guard<std::mutex> Lock(mMutex);
+		if (std::find(mChanges.begin(), mChanges.end(), Path) == mChanges.end())
+		{
+			mChanges.push_back(Path);
+		}
+	}
+
+#if defined(_WIN32)
+	void WatchLoop()
+	{
+		//FILE_NOTIFY_INFORMATION records are DWORD aligned
+		DWORD Buffer[16 * 1024];
+		OVERLAPPED Overlapped = {};
+		Overlapped.hEvent = mEvent;
+
+		const DWORD Filter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME;
+		bool Reading = ReadDirectoryChangesW(mDirectoryHandle, Buffer, sizeof(Buffer), FALSE, Filter, nullptr, &Overlapped, nullptr) != FALSE;
+
+		while (Reading && !mQuitting)
+		{
+			if (WaitForSingleObject(mEvent, kQuitPollMs) != WAIT_OBJECT_0)
+			{
+				continue;
+			}
+
+			DWORD Size = 0;
+			if (GetOverlappedResult(mDirectoryHandle, &Overlapped, &Size, FALSE) && Size != 0)
+			{
+				const uint8_t* Record = reinterpret_cast<const uint8_t*>(Buffer);
+				while (true)
+				{
+					const FILE_NOTIFY_INFORMATION* Info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(Record);
+					if (Info->Action != FILE_ACTION_REMOVED && Info->Action != FILE_ACTION_RENAMED_OLD_NAME)
+					{
+						char Name[MAX_PATH] = {};
+						WideCharToMultiByte(CP_UTF8, 0, Info->FileName, static_cast<int>(Info->FileNameLength / sizeof(WCHAR)), Name, MAX_PATH - 1, nullptr, nullptr);
+						AddChange(Name);
+					}
+					if (Info->NextEntryOffset == 0)
+					{
+						break;
+					}
+					Record += Info->NextEntryOffset;
+				}
+			}
+			//Size 0 means the buffer overflowed and the changes were lost: nothing to do but keep watching
+
+			ResetEvent(mEvent);
+			Reading = ReadDirectoryChangesW(mDirectoryHandle, Buffer, sizeof(Buffer), FALSE, Filter, nullptr, &Overlapped, nullptr) != FALSE;
+		}
+
+		//The read still pending writes into Buffer, it must be over before Buffer goes away
+		if (Reading)
+		{
+			DWORD Size = 0;
+			CancelIo(mDirectoryHandle);
+			GetOverlappedResult(mDirectoryHandle, &Overlapped, &Size, TRUE);
+		}
+	}
+
+	HANDLE mDirectoryHandle = INVALID_HANDLE_VALUE;
+
+	HANDLE mEvent = nullptr;
+#else
+	void WatchLoop()
+	{
+		alignas(inotify_event) char Buffer[16 * 1024];
+		while (!mQuitting)
+		{
+			pollfd Poll = {};
+			Poll.fd = mInotify;
+			Poll.events = POLLIN;
+			if (poll(&Poll, 1, kQuitPollMs) <= 0)
+			{
+				continue;
+			}
+
+			const ssize_t Size = read(mInotify, Buffer, sizeof(Buffer));
+			for (ssize_t Offset = 0; Offset < Size;)
+			{
+				const inotify_event* Event = reinterpret_cast<const inotify_event*>(Buffer + Offset);
+				if (Event->len > 0)
+				{
+					AddChange(Event->name);
+				}
+				Offset += sizeof(inotify_event) + Event->len;
+			}
+		}
+	}
+
+	int mInotify = -1;
+#endif
+
+	std::string mDirectory;
+
+	std::atomic<bool> mQuitting{ false };
+
+	std::mutex mMutex;
+
+	std::vector<std::string> mChanges;
+
+	std::thread mThread;
+};
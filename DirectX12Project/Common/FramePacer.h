@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "GpuFence.h"
+
+struct FramePacerStatistics
+{
+	uint64_t mFrameCount = 0;
+
+	//Frames that found their buffer still in flight and had to wait for the GPU
+	uint64_t mBlockedFrameCount = 0;
+
+	double mTotalBlockedMs = 0.0;
+
+	double mLastBlockedMs = 0.0;
+
+	double mMaxBlockedMs = 0.0;
+};
+
+/*
+	Lets the CPU run up to BufferCount frames ahead of the GPU.
+
+	Every buffered frame resource (back buffer, command allocator, per frame constants ...) remembers the fence value
+	signaled after the last frame that used it. Before recording into a buffer again, WaitForBuffer() blocks only if the
+	GPU hasn't reached that value yet, i.e. only when every buffer is really in flight. Waiting right before the reuse,
+	rather than right after submitting, is what lets the CPU build frame N+1 while the GPU is still on frame N.
+
+		Pacer.WaitForBuffer(Index);    //before resetting the allocator of Index
+		... record, submit, present ...
+		Pacer.EndFrame(Index);         //signals the fence for Index
+*/
+class FramePacer
+{
+public:
+
+	FramePacer(IGpuFence& Fence, uint32_t BufferCount)
+		: mFence(Fence), mBufferFenceValues(BufferCount, 0)
+	{
+		if (BufferCount == 0)
+		{
+			throw std::invalid_argument("FramePacer needs at least one buffer");
+		}
+	}
+
+	FramePacer(const FramePacer&) = delete;
+	FramePacer& operator=(const FramePacer&) = delete;
+
+	uint32_t GetBufferCount() const
+	{
+		return static_cast<uint32_t>(mBufferFenceValues.size());
+	}
+
+	//The GPU hasn't finished the last frame that used the buffer
+	bool IsBufferInFlight(uint32_t BufferIndex)
+	{
+		return mFence.GetCompletedValue() < mBufferFenceValues.at(BufferIndex);
+	}
+
+	//Number of submitted frames the GPU hasn't finished yet
+	uint32_t GetFramesInFlight()
+	{
+		const uint64_t Completed = mFence.GetCompletedValue();
+		return static_cast<uint32_t>(mLastSignaledValue > Completed ? mLastSignaledValue - Completed : 0);
+	}
+
+	//Make sure the GPU is done with the buffer before it gets reused. Returns the time spent blocked, in milliseconds.
+	double WaitForBuffer(uint32_t BufferIndex)
+	{
+		mStatistics.mLastBlockedMs = 0.0;
+		if (!IsBufferInFlight(BufferIndex))
+		{
+			return 0.0;
+		}
+
+		const auto Start = std::chrono::steady_clock::now();
+		mFence.Wait(mBufferFenceValues[BufferIndex]);
+		const double BlockedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+
+		++mStatistics.mBlockedFrameCount;
+		mStatistics.mTotalBlockedMs += BlockedMs;
+		mStatistics.mLastBlockedMs = BlockedMs;
+		mStatistics.mMaxBlockedMs = std::max(mStatistics.mMaxBlockedMs, BlockedMs);
+		return BlockedMs;
+	}
+
+	//The frame using the buffer has been submitted: signal the fence and tie the value to the buffer. Returns the value.
+	uint64_t EndFrame(uint32_t BufferIndex)
+	{
+		const uint64_t Value = ++mLastSignaledValue;
+		mFence.Signal(Value);
+		mBufferFenceValues.at(BufferIndex) = Value;
+		++mStatistics.mFrameCount;
+		return Value;
+	}
+
+	//Value signaled after the last frame that used the buffer (0 if it has never been used)
+	uint64_t GetBufferFenceValue(uint32_t BufferIndex) const
+	{
+		return mBufferFenceValues.at(BufferIndex);
+	}
+
+	uint64_t GetLastSignaledValue() const
+	{
+		return mLastSignaledValue;
+	}
+
+	//Block until the GPU has finished every submitted frame (resize, shutdown ...)
+	void WaitIdle()
+	{
+		mFence.Wait(mLastSignaledValue);
+	}
+
+	const FramePacerStatistics& GetStatistics() const
+	{
+		return mStatistics;
+	}
+
+private:
+
+	IGpuFence& mFence;
+
+	std::vector<uint64_t> mBufferFenceValues;
+
+	uint64_t mLastSignaledValue = 0;
+
+	FramePacerStatistics mStatistics;
+};
@@ -0,0 +1,364 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "RollingStatistics.h"
+
+//Timings of a single frame, in milliseconds
+struct FrameSample
+{
+	//From the beginning of this frame to the beginning of the next one
+	double mFrameMs = 0.0;
+
+	//CPU work: the frame time minus the time spent blocked on the GPU and in present
+	double mCpuMs = 0.0;
+
+	//Time spent blocked waiting for the GPU (fences, timeline semaphores ...)
+	double mWaitMs = 0.0;
+
+	//Time spent in the present call
+	double mPresentMs = 0.0;
+};
+
+//Distribution of one of the FrameSample timings
+struct TimingPercentiles
+{
+	double mAverage = 0.0;
+	double mP50 = 0.0;
+	double mP95 = 0.0;
+	double mP99 = 0.0;
+	double mMax = 0.0;
+};
+
+struct FrameStatisticsReport
+{
+	size_t mFrameCount = 0;
+
+	//Average frames per second over the reported frames
+	double mFps = 0.0;
+
+	TimingPercentiles mFrame;
+	TimingPercentiles mCpu;
+	TimingPercentiles mWait;
+	TimingPercentiles mPresent;
+
+	//Frame time histogram: bucket i counts the frames in [i * BucketMs, (i + 1) * BucketMs), the last one everything above
+	double mHistogramBucketMs = 1.0;
+	std::vector<uint32_t> mHistogram;
+};
+
+/*
+	Records the timings of every frame into a fixed size ring and turns them into percentiles and histograms.
+
+	The render thread pushes one sample per frame (AddFrame, usually through a FrameTimer) and never blocks or allocates.
+	Any thread can take a snapshot at any time: every slot is protected by a sequence counter (seqlock), so a reader
+	that races with the writer just skips the slot being written instead of reading a torn sample.
+	Single writer only.
+
+	Averages alone hide stutter: a 60 FPS average can be made of 10 ms frames and a few 100 ms hitches. Percentiles
+	and the histogram show them, which is why both backends report through this rather than an FPS counter.
+*/
+class FrameStatistics
+{
+public:
+
+	static constexpr size_t kDefaultCapacity = 4096;
+
+	explicit FrameStatistics(size_t Capacity = kDefaultCapacity)
+		: mSlots(std::max<size_t>(Capacity, 1))
+	{
+	}
+
+	FrameStatistics(const FrameStatistics&) = delete;
+	FrameStatistics& operator=(const FrameStatistics&) = delete;
+
+	void AddFrame(const FrameSample& Sample)
+	{
+		const uint64_t Index = mWriteIndex.load(std::memory_order_relaxed);
+		Slot& Target = mSlots[Index % mSlots.size()];
+
+		//Odd sequence: write in progress
+		const uint64_t Sequence = Target.mSequence.load(std::memory_order_relaxed);
+		Target.mSequence.store(Sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		Target.mFrameMs.store(Sample.mFrameMs, std::memory_order_relaxed);
+		Target.mCpuMs.store(Sample.mCpuMs, std::memory_order_relaxed);
+		Target.mWaitMs.store(Sample.mWaitMs, std::memory_order_relaxed);
+		Target.mPresentMs.store(Sample.mPresentMs, std::memory_order_relaxed);
+
+		Target.mSequence.store(Sequence + 2, std::memory_order_release);
+		mWriteIndex.store(Index + 1, std::memory_order_release);
+	}
+
+	//Total number of frames recorded so far (the ring only keeps the last GetCapacity() of them)
+	uint64_t GetFrameCount() const
+	{
+		return mWriteIndex.load(std::memory_order_acquire);
+	}
+
+	size_t GetCapacity() const
+	{
+		return mSlots.size();
+	}
+
+	//Copy of the last MaxFrames samples (or as many as available), oldest first
+	std::vector<FrameSample> Snapshot(size_t MaxFrames = ~size_t(0)) const
+	{
+		const uint64_t End = mWriteIndex.load(std::memory_order_acquire);
+		const uint64_t Count = std::min<uint64_t>({ End, mSlots.size(), MaxFrames });
+
+		std::vector<FrameSample> Samples;
+		Samples.reserve(static_cast<size_t>(Count));
+		for (uint64_t Index = End - Count; Index < End; ++Index)
+		{
+			const Slot& Source = mSlots[Index % mSlots.size()];
+
+			const uint64_t Before = Source.mSequence.load(std::memory_order_acquire);
+			FrameSample Sample;
+			Sample.mFrameMs = Source.mFrameMs.load(std::memory_order_relaxed);
+			Sample.mCpuMs = Source.mCpuMs.load(std::memory_order_relaxed);
+			Sample.mWaitMs = Source.mWaitMs.load(std::memory_order_relaxed);
+			Sample.mPresentMs = Source.mPresentMs.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			const uint64_t After = Source.mSequence.load(std::memory_order_relaxed);
+
+			//Being written, or already overwritten by a newer frame
+			if (Before != After || (Before & 1) != 0)
+			{
+				continue;
+			}
+			Samples.push_back(Sample);
+		}
+		return Samples;
+	}
+
+	//Percentiles and histogram of the last MaxFrames frames
+	FrameStatisticsReport ComputeReport(size_t MaxFrames = ~size_t(0), double HistogramBucketMs = 1.0, size_t HistogramBucketCount = 50) const
+	{
+		return ComputeReport(Snapshot(MaxFrames), HistogramBucketMs, HistogramBucketCount);
+	}
+
+	static FrameStatisticsReport ComputeReport(const std::vector<FrameSample>& Samples, double HistogramBucketMs = 1.0, size_t HistogramBucketCount = 50)
+	{
+		FrameStatisticsReport Report;
+		Report.mFrameCount = Samples.size();
+		Report.mHistogramBucketMs = HistogramBucketMs;
+		Report.mHistogram.assign(std::max<size_t>(HistogramBucketCount, 1), 0);
+		if (Samples.empty())
+		{
+			return Report;
+		}
+
+		std::vector<double> Values(Samples.size());
+		auto Summarize = [&](double FrameSample::* Member)
+		{
+			for (size_t i = 0; i < Samples.size(); ++i)
+			{
+				Values[i] = Samples[i].*Member;
+			}
+			std::sort(Values.begin(), Values.end());
+
+			double Sum = 0.0;
+			for (double Value : Values)
+			{
+				Sum += Value;
+			}
+
+			TimingPercentiles Percentiles;
+			Percentiles.mAverage = Sum / Values.size();
+			Percentiles.mP50 = GetSortedPercentile(Values, 50.0);
+			Percentiles.mP95 = GetSortedPercentile(Values, 95.0);
+			Percentiles.mP99 = GetSortedPercentile(Values, 99.0);
+			Percentiles.mMax = Values.back();
+			return Percentiles;
+		};
+
+		Report.mFrame = Summarize(&FrameSample::mFrameMs);
+		Report.mCpu = Summarize(&FrameSample::mCpuMs);
+		Report.mWait = Summarize(&FrameSample::mWaitMs);
+		Report.mPresent = Summarize(&FrameSample::mPresentMs);
+		Report.mFps = Report.mFrame.mAverage > 0.0 ? 1000.0 / Report.mFrame.mAverage : 0.0;
+
+		for (const FrameSample& Sample : Samples)
+		{
+			const size_t Bucket = static_cast<size_t>(std::max(0.0, Sample.mFrameMs) / HistogramBucketMs);
+			++Report.mHistogram[std::min(Bucket, Report.mHistogram.size() - 1)];
+		}
+		return Report;
+	}
+
+	//One line summary, e.g. for a once per second console/debugger print
+	static std::string FormatSummary(const FrameStatisticsReport& Report)
+	{
+		char Buffer[512];
+		snprintf(Buffer, sizeof(Buffer),
+			"FPS: %.1f | frame ms p50 %.2f p95 %.2f p99 %.2f max %.2f | cpu p99 %.2f | wait p99 %.2f | present p99 %.2f (%zu frames)",
+			Report.mFps, Report.mFrame.mP50, Report.mFrame.mP95, Report.mFrame.mP99, Report.mFrame.mMax,
+			Report.mCpu.mP99, Report.mWait.mP99, Report.mPresent.mP99, Report.mFrameCount);
+		return Buffer;
+	}
+
+	//Every recorded frame still in the ring, one per line
+	bool ExportCsv(const std::string& FilePath) const
+	{
+		std::ofstream File(FilePath, std::ios::trunc);
+		if (!File.is_open())
+		{
+			return false;
+		}
+
+		File << "frame,frame_ms,cpu_ms,wait_ms,present_ms\n";
+		const std::vector<FrameSample> Samples = Snapshot();
+		for (size_t i = 0; i < Samples.size(); ++i)
+		{
+			File << i << ',' << Samples[i].mFrameMs << ',' << Samples[i].mCpuMs << ',' << Samples[i].mWaitMs << ',' << Samples[i].mPresentMs << '\n';
+		}
+		return File.good();
+	}
+
+	//Percentiles and histogram of every frame still in the ring
+	bool ExportJson(const std::string& FilePath) const
+	{
+		std::ofstream File(FilePath, std::ios::trunc);
+		if (!File.is_open())
+		{
+			return false;
+		}
+
+		const FrameStatisticsReport Report = ComputeReport();
+
+		auto WritePercentiles = [&File](const char* Name, const TimingPercentiles& Percentiles)
+		{
+			File << "  \"" << Name << "\": { \"avg\": " << Percentiles.mAverage << ", \"p50\": " << Percentiles.mP50 << ", \"p95\": " << Percentiles.mP95
+				<< ", \"p99\": " << Percentiles.mP99 << ", \"max\": " << Percentiles.mMax << " },\n";
+		};
+
+		File << "{\n  \"frames\": " << Report.mFrameCount << ",\n  \"fps\": " << Report.mFps << ",\n";
+		WritePercentiles("frameMs", Report.mFrame);
+		WritePercentiles("cpuMs", Report.mCpu);
+		WritePercentiles("waitMs", Report.mWait);
+		WritePercentiles("presentMs", Report.mPresent);
+		File << "  \"histogram\": { \"bucketMs\": " << Report.mHistogramBucketMs << ", \"counts\": [";
+		for (size_t i = 0; i < Report.mHistogram.size(); ++i)
+		{
+			File << (i != 0 ? ", " : "") << Report.mHistogram[i];
+		}
+		File << "] }\n}\n";
+		return File.good();
+	}
+
+private:
+
+	struct Slot
+	{
+		std::atomic<uint64_t> mSequence{ 0 };
+		std::atomic<double> mFrameMs{ 0.0 };
+		std::atomic<double> mCpuMs{ 0.0 };
+		std::atomic<double> mWaitMs{ 0.0 };
+		std::atomic<double> mPresentMs{ 0.0 };
+	};
+
+	std::vector<Slot> mSlots;
+
+	std::atomic<uint64_t> mWriteIndex{ 0 };
+};
+
+/*
+	Measures the phases of each frame on the render thread and feeds a FrameStatistics.
+
+		Timer.BeginFrame();        //once per frame, the frame time goes from one BeginFrame to the next (or to EndFrame)
+		Timer.BeginWait();  ...  Timer.EndWait();         //around every blocking wait on the GPU
+		Timer.BeginPresent();  ...  Timer.EndPresent();   //around present
+*/
+class FrameTimer
+{
+public:
+
+	using Clock = std::chrono::steady_clock;
+
+	explicit FrameTimer(FrameStatistics& Statistics)
+		: mStatistics(Statistics)
+	{
+	}
+
+	//Closes the previous frame (if any) and starts a new one
+	void BeginFrame()
+	{
+		const Clock::time_point Now = Clock::now();
+		EndFrame(Now);
+
+		mFrameStarted = true;
+		mFrameStart = Now;
+		mWaitMs = 0.0;
+		mPresentMs = 0.0;
+	}
+
+	//Closes the current frame without starting a new one (e.g. when leaving the render loop)
+	void EndFrame()
+	{
+		EndFrame(Clock::now());
+	}
+
+	void BeginWait()
+	{
+		mPhaseStart = Clock::now();
+	}
+
+	void EndWait()
+	{
+		mWaitMs += ToMs(Clock::now() - mPhaseStart);
+	}
+
+	void BeginPresent()
+	{
+		mPhaseStart = Clock::now();
+	}
+
+	void EndPresent()
+	{
+		mPresentMs += ToMs(Clock::now() - mPhaseStart);
+	}
+
+private:
+
+	void EndFrame(Clock::time_point Now)
+	{
+		if (!mFrameStarted)
+		{
+			return;
+		}
+		mFrameStarted = false;
+
+		FrameSample Sample;
+		Sample.mFrameMs = ToMs(Now - mFrameStart);
+		Sample.mWaitMs = mWaitMs;
+		Sample.mPresentMs = mPresentMs;
+		Sample.mCpuMs = std::max(0.0, Sample.mFrameMs - Sample.mWaitMs - Sample.mPresentMs);
+		mStatistics.AddFrame(Sample);
+	}
+
+	static double ToMs(Clock::duration Duration)
+	{
+		return std::chrono::duration<double, std::milli>(Duration).count();
+	}
+
+	FrameStatistics& mStatistics;
+
+	bool mFrameStarted = false;
+
+	Clock::time_point mFrameStart;
+
+	Clock::time_point mPhaseStart;
+
+	double mWaitMs = 0.0;
+
+	double mPresentMs = 0.0;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+/*
+	Monotonically increasing GPU progress counter: an ID3D12Fence, a Vulkan timeline semaphore ...
+	The frame pacing and resource recycling code only talks to this interface, so it runs the same on any API and can be
+	driven by SoftwareGpuFence where no GPU is around (tests, tools).
+*/
+class IGpuFence
+{
+public:
+
+	virtual ~IGpuFence() = default;
+
+	//Last value the GPU has reached. Never blocks.
+	virtual uint64_t GetCompletedValue() = 0;
+
+	//Have the GPU set the fence to Value once everything submitted so far has executed
+	virtual void Signal(uint64_t Value) = 0;
+
+	//Block the calling thread until the fence reaches Value
+	virtual void Wait(uint64_t Value) = 0;
+};
+
+/*
+	Fence whose "GPU" is whoever calls Complete(): signals are recorded as pending, and only become completed values when
+	Complete() is called (from any thread), exactly like queued GPU work that finishes later.
+	Stands in for a device in tests and benchmarks.
+*/
+class SoftwareGpuFence : public IGpuFence
+{
+public:
+
+	uint64_t GetCompletedValue() override
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		return mCompletedValue;
+	}
+
+	void Signal(uint64_t Value) override
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mSignaledValue = std::max(mSignaledValue, Value);
+	}
+
+	void Wait(uint64_t Value) override
+	{
+		std::unique_lock<std::mutex> Lock(mMutex);
+		mCondition.wait(Lock, [this, Value] { return mCompletedValue >= Value; });
+	}
+
+	//The GPU reached Value (clamped to what has been signaled)
+	void Complete(uint64_t Value)
+	{
+		{
+			std::lock_guard<std::mutex> Lock(mMutex);
+			mCompletedValue = std::max(mCompletedValue, std::min(Value, mSignaledValue));
+		}
+		mCondition.notify_all();
+	}
+
+	//The GPU caught up with everything signaled so far
+	void CompleteAll()
+	{
+		{
+			std::lock_guard<std::mutex> Lock(mMutex);
+			mCompletedValue = mSignaledValue;
+		}
+		mCondition.notify_all();
+	}
+
+	uint64_t GetSignaledValue()
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		return mSignaledValue;
+	}
+
+private:
+
+	std::mutex mMutex;
+
+	std::condition_variable mCondition;
+
+	uint64_t mSignaledValue = 0;
+
+	uint64_t mCompletedValue = 0;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+
+//64 bit FNV-1a hash.
+//It is not a cryptographic hash, but it is stable across runs, compilers and platforms, which is what we need to key on-disk caches.
+constexpr uint64_t kFNV_OFFSET_BASIS = 14695981039346656037ull;
+constexpr uint64_t kFNV_PRIME = 1099511628211ull;
+
+inline uint64_t HashBytes(const void* Data, size_t Size, uint64_t Seed = kFNV_OFFSET_BASIS)
+{
+	const uint8_t* Bytes = static_cast<const uint8_t*>(Data);
+	uint64_t Hash = Seed;
+	for (size_t i = 0; i < Size; ++i)
+	{
+		Hash ^= Bytes[i];
+		Hash *= kFNV_PRIME;
+	}
+	return Hash;
+}
+
+inline uint64_t HashString(const std::string& String, uint64_t Seed = kFNV_OFFSET_BASIS)
+{
+	//Hash the length as well so that ("ab","c") and ("a","bc") don't collide when hashed one after the other
+	uint64_t Length = String.size();
+	return HashBytes(String.data(), String.size(), HashBytes(&Length, sizeof(Length), Seed));
+}
+
+//Hash a plain old data value (structs must not have padding holes with garbage in them, so zero initialize them first)
+template<typename T>
+inline uint64_t HashValue(const T& Value, uint64_t Seed = kFNV_OFFSET_BASIS)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "HashValue only works on trivially copyable types");
+	return HashBytes(&Value, sizeof(T), Seed);
+}
+
+inline uint64_t HashCombine(uint64_t Seed, uint64_t Value)
+{
+	return HashValue(Value, Seed);
+}
+
+//16 hex digits, handy to build file names out of a hash
+inline std::string HashToString(uint64_t Hash)
+{
+	char Buffer[17];
+	snprintf(Buffer, sizeof(Buffer), "%016llx", static_cast<unsigned long long>(Hash));
+	return Buffer;
+}
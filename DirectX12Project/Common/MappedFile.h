@@ -0,0 +1,187 @@
+#pragma once
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+/*
+	Read-only memory mapped file.
+
+	The OS pages the file in on demand and the data is never copied into a user buffer, so consumers that can work
+	straight out of memory (e.g. vkCreateShaderModule, which copies the code anyway) avoid an allocation and a copy
+	per file. The mapping stays valid for the lifetime of the object.
+*/
+class MappedFile
+{
+public:
+
+	MappedFile() = default;
+
+	explicit MappedFile(const std::string& FileName)
+	{
+		Open(FileName);
+	}
+
+	~MappedFile()
+	{
+		Close();
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& Other) noexcept
+	{
+		*this = std::move(Other);
+	}
+
+	MappedFile& operator=(MappedFile&& Other) noexcept
+	{
+		if (this != &Other)
+		{
+			Close();
+			mData = Other.mData;
+			mSize = Other.mSize;
+#if defined(_WIN32)
+			mFile = Other.mFile;
+			mMapping = Other.mMapping;
+			Other.mFile = INVALID_HANDLE_VALUE;
+			Other.mMapping = nullptr;
+#endif
+			Other.mData = nullptr;
+			Other.mSize = 0;
+		}
+		return *this;
+	}
+
+	void Open(const std::string& FileName)
+	{
+		Close();
+
+#if defined(_WIN32)
+		mFile = ::CreateFileA(FileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (mFile == INVALID_HANDLE_VALUE)
+		{
+			throw std::runtime_error("Failed to open file " + FileName + "!");
+		}
+
+		LARGE_INTEGER FileSize = {};
+		::GetFileSizeEx(mFile, &FileSize);
+		mSize = static_cast<size_t>(FileSize.QuadPart);
+
+		//Empty files can't be mapped, but they are perfectly valid (empty) files
+		if (mSize == 0)
+		{
+			return;
+		}
+
+		mMapping = ::CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mMapping == nullptr)
+		{
+			Close();
+			throw std::runtime_error("Failed to map file " + FileName + "!");
+		}
+
+		mData = ::MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+		if (mData == nullptr)
+		{
+			Close();
+			throw std::runtime_error("Failed to map file " + FileName + "!");
+		}
+#else
+		int File = ::open(FileName.c_str(), O_RDONLY);
+		if (File < 0)
+		{
+			throw std::runtime_error("Failed to open file " + FileName + "!");
+		}
+
+		struct stat FileStat = {};
+		if (::fstat(File, &FileStat) != 0)
+		{
+			::close(File);
+			throw std::runtime_error("Failed to stat file " + FileName + "!");
+		}
+		mSize = static_cast<size_t>(FileStat.st_size);
+
+		if (mSize != 0)
+		{
+			void* Data = ::mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, File, 0);
+			if (Data == MAP_FAILED)
+			{
+				::close(File);
+				mSize = 0;
+				throw std::runtime_error("Failed to map file " + FileName + "!");
+			}
+			mData = Data;
+		}
+
+		//The mapping keeps its own reference to the file
+		::close(File);
+#endif
+	}
+
+	void Close()
+	{
+#if defined(_WIN32)
+		if (mData != nullptr)
+		{
+			::UnmapViewOfFile(mData);
+		}
+		if (mMapping != nullptr)
+		{
+			::CloseHandle(mMapping);
+			mMapping = nullptr;
+		}
+		if (mFile != INVALID_HANDLE_VALUE)
+		{
+			::CloseHandle(mFile);
+			mFile = INVALID_HANDLE_VALUE;
+		}
+#else
+		if (mData != nullptr)
+		{
+			::munmap(const_cast<void*>(mData), mSize);
+		}
+#endif
+		mData = nullptr;
+		mSize = 0;
+	}
+
+	const void* Data() const
+	{
+		return mData;
+	}
+
+	size_t Size() const
+	{
+		return mSize;
+	}
+
+private:
+
+	const void* mData = nullptr;
+
+	size_t mSize = 0;
+
+#if defined(_WIN32)
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMapping = nullptr;
+#endif
+};
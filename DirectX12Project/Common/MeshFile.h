@@ -0,0 +1,462 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "VertexLayout.h"
+
+/*
+	Binary mesh container meant to be memory mapped (MappedFile) and handed to the GPU as is: there is nothing to parse,
+	the chunks already hold the vertex streams and indices in the formats the vertex input reads.
+
+		MeshFileHeader   64 bytes, at offset 0
+		MeshChunk[]      chunk table, right after the header
+		chunk data       every chunk starts on a kMeshChunkAlignment boundary
+
+	Vertex attributes are quantized, one stream (chunk) per attribute:
+		positions   SNorm16x4, xyz mapped to [-1, 1] over the bounding box: Position = Center + Value * HalfExtent
+		normals     SNorm16x2, octahedral encoding
+		texcoords   Half2
+	Indices are 16 bit when every vertex can be addressed with them, 32 bit otherwise.
+
+	MeshSourceData is the unquantized mesh importers produce (MeshImport.h) and BuildMeshFile() encodes.
+*/
+
+//'MESH' read as a little endian uint32
+constexpr uint32_t kMeshFileMagic = 0x4853454D;
+
+constexpr uint32_t kMeshFileVersion = 1;
+
+//Chunk data alignment: a multiple of every vertex/index format size and of the usual buffer offset alignments, so a
+//file can be copied to a GPU buffer chunk by chunk at the same relative offsets
+constexpr uint64_t kMeshChunkAlignment = 256;
+
+enum class MeshChunkType : uint32_t
+{
+	Positions,
+	Normals,
+	TexCoords,
+	Indices,
+};
+
+enum class MeshIndexFormat : uint32_t
+{
+	UInt16,
+	UInt32,
+};
+
+struct alignas(16) MeshFileHeader
+{
+	uint32_t mMagic;
+	uint32_t mVersion;
+
+	uint32_t mChunkCount;
+
+	//Byte offset of the chunk table
+	uint32_t mChunkTableOffset;
+
+	uint32_t mVertexCount;
+	uint32_t mIndexCount;
+
+	//Size of the whole file, to catch truncated ones
+	uint64_t mFileSize;
+
+	//Dequantization of the positions
+	float mCenter[3];
+	float mHalfExtent[3];
+
+	uint32_t mReserved[2];
+};
+
+static_assert(sizeof(MeshFileHeader) == 64, "The mesh file header layout is part of the format");
+
+struct MeshChunk
+{
+	MeshChunkType mType;
+
+	//VertexFormat for vertex streams, MeshIndexFormat for indices
+	uint32_t mFormat;
+
+	//Vertices or indices
+	uint32_t mElementCount;
+
+	//Bytes per element
+	uint32_t mStride;
+
+	//Byte offset (from the start of the file, aligned to kMeshChunkAlignment) and size of the data
+	uint64_t mOffset;
+	uint64_t mSize;
+};
+
+static_assert(sizeof(MeshChunk) == 32, "The mesh chunk layout is part of the format");
+
+//VERTEX STREAMS (one binding each, as laid out in the chunks)
+
+struct MeshPositionVertex
+{
+	SNorm16x4 mPosition;
+};
+
+struct MeshNormalVertex
+{
+	SNorm16x2 mNormal;
+};
+
+struct MeshTexCoordVertex
+{
+	Half2 mTexCoord;
+};
+
+template<>
+struct VertexLayoutTraits<MeshPositionVertex>
+{
+	static constexpr std::array<VertexAttributeDesc, 1> GetAttributes()
+	{
+		return { { VERTEX_ATTRIBUTE(MeshPositionVertex, mPosition, "POSITION", 0) } };
+	}
+};
+
+template<>
+struct VertexLayoutTraits<MeshNormalVertex>
+{
+	static constexpr std::array<VertexAttributeDesc, 1> GetAttributes()
+	{
+		return { { VERTEX_ATTRIBUTE(MeshNormalVertex, mNormal, "NORMAL", 1) } };
+	}
+};
+
+template<>
+struct VertexLayoutTraits<MeshTexCoordVertex>
+{
+	static constexpr std::array<VertexAttributeDesc, 1> GetAttributes()
+	{
+		return { { VERTEX_ATTRIBUTE(MeshTexCoordVertex, mTexCoord, "TEXCOORD", 2) } };
+	}
+};
+
+//ENCODING
+
+//Unit vector to the octahedron unfolded over [-1, 1]^2: the lower hemisphere is folded over the diagonals
+inline SNorm16x2 EncodeOctahedral(float X, float Y, float Z)
+{
+	const float Length = std::fabs(X) + std::fabs(Y) + std::fabs(Z);
+	if (Length == 0.0f)
+	{
+		return SNorm16x2{ 0, 0 };
+	}
+
+	float U = X / Length;
+	float V = Y / Length;
+	if (Z < 0.0f)
+	{
+		const float FoldedU = (1.0f - std::fabs(V)) * (U >= 0.0f ? 1.0f : -1.0f);
+		const float FoldedV = (1.0f - std::fabs(U)) * (V >= 0.0f ? 1.0f : -1.0f);
+		U = FoldedU;
+		V = FoldedV;
+	}
+	return SNorm16x2{ static_cast<int16_t>(PackSNorm(U, 32767)), static_cast<int16_t>(PackSNorm(V, 32767)) };
+}
+
+//What the vertex shader does with an octahedral normal (normalized)
+inline std::array<float, 3> DecodeOctahedral(SNorm16x2 Encoded)
+{
+	float X = std::max(Encoded.mX / 32767.0f, -1.0f);
+	float Y = std::max(Encoded.mY / 32767.0f, -1.0f);
+	const float Z = 1.0f - std::fabs(X) - std::fabs(Y);
+	const float Fold = std::max(-Z, 0.0f);
+	X += X >= 0.0f ? -Fold : Fold;
+	Y += Y >= 0.0f ? -Fold : Fold;
+
+	const float Length = std::sqrt(X * X + Y * Y + Z * Z);
+	return { { X / Length, Y / Length, Z / Length } };
+}
+
+//Unquantized mesh: triangle list, one index per corner
+struct MeshSourceData
+{
+	//xyz per vertex
+	std::vector<float> mPositions;
+
+	//xyz per vertex, or empty (BuildMeshFile() then generates smooth normals)
+	std::vector<float> mNormals;
+
+	//uv per vertex, or empty (no texcoord chunk)
+	std::vector<float> mTexCoords;
+
+	std::vector<uint32_t> mIndices;
+
+	uint32_t GetVertexCount() const
+	{
+		return static_cast<uint32_t>(mPositions.size() / 3);
+	}
+};
+
+//Area weighted vertex normals
+inline std::vector<float> ComputeSmoothNormals(const MeshSourceData& Mesh)
+{
+	std::vector<float> Normals(Mesh.mPositions.size(), 0.0f);
+	for (size_t Triangle = 0; Triangle + 2 < Mesh.mIndices.size(); Triangle += 3)
+	{
+		const float* P0 = &Mesh.mPositions[Mesh.mIndices[Triangle] * 3];
+		const float* P1 = &Mesh.mPositions[Mesh.mIndices[Triangle + 1] * 3];
+		const float* P2 = &Mesh.mPositions[Mesh.mIndices[Triangle + 2] * 3];
+		const float E1[3] = { P1[0] - P0[0], P1[1] - P0[1], P1[2] - P0[2] };
+		const float E2[3] = { P2[0] - P0[0], P2[1] - P0[1], P2[2] - P0[2] };
+
+		//Not normalized: its length is twice the triangle's area
+		const float FaceNormal[3] = { E1[1] * E2[2] - E1[2] * E2[1], E1[2] * E2[0] - E1[0] * E2[2], E1[0] * E2[1] - E1[1] * E2[0] };
+		for (size_t Corner = 0; Corner < 3; ++Corner)
+		{
+			float* Normal = &Normals[Mesh.mIndices[Triangle + Corner] * 3];
+			Normal[0] += FaceNormal[0];
+			Normal[1] += FaceNormal[1];
+			Normal[2] += FaceNormal[2];
+		}
+	}
+	return Normals;
+}
+
+//The whole file image of Mesh
+inline std::vector<uint8_t> BuildMeshFile(const MeshSourceData& Mesh)
+{
+	const uint32_t VertexCount = Mesh.GetVertexCount();
+	const uint32_t IndexCount = static_cast<uint32_t>(Mesh.mIndices.size());
+	if (VertexCount == 0 || IndexCount % 3 != 0)
+	{
+		throw std::runtime_error("Meshes need vertices and whole triangles!");
+	}
+	for (uint32_t Index : Mesh.mIndices)
+	{
+		if (Index >= VertexCount)
+		{
+			throw std::runtime_error("Mesh index out of range!");
+		}
+	}
+
+	MeshFileHeader Header = {};
+	Header.mMagic = kMeshFileMagic;
+	Header.mVersion = kMeshFileVersion;
+	Header.mVertexCount = VertexCount;
+	Header.mIndexCount = IndexCount;
+
+	//Bounding box, the quantization grid of the positions
+	float Min[3] = { Mesh.mPositions[0], Mesh.mPositions[1], Mesh.mPositions[2] };
+	float Max[3] = { Min[0], Min[1], Min[2] };
+	for (uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+	{
+		for (uint32_t Axis = 0; Axis < 3; ++Axis)
+		{
+			Min[Axis] = std::min(Min[Axis], Mesh.mPositions[Vertex * 3 + Axis]);
+			Max[Axis] = std::max(Max[Axis], Mesh.mPositions[Vertex * 3 + Axis]);
+		}
+	}
+	for (uint32_t Axis = 0; Axis < 3; ++Axis)
+	{
+		Header.mCenter[Axis] = (Min[Axis] + Max[Axis]) * 0.5f;
+		Header.mHalfExtent[Axis] = (Max[Axis] - Min[Axis]) * 0.5f;
+	}
+
+	//Encode every stream
+	std::vector<MeshPositionVertex> Positions(VertexCount);
+	for (uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+	{
+		int16_t Quantized[3];
+		for (uint32_t Axis = 0; Axis < 3; ++Axis)
+		{
+			//Flat axes only have the center
+			const float Value = Header.mHalfExtent[Axis] > 0.0f ? (Mesh.mPositions[Vertex * 3 + Axis] - Header.mCenter[Axis]) / Header.mHalfExtent[Axis] : 0.0f;
+			Quantized[Axis] = static_cast<int16_t>(PackSNorm(Value, 32767));
+		}
+		Positions[Vertex].mPosition = SNorm16x4{ Quantized[0], Quantized[1], Quantized[2], 32767 };
+	}
+
+	const std::vector<float> Normals = Mesh.mNormals.size() == Mesh.mPositions.size() ? Mesh.mNormals : ComputeSmoothNormals(Mesh);
+	std::vector<MeshNormalVertex> EncodedNormals(VertexCount);
+	for (uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+	{
+		EncodedNormals[Vertex].mNormal = EncodeOctahedral(Normals[Vertex * 3], Normals[Vertex * 3 + 1], Normals[Vertex * 3 + 2]);
+	}
+
+	std::vector<MeshTexCoordVertex> TexCoords;
+	if (Mesh.mTexCoords.size() == static_cast<size_t>(VertexCount) * 2)
+	{
+		TexCoords.resize(VertexCount);
+		for (uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+		{
+			TexCoords[Vertex].mTexCoord = Half2{ FloatToHalf(Mesh.mTexCoords[Vertex * 2]), FloatToHalf(Mesh.mTexCoords[Vertex * 2 + 1]) };
+		}
+	}
+
+	const bool ShortIndices = VertexCount <= 0x10000;
+	std::vector<uint16_t> Indices16;
+	if (ShortIndices)
+	{
+		Indices16.assign(Mesh.mIndices.begin(), Mesh.mIndices.end());
+	}
+
+	//Lay the chunks out
+	struct PendingChunk
+	{
+		MeshChunk mChunk;
+		const void* mData;
+	};
+	std::vector<PendingChunk> Chunks;
+	Chunks.push_back({ { MeshChunkType::Positions, static_cast<uint32_t>(VertexFormat::SNorm16x4), VertexCount, sizeof(MeshPositionVertex), 0, Positions.size() * sizeof(MeshPositionVertex) }, Positions.data() });
+	Chunks.push_back({ { MeshChunkType::Normals, static_cast<uint32_t>(VertexFormat::SNorm16x2), VertexCount, sizeof(MeshNormalVertex), 0, EncodedNormals.size() * sizeof(MeshNormalVertex) }, EncodedNormals.data() });
+	if (!TexCoords.empty())
+	{
+		Chunks.push_back({ { MeshChunkType::TexCoords, static_cast<uint32_t>(VertexFormat::Half2), VertexCount, sizeof(MeshTexCoordVertex), 0, TexCoords.size() * sizeof(MeshTexCoordVertex) }, TexCoords.data() });
+	}
+	if (ShortIndices)
+	{
+		Chunks.push_back({ { MeshChunkType::Indices, static_cast<uint32_t>(MeshIndexFormat::UInt16), IndexCount, sizeof(uint16_t), 0, Indices16.size() * sizeof(uint16_t) }, Indices16.data() });
+	}
+	else
+	{
+		Chunks.push_back({ { MeshChunkType::Indices, static_cast<uint32_t>(MeshIndexFormat::UInt32), IndexCount, sizeof(uint32_t), 0, Mesh.mIndices.size() * sizeof(uint32_t) }, Mesh.mIndices.data() });
+	}
+
+	Header.mChunkCount = static_cast<uint32_t>(Chunks.size());
+	Header.mChunkTableOffset = sizeof(MeshFileHeader);
+
+	uint64_t Offset = Header.mChunkTableOffset + Chunks.size() * sizeof(MeshChunk);
+	for (auto& Chunk : Chunks)
+	{
+		Offset = (Offset + kMeshChunkAlignment - 1) & ~(kMeshChunkAlignment - 1);
+		Chunk.mChunk.mOffset = Offset;
+		Offset += Chunk.mChunk.mSize;
+	}
+	Header.mFileSize = Offset;
+
+	//Write them, padding included (zeroed, so files are reproducible)
+	std::vector<uint8_t> File(static_cast<size_t>(Header.mFileSize), 0);
+	std::memcpy(File.data(), &Header, sizeof(Header));
+	for (size_t i = 0; i < Chunks.size(); ++i)
+	{
+		std::memcpy(File.data() + Header.mChunkTableOffset + i * sizeof(MeshChunk), &Chunks[i].mChunk, sizeof(MeshChunk));
+		std::memcpy(File.data() + Chunks[i].mChunk.mOffset, Chunks[i].mData, static_cast<size_t>(Chunks[i].mChunk.mSize));
+	}
+	return File;
+}
+
+inline void WriteMeshFile(const std::string& FileName, const MeshSourceData& Mesh)
+{
+	const std::vector<uint8_t> File = BuildMeshFile(Mesh);
+	std::ofstream Stream(FileName, std::ios::binary | std::ios::trunc);
+	if (!Stream.write(reinterpret_cast<const char*>(File.data()), File.size()))
+	{
+		throw std::runtime_error("Failed to write mesh file " + FileName + "!");
+	}
+}
+
+/*
+	Validated view over a mesh file image (typically a MappedFile). Checks the header and that every chunk lies inside
+	the file, is aligned and is consistent with the header, then only hands out pointers into the image: no copy.
+*/
+class MeshFileView
+{
+public:
+
+	MeshFileView(const void* Data, size_t Size)
+		: mData(static_cast<const uint8_t*>(Data))
+		, mSize(Size)
+	{
+		if (mData == nullptr || mSize < sizeof(MeshFileHeader) || reinterpret_cast<uintptr_t>(mData) % alignof(MeshFileHeader) != 0)
+		{
+			throw std::runtime_error("Not a mesh file!");
+		}
+
+		const MeshFileHeader& Header = GetHeader();
+		if (Header.mMagic != kMeshFileMagic)
+		{
+			throw std::runtime_error("Not a mesh file!");
+		}
+		if (Header.mVersion != kMeshFileVersion)
+		{
+			throw std::runtime_error("Unsupported mesh file version " + std::to_string(Header.mVersion) + "!");
+		}
+		if (Header.mFileSize != mSize || Header.mChunkTableOffset % alignof(MeshChunk) != 0 ||
+			Header.mChunkTableOffset + static_cast<uint64_t>(Header.mChunkCount) * sizeof(MeshChunk) > mSize)
+		{
+			throw std::runtime_error("Truncated or corrupted mesh file!");
+		}
+
+		for (uint32_t i = 0; i < Header.mChunkCount; ++i)
+		{
+			const MeshChunk& Chunk = GetChunk(i);
+			if (Chunk.mOffset % kMeshChunkAlignment != 0 || Chunk.mOffset > mSize || Chunk.mSize > mSize - Chunk.mOffset ||
+				static_cast<uint64_t>(Chunk.mElementCount) * Chunk.mStride != Chunk.mSize)
+			{
+				throw std::runtime_error("Corrupted mesh chunk " + std::to_string(i) + "!");
+			}
+
+			const uint32_t ExpectedCount = Chunk.mType == MeshChunkType::Indices ? Header.mIndexCount : Header.mVertexCount;
+			if (Chunk.mElementCount != ExpectedCount)
+			{
+				throw std::runtime_error("Mesh chunk " + std::to_string(i) + " doesn't match the header!");
+			}
+		}
+
+		if (FindChunk(MeshChunkType::Positions) == nullptr || FindChunk(MeshChunkType::Indices) == nullptr)
+		{
+			throw std::runtime_error("Mesh file without positions or indices!");
+		}
+	}
+
+	const MeshFileHeader& GetHeader() const
+	{
+		return *reinterpret_cast<const MeshFileHeader*>(mData);
+	}
+
+	uint32_t GetChunkCount() const
+	{
+		return GetHeader().mChunkCount;
+	}
+
+	const MeshChunk& GetChunk(uint32_t Index) const
+	{
+		return reinterpret_cast<const MeshChunk*>(mData + GetHeader().mChunkTableOffset)[Index];
+	}
+
+	//First chunk of that type, nullptr if there is none
+	const MeshChunk* FindChunk(MeshChunkType Type) const
+	{
+		for (uint32_t i = 0; i < GetChunkCount(); ++i)
+		{
+			if (GetChunk(i).mType == Type)
+			{
+				return &GetChunk(i);
+			}
+		}
+		return nullptr;
+	}
+
+	const void* GetChunkData(const MeshChunk& Chunk) const
+	{
+		return mData + Chunk.mOffset;
+	}
+
+	const void* GetData() const
+	{
+		return mData;
+	}
+
+	size_t GetSize() const
+	{
+		return mSize;
+	}
+
+private:
+
+	const uint8_t* mData = nullptr;
+
+	size_t mSize = 0;
+};
@@ -0,0 +1,667 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Hash.h"
+#include "MeshFile.h"
+
+/*
+	Importers of the mesh formats the offline converter accepts, producing a MeshSourceData to encode with
+	BuildMeshFile()/WriteMeshFile():
+
+		LoadObjMesh()    Wavefront OBJ (v, vt, vn, f; polygons are triangulated as fans)
+		LoadGltfMesh()   glTF 2.0, .gltf (external or base64 embedded buffers) or .glb
+
+	Both merge everything they find into a single mesh. glTF node transforms are not applied: meshes stay in their
+	local space.
+
+	The OBJ importer reads text the plain way (line by line through string streams) on purpose: it's what the
+	binary format gets benchmarked against.
+*/
+
+//OBJ
+
+inline MeshSourceData LoadObjMesh(const std::string& FileName)
+{
+	std::ifstream Stream(FileName);
+	if (!Stream)
+	{
+		throw std::runtime_error("Failed to open OBJ file " + FileName + "!");
+	}
+
+	std::vector<float> Positions;
+	std::vector<float> TexCoords;
+	std::vector<float> Normals;
+
+	MeshSourceData Mesh;
+
+	//Every distinct v/vt/vn triple becomes a vertex (0 for an absent vt or vn)
+	struct CornerHash
+	{
+		size_t operator()(const std::array<int32_t, 3>& Corner) const
+		{
+			return static_cast<size_t>(HashValue(Corner));
+		}
+	};
+	std::unordered_map<std::array<int32_t, 3>, uint32_t, CornerHash> Vertices;
+
+	//OBJ indices start at 1, negative ones count back from the last element read so far
+	auto ResolveIndex = [](int32_t Index, size_t Count) -> int32_t
+	{
+		return Index < 0 ? static_cast<int32_t>(Count) + Index + 1 : Index;
+	};
+
+	std::string Line;
+	std::vector<uint32_t> Face;
+	bool MissingNormals = false;
+	while (std::getline(Stream, Line))
+	{
+		std::istringstream LineStream(Line);
+		std::string Keyword;
+		LineStream >> Keyword;
+
+		if (Keyword == "v")
+		{
+			float X = 0.0f, Y = 0.0f, Z = 0.0f;
+			LineStream >> X >> Y >> Z;
+			Positions.insert(Positions.end(), { X, Y, Z });
+		}
+		else if (Keyword == "vt")
+		{
+			float U = 0.0f, V = 0.0f;
+			LineStream >> U >> V;
+			TexCoords.insert(TexCoords.end(), { U, V });
+		}
+		else if (Keyword == "vn")
+		{
+			float X = 0.0f, Y = 0.0f, Z = 0.0f;
+			LineStream >> X >> Y >> Z;
+			Normals.insert(Normals.end(), { X, Y, Z });
+		}
+		else if (Keyword == "f")
+		{
+			Face.clear();
+			std::string CornerText;
+			while (LineStream >> CornerText)
+			{
+				//v, v/vt, v//vn or v/vt/vn
+				std::array<int32_t, 3> Corner = { { 0, 0, 0 } };
+				std::istringstream CornerStream(CornerText);
+				std::string Field;
+				for (uint32_t i = 0; i < 3 && std::getline(CornerStream, Field, '/'); ++i)
+				{
+					Corner[i] = Field.empty() ? 0 : std::atoi(Field.c_str());
+				}
+				Corner[0] = ResolveIndex(Corner[0], Positions.size() / 3);
+				Corner[1] = Corner[1] != 0 ? ResolveIndex(Corner[1], TexCoords.size() / 2) : 0;
+				Corner[2] = Corner[2] != 0 ? ResolveIndex(Corner[2], Normals.size() / 3) : 0;
+				MissingNormals |= Corner[2] == 0;
+				if (Corner[0] <= 0 || static_cast<size_t>(Corner[0]) > Positions.size() / 3 ||
+					static_cast<size_t>(Corner[1]) > TexCoords.size() / 2 || static_cast<size_t>(Corner[2]) > Normals.size() / 3 ||
+					Corner[1] < 0 || Corner[2] < 0)
+				{
+					throw std::runtime_error("OBJ face index out of range in " + FileName + "!");
+				}
+
+				auto It = Vertices.find(Corner);
+				if (It == Vertices.end())
+				{
+					It = Vertices.emplace(Corner, Mesh.GetVertexCount()).first;
+					const float* Position = &Positions[(Corner[0] - 1) * 3];
+					Mesh.mPositions.insert(Mesh.mPositions.end(), Position, Position + 3);
+
+					const float* TexCoord = Corner[1] != 0 ? &TexCoords[(Corner[1] - 1) * 2] : nullptr;
+					Mesh.mTexCoords.insert(Mesh.mTexCoords.end(), { TexCoord ? TexCoord[0] : 0.0f, TexCoord ? TexCoord[1] : 0.0f });
+
+					const float* Normal = Corner[2] != 0 ? &Normals[(Corner[2] - 1) * 3] : nullptr;
+					Mesh.mNormals.insert(Mesh.mNormals.end(), { Normal ? Normal[0] : 0.0f, Normal ? Normal[1] : 0.0f, Normal ? Normal[2] : 0.0f });
+				}
+				Face.push_back(It->second);
+			}
+
+			for (size_t i = 2; i < Face.size(); ++i)
+			{
+				Mesh.mIndices.insert(Mesh.mIndices.end(), { Face[0], Face[i - 1], Face[i] });
+			}
+		}
+	}
+
+	//Normals some corner lacks are generated for the whole mesh; texcoords are only dropped if no corner has any
+	if (TexCoords.empty())
+	{
+		Mesh.mTexCoords.clear();
+	}
+	if (MissingNormals)
+	{
+		Mesh.mNormals.clear();
+	}
+	return Mesh;
+}
+
+//GLTF
+
+//Just enough JSON for glTF documents
+struct JsonValue
+{
+	enum class Type
+	{
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object,
+	};
+
+	Type mType = Type::Null;
+	double mNumber = 0.0;
+	std::string mString;
+	std::vector<JsonValue> mArray;
+
+	//Object members: mKeys[i] names mMembers[i]
+	std::vector<std::string> mKeys;
+	std::vector<JsonValue> mMembers;
+
+	//Member Key, nullptr if absent (or not an object)
+	const JsonValue* Find(const char* Key) const
+	{
+		for (size_t i = 0; i < mKeys.size(); ++i)
+		{
+			if (mKeys[i] == Key)
+			{
+				return &mMembers[i];
+			}
+		}
+		return nullptr;
+	}
+
+	const JsonValue& operator[](const char* Key) const
+	{
+		const JsonValue* Value = Find(Key);
+		if (Value == nullptr)
+		{
+			throw std::runtime_error(std::string("Missing JSON member ") + Key + "!");
+		}
+		return *Value;
+	}
+
+	const JsonValue& operator[](size_t Index) const
+	{
+		if (mType != Type::Array || Index >= mArray.size())
+		{
+			throw std::runtime_error("JSON array index out of range!");
+		}
+		return mArray[Index];
+	}
+
+	uint32_t AsUInt() const
+	{
+		if (mType != Type::Number || mNumber < 0.0)
+		{
+			throw std::runtime_error("Expected an unsigned JSON number!");
+		}
+		return static_cast<uint32_t>(mNumber);
+	}
+
+	//Member Key as an unsigned number, Default if absent
+	uint32_t GetUInt(const char* Key, uint32_t Default) const
+	{
+		const JsonValue* Value = Find(Key);
+		return Value != nullptr ? Value->AsUInt() : Default;
+	}
+};
+
+class JsonParser
+{
+public:
+
+	static JsonValue Parse(const char* Begin, const char* End)
+	{
+		JsonParser Parser(Begin, End);
+		JsonValue Value = Parser.ParseValue();
+		Parser.SkipWhitespace();
+		if (Parser.mCursor != Parser.mEnd && *Parser.mCursor != '\0')
+		{
+			Parser.Fail();
+		}
+		return Value;
+	}
+
+private:
+
+	JsonParser(const char* Begin, const char* End)
+		: mCursor(Begin)
+		, mEnd(End)
+	{
+	}
+
+	[[noreturn]] void Fail() const
+	{
+		throw std::runtime_error("Malformed JSON!");
+	}
+
+	void SkipWhitespace()
+	{
+		while (mCursor != mEnd && std::isspace(static_cast<unsigned char>(*mCursor)))
+		{
+			++mCursor;
+		}
+	}
+
+	bool Consume(const char* Token)
+	{
+		const size_t Length = std::strlen(Token);
+		if (static_cast<size_t>(mEnd - mCursor) >= Length && std::strncmp(mCursor, Token, Length) == 0)
+		{
+			mCursor += Length;
+			return true;
+		}
+		return false;
+	}
+
+	JsonValue ParseValue()
+	{
+		SkipWhitespace();
+		if (mCursor == mEnd)
+		{
+			Fail();
+		}
+
+		JsonValue Value;
+		if (*mCursor == '{')
+		{
+			++mCursor;
+			Value.mType = JsonValue::Type::Object;
+			SkipWhitespace();
+			if (Consume("}"))
+			{
+				return Value;
+			}
+			do
+			{
+				SkipWhitespace();
+				std::string Key = ParseString();
+				SkipWhitespace();
+				if (!Consume(":"))
+				{
+					Fail();
+				}
+				Value.mKeys.push_back(std::move(Key));
+				Value.mMembers.push_back(ParseValue());
+				SkipWhitespace();
+			} while (Consume(","));
+			if (!Consume("}"))
+			{
+				Fail();
+			}
+		}
+		else if (*mCursor == '[')
+		{
+			++mCursor;
+			Value.mType = JsonValue::Type::Array;
+			SkipWhitespace();
+			if (Consume("]"))
+			{
+				return Value;
+			}
+			do
+			{
+				Value.mArray.push_back(ParseValue());
+				SkipWhitespace();
+			} while (Consume(","));
+			if (!Consume("]"))
+			{
+				Fail();
+			}
+		}
+		else if (*mCursor == '"')
+		{
+			Value.mType = JsonValue::Type::String;
+			Value.mString = ParseString();
+		}
+		else if (Consume("true"))
+		{
+			Value.mType = JsonValue::Type::Bool;
+			Value.mNumber = 1.0;
+		}
+		else if (Consume("false"))
+		{
+			Value.mType = JsonValue::Type::Bool;
+		}
+		else if (Consume("null"))
+		{
+			Value.mType = JsonValue::Type::Null;
+		}
+		else
+		{
+			//strtod needs a terminated string: numbers are short, copy them out
+			const char* NumberEnd = mCursor;
+			while (NumberEnd != mEnd && std::strchr("+-.0123456789eE", *NumberEnd) != nullptr)
+			{
+				++NumberEnd;
+			}
+			if (NumberEnd == mCursor)
+			{
+				Fail();
+			}
+			Value.mType = JsonValue::Type::Number;
+			Value.mNumber = std::strtod(std::string(mCursor, NumberEnd).c_str(), nullptr);
+			mCursor = NumberEnd;
+		}
+		return Value;
+	}
+
+	//Escapes are kept as is but \" and \\, which is all glTF names and URIs need
+	std::string ParseString()
+	{
+		if (!Consume("\""))
+		{
+			Fail();
+		}
+		std::string String;
+		while (mCursor != mEnd && *mCursor != '"')
+		{
+			if (*mCursor == '\\' && mCursor + 1 != mEnd && (mCursor[1] == '"' || mCursor[1] == '\\'))
+			{
+				++mCursor;
+			}
+			String.push_back(*mCursor++);
+		}
+		if (!Consume("\""))
+		{
+			Fail();
+		}
+		return String;
+	}
+
+	const char* mCursor;
+
+	const char* mEnd;
+};
+
+inline std::vector<uint8_t> DecodeBase64(const std::string& Text)
+{
+	std::vector<uint8_t> Bytes;
+	uint32_t Bits = 0;
+	uint32_t BitCount = 0;
+	for (char Character : Text)
+	{
+		const char* Alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		const char* Found = Character != '\0' ? std::strchr(Alphabet, Character) : nullptr;
+		if (Found == nullptr)
+		{
+			//Padding (and anything else) ends the data
+			break;
+		}
+		Bits = (Bits << 6) | static_cast<uint32_t>(Found - Alphabet);
+		BitCount += 6;
+		if (BitCount >= 8)
+		{
+			BitCount -= 8;
+			Bytes.push_back(static_cast<uint8_t>(Bits >> BitCount));
+		}
+	}
+	return Bytes;
+}
+
+inline std::vector<uint8_t> ReadBinaryFile(const std::string& FileName)
+{
+	std::ifstream Stream(FileName, std::ios::binary | std::ios::ate);
+	if (!Stream)
+	{
+		throw std::runtime_error("Failed to open file " + FileName + "!");
+	}
+	std::vector<uint8_t> Bytes(static_cast<size_t>(Stream.tellg()));
+	Stream.seekg(0);
+	Stream.read(reinterpret_cast<char*>(Bytes.data()), Bytes.size());
+	return Bytes;
+}
+
+inline MeshSourceData LoadGltfMesh(const std::string& FileName)
+{
+	const std::vector<uint8_t> File = ReadBinaryFile(FileName);
+	const std::string Directory = FileName.find_last_of("/\\") != std::string::npos ? FileName.substr(0, FileName.find_last_of("/\\") + 1) : std::string();
+
+	//A .glb is a 12 byte header then chunks: JSON first, then an optional BIN one holding buffer 0
+	JsonValue Document;
+	std::vector<uint8_t> BinaryChunk;
+	const uint32_t kGlbMagic = 0x46546C67;
+	uint32_t Magic = 0;
+	if (File.size() >= 4)
+	{
+		std::memcpy(&Magic, File.data(), sizeof(Magic));
+	}
+	if (Magic == kGlbMagic)
+	{
+		size_t Offset = 12;
+		while (Offset + 8 <= File.size())
+		{
+			uint32_t ChunkLength = 0;
+			uint32_t ChunkType = 0;
+			std::memcpy(&ChunkLength, File.data() + Offset, 4);
+			std::memcpy(&ChunkType, File.data() + Offset + 4, 4);
+			Offset += 8;
+			if (ChunkLength > File.size() - Offset)
+			{
+				throw std::runtime_error("Truncated GLB file " + FileName + "!");
+			}
+
+			const char* ChunkData = reinterpret_cast<const char*>(File.data() + Offset);
+			if (ChunkType == 0x4E4F534A) //JSON
+			{
+				Document = JsonParser::Parse(ChunkData, ChunkData + ChunkLength);
+			}
+			else if (ChunkType == 0x004E4942) //BIN
+			{
+				BinaryChunk.assign(File.data() + Offset, File.data() + Offset + ChunkLength);
+			}
+			Offset += ChunkLength;
+		}
+	}
+	else
+	{
+		const char* Text = reinterpret_cast<const char*>(File.data());
+		Document = JsonParser::Parse(Text, Text + File.size());
+	}
+
+	//Buffers: the GLB one, base64 data URIs or files next to the document
+	std::vector<std::vector<uint8_t>> Buffers;
+	if (const JsonValue* BufferArray = Document.Find("buffers"))
+	{
+		for (const auto& Buffer : BufferArray->mArray)
+		{
+			const JsonValue* Uri = Buffer.Find("uri");
+			if (Uri == nullptr)
+			{
+				Buffers.push_back(BinaryChunk);
+			}
+			else if (Uri->mString.compare(0, 5, "data:") == 0)
+			{
+				const size_t Comma = Uri->mString.find(',');
+				Buffers.push_back(DecodeBase64(Comma != std::string::npos ? Uri->mString.substr(Comma + 1) : std::string()));
+			}
+			else
+			{
+				Buffers.push_back(ReadBinaryFile(Directory + Uri->mString));
+			}
+			if (Buffers.back().size() < Buffer["byteLength"].AsUInt())
+			{
+				throw std::runtime_error("glTF buffer smaller than its byteLength in " + FileName + "!");
+			}
+		}
+	}
+
+	//Every element of an accessor as ComponentCount values converted to T (floats must be float, indices any unsigned type)
+	auto ReadAccessor = [&](uint32_t AccessorIndex, uint32_t ComponentCount, auto Converter)
+	{
+		const JsonValue& Accessor = Document["accessors"][AccessorIndex];
+		if (Accessor.Find("sparse") != nullptr || Accessor.Find("bufferView") == nullptr)
+		{
+			throw std::runtime_error("Sparse glTF accessors aren't supported!");
+		}
+		const JsonValue& View = Document["bufferViews"][Accessor["bufferView"].AsUInt()];
+		const std::vector<uint8_t>& Buffer = Buffers.at(View["buffer"].AsUInt());
+
+		const uint32_t ComponentType = Accessor["componentType"].AsUInt();
+		const uint32_t ComponentSize = ComponentType == 5126 || ComponentType == 5125 ? 4 : (ComponentType == 5123 || ComponentType == 5122 ? 2 : 1);
+		const uint32_t Count = Accessor["count"].AsUInt();
+		const uint32_t Stride = View.GetUInt("byteStride", ComponentSize * ComponentCount);
+		const size_t Begin = static_cast<size_t>(View.GetUInt("byteOffset", 0)) + Accessor.GetUInt("byteOffset", 0);
+		if (Count != 0 && Begin + static_cast<size_t>(Count - 1) * Stride + ComponentSize * ComponentCount > Buffer.size())
+		{
+			throw std::runtime_error("glTF accessor out of its buffer!");
+		}
+
+		std::vector<decltype(Converter(ComponentType, nullptr))> Values;
+		Values.reserve(static_cast<size_t>(Count) * ComponentCount);
+		for (uint32_t Element = 0; Element < Count; ++Element)
+		{
+			for (uint32_t Component = 0; Component < ComponentCount; ++Component)
+			{
+				Values.push_back(Converter(ComponentType, Buffer.data() + Begin + static_cast<size_t>(Element) * Stride + Component * ComponentSize));
+			}
+		}
+		return Values;
+	};
+
+	auto ReadFloat = [](uint32_t ComponentType, const uint8_t* Data) -> float
+	{
+		if (ComponentType != 5126)
+		{
+			throw std::runtime_error("Only float glTF vertex attributes are supported!");
+		}
+		float Value = 0.0f;
+		if (Data != nullptr)
+		{
+			std::memcpy(&Value, Data, sizeof(Value));
+		}
+		return Value;
+	};
+
+	auto ReadIndex = [](uint32_t ComponentType, const uint8_t* Data) -> uint32_t
+	{
+		if (Data == nullptr)
+		{
+			return 0;
+		}
+		switch (ComponentType)
+		{
+		case 5121: return *Data;
+		case 5123: { uint16_t Value; std::memcpy(&Value, Data, sizeof(Value)); return Value; }
+		case 5125: { uint32_t Value; std::memcpy(&Value, Data, sizeof(Value)); return Value; }
+		}
+		throw std::runtime_error("Invalid glTF index type!");
+	};
+
+	MeshSourceData Mesh;
+	bool AllHaveNormals = true;
+	bool AllHaveTexCoords = true;
+	std::vector<float> Normals;
+	std::vector<float> TexCoords;
+
+	const JsonValue* Meshes = Document.Find("meshes");
+	if (Meshes == nullptr)
+	{
+		throw std::runtime_error("No mesh in " + FileName + "!");
+	}
+	for (const auto& GltfMesh : Meshes->mArray)
+	{
+		for (const auto& Primitive : GltfMesh["primitives"].mArray)
+		{
+			//Triangle lists only (the default mode)
+			if (Primitive.GetUInt("mode", 4) != 4)
+			{
+				continue;
+			}
+
+			const JsonValue& Attributes = Primitive["attributes"];
+			const uint32_t FirstVertex = Mesh.GetVertexCount();
+			const std::vector<float> Positions = ReadAccessor(Attributes["POSITION"].AsUInt(), 3, ReadFloat);
+			Mesh.mPositions.insert(Mesh.mPositions.end(), Positions.begin(), Positions.end());
+			const size_t VertexCount = Positions.size() / 3;
+
+			if (const JsonValue* Normal = Attributes.Find("NORMAL"))
+			{
+				const std::vector<float> Values = ReadAccessor(Normal->AsUInt(), 3, ReadFloat);
+				Normals.insert(Normals.end(), Values.begin(), Values.end());
+			}
+			else
+			{
+				AllHaveNormals = false;
+				Normals.resize(Mesh.mPositions.size(), 0.0f);
+			}
+
+			if (const JsonValue* TexCoord = Attributes.Find("TEXCOORD_0"))
+			{
+				const std::vector<float> Values = ReadAccessor(TexCoord->AsUInt(), 2, ReadFloat);
+				TexCoords.insert(TexCoords.end(), Values.begin(), Values.end());
+			}
+			else
+			{
+				AllHaveTexCoords = false;
+				TexCoords.resize(Mesh.GetVertexCount() * 2, 0.0f);
+			}
+
+			//Non indexed primitives draw their vertices in order
+			if (const JsonValue* Indices = Primitive.Find("indices"))
+			{
+				for (uint32_t Index : ReadAccessor(Indices->AsUInt(), 1, ReadIndex))
+				{
+					if (Index >= VertexCount)
+					{
+						throw std::runtime_error("glTF index out of range in " + FileName + "!");
+					}
+					Mesh.mIndices.push_back(FirstVertex + Index);
+				}
+			}
+			else
+			{
+				for (uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+				{
+					Mesh.mIndices.push_back(FirstVertex + Vertex);
+				}
+			}
+		}
+	}
+
+	//Partially present attributes: generated normals everywhere, zero texcoords where missing
+	if (AllHaveNormals)
+	{
+		Mesh.mNormals = std::move(Normals);
+	}
+	if (AllHaveTexCoords || std::any_of(TexCoords.begin(), TexCoords.end(), [](float Value) { return Value != 0.0f; }))
+	{
+		Mesh.mTexCoords = std::move(TexCoords);
+	}
+	return Mesh;
+}
+
+//By extension: .obj, .gltf or .glb
+inline MeshSourceData LoadMeshSource(const std::string& FileName)
+{
+	const size_t Dot = FileName.find_last_of('.');
+	std::string Extension = Dot != std::string::npos ? FileName.substr(Dot + 1) : std::string();
+	std::transform(Extension.begin(), Extension.end(), Extension.begin(), [](char Character) { return static_cast<char>(std::tolower(static_cast<unsigned char>(Character))); });
+
+	if (Extension == "obj")
+	{
+		return LoadObjMesh(FileName);
+	}
+	if (Extension == "gltf" || Extension == "glb")
+	{
+		return LoadGltfMesh(FileName);
+	}
+	throw std::runtime_error("Unknown mesh source format " + FileName + "!");
+}
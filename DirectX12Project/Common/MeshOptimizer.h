@@ -0,0 +1,552 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "MeshFile.h"
+
+/*
+	Triangle and vertex order optimizations of indexed triangle lists, for the offline converter and for meshes loaded
+	from sources at run time. All of them keep the very same triangles, only their order changes:
+
+		OptimizeVertexCache()   orders triangles so vertices are reused while still in the post-transform cache
+		                        (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+		OptimizeOverdraw()      splits the cache friendly order in clusters at the points where the cache restarts anyway
+		                        and sorts the clusters front to back from the outside in, so the depth test rejects more of
+		                        what's behind (Sander, Nehab, Barczak, "Fast Triangle Reordering for Vertex Locality and
+		                        Reduced Overdraw")
+		OptimizeVertexFetch()   renumbers vertices in the order the index buffer first uses them, so vertex fetches walk
+		                        memory forward (and drops unreferenced vertices)
+
+	and the metrics to check them with:
+
+		AnalyzeVertexCache()    ACMR (vertices transformed per triangle, 0.5 at best, 3 at worst) and ATVR (vertices
+		                        transformed per vertex, 1 at best) on a FIFO cache of the given size
+		AnalyzeOverdraw()       fragments shaded per pixel covered, rasterized on the CPU from the 6 axis directions with an
+		                        early depth test and back faces culled
+
+	OptimizeMesh() runs them in that order on a MeshSourceData.
+*/
+
+struct VertexCacheStatistics
+{
+	uint32_t mVerticesTransformed = 0;
+	uint32_t mTriangleCount = 0;
+
+	//Vertices the indices reference
+	uint32_t mVertexCount = 0;
+
+	//Average cache miss ratio: transformed vertices per triangle
+	float mAcmr = 0.0f;
+
+	//Average transform to vertex ratio: transformed vertices per referenced vertex
+	float mAtvr = 0.0f;
+};
+
+struct OverdrawStatistics
+{
+	uint64_t mPixelsCovered = 0;
+	uint64_t mPixelsShaded = 0;
+
+	//Shaded per covered, 1 at best
+	float mOverdraw = 0.0f;
+};
+
+//Post-transform cache size GPUs are usually assumed to behave like
+constexpr uint32_t kDefaultVertexCacheSize = 16;
+
+inline VertexCacheStatistics AnalyzeVertexCache(const uint32_t* Indices, size_t IndexCount, uint32_t VertexCount, uint32_t CacheSize = kDefaultVertexCacheSize)
+{
+	VertexCacheStatistics Stats;
+	Stats.mTriangleCount = static_cast<uint32_t>(IndexCount / 3);
+
+	//FIFO: a vertex is cached if fewer than CacheSize vertices went in after it. Timestamps start past CacheSize, so
+	//a zero (never seen) is always a miss.
+	std::vector<uint32_t> CachedAt(VertexCount, 0);
+	std::vector<bool> Referenced(VertexCount, false);
+	uint32_t Timestamp = CacheSize + 1;
+	for (size_t i = 0; i < IndexCount; ++i)
+	{
+		const uint32_t Vertex = Indices[i];
+		if (Timestamp - CachedAt[Vertex] > CacheSize)
+		{
+			CachedAt[Vertex] = Timestamp++;
+			++Stats.mVerticesTransformed;
+		}
+		if (!Referenced[Vertex])
+		{
+			Referenced[Vertex] = true;
+			++Stats.mVertexCount;
+		}
+	}
+
+	Stats.mAcmr = Stats.mTriangleCount != 0 ? static_cast<float>(Stats.mVerticesTransformed) / Stats.mTriangleCount : 0.0f;
+	Stats.mAtvr = Stats.mVertexCount != 0 ? static_cast<float>(Stats.mVerticesTransformed) / Stats.mVertexCount : 0.0f;
+	return Stats;
+}
+
+//Positions are xyz per vertex
+inline OverdrawStatistics AnalyzeOverdraw(const uint32_t* Indices, size_t IndexCount, const float* Positions, uint32_t VertexCount, uint32_t Resolution = 256)
+{
+	OverdrawStatistics Stats;
+	if (IndexCount == 0 || VertexCount == 0)
+	{
+		return Stats;
+	}
+
+	//Fit the mesh in [0, Resolution] on every axis (same scale for all of them)
+	float Min[3] = { Positions[0], Positions[1], Positions[2] };
+	float Max[3] = { Min[0], Min[1], Min[2] };
+	for (uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+	{
+		for (uint32_t Axis = 0; Axis < 3; ++Axis)
+		{
+			Min[Axis] = std::min(Min[Axis], Positions[Vertex * 3 + Axis]);
+			Max[Axis] = std::max(Max[Axis], Positions[Vertex * 3 + Axis]);
+		}
+	}
+	const float Extent = std::max(std::max(Max[0] - Min[0], Max[1] - Min[1]), Max[2] - Min[2]);
+	const float Scale = Extent > 0.0f ? Resolution / Extent : 0.0f;
+
+	std::vector<float> Depth(static_cast<size_t>(Resolution) * Resolution);
+	for (uint32_t View = 0; View < 6; ++View)
+	{
+		//Looking down -Axis or +Axis; the other two axes are the screen
+		const uint32_t Axis = View / 2;
+		const float Direction = View % 2 == 0 ? 1.0f : -1.0f;
+		const uint32_t AxisX = (Axis + 1) % 3;
+		const uint32_t AxisY = (Axis + 2) % 3;
+
+		std::fill(Depth.begin(), Depth.end(), 2.0f);
+		for (size_t Triangle = 0; Triangle + 2 < IndexCount; Triangle += 3)
+		{
+			float X[3], Y[3], Z[3];
+			for (uint32_t Corner = 0; Corner < 3; ++Corner)
+			{
+				const float* Position = &Positions[Indices[Triangle + Corner] * 3];
+				X[Corner] = (Position[AxisX] - Min[AxisX]) * Scale;
+				Y[Corner] = (Position[AxisY] - Min[AxisY]) * Scale;
+				//0 nearest, 1 farthest
+				Z[Corner] = Extent > 0.0f ? (Direction > 0.0f ? Max[Axis] - Position[Axis] : Position[Axis] - Min[Axis]) / Extent : 0.0f;
+			}
+
+			//The face normal's component along the view axis: counter clockwise triangles face outward
+			const float Area = (X[1] - X[0]) * (Y[2] - Y[0]) - (X[2] - X[0]) * (Y[1] - Y[0]);
+			if (Area * Direction <= 0.0f)
+			{
+				continue;
+			}
+
+			const int32_t MinX = std::max(0, static_cast<int32_t>(std::floor(std::min({ X[0], X[1], X[2] }))));
+			const int32_t MaxX = std::min(static_cast<int32_t>(Resolution) - 1, static_cast<int32_t>(std::ceil(std::max({ X[0], X[1], X[2] }))));
+			const int32_t MinY = std::max(0, static_cast<int32_t>(std::floor(std::min({ Y[0], Y[1], Y[2] }))));
+			const int32_t MaxY = std::min(static_cast<int32_t>(Resolution) - 1, static_cast<int32_t>(std::ceil(std::max({ Y[0], Y[1], Y[2] }))));
+			for (int32_t PixelY = MinY; PixelY <= MaxY; ++PixelY)
+			{
+				for (int32_t PixelX = MinX; PixelX <= MaxX; ++PixelX)
+				{
+					//Barycentrics of the pixel center, the same sign as Area inside the triangle
+					const float PX = PixelX + 0.5f;
+					const float PY = PixelY + 0.5f;
+					const float W0 = (X[1] - PX) * (Y[2] - PY) - (X[2] - PX) * (Y[1] - PY);
+					const float W1 = (X[2] - PX) * (Y[0] - PY) - (X[0] - PX) * (Y[2] - PY);
+					const float W2 = (X[0] - PX) * (Y[1] - PY) - (X[1] - PX) * (Y[0] - PY);
+					if (W0 * Area < 0.0f || W1 * Area < 0.0f || W2 * Area < 0.0f)
+					{
+						continue;
+					}
+
+					const float PixelDepth = (W0 * Z[0] + W1 * Z[1] + W2 * Z[2]) / Area;
+					float& Stored = Depth[static_cast<size_t>(PixelY) * Resolution + PixelX];
+					if (PixelDepth < Stored)
+					{
+						Stats.mPixelsCovered += Stored > 1.5f ? 1 : 0;
+						Stats.mPixelsShaded++;
+						Stored = PixelDepth;
+					}
+				}
+			}
+		}
+	}
+
+	Stats.mOverdraw = Stats.mPixelsCovered != 0 ? static_cast<float>(Stats.mPixelsShaded) / Stats.mPixelsCovered : 0.0f;
+	return Stats;
+}
+
+//Reorder the triangles of Indices (in place) for the post-transform vertex cache
+inline void OptimizeVertexCache(uint32_t* Indices, size_t IndexCount, uint32_t VertexCount)
+{
+	//Forsyth's LRU cache model and scoring
+	const uint32_t kCacheSize = 32;
+	const float kLastTriangleScore = 0.75f;
+	const float kCacheDecayPower = 1.5f;
+	const float kValenceBoostScale = 2.0f;
+	const float kValenceBoostPower = 0.5f;
+
+	const size_t TriangleCount = IndexCount / 3;
+
+	//Triangles of every vertex (the ones still to emit come first in each list)
+	std::vector<uint32_t> LiveTriangles(VertexCount, 0);
+	for (size_t i = 0; i < TriangleCount * 3; ++i)
+	{
+		++LiveTriangles[Indices[i]];
+	}
+	std::vector<uint32_t> FirstTriangle(VertexCount + 1, 0);
+	for (uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+	{
+		FirstTriangle[Vertex + 1] = FirstTriangle[Vertex] + LiveTriangles[Vertex];
+	}
+	std::vector<uint32_t> VertexTriangles(TriangleCount * 3);
+	{
+		std::vector<uint32_t> Cursor(FirstTriangle.begin(), FirstTriangle.end() - 1);
+		for (size_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+		{
+			for (uint32_t Corner = 0; Corner < 3; ++Corner)
+			{
+				VertexTriangles[Cursor[Indices[Triangle * 3 + Corner]]++] = static_cast<uint32_t>(Triangle);
+			}
+		}
+	}
+
+	auto VertexScore = [&](int32_t CachePosition, uint32_t Live) -> float
+	{
+		if (Live == 0)
+		{
+			return -1.0f;
+		}
+
+		float Score = 0.0f;
+		if (CachePosition >= 0)
+		{
+			if (CachePosition < 3)
+			{
+				//Used by the triangle just emitted: no extra reward for it, or strips would be favored over fans
+				Score = kLastTriangleScore;
+			}
+			else
+			{
+				const float Scaler = 1.0f / (kCacheSize - 3);
+				Score = std::pow(1.0f - (CachePosition - 3) * Scaler, kCacheDecayPower);
+			}
+		}
+
+		//Vertices with few triangles left get finished first, so they don't linger as single triangles later on
+		return Score + kValenceBoostScale * std::pow(static_cast<float>(Live), -kValenceBoostPower);
+	};
+
+	std::vector<int32_t> CachePosition(VertexCount, -1);
+	std::vector<float> Scores(VertexCount);
+	for (uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+	{
+		Scores[Vertex] = VertexScore(-1, LiveTriangles[Vertex]);
+	}
+
+	std::vector<float> TriangleScores(TriangleCount);
+	std::vector<bool> Emitted(TriangleCount, false);
+	for (size_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+	{
+		TriangleScores[Triangle] = Scores[Indices[Triangle * 3]] + Scores[Indices[Triangle * 3 + 1]] + Scores[Indices[Triangle * 3 + 2]];
+	}
+
+	const std::vector<uint32_t> Input(Indices, Indices + TriangleCount * 3);
+	std::vector<uint32_t> Cache;
+	Cache.reserve(kCacheSize + 3);
+	std::vector<uint32_t> NewCache;
+	NewCache.reserve(kCacheSize + 3);
+
+	//Linear scan cursor for when no triangle touches the cache
+	size_t NextCandidate = 0;
+	int64_t BestTriangle = -1;
+
+	for (size_t Output = 0; Output < TriangleCount; ++Output)
+	{
+		if (BestTriangle < 0)
+		{
+			float BestScore = -1.0f;
+			for (; NextCandidate < TriangleCount && Emitted[NextCandidate]; ++NextCandidate)
+			{
+			}
+			//Best of a short window from the cursor, not the whole mesh, to stay linear
+			for (size_t Triangle = NextCandidate; Triangle < std::min(TriangleCount, NextCandidate + 64); ++Triangle)
+			{
+				if (!Emitted[Triangle] && TriangleScores[Triangle] > BestScore)
+				{
+					BestScore = TriangleScores[Triangle];
+					BestTriangle = static_cast<int64_t>(Triangle);
+				}
+			}
+		}
+
+		const uint32_t* Corners = &Input[static_cast<size_t>(BestTriangle) * 3];
+		std::copy(Corners, Corners + 3, Indices + Output * 3);
+		Emitted[static_cast<size_t>(BestTriangle)] = true;
+
+		//Remove the triangle from its vertices' live lists
+		for (uint32_t Corner = 0; Corner < 3; ++Corner)
+		{
+			const uint32_t Vertex = Corners[Corner];
+			uint32_t* Begin = &VertexTriangles[FirstTriangle[Vertex]];
+			uint32_t* End = Begin + LiveTriangles[Vertex];
+			std::iter_swap(std::find(Begin, End, static_cast<uint32_t>(BestTriangle)), End - 1);
+			--LiveTriangles[Vertex];
+		}
+
+		//Its vertices go in front of the LRU cache
+		NewCache.assign(Corners, Corners + 3);
+		for (uint32_t Vertex : Cache)
+		{
+			if (Vertex != Corners[0] && Vertex != Corners[1] && Vertex != Corners[2])
+			{
+				NewCache.push_back(Vertex);
+			}
+		}
+		std::swap(Cache, NewCache);
+
+		//Rescore what's in the cache (and what just fell out of it), then pick the best triangle touching it
+		for (size_t Position = 0; Position < Cache.size(); ++Position)
+		{
+			const uint32_t Vertex = Cache[Position];
+			CachePosition[Vertex] = Position < kCacheSize ? static_cast<int32_t>(Position) : -1;
+			Scores[Vertex] = VertexScore(CachePosition[Vertex], LiveTriangles[Vertex]);
+		}
+
+		BestTriangle = -1;
+		float BestScore = -1.0f;
+		for (uint32_t Vertex : Cache)
+		{
+			for (uint32_t i = 0; i < LiveTriangles[Vertex]; ++i)
+			{
+				const uint32_t Triangle = VertexTriangles[FirstTriangle[Vertex] + i];
+				const float Score = Scores[Input[Triangle * 3]] + Scores[Input[Triangle * 3 + 1]] + Scores[Input[Triangle * 3 + 2]];
+				TriangleScores[Triangle] = Score;
+				if (Score > BestScore)
+				{
+					BestScore = Score;
+					BestTriangle = Triangle;
+				}
+			}
+		}
+
+		if (Cache.size() > kCacheSize)
+		{
+			Cache.resize(kCacheSize);
+		}
+	}
+}
+
+//Reorder clusters of triangles (in place) to reduce overdraw, keeping the cache efficiency of the current order within
+//Threshold (1.05: up to 5% more vertices transformed). Run it after OptimizeVertexCache().
+inline void OptimizeOverdraw(uint32_t* Indices, size_t IndexCount, const float* Positions, uint32_t VertexCount, float Threshold = 1.05f)
+{
+	const size_t TriangleCount = IndexCount / 3;
+	if (TriangleCount == 0)
+	{
+		return;
+	}
+
+	//Hard boundaries: triangles whose 3 vertices all miss the cache, where the order restarts from scratch anyway
+	std::vector<size_t> HardBoundaries;
+	{
+		std::vector<uint32_t> CachedAt(VertexCount, 0);
+		uint32_t Timestamp = kDefaultVertexCacheSize + 1;
+		for (size_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+		{
+			uint32_t Misses = 0;
+			for (uint32_t Corner = 0; Corner < 3; ++Corner)
+			{
+				const uint32_t Vertex = Indices[Triangle * 3 + Corner];
+				if (Timestamp - CachedAt[Vertex] > kDefaultVertexCacheSize)
+				{
+					CachedAt[Vertex] = Timestamp++;
+					++Misses;
+				}
+			}
+			if (Triangle == 0 || Misses == 3)
+			{
+				HardBoundaries.push_back(Triangle);
+			}
+		}
+		HardBoundaries.push_back(TriangleCount);
+	}
+
+	//Soft boundaries: within a hard cluster, also split wherever the part since the last split is already as cache
+	//efficient as Threshold allows (restarting the cache there costs little)
+	std::vector<size_t> Clusters;
+	for (size_t Hard = 0; Hard + 1 < HardBoundaries.size(); ++Hard)
+	{
+		const size_t Begin = HardBoundaries[Hard];
+		const size_t End = HardBoundaries[Hard + 1];
+		const VertexCacheStatistics ClusterStats = AnalyzeVertexCache(Indices + Begin * 3, (End - Begin) * 3, VertexCount);
+		const float TargetAcmr = ClusterStats.mAcmr * Threshold;
+
+		std::vector<uint32_t> CachedAt(VertexCount, 0);
+		uint32_t Timestamp = kDefaultVertexCacheSize + 1;
+		uint32_t Misses = 0;
+		size_t SoftBegin = Begin;
+		Clusters.push_back(Begin);
+		for (size_t Triangle = Begin; Triangle < End; ++Triangle)
+		{
+			for (uint32_t Corner = 0; Corner < 3; ++Corner)
+			{
+				const uint32_t Vertex = Indices[Triangle * 3 + Corner];
+				if (Timestamp - CachedAt[Vertex] > kDefaultVertexCacheSize)
+				{
+					CachedAt[Vertex] = Timestamp++;
+					++Misses;
+				}
+			}
+
+			const size_t Count = Triangle - SoftBegin + 1;
+			if (Triangle + 1 < End && static_cast<float>(Misses) / Count <= TargetAcmr)
+			{
+				SoftBegin = Triangle + 1;
+				Clusters.push_back(SoftBegin);
+				Timestamp += kDefaultVertexCacheSize + 1;
+				Misses = 0;
+			}
+		}
+	}
+	Clusters.push_back(TriangleCount);
+
+	//Mesh centroid, then per cluster: area weighted centroid and normal
+	double MeshCentroid[3] = { 0.0, 0.0, 0.0 };
+	for (uint32_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+	{
+		for (uint32_t Axis = 0; Axis < 3; ++Axis)
+		{
+			MeshCentroid[Axis] += Positions[Vertex * 3 + Axis];
+		}
+	}
+	for (uint32_t Axis = 0; Axis < 3; ++Axis)
+	{
+		MeshCentroid[Axis] /= std::max(VertexCount, 1u);
+	}
+
+	const size_t ClusterCount = Clusters.size() - 1;
+	std::vector<float> SortKeys(ClusterCount);
+	for (size_t Cluster = 0; Cluster < ClusterCount; ++Cluster)
+	{
+		double Centroid[3] = { 0.0, 0.0, 0.0 };
+		double Normal[3] = { 0.0, 0.0, 0.0 };
+		double TotalArea = 0.0;
+		for (size_t Triangle = Clusters[Cluster]; Triangle < Clusters[Cluster + 1]; ++Triangle)
+		{
+			const float* P0 = &Positions[Indices[Triangle * 3] * 3];
+			const float* P1 = &Positions[Indices[Triangle * 3 + 1] * 3];
+			const float* P2 = &Positions[Indices[Triangle * 3 + 2] * 3];
+			const double E1[3] = { P1[0] - P0[0], P1[1] - P0[1], P1[2] - P0[2] };
+			const double E2[3] = { P2[0] - P0[0], P2[1] - P0[1], P2[2] - P0[2] };
+			const double Cross[3] = { E1[1] * E2[2] - E1[2] * E2[1], E1[2] * E2[0] - E1[0] * E2[2], E1[0] * E2[1] - E1[1] * E2[0] };
+			const double Area = std::sqrt(Cross[0] * Cross[0] + Cross[1] * Cross[1] + Cross[2] * Cross[2]);
+			for (uint32_t Axis = 0; Axis < 3; ++Axis)
+			{
+				Centroid[Axis] += (P0[Axis] + P1[Axis] + P2[Axis]) / 3.0 * Area;
+				Normal[Axis] += Cross[Axis];
+			}
+			TotalArea += Area;
+		}
+
+		const double NormalLength = std::sqrt(Normal[0] * Normal[0] + Normal[1] * Normal[1] + Normal[2] * Normal[2]);
+		double Key = 0.0;
+		if (TotalArea > 0.0 && NormalLength > 0.0)
+		{
+			for (uint32_t Axis = 0; Axis < 3; ++Axis)
+			{
+				Key += (Centroid[Axis] / TotalArea - MeshCentroid[Axis]) * Normal[Axis] / NormalLength;
+			}
+		}
+		SortKeys[Cluster] = static_cast<float>(Key);
+	}
+
+	//Clusters facing away from the center the most are the likeliest occluders: draw them first
+	std::vector<size_t> Order(ClusterCount);
+	std::iota(Order.begin(), Order.end(), size_t(0));
+	std::stable_sort(Order.begin(), Order.end(), [&](size_t A, size_t B) { return SortKeys[A] > SortKeys[B]; });
+
+	const std::vector<uint32_t> Input(Indices, Indices + TriangleCount * 3);
+	size_t Output = 0;
+	for (size_t Cluster : Order)
+	{
+		for (size_t i = Clusters[Cluster] * 3; i < Clusters[Cluster + 1] * 3; ++i)
+		{
+			Indices[Output++] = Input[i];
+		}
+	}
+}
+
+//New index of every vertex, in order of first use by Indices (~0u for vertices never used). Returns the used count.
+inline uint32_t GenerateVertexFetchRemap(std::vector<uint32_t>& Remap, const uint32_t* Indices, size_t IndexCount, uint32_t VertexCount)
+{
+	Remap.assign(VertexCount, ~0u);
+	uint32_t Next = 0;
+	for (size_t i = 0; i < IndexCount; ++i)
+	{
+		if (Remap[Indices[i]] == ~0u)
+		{
+			Remap[Indices[i]] = Next++;
+		}
+	}
+	return Next;
+}
+
+//Apply a remap to an attribute of ComponentCount floats per vertex
+inline void RemapVertexAttribute(std::vector<float>& Attribute, uint32_t ComponentCount, const std::vector<uint32_t>& Remap, uint32_t NewVertexCount)
+{
+	if (Attribute.empty())
+	{
+		return;
+	}
+
+	std::vector<float> Remapped(static_cast<size_t>(NewVertexCount) * ComponentCount);
+	for (size_t Vertex = 0; Vertex < Remap.size(); ++Vertex)
+	{
+		if (Remap[Vertex] != ~0u)
+		{
+			std::copy_n(&Attribute[Vertex * ComponentCount], ComponentCount, &Remapped[static_cast<size_t>(Remap[Vertex]) * ComponentCount]);
+		}
+	}
+	Attribute.swap(Remapped);
+}
+
+inline void OptimizeVertexFetch(MeshSourceData& Mesh)
+{
+	std::vector<uint32_t> Remap;
+	const uint32_t NewVertexCount = GenerateVertexFetchRemap(Remap, Mesh.mIndices.data(), Mesh.mIndices.size(), Mesh.GetVertexCount());
+
+	RemapVertexAttribute(Mesh.mPositions, 3, Remap, NewVertexCount);
+	RemapVertexAttribute(Mesh.mNormals, 3, Remap, NewVertexCount);
+	RemapVertexAttribute(Mesh.mTexCoords, 2, Remap, NewVertexCount);
+	for (auto& Index : Mesh.mIndices)
+	{
+		Index = Remap[Index];
+	}
+}
+
+enum MeshOptimizations : uint32_t
+{
+	kMeshOptimizeVertexCache = 1 << 0,
+	kMeshOptimizeOverdraw = 1 << 1,
+	kMeshOptimizeVertexFetch = 1 << 2,
+
+	kMeshOptimizeAll = kMeshOptimizeVertexCache | kMeshOptimizeOverdraw | kMeshOptimizeVertexFetch,
+};
+
+inline void OptimizeMesh(MeshSourceData& Mesh, uint32_t Optimizations = kMeshOptimizeAll, float OverdrawThreshold = 1.05f)
+{
+	if (Optimizations & kMeshOptimizeVertexCache)
+	{
+		OptimizeVertexCache(Mesh.mIndices.data(), Mesh.mIndices.size(), Mesh.GetVertexCount());
+	}
+	if (Optimizations & kMeshOptimizeOverdraw)
+	{
+		OptimizeOverdraw(Mesh.mIndices.data(), Mesh.mIndices.size(), Mesh.mPositions.data(), Mesh.GetVertexCount(), OverdrawThreshold);
+	}
+	if (Optimizations & kMeshOptimizeVertexFetch)
+	{
+		OptimizeVertexFetch(Mesh);
+	}
+}
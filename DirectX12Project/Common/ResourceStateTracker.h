@@ -0,0 +1,358 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum class BarrierKind
+{
+	//Regular transition
+	Full,
+
+	//First half of a split transition: the GPU may start it now and has until the matching End to complete it
+	Begin,
+
+	//Second half: the resource is in the new state from here on
+	End
+};
+
+template <typename StateType>
+struct StateTransition
+{
+	uint64_t mResource;
+
+	//Subresource index, or kAllSubresources
+	uint32_t mSubresource;
+
+	StateType mBefore;
+
+	StateType mAfter;
+
+	BarrierKind mKind;
+};
+
+//Any difference means a barrier. APIs where some same state transitions still need one (a write after a write in
+//Vulkan) provide their own.
+template <typename StateType>
+struct DefaultStateTraits
+{
+	static bool NeedsBarrier(const StateType& Before, const StateType& After)
+	{
+		return !(Before == After);
+	}
+};
+
+/*
+	Tracks the state (D3D12 resource state, Vulkan layout/access/stages ...) of every subresource of registered resources
+	and turns "resource X is used as Y from now on" into the barriers that need to happen, without touching any API.
+
+	- Transitions are deferred: they pile up until Flush(), called once per pass boundary, which hands them back as one
+	  batch so that the whole lot goes to the GPU in a single barrier call.
+	- Transitions of the same subresource in the same batch are merged (A->B then B->C becomes A->C), and dropped
+	  entirely if they end up where they started.
+	- States are compared with ==, Traits::NeedsBarrier() decides whether going from one to the other takes a barrier.
+	- A resource is tracked as a single state as long as all of its subresources agree, and only expands to per
+	  subresource states once one of them is transitioned on its own; transitioning the whole resource again collapses it.
+	- BeginTransition() issues the first half of a split barrier as soon as the previous use is over; the next
+	  Transition() to the same state issues the second half, giving the GPU the work in between to overlap it.
+
+	Resources are identified by a 64 bit key (the resource pointer or handle). Not thread safe: one tracker per recording
+	timeline.
+*/
+template <typename StateType, typename Traits = DefaultStateTraits<StateType>>
+class ResourceStateTracker
+{
+public:
+
+	typedef StateTransition<StateType> TransitionType;
+
+	static constexpr uint32_t kAllSubresources = ~0u;
+
+	void Register(uint64_t Resource, uint32_t SubresourceCount, const StateType& InitialState)
+	{
+		Entry& NewEntry = mResources[Resource];
+		NewEntry.mSubresourceCount = std::max(SubresourceCount, 1u);
+		NewEntry.mUniform = true;
+		NewEntry.mState = InitialState;
+		NewEntry.mSubresourceStates.clear();
+	}
+
+	//Pending barriers of the resource are dropped too: the resource is going away
+	void Unregister(uint64_t Resource)
+	{
+		mResources.erase(Resource);
+
+		auto IsResource = [Resource](const TransitionType& Transition) { return Transition.mResource == Resource; };
+		mPending.erase(std::remove_if(mPending.begin(), mPending.end(), IsResource), mPending.end());
+
+		for (auto It = mSplitTargets.begin(); It != mSplitTargets.end();)
+		{
+			if (It->first.first == Resource)
+			{
+				It = mSplitTargets.erase(It);
+			}
+			else
+			{
+				++It;
+			}
+		}
+	}
+
+	bool IsRegistered(uint64_t Resource) const
+	{
+		return mResources.find(Resource) != mResources.end();
+	}
+
+	//Current state (once the pending barriers execute) of one subresource
+	StateType GetState(uint64_t Resource, uint32_t Subresource = 0) const
+	{
+		const Entry& Found = GetEntry(Resource);
+		return Found.mUniform ? Found.mState : Found.mSubresourceStates.at(Subresource);
+	}
+
+	//The resource (or one subresource) is used in After from the next Flush() on
+	void Transition(uint64_t Resource, const StateType& After, uint32_t Subresource = kAllSubresources)
+	{
+		Entry& Found = GetEntry(Resource);
+
+		//The End half of a split landing right on After is the whole transition
+		if (EndSplitTransitions(Resource, Found, Subresource, After))
+		{
+			return;
+		}
+
+		if (Subresource == kAllSubresources)
+		{
+			if (Found.mUniform)
+			{
+				Add(Resource, kAllSubresources, Found.mState, After, BarrierKind::Full);
+			}
+			else
+			{
+				for (uint32_t i = 0; i < Found.mSubresourceCount; ++i)
+				{
+					Add(Resource, i, Found.mSubresourceStates[i], After, BarrierKind::Full);
+				}
+				Found.mUniform = true;
+				Found.mSubresourceStates.clear();
+			}
+			Found.mState = After;
+			return;
+		}
+
+		if (Subresource >= Found.mSubresourceCount)
+		{
+			throw std::out_of_range("Subresource index out of range");
+		}
+
+		if (Found.mUniform)
+		{
+			//No state change, but maybe still a barrier
+			if (Found.mState == After)
+			{
+				Add(Resource, Subresource, Found.mState, After, BarrierKind::Full);
+				return;
+			}
+			Found.mUniform = false;
+			Found.mSubresourceStates.assign(Found.mSubresourceCount, Found.mState);
+		}
+
+		Add(Resource, Subresource, Found.mSubresourceStates[Subresource], After, BarrierKind::Full);
+		Found.mSubresourceStates[Subresource] = After;
+		CollapseIfUniform(Found);
+	}
+
+	//Start moving the resource (or one subresource) to After while it isn't used. The state only changes with the
+	//Transition() to After that must follow before its next use.
+	void BeginTransition(uint64_t Resource, const StateType& After, uint32_t Subresource = kAllSubresources)
+	{
+		const StateType Before = GetState(Resource, Subresource == kAllSubresources ? 0 : Subresource);
+		if (!Traits::NeedsBarrier(Before, After))
+		{
+			return;
+		}
+
+		//Splitting a per subresource state in one go isn't worth it, a regular transition will do later
+		const Entry& Found = GetEntry(Resource);
+		if (Subresource == kAllSubresources && !Found.mUniform)
+		{
+			return;
+		}
+
+		auto Key = std::make_pair(Resource, Subresource);
+		if (mSplitTargets.find(Key) != mSplitTargets.end())
+		{
+			return;
+		}
+		mSplitTargets.emplace(Key, After);
+		mPending.push_back({ Resource, Subresource, Before, After, BarrierKind::Begin });
+	}
+
+	bool HasPendingBarriers() const
+	{
+		return !mPending.empty();
+	}
+
+	//The barriers to issue before the next pass, in order, as one batch
+	std::vector<TransitionType> Flush()
+	{
+		std::vector<TransitionType> Batch;
+		Batch.swap(mPending);
+		return Batch;
+	}
+
+private:
+
+	struct Entry
+	{
+		uint32_t mSubresourceCount = 1;
+
+		//All subresources are in mState
+		bool mUniform = true;
+
+		StateType mState{};
+
+		//Only meaningful when !mUniform
+		std::vector<StateType> mSubresourceStates;
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const std::pair<uint64_t, uint32_t>& Key) const
+		{
+			return std::hash<uint64_t>()(Key.first * 31 + Key.second);
+		}
+	};
+
+	Entry& GetEntry(uint64_t Resource)
+	{
+		auto It = mResources.find(Resource);
+		if (It == mResources.end())
+		{
+			throw std::invalid_argument("Resource isn't registered in the state tracker");
+		}
+		return It->second;
+	}
+
+	const Entry& GetEntry(uint64_t Resource) const
+	{
+		auto It = mResources.find(Resource);
+		if (It == mResources.end())
+		{
+			throw std::invalid_argument("Resource isn't registered in the state tracker");
+		}
+		return It->second;
+	}
+
+	void Add(uint64_t Resource, uint32_t Subresource, const StateType& Before, const StateType& After, BarrierKind Kind)
+	{
+		//Merge with a regular transition of the same subresource still in the batch
+		if (Kind == BarrierKind::Full)
+		{
+			for (size_t i = mPending.size(); i-- > 0;)
+			{
+				TransitionType& Previous = mPending[i];
+				if (Previous.mResource != Resource || Previous.mSubresource != Subresource)
+				{
+					continue;
+				}
+				if (Previous.mKind != BarrierKind::Full)
+				{
+					break;
+				}
+
+				Previous.mAfter = After;
+				if (!Traits::NeedsBarrier(Previous.mBefore, Previous.mAfter))
+				{
+					mPending.erase(mPending.begin() + i);
+				}
+				return;
+			}
+		}
+
+		if (Kind != BarrierKind::Full || Traits::NeedsBarrier(Before, After))
+		{
+			mPending.push_back({ Resource, Subresource, Before, After, Kind });
+		}
+	}
+
+	//Close the split transitions a Transition() on (Resource, Subresource) lands on or overrides. True when one of them
+	//was the transition of exactly that subresource to After.
+	bool EndSplitTransitions(uint64_t Resource, Entry& Found, uint32_t Subresource, const StateType& After)
+	{
+		if (mSplitTargets.empty())
+		{
+			return false;
+		}
+
+		bool EndedOnAfter = false;
+
+		for (auto It = mSplitTargets.begin(); It != mSplitTargets.end();)
+		{
+			const uint32_t SplitSubresource = It->first.second;
+			const bool Overlaps = It->first.first == Resource && (Subresource == kAllSubresources || SplitSubresource == kAllSubresources || SplitSubresource == Subresource);
+			if (!Overlaps)
+			{
+				++It;
+				continue;
+			}
+
+			//The End half moves the state to the split target, the caller's transition continues from there unless
+			//that is already where it goes
+			const StateType Target = It->second;
+			EndedOnAfter = EndedOnAfter || (SplitSubresource == Subresource && Target == After);
+			const StateType Before = SplitSubresource == kAllSubresources ? Found.mState : (Found.mUniform ? Found.mState : Found.mSubresourceStates[SplitSubresource]);
+			mPending.push_back({ Resource, SplitSubresource, Before, Target, BarrierKind::End });
+			SetState(Found, SplitSubresource, Target);
+			It = mSplitTargets.erase(It);
+		}
+		return EndedOnAfter;
+	}
+
+	void SetState(Entry& Found, uint32_t Subresource, const StateType& State)
+	{
+		if (Subresource == kAllSubresources)
+		{
+			Found.mUniform = true;
+			Found.mState = State;
+			Found.mSubresourceStates.clear();
+			return;
+		}
+		if (Found.mUniform)
+		{
+			if (Found.mState == State)
+			{
+				return;
+			}
+			Found.mUniform = false;
+			Found.mSubresourceStates.assign(Found.mSubresourceCount, Found.mState);
+		}
+		Found.mSubresourceStates[Subresource] = State;
+		CollapseIfUniform(Found);
+	}
+
+	void CollapseIfUniform(Entry& Found)
+	{
+		for (uint32_t i = 1; i < Found.mSubresourceCount; ++i)
+		{
+			if (!(Found.mSubresourceStates[0] == Found.mSubresourceStates[i]))
+			{
+				return;
+			}
+		}
+		Found.mUniform = true;
+		Found.mState = Found.mSubresourceStates[0];
+		Found.mSubresourceStates.clear();
+	}
+
+	std::unordered_map<uint64_t, Entry> mResources;
+
+	std::vector<TransitionType> mPending;
+
+	//Split transitions begun and not ended yet: (resource, subresource) -> target state
+	std::unordered_map<std::pair<uint64_t, uint32_t>, StateType, KeyHash> mSplitTargets;
+};
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <stdexcept>
+
+/*
+	Linear allocator over a ring of [0, Size) bytes, for data the GPU consumes within a frame (uploads, per frame constants).
+
+	Allocations only ever move the head forward. FinishFrame() closes everything allocated since the previous call into
+	one range tagged with the fence value the GPU signals once it's done with that frame, and Retire() moves the tail past
+	the ranges whose value has been reached. An allocation that doesn't fit before the end of the ring restarts at 0,
+	the skipped bytes are charged to the current frame and come back with it.
+
+	Like BuddyAllocator it only hands out offsets: the memory (an upload heap, a staging VkBuffer) belongs to the caller.
+*/
+class RingAllocator
+{
+public:
+
+	static constexpr uint64_t kInvalidOffset = ~0ull;
+
+	RingAllocator() = default;
+
+	explicit RingAllocator(uint64_t Size)
+	{
+		Reset(Size);
+	}
+
+	void Reset(uint64_t Size)
+	{
+		if (Size == 0)
+		{
+			throw std::runtime_error("Ring allocator size must not be 0!");
+		}
+
+		mSize = Size;
+		mHead = 0;
+		mTail = 0;
+		mUsedSize = 0;
+		mPeakUsedSize = 0;
+		mCurrentFrameSize = 0;
+		mPendingFrames.clear();
+	}
+
+	//Returns the offset of Size bytes aligned to Alignment, or kInvalidOffset if the GPU still holds the room
+	uint64_t Allocate(uint64_t Size, uint64_t Alignment = 1)
+	{
+		if (Size == 0 || Size > mSize || Alignment == 0)
+		{
+			return kInvalidOffset;
+		}
+
+		//Nothing in flight: start over from the beginning, the whole ring is contiguous again
+		if (mUsedSize == 0)
+		{
+			mHead = 0;
+			mTail = 0;
+		}
+
+		const uint64_t AlignedHead = AlignUp(mHead, Alignment);
+		uint64_t Offset = kInvalidOffset;
+		uint64_t NewHead = 0;
+
+		if (mHead >= mTail && mUsedSize < mSize)
+		{
+			//Free space is [Head, Size) followed by [0, Tail)
+			if (AlignedHead + Size <= mSize)
+			{
+				Offset = AlignedHead;
+				NewHead = AlignedHead + Size;
+			}
+			else if (Size <= mTail)
+			{
+				//Wrap: the end of the ring is skipped
+				Offset = 0;
+				NewHead = Size;
+			}
+		}
+		else if (mHead < mTail)
+		{
+			//Free space is [Head, Tail)
+			if (AlignedHead + Size <= mTail)
+			{
+				Offset = AlignedHead;
+				NewHead = AlignedHead + Size;
+			}
+		}
+
+		if (Offset == kInvalidOffset)
+		{
+			return kInvalidOffset;
+		}
+
+		//Bytes consumed, padding and skipped end of the ring included
+		const uint64_t Consumed = NewHead > mHead ? NewHead - mHead : mSize - mHead + NewHead;
+		mUsedSize += Consumed;
+		mCurrentFrameSize += Consumed;
+		mPeakUsedSize = std::max(mPeakUsedSize, mUsedSize);
+
+		mHead = NewHead == mSize ? 0 : NewHead;
+		return Offset;
+	}
+
+	//Allocate, and while there's no room wait for the oldest frame in flight: WaitForValue(Value) must block until the
+	//GPU reaches Value. Returns kInvalidOffset only if the request can't fit even with every previous frame retired.
+	uint64_t AllocateOrWait(uint64_t Size, uint64_t Alignment, const std::function<void(uint64_t)>& WaitForValue)
+	{
+		//Would never fit, no point draining the GPU first
+		if (Size > mSize)
+		{
+			return kInvalidOffset;
+		}
+
+		for (;;)
+		{
+			const uint64_t Offset = Allocate(Size, Alignment);
+			if (Offset != kInvalidOffset || mPendingFrames.empty())
+			{
+				return Offset;
+			}
+
+			const uint64_t OldestValue = mPendingFrames.front().mFenceValue;
+			WaitForValue(OldestValue);
+			Retire(OldestValue);
+		}
+	}
+
+	//Everything allocated since the last call is in use until the GPU reaches FenceValue (values must not decrease)
+	void FinishFrame(uint64_t FenceValue)
+	{
+		if (mCurrentFrameSize == 0)
+		{
+			return;
+		}
+
+		mPendingFrames.push_back({ mHead, mCurrentFrameSize, FenceValue });
+		mCurrentFrameSize = 0;
+	}
+
+	//Give back the ranges of the frames the GPU is done with
+	void Retire(uint64_t CompletedValue)
+	{
+		while (!mPendingFrames.empty() && mPendingFrames.front().mFenceValue <= CompletedValue)
+		{
+			mTail = mPendingFrames.front().mEndOffset;
+			mUsedSize -= mPendingFrames.front().mSize;
+			mPendingFrames.pop_front();
+		}
+	}
+
+	uint64_t GetSize() const
+	{
+		return mSize;
+	}
+
+	//Bytes held by the current frame and the frames in flight
+	uint64_t GetUsedSize() const
+	{
+		return mUsedSize;
+	}
+
+	//Highest GetUsedSize() since Reset(), to size the ring
+	uint64_t GetPeakUsedSize() const
+	{
+		return mPeakUsedSize;
+	}
+
+	//Any alignment, not only powers of two: texel blocks of 3 components (12 bytes for R32G32B32) need a multiple of 3
+	static uint64_t AlignUp(uint64_t Value, uint64_t Alignment)
+	{
+		if ((Alignment & (Alignment - 1)) == 0)
+		{
+			return (Value + Alignment - 1) & ~(Alignment - 1);
+		}
+		return (Value + Alignment - 1) / Alignment * Alignment;
+	}
+
+private:
+
+	struct PendingFrame
+	{
+		//Head at the end of the frame, the tail moves there once it retires
+		uint64_t mEndOffset;
+
+		uint64_t mSize;
+
+		uint64_t mFenceValue;
+	};
+
+	uint64_t mSize = 0;
+
+	uint64_t mHead = 0;
+
+	uint64_t mTail = 0;
+
+	uint64_t mUsedSize = 0;
+
+	uint64_t mPeakUsedSize = 0;
+
+	uint64_t mCurrentFrameSize = 0;
+
+	std::deque<PendingFrame> mPendingFrames;
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+//Nearest rank percentile (Percentile in [0, 100]) of an already sorted set of samples
+inline double GetSortedPercentile(const std::vector<double>& SortedSamples, double Percentile)
+{
+	if (SortedSamples.empty())
+	{
+		return 0.0;
+	}
+	const double Rank = std::ceil(Percentile / 100.0 * SortedSamples.size());
+	const size_t Index = static_cast<size_t>(std::max(1.0, Rank)) - 1;
+	return SortedSamples[std::min(Index, SortedSamples.size() - 1)];
+}
+
+struct RollingSummary
+{
+	size_t mSampleCount = 0;
+
+	double mLast = 0.0;
+	double mMin = 0.0;
+	double mAverage = 0.0;
+	double mMax = 0.0;
+	double mP50 = 0.0;
+	double mP95 = 0.0;
+	double mP99 = 0.0;
+};
+
+/*
+	Keeps the last N samples of some measure (a timing usually) and summarizes them on demand.
+	Adding a sample is O(1); the summary sorts a copy of the window, so ask for it once in a while, not every sample.
+	Not thread safe.
+*/
+class RollingStatistics
+{
+public:
+
+	explicit RollingStatistics(size_t Capacity = 256)
+		: mSamples(std::max<size_t>(Capacity, 1))
+	{
+	}
+
+	void Add(double Value)
+	{
+		mSamples[mNext] = Value;
+		mNext = (mNext + 1) % mSamples.size();
+		mCount = std::min(mCount + 1, mSamples.size());
+		mLast = Value;
+	}
+
+	void Clear()
+	{
+		mNext = 0;
+		mCount = 0;
+		mLast = 0.0;
+	}
+
+	size_t GetCount() const
+	{
+		return mCount;
+	}
+
+	double GetLast() const
+	{
+		return mLast;
+	}
+
+	RollingSummary GetSummary() const
+	{
+		RollingSummary Summary;
+		Summary.mSampleCount = mCount;
+		Summary.mLast = mLast;
+		if (mCount == 0)
+		{
+			return Summary;
+		}
+
+		std::vector<double> Sorted(mSamples.begin(), mSamples.begin() + mCount);
+		std::sort(Sorted.begin(), Sorted.end());
+
+		double Sum = 0.0;
+		for (double Value : Sorted)
+		{
+			Sum += Value;
+		}
+
+		Summary.mMin = Sorted.front();
+		Summary.mMax = Sorted.back();
+		Summary.mAverage = Sum / mCount;
+		Summary.mP50 = GetSortedPercentile(Sorted, 50.0);
+		Summary.mP95 = GetSortedPercentile(Sorted, 95.0);
+		Summary.mP99 = GetSortedPercentile(Sorted, 99.0);
+		return Summary;
+	}
+
+private:
+
+	std::vector<double> mSamples;
+
+	size_t mNext = 0;
+
+	size_t mCount = 0;
+
+	double mLast = 0.0;
+};
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	Minimal task system: a fixed set of worker threads pulling jobs out of a shared queue.
+
+	ParallelFor() is the only thing the renderers need: it splits some work in N tasks, runs them on the workers and
+	returns once all of them are done. The calling thread doesn't sit idle in the meantime, it executes queued jobs too,
+	so ParallelFor() can also be called from inside a task without deadlocking.
+*/
+class TaskSystem
+{
+public:
+
+	//One worker per hardware thread, minus the calling one which takes part in ParallelFor() as well
+	static uint32_t GetDefaultWorkerCount()
+	{
+		return std::max(1u, std::thread::hardware_concurrency()) - 1;
+	}
+
+	explicit TaskSystem(uint32_t WorkerCount = GetDefaultWorkerCount())
+	{
+		mWorkers.reserve(WorkerCount);
+		for (uint32_t i = 0; i < WorkerCount; ++i)
+		{
+			mWorkers.emplace_back([this, i]() { WorkerLoop(i + 1); });
+		}
+	}
+
+	~TaskSystem()
+	{
+		{
+			std::lock_guard<std::mutex> Lock(mMutex);
+			mQuitting = true;
+		}
+		mWakeUp.notify_all();
+
+		for (auto& Worker : mWorkers)
+		{
+			Worker.join();
+		}
+	}
+
+	TaskSystem(const TaskSystem&) = delete;
+	TaskSystem& operator=(const TaskSystem&) = delete;
+
+	//Number of threads that can run tasks concurrently (workers plus the calling thread)
+	uint32_t GetThreadCount() const
+	{
+		return static_cast<uint32_t>(mWorkers.size()) + 1;
+	}
+
+	//Index of the calling thread in [0, GetThreadCount()): workers are 1 ... N, any other thread is 0.
+	//Lets tasks pick per thread resources without locking, as long as ParallelFor() is only issued from one non worker thread.
+	static uint32_t GetCurrentThreadIndex()
+	{
+		return CurrentThreadIndex();
+	}
+
+	//Run Task(0) ... Task(TaskCount - 1) concurrently and wait for all of them to complete.
+	//If some tasks throw, the first exception is rethrown on the calling thread once the whole batch is over.
+	void ParallelFor(uint32_t TaskCount, const std::function<void(uint32_t)>& Task)
+	{
+		if (TaskCount == 0)
+		{
+			return;
+		}
+
+		//Nothing to gain from going through the queue
+		if (TaskCount == 1 || mWorkers.empty())
+		{
+			for (uint32_t i = 0; i < TaskCount; ++i)
+			{
+				Task(i);
+			}
+			return;
+		}
+
+		std::atomic<uint32_t> Remaining(TaskCount);
+		std::exception_ptr FirstError;
+		std::mutex ErrorMutex;
+		{
+			std::lock_guard<std::mutex> Lock(mMutex);
+			for (uint32_t i = 0; i < TaskCount; ++i)
+			{
+				mJobs.push_back([&Task, &Remaining, &FirstError, &ErrorMutex, i]()
+				{
+					try
+					{
+						Task(i);
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> ErrorLock(ErrorMutex);
+						if (!FirstError)
+						{
+							FirstError = std::current_exception();
+						}
+					}
+					Remaining.fetch_sub(1, std::memory_order_acq_rel);
+				});
+			}
+		}
+		mWakeUp.notify_all();
+
+		//Help out until every task of this batch is done
+		while (Remaining.load(std::memory_order_acquire) != 0)
+		{
+			if (!RunOneJob())
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		if (FirstError)
+		{
+			std::rethrow_exception(FirstError);
+		}
+	}
+
+private:
+
+	//Pops and runs one job, returns false if the queue was empty
+	bool RunOneJob()
+	{
+		std::function<void()> Job;
+		{
+			std::lock_guard<std::mutex> Lock(mMutex);
+			if (mJobs.empty())
+			{
+				return false;
+			}
+			Job = std::move(mJobs.front());
+			mJobs.pop_front();
+		}
+		Job();
+		return true;
+	}
+
+	static uint32_t& CurrentThreadIndex()
+	{
+		static thread_local uint32_t ThreadIndex = 0;
+		return ThreadIndex;
+	}
+
+	void WorkerLoop(uint32_t ThreadIndex)
+	{
+		CurrentThreadIndex() = ThreadIndex;
+
+		for (;;)
+		{
+			std::function<void()> Job;
+			{
+				std::unique_lock<std::mutex> Lock(mMutex);
+				mWakeUp.wait(Lock, [this]() { return mQuitting || !mJobs.empty(); });
+				if (mQuitting && mJobs.empty())
+				{
+					return;
+				}
+				Job = std::move(mJobs.front());
+				mJobs.pop_front();
+			}
+			Job();
+		}
+	}
+
+	std::vector<std::thread> mWorkers;
+
+	std::deque<std::function<void()>> mJobs;
+
+	std::mutex mMutex;
+
+	std::condition_variable mWakeUp;
+
+	bool mQuitting = false;
+};
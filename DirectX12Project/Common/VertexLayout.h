@@ -0,0 +1,244 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+	Vertex input layouts described once, next to the C++ vertex struct, and turned into VkVertexInput*Description
+	(VulkanVertexLayout.h) or D3D12_INPUT_ELEMENT_DESC (D3D12VertexLayout.h) at compile time.
+
+	C++ has no reflection, so the struct lists its attributes in a VertexLayoutTraits specialization; VERTEX_ATTRIBUTE
+	takes the format from the member's type and the offset from offsetof, so they can't drift away from the struct:
+
+		struct MyVertex { float mPosition[3]; UNorm8x4 mColor; };
+
+		template<> struct VertexLayoutTraits<MyVertex>
+		{
+			static constexpr std::array<VertexAttributeDesc, 2> GetAttributes()
+			{
+				return { { VERTEX_ATTRIBUTE(MyVertex, mPosition, "POSITION", 0), VERTEX_ATTRIBUTE(MyVertex, mColor, "COLOR", 1) } };
+			}
+		};
+
+	The packed types below (half floats, normalized integers) give quantized vertex formats the same way, the shader
+	still reads floats.
+*/
+
+enum class VertexFormat : uint8_t
+{
+	Float1,
+	Float2,
+	Float3,
+	Float4,
+	Half2,
+	Half4,
+	UNorm8x4,
+	SNorm8x4,
+	UInt8x4,
+	UNorm16x2,
+	SNorm16x2,
+	SNorm16x4,
+	UInt1,
+	SInt1,
+};
+
+//What the shader sees: normalized and half formats are read as floats
+enum class VertexFormatClass : uint8_t
+{
+	Float,
+	UInt,
+	SInt,
+};
+
+constexpr uint32_t GetVertexFormatSize(VertexFormat Format)
+{
+	switch (Format)
+	{
+	case VertexFormat::Float1: return 4;
+	case VertexFormat::Float2: return 8;
+	case VertexFormat::Float3: return 12;
+	case VertexFormat::Float4: return 16;
+	case VertexFormat::Half2: return 4;
+	case VertexFormat::Half4: return 8;
+	case VertexFormat::UNorm8x4: return 4;
+	case VertexFormat::SNorm8x4: return 4;
+	case VertexFormat::UInt8x4: return 4;
+	case VertexFormat::UNorm16x2: return 4;
+	case VertexFormat::SNorm16x2: return 4;
+	case VertexFormat::SNorm16x4: return 8;
+	case VertexFormat::UInt1: return 4;
+	case VertexFormat::SInt1: return 4;
+	}
+	return 0;
+}
+
+constexpr VertexFormatClass GetVertexFormatClass(VertexFormat Format)
+{
+	return Format == VertexFormat::UInt8x4 || Format == VertexFormat::UInt1 ? VertexFormatClass::UInt :
+		Format == VertexFormat::SInt1 ? VertexFormatClass::SInt : VertexFormatClass::Float;
+}
+
+//PACKED ATTRIBUTE TYPES
+
+struct Half2 { uint16_t mX, mY; };
+struct Half4 { uint16_t mX, mY, mZ, mW; };
+struct UNorm8x4 { uint8_t mX, mY, mZ, mW; };
+struct SNorm8x4 { int8_t mX, mY, mZ, mW; };
+struct UInt8x4 { uint8_t mX, mY, mZ, mW; };
+struct UNorm16x2 { uint16_t mX, mY; };
+struct SNorm16x2 { int16_t mX, mY; };
+struct SNorm16x4 { int16_t mX, mY, mZ, mW; };
+
+//IEEE 754 half, round to nearest even; out of range values become infinity, NaN stays NaN
+inline uint16_t FloatToHalf(float Value)
+{
+	uint32_t Bits;
+	std::memcpy(&Bits, &Value, sizeof(Bits));
+
+	const uint32_t Sign = (Bits >> 16) & 0x8000;
+	const uint32_t Exponent = (Bits >> 23) & 0xFF;
+	uint32_t Mantissa = Bits & 0x7FFFFF;
+
+	if (Exponent == 0xFF)
+	{
+		return static_cast<uint16_t>(Sign | 0x7C00 | (Mantissa != 0 ? 0x200 : 0));
+	}
+
+	const int32_t HalfExponent = static_cast<int32_t>(Exponent) - 127 + 15;
+	if (HalfExponent >= 31)
+	{
+		return static_cast<uint16_t>(Sign | 0x7C00);
+	}
+	if (HalfExponent <= 0)
+	{
+		//Subnormal half (or zero): shift the mantissa with its implicit bit in
+		if (HalfExponent < -10)
+		{
+			return static_cast<uint16_t>(Sign);
+		}
+		Mantissa |= 0x800000;
+		const uint32_t Shift = static_cast<uint32_t>(14 - HalfExponent);
+		uint32_t Half = Mantissa >> Shift;
+		const uint32_t Remainder = Mantissa & ((1u << Shift) - 1);
+		const uint32_t Halfway = 1u << (Shift - 1);
+		if (Remainder > Halfway || (Remainder == Halfway && (Half & 1) != 0))
+		{
+			++Half;
+		}
+		return static_cast<uint16_t>(Sign | Half);
+	}
+
+	uint32_t Half = Sign | (static_cast<uint32_t>(HalfExponent) << 10) | (Mantissa >> 13);
+	const uint32_t Remainder = Mantissa & 0x1FFF;
+	if (Remainder > 0x1000 || (Remainder == 0x1000 && (Half & 1) != 0))
+	{
+		//May carry into the exponent, which is still the right answer (up to infinity)
+		++Half;
+	}
+	return static_cast<uint16_t>(Half);
+}
+
+//[0, 1] to [0, Max]
+inline uint32_t PackUNorm(float Value, uint32_t Max)
+{
+	const float Clamped = Value < 0.0f ? 0.0f : (Value > 1.0f ? 1.0f : Value);
+	return static_cast<uint32_t>(std::lround(Clamped * static_cast<float>(Max)));
+}
+
+//[-1, 1] to [-Max, Max]
+inline int32_t PackSNorm(float Value, int32_t Max)
+{
+	const float Clamped = Value < -1.0f ? -1.0f : (Value > 1.0f ? 1.0f : Value);
+	return static_cast<int32_t>(std::lround(Clamped * static_cast<float>(Max)));
+}
+
+//MEMBER TYPE TO FORMAT
+
+//Specialized for every type a vertex member can have (API headers add their math library's vector types)
+template<typename T>
+struct VertexFormatOf;
+
+template<> struct VertexFormatOf<float> { static constexpr VertexFormat kFormat = VertexFormat::Float1; };
+template<> struct VertexFormatOf<float[2]> { static constexpr VertexFormat kFormat = VertexFormat::Float2; };
+template<> struct VertexFormatOf<float[3]> { static constexpr VertexFormat kFormat = VertexFormat::Float3; };
+template<> struct VertexFormatOf<float[4]> { static constexpr VertexFormat kFormat = VertexFormat::Float4; };
+template<> struct VertexFormatOf<Half2> { static constexpr VertexFormat kFormat = VertexFormat::Half2; };
+template<> struct VertexFormatOf<Half4> { static constexpr VertexFormat kFormat = VertexFormat::Half4; };
+template<> struct VertexFormatOf<UNorm8x4> { static constexpr VertexFormat kFormat = VertexFormat::UNorm8x4; };
+template<> struct VertexFormatOf<SNorm8x4> { static constexpr VertexFormat kFormat = VertexFormat::SNorm8x4; };
+template<> struct VertexFormatOf<UInt8x4> { static constexpr VertexFormat kFormat = VertexFormat::UInt8x4; };
+template<> struct VertexFormatOf<UNorm16x2> { static constexpr VertexFormat kFormat = VertexFormat::UNorm16x2; };
+template<> struct VertexFormatOf<SNorm16x2> { static constexpr VertexFormat kFormat = VertexFormat::SNorm16x2; };
+template<> struct VertexFormatOf<SNorm16x4> { static constexpr VertexFormat kFormat = VertexFormat::SNorm16x4; };
+template<> struct VertexFormatOf<uint32_t> { static constexpr VertexFormat kFormat = VertexFormat::UInt1; };
+template<> struct VertexFormatOf<int32_t> { static constexpr VertexFormat kFormat = VertexFormat::SInt1; };
+
+//LAYOUT DESCRIPTION
+
+struct VertexAttributeDesc
+{
+	//HLSL semantic (D3D12), and its index (TEXCOORD1 ...)
+	const char* mSemantic;
+	uint32_t mSemanticIndex;
+
+	//GLSL layout(location = N) (Vulkan)
+	uint32_t mLocation;
+
+	VertexFormat mFormat;
+
+	//Byte offset in the vertex
+	uint32_t mOffset;
+};
+
+//Specialize with: static constexpr std::array<VertexAttributeDesc, N> GetAttributes()
+template<typename Vertex>
+struct VertexLayoutTraits;
+
+template<typename MemberType>
+constexpr VertexAttributeDesc MakeVertexAttribute(const char* Semantic, uint32_t SemanticIndex, uint32_t Location, uint32_t Offset)
+{
+	static_assert(sizeof(MemberType) == GetVertexFormatSize(VertexFormatOf<MemberType>::kFormat), "Vertex member size doesn't match its format");
+	return VertexAttributeDesc{ Semantic, SemanticIndex, Location, VertexFormatOf<MemberType>::kFormat, Offset };
+}
+
+#define VERTEX_ATTRIBUTE(Vertex, Member, Semantic, Location) \
+	MakeVertexAttribute<decltype(Vertex::Member)>(Semantic, 0, Location, static_cast<uint32_t>(offsetof(Vertex, Member)))
+
+#define VERTEX_ATTRIBUTE_INDEXED(Vertex, Member, Semantic, SemanticIndex, Location) \
+	MakeVertexAttribute<decltype(Vertex::Member)>(Semantic, SemanticIndex, Location, static_cast<uint32_t>(offsetof(Vertex, Member)))
+
+template<typename Vertex>
+constexpr size_t GetVertexAttributeCount()
+{
+	return VertexLayoutTraits<Vertex>::GetAttributes().size();
+}
+
+//Every attribute inside the vertex, no two of them overlapping or sharing a location. API helpers static_assert this.
+template<typename Vertex>
+constexpr bool IsVertexLayoutValid()
+{
+	constexpr size_t Count = GetVertexAttributeCount<Vertex>();
+	const std::array<VertexAttributeDesc, Count> Attributes = VertexLayoutTraits<Vertex>::GetAttributes();
+	for (size_t i = 0; i < Count; ++i)
+	{
+		const uint32_t Begin = Attributes[i].mOffset;
+		const uint32_t End = Begin + GetVertexFormatSize(Attributes[i].mFormat);
+		if (End > sizeof(Vertex))
+		{
+			return false;
+		}
+		for (size_t j = i + 1; j < Count; ++j)
+		{
+			const uint32_t OtherBegin = Attributes[j].mOffset;
+			const uint32_t OtherEnd = OtherBegin + GetVertexFormatSize(Attributes[j].mFormat);
+			if (Attributes[i].mLocation == Attributes[j].mLocation || (Begin < OtherEnd && OtherBegin < End))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
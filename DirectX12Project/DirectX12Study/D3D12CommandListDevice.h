@@ -0,0 +1,88 @@
+#pragma once
+
+#include <wrl.h>
+#include <d3d12.h>
+
+#include <mutex>
+#include <vector>
+
+#include "Helpers.h"
+
+/*
+	DeviceType of CommandListPool for D3D12 direct command lists.
+
+	The pool deals in raw pointers, the references are held here and released on destruction (or Destroy()), once the
+	GPU is idle. ID3D12Device is free threaded, only the bookkeeping of the created objects needs a lock.
+*/
+class D3D12CommandListDevice
+{
+public:
+
+	typedef ID3D12CommandAllocator* AllocatorHandle;
+	typedef ID3D12GraphicsCommandList* CommandListHandle;
+
+	explicit D3D12CommandListDevice(ID3D12Device* Device, D3D12_COMMAND_LIST_TYPE Type = D3D12_COMMAND_LIST_TYPE_DIRECT)
+		: mDevice(Device), mType(Type)
+	{
+	}
+
+	D3D12CommandListDevice(const D3D12CommandListDevice&) = delete;
+	D3D12CommandListDevice& operator=(const D3D12CommandListDevice&) = delete;
+
+	AllocatorHandle CreateAllocator()
+	{
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> Allocator;
+		ThrowIfFailed(mDevice->CreateCommandAllocator(mType, IID_PPV_ARGS(&Allocator)));
+
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mAllocators.push_back(Allocator);
+		return Allocator.Get();
+	}
+
+	CommandListHandle CreateCommandList(AllocatorHandle Allocator)
+	{
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> CommandList;
+		ThrowIfFailed(mDevice->CreateCommandList(0, mType, Allocator, nullptr, IID_PPV_ARGS(&CommandList)));
+
+		//Command lists are created in the recording state, the pool expects them closed
+		ThrowIfFailed(CommandList->Close());
+
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mCommandLists.push_back(CommandList);
+		return CommandList.Get();
+	}
+
+	void ResetAllocator(AllocatorHandle Allocator)
+	{
+		ThrowIfFailed(Allocator->Reset());
+	}
+
+	void ResetCommandList(CommandListHandle CommandList, AllocatorHandle Allocator)
+	{
+		ThrowIfFailed(CommandList->Reset(Allocator, nullptr));
+	}
+
+	void CloseCommandList(CommandListHandle CommandList)
+	{
+		ThrowIfFailed(CommandList->Close());
+	}
+
+	void Destroy()
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mCommandLists.clear();
+		mAllocators.clear();
+	}
+
+private:
+
+	Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+
+	D3D12_COMMAND_LIST_TYPE mType;
+
+	std::mutex mMutex;
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> mAllocators;
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>> mCommandLists;
+};
@@ -0,0 +1,249 @@
+#pragma once
+
+#include <wrl.h>
+#include <d3d12.h>
+#include "d3dx12.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "Helpers.h"
+#include "../Common/DescriptorPageAllocator.h"
+#include "../Common/GpuFence.h"
+#include "../Common/RingAllocator.h"
+
+//Contiguous descriptors in a CPU only heap
+struct D3D12DescriptorAllocation
+{
+	DescriptorRange mRange;
+
+	D3D12_CPU_DESCRIPTOR_HANDLE mCpuHandle = {};
+
+	UINT mDescriptorSize = 0;
+
+	bool IsValid() const
+	{
+		return mRange.IsValid();
+	}
+
+	uint32_t GetCount() const
+	{
+		return mRange.mCount;
+	}
+
+	D3D12_CPU_DESCRIPTOR_HANDLE GetCpuHandle(uint32_t Index = 0) const
+	{
+		return CD3DX12_CPU_DESCRIPTOR_HANDLE(mCpuHandle, Index, mDescriptorSize);
+	}
+};
+
+/*
+	Persistent views (RTV, DSV, and the CBV/SRV/UAV/sampler originals) live in CPU only heaps: creating and copying
+	descriptors there is cheap, and there is no limit on how many such heaps exist. They come in pages handed out by a
+	DescriptorPageAllocator, so views are created and released individually without ever moving.
+
+	Free() takes the fence value of the last frame that may reference the view; it's reused only after Retire() sees that
+	value completed. Thread safe.
+*/
+class D3D12CpuDescriptorAllocator
+{
+public:
+
+	D3D12CpuDescriptorAllocator(ID3D12Device* Device, D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t DescriptorsPerPage = 256)
+		: mDevice(Device), mType(Type), mPageAllocator(DescriptorsPerPage, [this](uint32_t) { CreatePage(); })
+	{
+		mDescriptorSize = mDevice->GetDescriptorHandleIncrementSize(Type);
+	}
+
+	D3D12CpuDescriptorAllocator(const D3D12CpuDescriptorAllocator&) = delete;
+	D3D12CpuDescriptorAllocator& operator=(const D3D12CpuDescriptorAllocator&) = delete;
+
+	D3D12DescriptorAllocation Allocate(uint32_t Count = 1)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+
+		D3D12DescriptorAllocation Allocation;
+		Allocation.mRange = mPageAllocator.Allocate(Count);
+		Allocation.mCpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(mPages[Allocation.mRange.mPage]->GetCPUDescriptorHandleForHeapStart(), Allocation.mRange.mOffset, mDescriptorSize);
+		Allocation.mDescriptorSize = mDescriptorSize;
+		return Allocation;
+	}
+
+	//The descriptors can be overwritten once the GPU reaches FenceValue
+	void Free(D3D12DescriptorAllocation& Allocation, uint64_t FenceValue)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mPageAllocator.Free(Allocation.mRange, FenceValue);
+		Allocation = D3D12DescriptorAllocation();
+	}
+
+	//Reclaim the descriptors freed by the frames the GPU has completed
+	void Retire(uint64_t CompletedValue)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mPageAllocator.Retire(CompletedValue);
+	}
+
+	DescriptorPageStatistics GetStatistics()
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		return mPageAllocator.GetStatistics();
+	}
+
+	UINT GetDescriptorSize() const
+	{
+		return mDescriptorSize;
+	}
+
+private:
+
+	void CreatePage()
+	{
+		D3D12_DESCRIPTOR_HEAP_DESC Desc = {};
+		Desc.NumDescriptors = mPageAllocator.GetDescriptorsPerPage();
+		Desc.Type = mType;
+		Desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+
+		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> Heap;
+		ThrowIfFailed(mDevice->CreateDescriptorHeap(&Desc, IID_PPV_ARGS(&Heap)));
+		mPages.push_back(Heap);
+	}
+
+	Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+
+	D3D12_DESCRIPTOR_HEAP_TYPE mType;
+
+	UINT mDescriptorSize = 0;
+
+	std::mutex mMutex;
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> mPages;
+
+	DescriptorPageAllocator mPageAllocator;
+};
+
+/*
+	The shader visible heap (CBV/SRV/UAV or sampler) the command lists bind. Only one of each type can be bound at a
+	time, and switching is expensive, so there is a single big one used as a ring: every frame, the descriptor tables
+	it needs are copied from the CPU only heaps into fresh contiguous slots with one CopyDescriptors() call per table.
+	The slots of a frame are recycled once its fence value completes. Thread safe.
+
+		Ring.BeginFrame(Fence.GetCompletedValue());
+		CommandList->SetDescriptorHeaps(1, Ring.GetHeapAddress());
+		CommandList->SetGraphicsRootDescriptorTable(0, Ring.CopyTable(Sources, Count));
+		Ring.EndFrame(FenceValueOfTheFrame);
+*/
+class D3D12ShaderVisibleDescriptorRing
+{
+public:
+
+	//Fence is the one signaled at the end of every frame, waited on if the ring ever gets full
+	void Create(ID3D12Device* Device, D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t DescriptorCount, IGpuFence& Fence)
+	{
+		mDevice = Device;
+		mType = Type;
+		mFence = &Fence;
+		mDescriptorSize = Device->GetDescriptorHandleIncrementSize(Type);
+		mRing.Reset(DescriptorCount);
+
+		D3D12_DESCRIPTOR_HEAP_DESC Desc = {};
+		Desc.NumDescriptors = DescriptorCount;
+		Desc.Type = Type;
+		Desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+		ThrowIfFailed(Device->CreateDescriptorHeap(&Desc, IID_PPV_ARGS(&mHeap)));
+
+		mCpuStart = mHeap->GetCPUDescriptorHandleForHeapStart();
+		mGpuStart = mHeap->GetGPUDescriptorHandleForHeapStart();
+	}
+
+	void Destroy()
+	{
+		mHeap.Reset();
+		mDevice.Reset();
+	}
+
+	void BeginFrame(uint64_t CompletedValue)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mRing.Retire(CompletedValue);
+	}
+
+	void EndFrame(uint64_t FenceValue)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mRing.FinishFrame(FenceValue);
+	}
+
+	//Copy Count descriptors, scattered across any CPU only heaps, into contiguous slots. Returns the GPU handle of the table.
+	D3D12_GPU_DESCRIPTOR_HANDLE CopyTable(const D3D12_CPU_DESCRIPTOR_HANDLE* Sources, UINT Count)
+	{
+		const uint64_t Offset = AllocateSlots(Count);
+
+		//One destination range, Count source ranges of one descriptor each: a single call whatever the sources are
+		D3D12_CPU_DESCRIPTOR_HANDLE Destination = CD3DX12_CPU_DESCRIPTOR_HANDLE(mCpuStart, static_cast<INT>(Offset), mDescriptorSize);
+		const UINT DestinationSize = Count;
+		mDevice->CopyDescriptors(1, &Destination, &DestinationSize, Count, Sources, nullptr, mType);
+
+		return CD3DX12_GPU_DESCRIPTOR_HANDLE(mGpuStart, static_cast<INT>(Offset), mDescriptorSize);
+	}
+
+	//Same, for descriptors already contiguous in a CPU only heap
+	D3D12_GPU_DESCRIPTOR_HANDLE CopyTable(const D3D12DescriptorAllocation& Source)
+	{
+		const uint64_t Offset = AllocateSlots(Source.GetCount());
+
+		D3D12_CPU_DESCRIPTOR_HANDLE Destination = CD3DX12_CPU_DESCRIPTOR_HANDLE(mCpuStart, static_cast<INT>(Offset), mDescriptorSize);
+		mDevice->CopyDescriptorsSimple(Source.GetCount(), Destination, Source.GetCpuHandle(), mType);
+
+		return CD3DX12_GPU_DESCRIPTOR_HANDLE(mGpuStart, static_cast<INT>(Offset), mDescriptorSize);
+	}
+
+	ID3D12DescriptorHeap* GetHeap() const
+	{
+		return mHeap.Get();
+	}
+
+	ID3D12DescriptorHeap* const* GetHeapAddress() const
+	{
+		return mHeap.GetAddressOf();
+	}
+
+	uint64_t GetPeakUsedCount() const
+	{
+		return mRing.GetPeakUsedSize();
+	}
+
+private:
+
+	uint64_t AllocateSlots(UINT Count)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		const uint64_t Offset = mRing.AllocateOrWait(Count, 1, [this](uint64_t Value) { mFence->Wait(Value); });
+		if (Offset == RingAllocator::kInvalidOffset)
+		{
+			throw std::runtime_error("Shader visible descriptor heap too small for the table");
+		}
+		return Offset;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+
+	D3D12_DESCRIPTOR_HEAP_TYPE mType = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+
+	IGpuFence* mFence = nullptr;
+
+	UINT mDescriptorSize = 0;
+
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mHeap;
+
+	D3D12_CPU_DESCRIPTOR_HANDLE mCpuStart = {};
+
+	D3D12_GPU_DESCRIPTOR_HANDLE mGpuStart = {};
+
+	std::mutex mMutex;
+
+	RingAllocator mRing;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <wrl.h>
+#include <d3d12.h>
+
+#include <cassert>
+#include <cstdint>
+
+#include "Helpers.h"
+#include "../Common/GpuFence.h"
+
+/*
+	IGpuFence on top of an ID3D12Fence.
+
+	The fence is signaled **FROM** the GPU: ID3D12CommandQueue::Signal doesn't set the value immediately but only once the
+	command queue has reached that point during execution, i.e. once every command queued before the signal has completed.
+	The CPU waits for a value through an OS event that the fence sets when it gets there.
+*/
+class D3D12GpuFence : public IGpuFence
+{
+public:
+
+	D3D12GpuFence() = default;
+
+	~D3D12GpuFence() override
+	{
+		Destroy();
+	}
+
+	D3D12GpuFence(const D3D12GpuFence&) = delete;
+	D3D12GpuFence& operator=(const D3D12GpuFence&) = delete;
+
+	//Signals go through CommandQueue
+	void Create(ID3D12Device* Device, ID3D12CommandQueue* CommandQueue)
+	{
+		ThrowIfFailed(Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
+		mCommandQueue = CommandQueue;
+
+		//Event used to stall the CPU until the GPU reaches a fence value
+		mFenceEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+		assert(mFenceEvent && "Failed to create fence event.");
+	}
+
+	void Destroy()
+	{
+		if (mFenceEvent != NULL)
+		{
+			::CloseHandle(mFenceEvent);
+			mFenceEvent = NULL;
+		}
+		mFence.Reset();
+		mCommandQueue.Reset();
+	}
+
+	uint64_t GetCompletedValue() override
+	{
+		return mFence->GetCompletedValue();
+	}
+
+	void Signal(uint64_t Value) override
+	{
+		ThrowIfFailed(mCommandQueue->Signal(mFence.Get(), Value));
+	}
+
+	void Wait(uint64_t Value) override
+	{
+		if (mFence->GetCompletedValue() < Value)
+		{
+			ThrowIfFailed(mFence->SetEventOnCompletion(Value, mFenceEvent));
+			::WaitForSingleObject(mFenceEvent, INFINITE);
+		}
+	}
+
+	ID3D12Fence* Get() const
+	{
+		return mFence.Get();
+	}
+
+private:
+
+	Microsoft::WRL::ComPtr<ID3D12Fence> mFence;
+
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> mCommandQueue;
+
+	HANDLE mFenceEvent = NULL;
+};
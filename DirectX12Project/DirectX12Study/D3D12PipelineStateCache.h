@@ -0,0 +1,775 @@
+#pragma once
+
+#include <wrl.h>
+#include <d3d12.h>
+#include "d3dx12.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Helpers.h"
+#include "../Common/AsyncCache.h"
+#include "../Common/Hash.h"
+
+/*
+	A pipeline state stream (CD3DX12_PIPELINE_STATE_STREAM1, or any sequence of CD3DX12_PIPELINE_STATE_STREAM_XXX
+	subobjects) reduced to a hash of what it describes, and optionally deep copied so that the pipeline can be created
+	later, on another thread, once the caller's stream is gone.
+
+	The hash covers the content of the subobjects, never their addresses: shader bytecode, input elements and their
+	semantic names, stream output declarations... and skips the padding of the state descs. Two streams describing the
+	same pipeline hash the same however they were built, and the hash is stable from one run to the next (it names the
+	pipeline in the pipeline library saved to disk). Root signatures are hashed through RootSignatureHash, which gives
+	the hash of their serialized blob for the ones created by D3D12RootSignatureCache.
+	The cached PSO subobject isn't part of what the pipeline is, it's neither hashed nor copied.
+*/
+class D3D12PipelineStream : public ID3DX12PipelineParserCallbacks
+{
+public:
+
+	typedef std::function<uint64_t(ID3D12RootSignature*)> RootSignatureHashFunction;
+
+	//Bump when the hashing changes, hashes saved to disk become meaningless
+	static const uint32_t kHashVersion = 1;
+
+	static uint64_t ComputeHash(const D3D12_PIPELINE_STATE_STREAM_DESC& Desc, const RootSignatureHashFunction& RootSignatureHash)
+	{
+		D3D12PipelineStream Stream(Desc, RootSignatureHash, false);
+		return Stream.GetHash();
+	}
+
+	//Hash and copy Desc
+	D3D12PipelineStream(const D3D12_PIPELINE_STATE_STREAM_DESC& Desc, const RootSignatureHashFunction& RootSignatureHash)
+		: D3D12PipelineStream(Desc, RootSignatureHash, true)
+	{
+	}
+
+	//The copy points into itself
+	D3D12PipelineStream(const D3D12PipelineStream&) = delete;
+	D3D12PipelineStream& operator=(const D3D12PipelineStream&) = delete;
+
+	uint64_t GetHash() const
+	{
+		return mHash;
+	}
+
+	//The copied stream, valid as long as this object is
+	D3D12_PIPELINE_STATE_STREAM_DESC GetDesc() const
+	{
+		D3D12_PIPELINE_STATE_STREAM_DESC Desc = {};
+		Desc.SizeInBytes = mStream.size() * sizeof(void*);
+		Desc.pPipelineStateSubobjectStream = const_cast<void**>(mStream.data());
+		return Desc;
+	}
+
+	//ID3DX12PipelineParserCallbacks
+	void FlagsCb(D3D12_PIPELINE_STATE_FLAGS Flags) override
+	{
+		Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_FLAGS, Flags);
+		Append(CD3DX12_PIPELINE_STATE_STREAM_FLAGS(Flags));
+	}
+
+	void NodeMaskCb(UINT NodeMask) override
+	{
+		Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_NODE_MASK, NodeMask);
+		Append(CD3DX12_PIPELINE_STATE_STREAM_NODE_MASK(NodeMask));
+	}
+
+	void RootSignatureCb(ID3D12RootSignature* RootSignature) override
+	{
+		Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE, mRootSignatureHash ? mRootSignatureHash(RootSignature) : reinterpret_cast<uintptr_t>(RootSignature));
+		if (mCopy)
+		{
+			//Keep it alive until the pipeline is created
+			mRootSignature = RootSignature;
+			Append(CD3DX12_PIPELINE_STATE_STREAM_ROOT_SIGNATURE(RootSignature));
+		}
+	}
+
+	void InputLayoutCb(const D3D12_INPUT_LAYOUT_DESC& InputLayout) override
+	{
+		Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT, InputLayout.NumElements);
+		for (UINT i = 0; i < InputLayout.NumElements; ++i)
+		{
+			const D3D12_INPUT_ELEMENT_DESC& Element = InputLayout.pInputElementDescs[i];
+			AddString(Element.SemanticName);
+			Add(Element.SemanticIndex);
+			Add(Element.Format);
+			Add(Element.InputSlot);
+			Add(Element.AlignedByteOffset);
+			Add(Element.InputSlotClass);
+			Add(Element.InstanceDataStepRate);
+		}
+
+		if (mCopy)
+		{
+			mInputElements.assign(InputLayout.pInputElementDescs, InputLayout.pInputElementDescs + InputLayout.NumElements);
+			mInputSemanticNames.reserve(InputLayout.NumElements);
+			for (auto& Element : mInputElements)
+			{
+				mInputSemanticNames.push_back(Element.SemanticName);
+			}
+			for (size_t i = 0; i < mInputElements.size(); ++i)
+			{
+				mInputElements[i].SemanticName = mInputSemanticNames[i].c_str();
+			}
+			Append(CD3DX12_PIPELINE_STATE_STREAM_INPUT_LAYOUT(D3D12_INPUT_LAYOUT_DESC{ mInputElements.data(), InputLayout.NumElements }));
+		}
+	}
+
+	void IBStripCutValueCb(D3D12_INDEX_BUFFER_STRIP_CUT_VALUE IBStripCutValue) override
+	{
+		Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_IB_STRIP_CUT_VALUE, IBStripCutValue);
+		Append(CD3DX12_PIPELINE_STATE_STREAM_IB_STRIP_CUT_VALUE(IBStripCutValue));
+	}
+
+	void PrimitiveTopologyTypeCb(D3D12_PRIMITIVE_TOPOLOGY_TYPE PrimitiveTopologyType) override
+	{
+		Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PRIMITIVE_TOPOLOGY, PrimitiveTopologyType);
+		Append(CD3DX12_PIPELINE_STATE_STREAM_PRIMITIVE_TOPOLOGY(PrimitiveTopologyType));
+	}
+
+	void VSCb(const D3D12_SHADER_BYTECODE& VS) override
+	{
+		Append(CD3DX12_PIPELINE_STATE_STREAM_VS(AddShader(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS, VS)));
+	}
+
+	void GSCb(const D3D12_SHADER_BYTECODE& GS) override
+	{
+		Append(CD3DX12_PIPELINE_STATE_STREAM_GS(AddShader(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_GS, GS)));
+	}
+
+	void HSCb(const D3D12_SHADER_BYTECODE& HS) override
+	{
+		Append(CD3DX12_PIPELINE_STATE_STREAM_HS(AddShader(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_HS, HS)));
+	}
+
+	void DSCb(const D3D12_SHADER_BYTECODE& DS) override
+	{
+		Append(CD3DX12_PIPELINE_STATE_STREAM_DS(AddShader(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DS, DS)));
+	}
+
+	void PSCb(const D3D12_SHADER_BYTECODE& PS) override
+	{
+		Append(CD3DX12_PIPELINE_STATE_STREAM_PS(AddShader(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS, PS)));
+	}
+
+	void CSCb(const D3D12_SHADER_BYTECODE& CS) override
+	{
+		Append(CD3DX12_PIPELINE_STATE_STREAM_CS(AddShader(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS, CS)));
+	}
+
+	void StreamOutputCb(const D3D12_STREAM_OUTPUT_DESC& StreamOutput) override
+	{
+		Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_STREAM_OUTPUT, StreamOutput.NumEntries);
+		for (UINT i = 0; i < StreamOutput.NumEntries; ++i)
+		{
+			const D3D12_SO_DECLARATION_ENTRY& Entry = StreamOutput.pSODeclaration[i];
+			Add(Entry.Stream);
+			AddString(Entry.SemanticName);
+			Add(Entry.SemanticIndex);
+			Add(Entry.StartComponent);
+			Add(Entry.ComponentCount);
+			Add(Entry.OutputSlot);
+		}
+		Add(StreamOutput.NumStrides);
+		for (UINT i = 0; i < StreamOutput.NumStrides; ++i)
+		{
+			Add(StreamOutput.pBufferStrides[i]);
+		}
+		Add(StreamOutput.RasterizedStream);
+
+		if (mCopy)
+		{
+			mStreamOutputEntries.assign(StreamOutput.pSODeclaration, StreamOutput.pSODeclaration + StreamOutput.NumEntries);
+			mStreamOutputSemanticNames.reserve(StreamOutput.NumEntries);
+			for (auto& Entry : mStreamOutputEntries)
+			{
+				//Null names declare gaps
+				mStreamOutputSemanticNames.push_back(Entry.SemanticName != nullptr ? Entry.SemanticName : "");
+			}
+			for (size_t i = 0; i < mStreamOutputEntries.size(); ++i)
+			{
+				if (mStreamOutputEntries[i].SemanticName != nullptr)
+				{
+					mStreamOutputEntries[i].SemanticName = mStreamOutputSemanticNames[i].c_str();
+				}
+			}
+			mStreamOutputStrides.assign(StreamOutput.pBufferStrides, StreamOutput.pBufferStrides + StreamOutput.NumStrides);
+
+			D3D12_STREAM_OUTPUT_DESC Copy = StreamOutput;
+			Copy.pSODeclaration = mStreamOutputEntries.data();
+			Copy.pBufferStrides = mStreamOutputStrides.data();
+			Append(CD3DX12_PIPELINE_STATE_STREAM_STREAM_OUTPUT(Copy));
+		}
+	}
+
+	void BlendStateCb(const D3D12_BLEND_DESC& BlendState) override
+	{
+		Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_BLEND, BlendState.AlphaToCoverageEnable);
+		Add(BlendState.IndependentBlendEnable);
+		for (const auto& RenderTarget : BlendState.RenderTarget)
+		{
+			Add(RenderTarget.BlendEnable);
+			Add(RenderTarget.LogicOpEnable);
+			Add(RenderTarget.SrcBlend);
+			Add(RenderTarget.DestBlend);
+			Add(RenderTarget.BlendOp);
+			Add(RenderTarget.SrcBlendAlpha);
+			Add(RenderTarget.DestBlendAlpha);
+			Add(RenderTarget.BlendOpAlpha);
+			Add(RenderTarget.LogicOp);
+			Add(RenderTarget.RenderTargetWriteMask);
+		}
+		Append(CD3DX12_PIPELINE_STATE_STREAM_BLEND_DESC(CD3DX12_BLEND_DESC(BlendState)));
+	}
+
+	void DepthStencilStateCb(const D3D12_DEPTH_STENCIL_DESC& DepthStencilState) override
+	{
+		Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL, 0);
+		AddDepthStencil(DepthStencilState);
+		Append(CD3DX12_PIPELINE_STATE_STREAM_DEPTH_STENCIL(CD3DX12_DEPTH_STENCIL_DESC(DepthStencilState)));
+	}
+
+	void DepthStencilState1Cb(const D3D12_DEPTH_STENCIL_DESC1& DepthStencilState) override
+	{
+		Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL1, DepthStencilState.DepthBoundsTestEnable);
+		AddDepthStencil(DepthStencilState);
+		Append(CD3DX12_PIPELINE_STATE_STREAM_DEPTH_STENCIL1(CD3DX12_DEPTH_STENCIL_DESC1(DepthStencilState)));
+	}
+
+	void DSVFormatCb(DXGI_FORMAT DSVFormat) override
+	{
+		Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL_FORMAT, DSVFormat);
+		Append(CD3DX12_PIPELINE_STATE_STREAM_DEPTH_STENCIL_FORMAT(DSVFormat));
+	}
+
+	//No padding in there
+	void RasterizerStateCb(const D3D12_RASTERIZER_DESC& RasterizerState) override
+	{
+		Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RASTERIZER, HashValue(RasterizerState));
+		Append(CD3DX12_PIPELINE_STATE_STREAM_RASTERIZER(CD3DX12_RASTERIZER_DESC(RasterizerState)));
+	}
+
+	void RTVFormatsCb(const D3D12_RT_FORMAT_ARRAY& RTVFormats) override
+	{
+		Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RENDER_TARGET_FORMATS, RTVFormats.NumRenderTargets);
+		for (UINT i = 0; i < RTVFormats.NumRenderTargets && i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i)
+		{
+			Add(RTVFormats.RTFormats[i]);
+		}
+		Append(CD3DX12_PIPELINE_STATE_STREAM_RENDER_TARGET_FORMATS(RTVFormats));
+	}
+
+	void SampleDescCb(const DXGI_SAMPLE_DESC& SampleDesc) override
+	{
+		Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_DESC, SampleDesc.Count);
+		Add(SampleDesc.Quality);
+		Append(CD3DX12_PIPELINE_STATE_STREAM_SAMPLE_DESC(SampleDesc));
+	}
+
+	void SampleMaskCb(UINT SampleMask) override
+	{
+		Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_MASK, SampleMask);
+		Append(CD3DX12_PIPELINE_STATE_STREAM_SAMPLE_MASK(SampleMask));
+	}
+
+	void ViewInstancingCb(const D3D12_VIEW_INSTANCING_DESC& ViewInstancing) override
+	{
+		Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VIEW_INSTANCING, ViewInstancing.ViewInstanceCount);
+		Add(ViewInstancing.Flags);
+		for (UINT i = 0; i < ViewInstancing.ViewInstanceCount; ++i)
+		{
+			Add(ViewInstancing.pViewInstanceLocations[i].ViewportArrayIndex);
+			Add(ViewInstancing.pViewInstanceLocations[i].RenderTargetArrayIndex);
+		}
+
+		if (mCopy)
+		{
+			mViewInstanceLocations.assign(ViewInstancing.pViewInstanceLocations, ViewInstancing.pViewInstanceLocations + ViewInstancing.ViewInstanceCount);
+			D3D12_VIEW_INSTANCING_DESC Copy = ViewInstancing;
+			Copy.pViewInstanceLocations = mViewInstanceLocations.data();
+			Append(CD3DX12_PIPELINE_STATE_STREAM_VIEW_INSTANCING(CD3DX12_VIEW_INSTANCING_DESC(Copy)));
+		}
+	}
+
+	void ErrorBadInputParameter(UINT) override
+	{
+		mValid = false;
+	}
+
+	void ErrorDuplicateSubobject(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE) override
+	{
+		mValid = false;
+	}
+
+	void ErrorUnknownSubobject(UINT) override
+	{
+		mValid = false;
+	}
+
+private:
+
+	D3D12PipelineStream(const D3D12_PIPELINE_STATE_STREAM_DESC& Desc, const RootSignatureHashFunction& RootSignatureHash, bool Copy)
+		: mRootSignatureHash(RootSignatureHash), mCopy(Copy)
+	{
+		Add(kHashVersion);
+		if (FAILED(D3DX12ParsePipelineStream(Desc, this)) || !mValid)
+		{
+			throw std::invalid_argument("Invalid pipeline state stream");
+		}
+	}
+
+	void Add(uint64_t Value)
+	{
+		mHash = HashCombine(mHash, Value);
+	}
+
+	//Subobjects start with their type, so that a missing one doesn't look like the next one
+	void Add(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type, uint64_t Value)
+	{
+		Add(static_cast<uint64_t>(Type));
+		Add(Value);
+	}
+
+	void AddString(const char* String)
+	{
+		Add(String != nullptr ? HashBytes(String, strlen(String)) : 0);
+	}
+
+	void AddStencilOp(const D3D12_DEPTH_STENCILOP_DESC& StencilOp)
+	{
+		Add(StencilOp.StencilFailOp);
+		Add(StencilOp.StencilDepthFailOp);
+		Add(StencilOp.StencilPassOp);
+		Add(StencilOp.StencilFunc);
+	}
+
+	//Field by field: the two UINT8 masks are followed by padding
+	template <typename DepthStencilDescType>
+	void AddDepthStencil(const DepthStencilDescType& DepthStencilState)
+	{
+		Add(DepthStencilState.DepthEnable);
+		Add(DepthStencilState.DepthWriteMask);
+		Add(DepthStencilState.DepthFunc);
+		Add(DepthStencilState.StencilEnable);
+		Add(DepthStencilState.StencilReadMask);
+		Add(DepthStencilState.StencilWriteMask);
+		AddStencilOp(DepthStencilState.FrontFace);
+		AddStencilOp(DepthStencilState.BackFace);
+	}
+
+	D3D12_SHADER_BYTECODE AddShader(D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type, const D3D12_SHADER_BYTECODE& Shader)
+	{
+		Add(Type, Shader.BytecodeLength);
+		Add(HashBytes(Shader.pShaderBytecode, Shader.BytecodeLength));
+
+		if (!mCopy)
+		{
+			return Shader;
+		}
+
+		const uint8_t* Bytecode = static_cast<const uint8_t*>(Shader.pShaderBytecode);
+		mShaders.emplace_back(Bytecode, Bytecode + Shader.BytecodeLength);
+		return D3D12_SHADER_BYTECODE{ mShaders.back().data(), Shader.BytecodeLength };
+	}
+
+	//Subobjects are pointer aligned, and every CD3DX12 one is padded to a multiple of a pointer
+	template <typename SubobjectType>
+	void Append(const SubobjectType& Subobject)
+	{
+		static_assert(sizeof(SubobjectType) % sizeof(void*) == 0, "Pipeline state subobjects must be pointer aligned");
+		if (!mCopy)
+		{
+			return;
+		}
+
+		const size_t Offset = mStream.size();
+		mStream.resize(Offset + sizeof(SubobjectType) / sizeof(void*));
+		memcpy(&mStream[Offset], &Subobject, sizeof(SubobjectType));
+	}
+
+	RootSignatureHashFunction mRootSignatureHash;
+
+	bool mCopy;
+
+	bool mValid = true;
+
+	uint64_t mHash = kFNV_OFFSET_BASIS;
+
+	//The copy: the subobjects, and everything they point to
+	std::vector<void*> mStream;
+
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> mRootSignature;
+
+	std::vector<std::vector<uint8_t>> mShaders;
+
+	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputElements;
+
+	std::vector<std::string> mInputSemanticNames;
+
+	std::vector<D3D12_SO_DECLARATION_ENTRY> mStreamOutputEntries;
+
+	std::vector<std::string> mStreamOutputSemanticNames;
+
+	std::vector<UINT> mStreamOutputStrides;
+
+	std::vector<D3D12_VIEW_INSTANCE_LOCATION> mViewInstanceLocations;
+};
+
+/*
+	Root signatures deduplicated by the hash of their serialized blob, which is also what identifies them in the hash
+	of a pipeline state stream. Thread safe.
+*/
+class D3D12RootSignatureCache
+{
+public:
+
+	void Create(ID3D12Device* Device)
+	{
+		mDevice = Device;
+
+		D3D12_FEATURE_DATA_ROOT_SIGNATURE FeatureData = {};
+		FeatureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+		if (FAILED(Device->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &FeatureData, sizeof(FeatureData))))
+		{
+			FeatureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+		}
+		mHighestVersion = FeatureData.HighestVersion;
+	}
+
+	void Destroy()
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mRootSignatures.clear();
+		mHashes.clear();
+		mDevice.Reset();
+	}
+
+	//Serialized for the highest version the device supports (1.1 descs are converted down if needed)
+	ID3D12RootSignature* GetRootSignature(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& Desc)
+	{
+		Microsoft::WRL::ComPtr<ID3DBlob> Blob;
+		Microsoft::WRL::ComPtr<ID3DBlob> Error;
+		if (FAILED(D3DX12SerializeVersionedRootSignature(&Desc, mHighestVersion, &Blob, &Error)))
+		{
+			if (Error)
+			{
+				OutputDebugStringA(static_cast<const char*>(Error->GetBufferPointer()));
+			}
+			throw std::runtime_error("Failed to serialize the root signature");
+		}
+		return GetRootSignature(Blob->GetBufferPointer(), Blob->GetBufferSize());
+	}
+
+	//From a serialized root signature (D3D12SerializeVersionedRootSignature, or the one embedded in a shader)
+	ID3D12RootSignature* GetRootSignature(const void* Blob, size_t Size)
+	{
+		const uint64_t Hash = HashBytes(Blob, Size);
+
+		//Creating a root signature is cheap, no need to do it outside of the lock
+		std::lock_guard<std::mutex> Lock(mMutex);
+		auto It = mRootSignatures.find(Hash);
+		if (It != mRootSignatures.end())
+		{
+			return It->second.Get();
+		}
+
+		Microsoft::WRL::ComPtr<ID3D12RootSignature> RootSignature;
+		ThrowIfFailed(mDevice->CreateRootSignature(0, Blob, Size, IID_PPV_ARGS(&RootSignature)));
+		mRootSignatures[Hash] = RootSignature;
+		mHashes[RootSignature.Get()] = Hash;
+		return RootSignature.Get();
+	}
+
+	//Hash of the blob of a root signature created here, its address (only stable within a run) for any other one
+	uint64_t GetHash(ID3D12RootSignature* RootSignature)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		auto It = mHashes.find(RootSignature);
+		return It != mHashes.end() ? It->second : static_cast<uint64_t>(reinterpret_cast<uintptr_t>(RootSignature));
+	}
+
+private:
+
+	Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+
+	D3D_ROOT_SIGNATURE_VERSION mHighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+
+	std::mutex mMutex;
+
+	std::unordered_map<uint64_t, Microsoft::WRL::ComPtr<ID3D12RootSignature>> mRootSignatures;
+
+	std::unordered_map<ID3D12RootSignature*, uint64_t> mHashes;
+};
+
+struct D3D12PipelineStateCacheStatistics
+{
+	AsyncCacheStatistics mCache;
+
+	//Pipelines loaded from the pipeline library instead of compiled
+	uint64_t mLibraryHitCount = 0;
+
+	uint64_t mCompiledCount = 0;
+};
+
+/*
+	Every pipeline state of the application, created once and keyed by the hash of its stream (see D3D12PipelineStream),
+	so that asking for the same pipeline twice, from any thread, returns the same object.
+
+	- GetPipelineState() returns the pipeline, creating it on the spot if needed: fine at load time, a hitch in a frame.
+	- RequestPipelineState() never waits: a pipeline that doesn't exist yet is compiled on a background thread and the
+	  fallback is returned until it's ready (e.g. a generic version of the material, or nullptr to skip the draw).
+
+	Created pipelines go into an ID3D12PipelineLibrary that is saved to disk and loaded on the next run, where creating
+	them again is just a lookup by name (the hash). The library blob is wrapped in a header with a hash of its payload,
+	to catch truncated or corrupted files; the runtime itself rejects libraries made by another adapter or driver, and
+	either way we start from an empty library. The file is written to a temporary file and renamed over the old one.
+
+	The pipeline library is free threaded as long as the same pipeline isn't loaded by two threads at once, which the
+	cache already guarantees. Pipelines are owned by the cache and released by Destroy().
+*/
+class D3D12PipelineStateCache
+{
+public:
+
+	D3D12PipelineStateCache() = default;
+
+	D3D12PipelineStateCache(const D3D12PipelineStateCache&) = delete;
+	D3D12PipelineStateCache& operator=(const D3D12PipelineStateCache&) = delete;
+
+	void Create(ID3D12Device2* Device, const std::string& FilePath, uint32_t BackgroundThreadCount = 1)
+	{
+		mDevice = Device;
+		mFilePath = FilePath;
+		mRootSignatures.Create(Device);
+		mCache = std::make_unique<AsyncCache<Microsoft::WRL::ComPtr<ID3D12PipelineState>>>(BackgroundThreadCount);
+		CreateLibrary();
+	}
+
+	//Waits for the pipelines being compiled, drops the queued ones
+	void Destroy()
+	{
+		mCache.reset();
+		mLibrary.Reset();
+		mLibraryData.clear();
+		mRootSignatures.Destroy();
+		mDevice.Reset();
+	}
+
+	D3D12RootSignatureCache& GetRootSignatures()
+	{
+		return mRootSignatures;
+	}
+
+	uint64_t ComputeHash(const D3D12_PIPELINE_STATE_STREAM_DESC& Desc)
+	{
+		return D3D12PipelineStream::ComputeHash(Desc, [this](ID3D12RootSignature* RootSignature) { return mRootSignatures.GetHash(RootSignature); });
+	}
+
+	ID3D12PipelineState* GetPipelineState(const D3D12_PIPELINE_STATE_STREAM_DESC& Desc)
+	{
+		const uint64_t Hash = ComputeHash(Desc);
+
+		//Created before this call returns, no need to copy the stream
+		return mCache->GetOrCreate(Hash, [this, Hash, &Desc]() { return CreatePipelineState(Hash, Desc); }).Get();
+	}
+
+	ID3D12PipelineState* RequestPipelineState(const D3D12_PIPELINE_STATE_STREAM_DESC& Desc, ID3D12PipelineState* Fallback)
+	{
+		const uint64_t Hash = ComputeHash(Desc);
+
+		auto MakeCreate = [this, Hash, &Desc]()
+		{
+			std::shared_ptr<D3D12PipelineStream> Stream = std::make_shared<D3D12PipelineStream>(Desc, [this](ID3D12RootSignature* RootSignature) { return mRootSignatures.GetHash(RootSignature); });
+			return [this, Hash, Stream]() { return CreatePipelineState(Hash, Stream->GetDesc()); };
+		};
+		return mCache->Request(Hash, MakeCreate, Fallback).Get();
+	}
+
+	//Wait for the background compilations
+	void WaitIdle()
+	{
+		mCache->WaitIdle();
+	}
+
+	size_t GetPendingCount()
+	{
+		return mCache->GetPendingCount();
+	}
+
+	//Write the pipeline library to disk, once the background compilations are done (nothing to do if nothing was added)
+	void Save()
+	{
+		mCache->WaitIdle();
+		if (!mLibrary || !mLibraryDirty)
+		{
+			return;
+		}
+
+		std::vector<char> Data(mLibrary->GetSerializedSize());
+		if (Data.empty() || FAILED(mLibrary->Serialize(Data.data(), Data.size())))
+		{
+			OutputDebugStringA("Failed to serialize the pipeline library, it won't be saved\n");
+			return;
+		}
+
+		FileHeader Header = {};
+		Header.mMagic = kMagic;
+		Header.mFileVersion = kFileVersion;
+		Header.mHashVersion = D3D12PipelineStream::kHashVersion;
+		Header.mDataSize = Data.size();
+		Header.mDataHash = HashBytes(Data.data(), Data.size());
+
+		const std::string TempPath = mFilePath + ".tmp";
+		{
+			std::ofstream File(TempPath, std::ios::binary | std::ios::trunc);
+			if (!File.is_open())
+			{
+				OutputDebugStringA(("Failed to open " + TempPath + " for writing, the pipeline library won't be saved\n").c_str());
+				return;
+			}
+			File.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+			File.write(Data.data(), Data.size());
+			if (!File.good())
+			{
+				OutputDebugStringA(("Failed to write " + TempPath + ", the pipeline library won't be saved\n").c_str());
+				return;
+			}
+		}
+
+		if (!::MoveFileExA(TempPath.c_str(), mFilePath.c_str(), MOVEFILE_REPLACE_EXISTING))
+		{
+			OutputDebugStringA(("Failed to replace " + mFilePath + "\n").c_str());
+			::DeleteFileA(TempPath.c_str());
+			return;
+		}
+		mLibraryDirty = false;
+	}
+
+	D3D12PipelineStateCacheStatistics GetStatistics()
+	{
+		D3D12PipelineStateCacheStatistics Statistics;
+		Statistics.mCache = mCache->GetStatistics();
+		Statistics.mLibraryHitCount = mLibraryHitCount;
+		Statistics.mCompiledCount = mCompiledCount;
+		return Statistics;
+	}
+
+private:
+
+	static const uint32_t kMagic = 0x4C505844; // 'DXPL'
+	static const uint32_t kFileVersion = 1;
+
+	struct FileHeader
+	{
+		uint32_t mMagic;
+		uint32_t mFileVersion;
+		uint32_t mHashVersion;
+		uint32_t mPadding;
+		uint64_t mDataSize;
+		uint64_t mDataHash;
+	};
+
+	void CreateLibrary()
+	{
+		mLibraryData = LoadFromDisk();
+
+		//The library keeps pointing into the blob it's created from, mLibraryData lives as long as it does
+		HRESULT Result = mDevice->CreatePipelineLibrary(mLibraryData.empty() ? nullptr : mLibraryData.data(), mLibraryData.size(), IID_PPV_ARGS(&mLibrary));
+		if (FAILED(Result) && !mLibraryData.empty())
+		{
+			//D3D12_ERROR_ADAPTER_NOT_FOUND, D3D12_ERROR_DRIVER_VERSION_MISMATCH...
+			OutputDebugStringA(("Pipeline library " + mFilePath + " was rejected by the driver, discarding it\n").c_str());
+			mLibraryData.clear();
+			Result = mDevice->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&mLibrary));
+		}
+
+		if (FAILED(Result))
+		{
+			//DXGI_ERROR_UNSUPPORTED on some drivers and tools: pipelines are compiled on every run
+			OutputDebugStringA("Pipeline libraries aren't supported, pipelines won't be saved\n");
+			mLibrary.Reset();
+		}
+	}
+
+	//The library blob if the file exists and is intact, an empty vector otherwise
+	std::vector<char> LoadFromDisk() const
+	{
+		std::ifstream File(mFilePath, std::ios::ate | std::ios::binary);
+		if (!File.is_open())
+		{
+			return {};
+		}
+
+		const size_t FileSize = static_cast<size_t>(File.tellg());
+		File.seekg(0);
+
+		FileHeader Header = {};
+		if (FileSize < sizeof(Header) || !File.read(reinterpret_cast<char*>(&Header), sizeof(Header)) ||
+			Header.mMagic != kMagic || Header.mFileVersion != kFileVersion || Header.mHashVersion != D3D12PipelineStream::kHashVersion ||
+			Header.mDataSize != FileSize - sizeof(Header))
+		{
+			OutputDebugStringA(("Pipeline library " + mFilePath + " is truncated or outdated, discarding it\n").c_str());
+			return {};
+		}
+
+		std::vector<char> Data(static_cast<size_t>(Header.mDataSize));
+		if (!File.read(Data.data(), Data.size()) || HashBytes(Data.data(), Data.size()) != Header.mDataHash)
+		{
+			OutputDebugStringA(("Pipeline library " + mFilePath + " is corrupted, discarding it\n").c_str());
+			return {};
+		}
+		return Data;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> CreatePipelineState(uint64_t Hash, const D3D12_PIPELINE_STATE_STREAM_DESC& Desc)
+	{
+		const std::string HashString = HashToString(Hash);
+		const std::wstring Name(HashString.begin(), HashString.end());
+
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> PipelineState;
+		if (mLibrary && SUCCEEDED(mLibrary->LoadPipeline(Name.c_str(), &Desc, IID_PPV_ARGS(&PipelineState))))
+		{
+			++mLibraryHitCount;
+			return PipelineState;
+		}
+
+		//The expensive part: the driver compiles the shaders for this GPU
+		ThrowIfFailed(mDevice->CreatePipelineState(&Desc, IID_PPV_ARGS(&PipelineState)));
+		++mCompiledCount;
+
+		if (mLibrary && SUCCEEDED(mLibrary->StorePipeline(Name.c_str(), PipelineState.Get())))
+		{
+			mLibraryDirty = true;
+		}
+		return PipelineState;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D12Device2> mDevice;
+
+	std::string mFilePath;
+
+	D3D12RootSignatureCache mRootSignatures;
+
+	std::unique_ptr<AsyncCache<Microsoft::WRL::ComPtr<ID3D12PipelineState>>> mCache;
+
+	Microsoft::WRL::ComPtr<ID3D12PipelineLibrary1> mLibrary;
+
+	std::vector<char> mLibraryData;
+
+	std::atomic<bool> mLibraryDirty{ false };
+
+	std::atomic<uint64_t> mLibraryHitCount{ 0 };
+
+	std::atomic<uint64_t> mCompiledCount{ 0 };
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <d3d12.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "../Common/ResourceStateTracker.h"
+
+/*
+	ResourceStateTracker for D3D12_RESOURCE_STATES.
+
+	Resources are registered with the state they're in, then every use is declared with Transition(): the barriers come
+	out of FlushBarriers() as one ResourceBarrier() call (or as a batch to record later, e.g. from another thread), with
+	BEGIN_ONLY/END_ONLY flags for the split transitions started with BeginTransition().
+*/
+class D3D12ResourceStateTracker
+{
+public:
+
+	void Register(ID3D12Resource* Resource, D3D12_RESOURCE_STATES InitialState)
+	{
+		mTracker.Register(GetKey(Resource), GetSubresourceCount(Resource), InitialState);
+	}
+
+	void Unregister(ID3D12Resource* Resource)
+	{
+		mTracker.Unregister(GetKey(Resource));
+	}
+
+	void Transition(ID3D12Resource* Resource, D3D12_RESOURCE_STATES After, UINT Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+	{
+		mTracker.Transition(GetKey(Resource), After, Subresource);
+	}
+
+	//Split barrier: the transition to After starts now and must be completed by Transition(Resource, After) before use
+	void BeginTransition(ID3D12Resource* Resource, D3D12_RESOURCE_STATES After, UINT Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+	{
+		mTracker.BeginTransition(GetKey(Resource), After, Subresource);
+	}
+
+	D3D12_RESOURCE_STATES GetState(ID3D12Resource* Resource, UINT Subresource = 0) const
+	{
+		return mTracker.GetState(GetKey(Resource), Subresource);
+	}
+
+	//The pending barriers, to be recorded with a single ResourceBarrier() call
+	std::vector<D3D12_RESOURCE_BARRIER> FlushBarriers()
+	{
+		std::vector<D3D12_RESOURCE_BARRIER> Barriers;
+		for (const auto& Transition : mTracker.Flush())
+		{
+			D3D12_RESOURCE_BARRIER Barrier = {};
+			Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+			Barrier.Flags = Transition.mKind == BarrierKind::Begin ? D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY
+				: Transition.mKind == BarrierKind::End ? D3D12_RESOURCE_BARRIER_FLAG_END_ONLY
+				: D3D12_RESOURCE_BARRIER_FLAG_NONE;
+			Barrier.Transition.pResource = reinterpret_cast<ID3D12Resource*>(static_cast<uintptr_t>(Transition.mResource));
+			Barrier.Transition.Subresource = Transition.mSubresource;
+			Barrier.Transition.StateBefore = Transition.mBefore;
+			Barrier.Transition.StateAfter = Transition.mAfter;
+			Barriers.push_back(Barrier);
+		}
+		return Barriers;
+	}
+
+	//Record the pending barriers on CommandList, all in one call
+	void FlushBarriers(ID3D12GraphicsCommandList* CommandList)
+	{
+		RecordBarriers(CommandList, FlushBarriers());
+	}
+
+	static void RecordBarriers(ID3D12GraphicsCommandList* CommandList, const std::vector<D3D12_RESOURCE_BARRIER>& Barriers)
+	{
+		if (!Barriers.empty())
+		{
+			CommandList->ResourceBarrier(static_cast<UINT>(Barriers.size()), Barriers.data());
+		}
+	}
+
+private:
+
+	static uint64_t GetKey(ID3D12Resource* Resource)
+	{
+		return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(Resource));
+	}
+
+	static uint32_t GetSubresourceCount(ID3D12Resource* Resource)
+	{
+		const D3D12_RESOURCE_DESC Desc = Resource->GetDesc();
+		if (Desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+		{
+			return 1;
+		}
+
+		//Depth is not made of subresources for 3D textures. Planes (depth/stencil formats) are ignored.
+		const uint32_t ArraySize = Desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : Desc.DepthOrArraySize;
+		return Desc.MipLevels * ArraySize;
+	}
+
+	ResourceStateTracker<D3D12_RESOURCE_STATES> mTracker;
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <wrl.h>
+#include <d3d12.h>
+#include "d3dx12.h"
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+#include "Helpers.h"
+#include "../Common/GpuFence.h"
+#include "../Common/RingAllocator.h"
+
+struct UploadAllocation
+{
+	ID3D12Resource* mResource = nullptr;
+
+	//Offset of the allocation inside mResource
+	uint64_t mOffset = 0;
+
+	void* mCpuAddress = nullptr;
+
+	D3D12_GPU_VIRTUAL_ADDRESS mGpuAddress = 0;
+};
+
+/*
+	One persistent, persistently mapped upload heap buffer, carved with a RingAllocator.
+
+	Instead of creating an intermediate resource for every upload, data is written in the ring and copied from there.
+	Whatever is allocated during a frame stays untouched until the fence value of that frame completes; when the ring is
+	full, the oldest frame in flight is waited for rather than failing. Also good for per frame constants, read by the GPU
+	directly from the upload heap (mGpuAddress).
+
+		Ring.BeginFrame(Fence.GetCompletedValue());
+		Ring.UploadSubresources(CommandList, Texture, 0, MipCount, Data);
+		... execute ...
+		Ring.EndFrame(FenceValueOfTheFrame);
+
+	Allocations can come from several recording threads at the same time.
+*/
+class D3D12UploadRing
+{
+public:
+
+	D3D12UploadRing() = default;
+
+	~D3D12UploadRing()
+	{
+		Destroy();
+	}
+
+	D3D12UploadRing(const D3D12UploadRing&) = delete;
+	D3D12UploadRing& operator=(const D3D12UploadRing&) = delete;
+
+	//Fence is the one signaled at the end of every frame, waited on when the ring is full
+	void Create(ID3D12Device* Device, IGpuFence& Fence, uint64_t Size)
+	{
+		mFence = &Fence;
+		mRing.Reset(Size);
+
+		CD3DX12_HEAP_PROPERTIES HeapProperties(D3D12_HEAP_TYPE_UPLOAD);
+		CD3DX12_RESOURCE_DESC BufferDesc = CD3DX12_RESOURCE_DESC::Buffer(Size);
+		ThrowIfFailed(Device->CreateCommittedResource(&HeapProperties, D3D12_HEAP_FLAG_NONE, &BufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&mBuffer)));
+
+		//Upload heaps can stay mapped for their whole life, the CPU never reads from it
+		CD3DX12_RANGE ReadRange(0, 0);
+		ThrowIfFailed(mBuffer->Map(0, &ReadRange, reinterpret_cast<void**>(&mMappedData)));
+		mGpuAddress = mBuffer->GetGPUVirtualAddress();
+	}
+
+	//The GPU must be done with the ring
+	void Destroy()
+	{
+		if (mBuffer)
+		{
+			mBuffer->Unmap(0, nullptr);
+			mBuffer.Reset();
+			mMappedData = nullptr;
+		}
+	}
+
+	//Give back the space of the frames the GPU has completed
+	void BeginFrame(uint64_t CompletedValue)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mRing.Retire(CompletedValue);
+	}
+
+	//Everything allocated since BeginFrame() is used by the frame that signals FenceValue
+	void EndFrame(uint64_t FenceValue)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mRing.FinishFrame(FenceValue);
+	}
+
+	//Size bytes aligned to Alignment, valid until the end of the current frame on the GPU
+	UploadAllocation Allocate(uint64_t Size, uint64_t Alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT)
+	{
+		uint64_t Offset;
+		{
+			std::lock_guard<std::mutex> Lock(mMutex);
+			Offset = mRing.AllocateOrWait(Size, Alignment, [this](uint64_t Value) { mFence->Wait(Value); });
+		}
+		if (Offset == RingAllocator::kInvalidOffset)
+		{
+			throw std::runtime_error("Upload ring too small for the request");
+		}
+
+		UploadAllocation Allocation;
+		Allocation.mResource = mBuffer.Get();
+		Allocation.mOffset = Offset;
+		Allocation.mCpuAddress = mMappedData + Offset;
+		Allocation.mGpuAddress = mGpuAddress + Offset;
+		return Allocation;
+	}
+
+	//Copy Data into Destination (a buffer) at DestinationOffset
+	void UploadBuffer(ID3D12GraphicsCommandList* CommandList, ID3D12Resource* Destination, uint64_t DestinationOffset, const void* Data, uint64_t Size)
+	{
+		UploadAllocation Allocation = Allocate(Size, 4);
+		std::memcpy(Allocation.mCpuAddress, Data, static_cast<size_t>(Size));
+		CommandList->CopyBufferRegion(Destination, DestinationOffset, Allocation.mResource, Allocation.mOffset, Size);
+	}
+
+	//Copy NumSubresources subresources of Destination (a whole mip chain, the faces of a cube ...) in one go: they share a
+	//single intermediate region laid out by UpdateSubresources. Destination must be in the COPY_DEST state.
+	void UploadSubresources(ID3D12GraphicsCommandList* CommandList, ID3D12Resource* Destination, UINT FirstSubresource, UINT NumSubresources, D3D12_SUBRESOURCE_DATA* Data)
+	{
+		const uint64_t RequiredSize = GetRequiredIntermediateSize(Destination, FirstSubresource, NumSubresources);
+		UploadAllocation Allocation = Allocate(RequiredSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+		if (UpdateSubresources(CommandList, Destination, Allocation.mResource, Allocation.mOffset, FirstSubresource, NumSubresources, Data) == 0)
+		{
+			throw std::runtime_error("UpdateSubresources failed");
+		}
+	}
+
+	uint64_t GetSize() const
+	{
+		return mRing.GetSize();
+	}
+
+	uint64_t GetPeakUsedSize() const
+	{
+		return mRing.GetPeakUsedSize();
+	}
+
+private:
+
+	IGpuFence* mFence = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mBuffer;
+
+	uint8_t* mMappedData = nullptr;
+
+	D3D12_GPU_VIRTUAL_ADDRESS mGpuAddress = 0;
+
+	std::mutex mMutex;
+
+	RingAllocator mRing;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <d3d12.h>
+#include <DirectXMath.h>
+
+#include <array>
+
+#include "../Common/VertexLayout.h"
+
+template<> struct VertexFormatOf<DirectX::XMFLOAT2> { static constexpr VertexFormat kFormat = VertexFormat::Float2; };
+template<> struct VertexFormatOf<DirectX::XMFLOAT3> { static constexpr VertexFormat kFormat = VertexFormat::Float3; };
+template<> struct VertexFormatOf<DirectX::XMFLOAT4> { static constexpr VertexFormat kFormat = VertexFormat::Float4; };
+
+constexpr DXGI_FORMAT ToDxgiFormat(VertexFormat Format)
+{
+	switch (Format)
+	{
+	case VertexFormat::Float1: return DXGI_FORMAT_R32_FLOAT;
+	case VertexFormat::Float2: return DXGI_FORMAT_R32G32_FLOAT;
+	case VertexFormat::Float3: return DXGI_FORMAT_R32G32B32_FLOAT;
+	case VertexFormat::Float4: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+	case VertexFormat::Half2: return DXGI_FORMAT_R16G16_FLOAT;
+	case VertexFormat::Half4: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+	case VertexFormat::UNorm8x4: return DXGI_FORMAT_R8G8B8A8_UNORM;
+	case VertexFormat::SNorm8x4: return DXGI_FORMAT_R8G8B8A8_SNORM;
+	case VertexFormat::UInt8x4: return DXGI_FORMAT_R8G8B8A8_UINT;
+	case VertexFormat::UNorm16x2: return DXGI_FORMAT_R16G16_UNORM;
+	case VertexFormat::SNorm16x2: return DXGI_FORMAT_R16G16_SNORM;
+	case VertexFormat::SNorm16x4: return DXGI_FORMAT_R16G16B16A16_SNORM;
+	case VertexFormat::UInt1: return DXGI_FORMAT_R32_UINT;
+	case VertexFormat::SInt1: return DXGI_FORMAT_R32_SINT;
+	}
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+//Input elements of Vertex in input slot Slot (semantics come from the layout traits)
+template<typename Vertex>
+constexpr std::array<D3D12_INPUT_ELEMENT_DESC, GetVertexAttributeCount<Vertex>()> GetD3D12InputElements(UINT Slot, D3D12_INPUT_CLASSIFICATION Classification = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA)
+{
+	static_assert(IsVertexLayoutValid<Vertex>(), "Vertex attributes overlap, share a location or don't fit in the vertex");
+
+	constexpr size_t Count = GetVertexAttributeCount<Vertex>();
+	const std::array<VertexAttributeDesc, Count> Attributes = VertexLayoutTraits<Vertex>::GetAttributes();
+	std::array<D3D12_INPUT_ELEMENT_DESC, Count> Elements = {};
+	for (size_t i = 0; i < Count; ++i)
+	{
+		Elements[i] = D3D12_INPUT_ELEMENT_DESC{ Attributes[i].mSemantic, Attributes[i].mSemanticIndex, ToDxgiFormat(Attributes[i].mFormat), Slot,
+			Attributes[i].mOffset, Classification, Classification == D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA ? 1u : 0u };
+	}
+	return Elements;
+}
+
+//What D3D12_GRAPHICS_PIPELINE_STATE_DESC::InputLayout wants for Vertex alone in slot 0. The elements live in static storage.
+template<typename Vertex>
+D3D12_INPUT_LAYOUT_DESC GetD3D12InputLayout()
+{
+	static const std::array<D3D12_INPUT_ELEMENT_DESC, GetVertexAttributeCount<Vertex>()> kElements = GetD3D12InputElements<Vertex>(0);
+
+	D3D12_INPUT_LAYOUT_DESC Layout = {};
+	Layout.pInputElementDescs = kElements.data();
+	Layout.NumElements = static_cast<UINT>(kElements.size());
+	return Layout;
+}
@@ -36,9 +36,23 @@
 // STL Headers
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "Helpers.h"
+#include "D3D12CommandListDevice.h"
+#include "D3D12DescriptorAllocator.h"
+#include "D3D12GpuFence.h"
+#include "D3D12PipelineStateCache.h"
+#include "D3D12ResourceStateTracker.h"
+#include "D3D12UploadRing.h"
+#include "../Common/CommandListPool.h"
+#include "../Common/FramePacer.h"
+#include "../Common/FrameStatistics.h"
 
 #if _DEBUG
 
@@ -80,17 +94,61 @@ ComPtr<ID3D12Device2> gDevice;
 ComPtr<ID3D12CommandQueue> gCommandQueue;
 ComPtr<IDXGISwapChain4> gSwapChain;
 ComPtr<ID3D12Resource> gBackBuffers[gNumFrames];
-ComPtr<ID3D12GraphicsCommandList> gCommandList;
-ComPtr<ID3D12CommandAllocator> gCommandAllocators[gNumFrames];
-ComPtr<ID3D12DescriptorHeap> gRTVDescriptorHeap;
-UINT gRTVDescriptorSize;
 UINT gCurrentBackBufferIndex;
 
 // Synchronization objects
-ComPtr<ID3D12Fence> gFence;
-uint64_t gFenceValue = 0;
-uint64_t gFrameFenceValues[gNumFrames] = {};
-HANDLE   gFenceEvent;
+D3D12GpuFence gFence;
+
+// Remembers the fence value of the last frame that used each back buffer (and its command allocator), so the CPU only waits when all of them are in flight
+FramePacer gFramePacer(gFence, gNumFrames);
+
+// Current state of every resource, barriers are derived from it rather than written by hand
+D3D12ResourceStateTracker gResourceStates;
+
+// Descriptors: persistent views live in paged CPU only heaps, the shader visible heap is a ring refilled every frame
+std::unique_ptr<D3D12CpuDescriptorAllocator> gRTVAllocator;
+std::unique_ptr<D3D12CpuDescriptorAllocator> gCBVSRVUAVAllocator;
+D3D12ShaderVisibleDescriptorRing gShaderVisibleDescriptors;
+const uint32_t gShaderVisibleDescriptorCount = 65536;
+
+// One RTV per back buffer
+D3D12DescriptorAllocation gBackBufferRTVs;
+
+// Persistent upload heap for streaming data to the GPU (textures, buffers, per frame constants)
+D3D12UploadRing gUploadRing;
+const uint64_t gUploadRingSize = 16 * 1024 * 1024;
+
+// Pipeline states and root signatures, compiled once (in the background if requested) and kept in a pipeline library on disk
+D3D12PipelineStateCache gPipelineStateCache;
+
+// Where the pipeline library is saved (--pipeline-library <path>)
+std::string gPipelineLibraryPath = "PipelineLibrary.bin";
+
+// The triangle drawn every frame. Its root signature and pipeline states belong to gPipelineStateCache.
+ComPtr<ID3DBlob> gTriangleVertexShader;
+ComPtr<ID3DBlob> gTrianglePixelShader;
+ID3D12RootSignature* gTriangleRootSignature = nullptr;
+ID3D12PipelineState* gTrianglePipeline = nullptr;
+
+// Draw the triangle in wireframe (toggled with the W key): that pipeline is compiled in the background the first time
+bool gWireframe = false;
+
+// Rotation of the triangle in radians, one per second
+float gTriangleAngle = 0.0f;
+
+// Parallel command list recording: every worker thread records into command lists from its own pool
+std::unique_ptr<TaskSystem> gTaskSystem;
+std::unique_ptr<D3D12CommandListDevice> gCommandListDevice;
+std::unique_ptr<CommandListPool<D3D12CommandListDevice>> gCommandListPool;
+
+// Threads recording the frame, the calling one included (--recording-threads <count>, 0 means one per hardware thread)
+uint32_t gRecordingThreadCount = 0;
+
+// Command lists the frame is split into (--recording-tasks <count>, 0 means one per recording thread)
+uint32_t gRecordingTaskCount = 0;
+
+// Measure the recording throughput for an increasing number of threads, then quit (--bench-recording)
+bool gBenchRecording = false;
 
 // By default, enable V-Sync.
 // Can be toggled with the V key.
@@ -101,6 +159,13 @@ bool gTearingSupported = false;
 // Can be toggled with the Alt+Enter or F11
 bool gFullscreen = false;
 
+// Per frame CPU, fence wait and present timings.
+FrameStatistics gFrameStatistics;
+FrameTimer gFrameTimer(gFrameStatistics);
+
+//If not empty the frame statistics are written to <path>.csv and <path>.json on exit (--frame-stats <path>)
+std::string gFrameStatisticsPath;
+
 
 // Window callback function.
 LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
@@ -125,6 +190,30 @@ void ParseCommandLineArguments()
 		{
 			gUseWarp = true;
 		}
+		if (::wcscmp(argv[i], L"--frame-stats") == 0 && i + 1 < argc)
+		{
+			char Path[MAX_PATH] = {};
+			::WideCharToMultiByte(CP_ACP, 0, argv[++i], -1, Path, MAX_PATH, nullptr, nullptr);
+			gFrameStatisticsPath = Path;
+		}
+		if (::wcscmp(argv[i], L"--pipeline-library") == 0 && i + 1 < argc)
+		{
+			char Path[MAX_PATH] = {};
+			::WideCharToMultiByte(CP_ACP, 0, argv[++i], -1, Path, MAX_PATH, nullptr, nullptr);
+			gPipelineLibraryPath = Path;
+		}
+		if (::wcscmp(argv[i], L"--recording-threads") == 0 && i + 1 < argc)
+		{
+			gRecordingThreadCount = ::wcstol(argv[++i], nullptr, 10);
+		}
+		if (::wcscmp(argv[i], L"--recording-tasks") == 0 && i + 1 < argc)
+		{
+			gRecordingTaskCount = ::wcstol(argv[++i], nullptr, 10);
+		}
+		if (::wcscmp(argv[i], L"--bench-recording") == 0)
+		{
+			gBenchRecording = true;
+		}
 	}
 
 	// Free memory allocated by CommandLineToArgvW
@@ -395,160 +484,176 @@ ComPtr<IDXGISwapChain4> CreateSwapChain(HWND     hWnd
 	return dxgiSwapChain4;
 }
 
-//Ready to create a Descriptor Heap
-
-ComPtr<ID3D12DescriptorHeap> CreateDescriptorHeap(  ComPtr<ID3D12Device2> Device
-												  , D3D12_DESCRIPTOR_HEAP_TYPE Type
-	                                              , uint32_t NumDescriptors)
-{
-	ComPtr<ID3D12DescriptorHeap> DescriptorHeap;
-
-	D3D12_DESCRIPTOR_HEAP_DESC Desc = {};
-	Desc.NumDescriptors = NumDescriptors;
-	Desc.Type           = Type;
-
-	ThrowIfFailed( Device->CreateDescriptorHeap(&Desc, IID_PPV_ARGS(&DescriptorHeap)) );
-
-	return DescriptorHeap;
-}
+//Descriptor heaps
+/*
+	Views are allocated from D3D12CpuDescriptorAllocator: CPU only heaps created a page at a time, with free lists, so
+	views can come and go without a fixed size heap to outgrow. What shaders see is copied every frame into the
+	D3D12ShaderVisibleDescriptorRing with CopyDescriptors.
+*/
 
 //We define a function to create the RTV for each backbuffer of our swapchain
 //For each back buffer of the swap chain, a single RTV is used to describe the resource.
 
-void UpdateRenderTargetViews( ComPtr<ID3D12Device2>        device
-	                        , ComPtr<IDXGISwapChain4>      swapChain
-	                        , ComPtr<ID3D12DescriptorHeap> descriptorHeap)
+void UpdateRenderTargetViews( ComPtr<ID3D12Device2>            device
+	                        , ComPtr<IDXGISwapChain4>          swapChain
+	                        , const D3D12DescriptorAllocation& RTVs)
 {
-	auto RTVDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-
-	CD3DX12_CPU_DESCRIPTOR_HANDLE RTVHandle(descriptorHeap->GetCPUDescriptorHandleForHeapStart());
-
 	for (int i = 0; i < gNumFrames; ++i)
 	{
 		ComPtr<ID3D12Resource> backBuffer;
 		ThrowIfFailed(swapChain->GetBuffer(i, IID_PPV_ARGS(&backBuffer)));
 
-		device->CreateRenderTargetView(backBuffer.Get(), nullptr, RTVHandle);
+		device->CreateRenderTargetView(backBuffer.Get(), nullptr, RTVs.GetCpuHandle(i));
 
-		gBackBuffers[i] = backBuffer;
+		//Back buffers come out of the swap chain ready to be presented
+		gResourceStates.Register(backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT);
 
-		RTVHandle.Offset(RTVDescriptorSize);
+		gBackBuffers[i] = backBuffer;
 	}
 }
 
-//Create a Command Allocator
+//Command allocators and command lists
 /*  
     A command allocator is the backing memory used by a command list. 
-	A command allocator is created using the ID3D12Device::CreateCommandAllocator method and must specify the type of command list the allocator will be used with. 	
 	The command allocator does not provide any functionality and can only be accessed indirectly through a command list.
-	The CreateCommandAllocator function is used to create the command allocator for the application. 	
-	In order to achieve maximum frame-rates for the application, one command allocator per "in-flight" command list should be created. 	
-	The CreateCommandAllocator function shown here only creates a single command allocator but this function will be used later to create multiple allocators for the demo.
+	An allocator can only be reset once the GPU has executed everything recorded through it, and only one command list can record into it at a time.
+	To record in parallel without stalling, each recording thread gets its own allocators, one per "in-flight" frame: see CommandListPool and D3D12CommandListDevice.
 */
 
-ComPtr<ID3D12CommandAllocator> CreateCommandAllocator( ComPtr<ID3D12Device2>   Device
-	                                                 , D3D12_COMMAND_LIST_TYPE Type)
-{
-	ComPtr<ID3D12CommandAllocator> CommandAllocator;
-	ThrowIfFailed( Device->CreateCommandAllocator(Type, IID_PPV_ARGS(&CommandAllocator)) );
-	return CommandAllocator;
-}
+//GPU synchronization (fence signal/wait) lives in D3D12GpuFence, frame pacing in FramePacer
 
+//Pipeline state objects
+/*
+	The triangle has no vertex buffer, its vertices come from SV_VertexID.
+	Root signatures and pipeline states are only ever asked to gPipelineStateCache: the same desc gives back the same
+	object, pipelines compiled by a previous run are loaded from the pipeline library, and the ones wanted in the middle
+	of a frame are compiled in the background while a fallback is drawn instead.
+*/
+static const char* kTriangleShaderSource = R"(
+cbuffer TriangleConstants : register(b0)
+{
+	float Angle;
+	float AspectRatio;
+};
 
-//Create a Command List
-
-//The CreateCommandList function is used to create a command list for the application.
-
-ComPtr<ID3D12GraphicsCommandList> CreateCommandList(  ComPtr<ID3D12Device2> Device
-	                                                , ComPtr<ID3D12CommandAllocator> CommandAllocator
-	                                                , D3D12_COMMAND_LIST_TYPE Type)
+struct VSOutput
 {
-	ComPtr<ID3D12GraphicsCommandList> CommandList;
+	float4 Position : SV_Position;
+	float3 Color : COLOR;
+};
 
-	ThrowIfFailed( Device->CreateCommandList(0, Type, CommandAllocator.Get(), nullptr, IID_PPV_ARGS(&CommandList)) );
+VSOutput VSMain(uint VertexId : SV_VertexID)
+{
+	const float2 Positions[3] = { float2(0.0f, 0.5f), float2(0.5f, -0.5f), float2(-0.5f, -0.5f) };
+	const float3 Colors[3] = { float3(1.0f, 0.0f, 0.0f), float3(0.0f, 1.0f, 0.0f), float3(0.0f, 0.0f, 1.0f) };
 
-	//Before to reset a command list, we must close it.
-	ThrowIfFailed( CommandList->Close() );
+	float Sin, Cos;
+	sincos(Angle, Sin, Cos);
+	const float2 Position = float2(Positions[VertexId].x * Cos - Positions[VertexId].y * Sin, Positions[VertexId].x * Sin + Positions[VertexId].y * Cos);
 
-	return CommandList;
+	VSOutput Output;
+	Output.Position = float4(Position.x * AspectRatio, Position.y, 0.0f, 1.0f);
+	Output.Color = Colors[VertexId];
+	return Output;
 }
 
-
-//The next functions deal with GPU synchronization.
-
-ComPtr<ID3D12Fence> CreateFence(ComPtr<ID3D12Device2> Device)
+float4 PSMain(VSOutput Input) : SV_Target
 {
-	ComPtr<ID3D12Fence> Fence;
-
-	ThrowIfFailed( Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&Fence)) );
-
-	return Fence;
+	return float4(Input.Color, 1.0f);
 }
+)";
 
-//An OS event handle is used to allow the CPU thread to wait until the fence has been signaled with a particular value.
-//In the next section, the OS event handle is created.
-
-HANDLE CreateEventHandle()
+//Written every frame in gUploadRing, must match the cbuffer of the vertex shader
+struct TriangleConstants
 {
-	HANDLE FenceEvent;
+	float mAngle;
+	float mAspectRatio;
+};
 
-	FenceEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
-	assert(FenceEvent && "Failed to create fence event.");
+//Subobjects of the triangle pipeline states, everything else keeps its default
+struct TrianglePipelineStream
+{
+	CD3DX12_PIPELINE_STATE_STREAM_ROOT_SIGNATURE RootSignature;
+	CD3DX12_PIPELINE_STATE_STREAM_PRIMITIVE_TOPOLOGY PrimitiveTopologyType;
+	CD3DX12_PIPELINE_STATE_STREAM_VS VS;
+	CD3DX12_PIPELINE_STATE_STREAM_PS PS;
+	CD3DX12_PIPELINE_STATE_STREAM_RASTERIZER RasterizerState;
+	CD3DX12_PIPELINE_STATE_STREAM_DEPTH_STENCIL1 DepthStencilState;
+	CD3DX12_PIPELINE_STATE_STREAM_RENDER_TARGET_FORMATS RTVFormats;
+};
+
+ComPtr<ID3DBlob> CompileShader(const char* Source, const char* EntryPoint, const char* Target)
+{
+	UINT Flags = D3DCOMPILE_ENABLE_STRICTNESS;
+#if defined(_DEBUG)
+	Flags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
 
-	return FenceEvent;
+	ComPtr<ID3DBlob> Bytecode;
+	ComPtr<ID3DBlob> Errors;
+	if (FAILED(D3DCompile(Source, std::strlen(Source), nullptr, nullptr, nullptr, EntryPoint, Target, Flags, 0, &Bytecode, &Errors)))
+	{
+		if (Errors)
+		{
+			OutputDebugStringA(static_cast<const char*>(Errors->GetBufferPointer()));
+		}
+		throw std::runtime_error(std::string("Failed to compile shader ") + EntryPoint);
+	}
+	return Bytecode;
 }
 
-//Signal the Fence
-
-/*
-	The Signal function is used to signal the fence **FROM** the GPU. It should be noted that when using the ID3D12CommandQueue::Signal method to signal a fence from the GPU, the fence is not signaled immediatly but is only signaled once the GPU command queue has reached that point during execution. 
-	Any commands that have been queued before the signal method was invoked must complete execution before the fence will be signaled.
-*/
-
-uint64_t Signal(   ComPtr<ID3D12CommandQueue> CommandQueue
-	             , ComPtr<ID3D12Fence> Fence
-	             , uint64_t& FenceValue)
+TrianglePipelineStream MakeTrianglePipelineStream(D3D12_FILL_MODE FillMode)
 {
-	uint64_t FenceValueForSignal = ++FenceValue;
-	ThrowIfFailed(CommandQueue->Signal(Fence.Get(), FenceValueForSignal));
-
-	return FenceValueForSignal;
+	CD3DX12_RASTERIZER_DESC RasterizerState(D3D12_DEFAULT);
+	RasterizerState.FillMode = FillMode;
+	RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+
+	CD3DX12_DEPTH_STENCIL_DESC1 DepthStencilState(D3D12_DEFAULT);
+	DepthStencilState.DepthEnable = FALSE;
+
+	D3D12_RT_FORMAT_ARRAY RTVFormats = {};
+	RTVFormats.NumRenderTargets = 1;
+	RTVFormats.RTFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+	TrianglePipelineStream Stream;
+	Stream.RootSignature = gTriangleRootSignature;
+	Stream.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	Stream.VS = CD3DX12_SHADER_BYTECODE(gTriangleVertexShader.Get());
+	Stream.PS = CD3DX12_SHADER_BYTECODE(gTrianglePixelShader.Get());
+	Stream.RasterizerState = RasterizerState;
+	Stream.DepthStencilState = DepthStencilState;
+	Stream.RTVFormats = RTVFormats;
+	return Stream;
 }
 
+//At load time, so the solid pipeline is created (or loaded from the library) before the first frame
+void CreateTrianglePipelines()
+{
+	gTriangleVertexShader = CompileShader(kTriangleShaderSource, "VSMain", "vs_5_1");
+	gTrianglePixelShader = CompileShader(kTriangleShaderSource, "PSMain", "ps_5_1");
+
+	//A single root CBV (b0): the per frame constants, read straight from the upload ring
+	CD3DX12_ROOT_PARAMETER1 ConstantsParameter;
+	ConstantsParameter.InitAsConstantBufferView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, D3D12_SHADER_VISIBILITY_VERTEX);
 
-//Wait for Fence Value
+	CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC RootSignatureDesc;
+	RootSignatureDesc.Init_1_1(1, &ConstantsParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE);
+	gTriangleRootSignature = gPipelineStateCache.GetRootSignatures().GetRootSignature(RootSignatureDesc);
 
-//CPU builds a command list and send it to the command queue on the GPU and wait for a fence value. 
-//As soon as the GPU reach that fence, after having executed all the queued commands, it'll signal that fence.
+	TrianglePipelineStream Stream = MakeTrianglePipelineStream(D3D12_FILL_MODE_SOLID);
+	gTrianglePipeline = gPipelineStateCache.GetPipelineState({ sizeof(Stream), &Stream });
+}
 
-void WaitForFenceValue( ComPtr<ID3D12Fence> Fence
-	                 ,  uint64_t FenceValue
-	                 ,  HANDLE FenceEvent
-	                 ,  std::chrono::milliseconds Duration = std::chrono::milliseconds::max() )
+//Never waits: until the wireframe pipeline is ready the solid one is drawn
+ID3D12PipelineState* GetTrianglePipeline()
 {
-	if (Fence->GetCompletedValue() < FenceValue)
+	if (!gWireframe)
 	{
-		ThrowIfFailed(Fence->SetEventOnCompletion(FenceValue, FenceEvent));
-		::WaitForSingleObject(FenceEvent, static_cast<DWORD>(Duration.count()));
+		return gTrianglePipeline;
 	}
-}
-
-
-//Flush the GPU
 
-/*
-	It is sometimes useful to wait until all previously executed commands have finished executing before doing something 
-	(for example, resizing the swap chain buffers requires any references to the buffers to be released). 
-	For this, the Flush function is used to ensure the GPU has finished processing all commands before continuing.
-*/
-
-void Flush(  ComPtr<ID3D12CommandQueue> CommandQueue
-	       , ComPtr<ID3D12Fence> Fence
-	       , uint64_t& FenceValue
-	       , HANDLE FenceEvent)
-{
-	uint64_t FenceValueForSignal = Signal(CommandQueue, Fence, FenceValue);
-	WaitForFenceValue(Fence, FenceValueForSignal, FenceEvent);
+	TrianglePipelineStream Stream = MakeTrianglePipelineStream(D3D12_FILL_MODE_WIREFRAME);
+	return gPipelineStateCache.RequestPipelineState({ sizeof(Stream), &Stream }, gTrianglePipeline);
 }
 
 
@@ -561,19 +666,30 @@ void Update()
 	static std::chrono::high_resolution_clock clock;
 	static auto t0 = clock.now();
 
+	//The frame time goes from one Update to the next
+	gFrameTimer.BeginFrame();
+
 	frameCounter++;
 	auto t1 = clock.now();
 	auto deltaTime = t1 - t0;
 	t0 = t1;
 
+	gTriangleAngle = std::fmod(gTriangleAngle + static_cast<float>(deltaTime.count() * 1e-9), 6.2831853f);
+
 	elapsedSeconds += deltaTime.count() * 1e-9;
 	if (elapsedSeconds > 1.0)
 	{
-		char buffer[500];
-		auto fps = frameCounter / elapsedSeconds;
-		sprintf_s(buffer, 500, "FPS: %f\n", fps);
-		OutputDebugString(buffer);
+		//Percentiles of the frames of the last second rather than a plain FPS average, so that hitches show up
+		FrameStatisticsReport Report = gFrameStatistics.ComputeReport(static_cast<size_t>(frameCounter));
+
+		//Frames that found every back buffer in flight (GPU bound)
+		static uint64_t lastBlockedFrameCount = 0;
+		const uint64_t blockedFrameCount = gFramePacer.GetStatistics().mBlockedFrameCount;
 
+		std::string Summary = FrameStatistics::FormatSummary(Report) + " | blocked on the GPU " + std::to_string(blockedFrameCount - lastBlockedFrameCount) + "/" + std::to_string(frameCounter) + " frames\n";
+		OutputDebugStringA(Summary.c_str());
+
+		lastBlockedFrameCount = blockedFrameCount;
 		frameCounter = 0;
 		elapsedSeconds = 0.0;
 	}
@@ -584,63 +700,114 @@ void Update()
 
 void Render(float* ClearColor)
 {
+	//Before overwriting the contents of the current back buffer, and resetting its command allocator, the GPU must be done with the frame that last used them.
+	//This only blocks when every back buffer is in flight: the CPU is free to build this frame (Update included) while the GPU still works on the previous ones.
+	gFrameTimer.BeginWait();
+	gFramePacer.WaitForBuffer(gCurrentBackBufferIndex);
+	gFrameTimer.EndWait();
+
+	//Upload space and descriptors used by the frames the GPU has completed can be handed out again
+	const uint64_t completedValue = gFence.GetCompletedValue();
+	gUploadRing.BeginFrame(completedValue);
+	gShaderVisibleDescriptors.BeginFrame(completedValue);
+	gRTVAllocator->Retire(completedValue);
+	gCBVSRVUAVAllocator->Retire(completedValue);
+
 	//Beginning of the frame
-	auto commandAllocator = gCommandAllocators[gCurrentBackBufferIndex];
 	auto backBuffer = gBackBuffers[gCurrentBackBufferIndex];
+	D3D12_CPU_DESCRIPTOR_HANDLE rtv = gBackBufferRTVs.GetCpuHandle(gCurrentBackBufferIndex);
 
-	//Before any commands can be recorded into the command list, the command allocator and command list needs to be reset to their initial state.
-	commandAllocator->Reset();
-	gCommandList->Reset(commandAllocator.Get(), nullptr);
+	//The allocators used by this frame are reused once the GPU reaches the fence value signaled at its end
+	gCommandListPool->BeginFrame(gFramePacer.GetLastSignaledValue() + 1);
 
-	//Before the render target can be cleared, it must be transitioned to the RENDER_TARGET state.
+	//Resource states are tracked here, on the submission timeline, while the tasks below only record the resulting barriers:
+	//one batch (a single ResourceBarrier call) at each pass boundary.
+	//Before the render target can be cleared, it must be transitioned to the RENDER_TARGET state, and back to PRESENT at the end.
+	gResourceStates.Transition(backBuffer.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET);
+	const std::vector<D3D12_RESOURCE_BARRIER> beginBarriers = gResourceStates.FlushBarriers();
 
-	// Clear the render target.
-	{
-		CD3DX12_RESOURCE_BARRIER Barrier = CD3DX12_RESOURCE_BARRIER::Transition(backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
+	gResourceStates.Transition(backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT);
+	const std::vector<D3D12_RESOURCE_BARRIER> endBarriers = gResourceStates.FlushBarriers();
 
-		gCommandList->ResourceBarrier(1, &Barrier);
-	
-		//FLOAT ClearColor[] = { 0.4f, 0.6f, 0.9f, 1.0f };
+	//Picked once for the whole frame, before the tasks start recording
+	ID3D12PipelineState* trianglePipeline = GetTrianglePipeline();
 
-		//Now the back buffer can be cleared.
-		CD3DX12_CPU_DESCRIPTOR_HANDLE rtv(gRTVDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), gCurrentBackBufferIndex, gRTVDescriptorSize);
+	//The per frame constants go in the upload ring, where the GPU reads them until the frame completes
+	const TriangleConstants triangleConstants = { gTriangleAngle, static_cast<float>(gClientHeight) / static_cast<float>(gClientWidth) };
+	const UploadAllocation triangleConstantsAllocation = gUploadRing.Allocate(sizeof(TriangleConstants));
+	std::memcpy(triangleConstantsAllocation.mCpuAddress, &triangleConstants, sizeof(TriangleConstants));
 
-		gCommandList->ClearRenderTargetView(rtv, ClearColor, 0, nullptr);	
-	}
+	//The frame is split into gRecordingTaskCount command lists, recorded in parallel on the task system.
+	//The pool hands each task a command list already reset against the allocator of the thread running it, and closes it afterwards.
+	const uint32_t TaskCount = gRecordingTaskCount;
+	std::vector<ID3D12GraphicsCommandList*> recordedLists = gCommandListPool->Record(*gTaskSystem, TaskCount, [&](uint32_t Task, ID3D12GraphicsCommandList* commandList)
+	{
+		//Lists execute in task order, so the first one issues the barriers of the frame start and clears.
+		if (Task == 0)
+		{
+			D3D12ResourceStateTracker::RecordBarriers(commandList, beginBarriers);
 
+			//FLOAT ClearColor[] = { 0.4f, 0.6f, 0.9f, 1.0f };
 
+			//Now the back buffer can be cleared.
+			commandList->ClearRenderTargetView(rtv, ClearColor, 0, nullptr);
+		}
 
-	//Perform draws/dispatch here
+		//State isn't inherited between command lists, every list binds its own
+		commandList->OMSetRenderTargets(1, &rtv, FALSE, nullptr);
+		commandList->SetDescriptorHeaps(1, gShaderVisibleDescriptors.GetHeapAddress());
 
+		//Perform draws/dispatch here, each task records its share of them
+		if (Task == 0)
+		{
+			const CD3DX12_VIEWPORT Viewport(0.0f, 0.0f, static_cast<float>(gClientWidth), static_cast<float>(gClientHeight));
+			const CD3DX12_RECT ScissorRect(0, 0, static_cast<LONG>(gClientWidth), static_cast<LONG>(gClientHeight));
+			commandList->RSSetViewports(1, &Viewport);
+			commandList->RSSetScissorRects(1, &ScissorRect);
+
+			commandList->SetGraphicsRootSignature(gTriangleRootSignature);
+			commandList->SetGraphicsRootConstantBufferView(0, triangleConstantsAllocation.mGpuAddress);
+			commandList->SetPipelineState(trianglePipeline);
+			commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			commandList->DrawInstanced(3, 1, 0, 0);
+		}
 
 
+		//Nothing follows the last list before the present: it transitions the back buffer back to the PRESENT state
+		if (Task == TaskCount - 1)
+		{
+			D3D12ResourceStateTracker::RecordBarriers(commandList, endBarriers);
+		}
+	});
 
 	// Present
 	{
-		CD3DX12_RESOURCE_BARRIER Barrier = CD3DX12_RESOURCE_BARRIER::Transition(backBuffer.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+		//All the command lists go to the command queue in a single batch, in task order
+		std::vector<ID3D12CommandList*> commandLists(recordedLists.begin(), recordedLists.end());
 
-		gCommandList->ResourceBarrier(1, &Barrier);
-		
-		//After transitioning to the correct state, the command list that contains the resource transition barrier must be executed on the command queue.
-		ThrowIfFailed( gCommandList->Close() );
+		gCommandQueue->ExecuteCommandLists(static_cast<UINT>(commandLists.size()), commandLists.data());	
 
-		ID3D12CommandList* const commandLists[] = { gCommandList.Get() };
+		//Submitted: the command lists can be reset from the next frame on
+		gCommandListPool->EndFrame();
 
-		gCommandQueue->ExecuteCommandLists(_countof(commandLists), commandLists);	
+		//Whatever the frame uploaded stays in the ring until the GPU is done with it
+		gUploadRing.EndFrame(gFramePacer.GetLastSignaledValue() + 1);
+		gShaderVisibleDescriptors.EndFrame(gFramePacer.GetLastSignaledValue() + 1);
 
 
 		UINT SyncInterval = gVSync ? 1 : 0;
 		UINT PresentFlags = gTearingSupported && !gVSync ? DXGI_PRESENT_ALLOW_TEARING : 0;
 		
+		gFrameTimer.BeginPresent();
 		ThrowIfFailed( gSwapChain->Present(SyncInterval, PresentFlags) );
+		gFrameTimer.EndPresent();
 
-		gFrameFenceValues[gCurrentBackBufferIndex] = Signal(gCommandQueue, gFence, gFenceValue);
+		//Signal the fence for this frame, the back buffer can be reused once the GPU gets there
+		gFramePacer.EndFrame(gCurrentBackBufferIndex);
 
 		//After signaling the command queue, the index of the current back buffer is updated.
+		//No wait here: it happens at the beginning of the next Render(), only if that back buffer is still in flight
 		gCurrentBackBufferIndex = gSwapChain->GetCurrentBackBufferIndex();
-
-		//Before overwriting the contents of the current back buffer with the content of the next frame, the CPU thread is stalled using the WaitForFenceValue function described earlier.
-		WaitForFenceValue(gFence, gFrameFenceValues[gCurrentBackBufferIndex], gFenceEvent);
 	}
 
 }
@@ -656,14 +823,14 @@ void Resize(uint32_t width, uint32_t height)
 
 		// Flush the GPU queue to make sure the swap chain's back buffers
 		// are not being referenced by an in-flight command list.
-		Flush(gCommandQueue, gFence, gFenceValue, gFenceEvent);
+		gFramePacer.WaitIdle();
 
 		for (int i = 0; i < gNumFrames; ++i)
 		{
 			// Any references to the back buffers must be released
 			// before the swap chain can be resized.
+			gResourceStates.Unregister(gBackBuffers[i].Get());
 			gBackBuffers[i].Reset();
-			gFrameFenceValues[i] = gFrameFenceValues[gCurrentBackBufferIndex];
 		}
 
 		DXGI_SWAP_CHAIN_DESC swapChainDesc = {};
@@ -672,7 +839,7 @@ void Resize(uint32_t width, uint32_t height)
 
 		gCurrentBackBufferIndex = gSwapChain->GetCurrentBackBufferIndex();
 
-		UpdateRenderTargetViews(gDevice, gSwapChain, gRTVDescriptorHeap);
+		UpdateRenderTargetViews(gDevice, gSwapChain, gBackBufferRTVs);
 	}
 }
 
@@ -753,6 +920,9 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 			case 'V':
 				gVSync = !gVSync;
 				break;
+			case 'W':
+				gWireframe = !gWireframe;
+				break;
 			case VK_ESCAPE:
 				::PostQuitMessage(0);
 				break;
@@ -805,6 +975,76 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 	return 0;
 }
 
+/*
+	--bench-recording: records the same amount of commands per frame with 1, 2, 4 ... threads and reports the CPU
+	recording time, so the scaling of parallel recording can be measured on the machine.
+	The commands only set state, so the GPU cost stays negligible and the numbers are about the CPU side.
+*/
+void BenchmarkRecording()
+{
+	const uint32_t kFrameCount = 200;
+	const uint32_t kTaskCount = 64;
+	const uint32_t kCommandsPerTask = 2000;
+	const uint32_t MaxThreadCount = TaskSystem::GetDefaultWorkerCount() + 1;
+
+	D3D12_VIEWPORT Viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(gClientWidth), static_cast<float>(gClientHeight));
+	D3D12_RECT ScissorRect = CD3DX12_RECT(0, 0, gClientWidth, gClientHeight);
+	D3D12_CPU_DESCRIPTOR_HANDLE rtv = gBackBufferRTVs.GetCpuHandle();
+
+	//Frames are paced like the real ones, so allocators get recycled rather than created every frame
+	FramePacer Pacer(gFence, gNumFrames);
+
+	double SingleThreadMs = 0.0;
+	for (uint32_t ThreadCount = 1; ThreadCount <= MaxThreadCount; ThreadCount = ThreadCount < MaxThreadCount ? std::min(ThreadCount * 2, MaxThreadCount) : ThreadCount + 1)
+	{
+		TaskSystem Tasks(ThreadCount - 1);
+		D3D12CommandListDevice Device(gDevice.Get());
+		CommandListPool<D3D12CommandListDevice> Pool(Device, gFence, Tasks.GetThreadCount());
+
+		double TotalMs = 0.0;
+		for (uint32_t Frame = 0; Frame < kFrameCount; ++Frame)
+		{
+			const uint32_t BufferIndex = Frame % gNumFrames;
+			Pacer.WaitForBuffer(BufferIndex);
+			Pool.BeginFrame(Pacer.GetLastSignaledValue() + 1);
+
+			auto Start = std::chrono::high_resolution_clock::now();
+			std::vector<ID3D12GraphicsCommandList*> recordedLists = Pool.Record(Tasks, kTaskCount, [&](uint32_t, ID3D12GraphicsCommandList* commandList)
+			{
+				for (uint32_t i = 0; i < kCommandsPerTask; ++i)
+				{
+					commandList->OMSetRenderTargets(1, &rtv, FALSE, nullptr);
+					commandList->RSSetViewports(1, &Viewport);
+					commandList->RSSetScissorRects(1, &ScissorRect);
+					commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+				}
+			});
+			TotalMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - Start).count();
+
+			std::vector<ID3D12CommandList*> commandLists(recordedLists.begin(), recordedLists.end());
+			gCommandQueue->ExecuteCommandLists(static_cast<UINT>(commandLists.size()), commandLists.data());
+			Pool.EndFrame();
+			Pacer.EndFrame(BufferIndex);
+		}
+
+		//The pool and the device go out of scope with this iteration
+		Pacer.WaitIdle();
+
+		const double FrameMs = TotalMs / kFrameCount;
+		if (ThreadCount == 1)
+		{
+			SingleThreadMs = FrameMs;
+		}
+
+		const CommandListPoolStatistics PoolStats = Pool.GetStatistics();
+		const double CommandsPerSecond = (4.0 * kTaskCount * kCommandsPerTask) / (FrameMs * 1e-3);
+		char Buffer[256];
+		sprintf_s(Buffer, "Recording benchmark: %2u threads, %.3f ms/frame, %.1f M commands/s, x%.2f, %llu allocators created, %llu reused\n",
+			ThreadCount, FrameMs, CommandsPerSecond * 1e-6, SingleThreadMs / FrameMs, PoolStats.mAllocatorsCreated, PoolStats.mAllocatorsReused);
+		OutputDebugStringA(Buffer);
+	}
+}
+
 //This program Entry Point
 int CALLBACK wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR lpCmdLine, int nCmdShow)
 {
@@ -844,34 +1084,53 @@ int CALLBACK wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR lpCmdL
 
 	gCurrentBackBufferIndex = gSwapChain->GetCurrentBackBufferIndex();
 
-	gRTVDescriptorHeap = CreateDescriptorHeap(gDevice, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, gNumFrames);
+	gRTVAllocator = std::make_unique<D3D12CpuDescriptorAllocator>(gDevice.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_RTV, 64);
+	gCBVSRVUAVAllocator = std::make_unique<D3D12CpuDescriptorAllocator>(gDevice.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 1024);
 
-	gRTVDescriptorSize = gDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+	gBackBufferRTVs = gRTVAllocator->Allocate(gNumFrames);
 
-	UpdateRenderTargetViews(gDevice, gSwapChain, gRTVDescriptorHeap);
+	UpdateRenderTargetViews(gDevice, gSwapChain, gBackBufferRTVs);
 
-	//Command list and command allocator creation
-	for (int i = 0; i < gNumFrames; ++i)
-	{
-		gCommandAllocators[i] = CreateCommandAllocator(gDevice, D3D12_COMMAND_LIST_TYPE_DIRECT);
-	}
-	gCommandList = CreateCommandList(gDevice, gCommandAllocators[gCurrentBackBufferIndex], D3D12_COMMAND_LIST_TYPE_DIRECT);
+	//Create the dx12 fence, signaled from the command queue (and the CPU event that we'll use to stall the CPU on a fence value)
+	gFence.Create(gDevice.Get(), gCommandQueue.Get());
+
+	gUploadRing.Create(gDevice.Get(), gFence, gUploadRingSize);
 
+	gShaderVisibleDescriptors.Create(gDevice.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, gShaderVisibleDescriptorCount, gFence);
 
-	//Create the dx12 fence
-	gFence = CreateFence(gDevice);
-	//Create the CPU event that we'll use to stall the CPU on the fence value (the fence value will get signaled from the GPU as soon as the GPU will reach the fence)
-	gFenceEvent = CreateEventHandle();
+	gPipelineStateCache.Create(gDevice.Get(), gPipelineLibraryPath);
+	CreateTrianglePipelines();
+
+	//Recording threads, with their command list and command allocator pools
+	if (gRecordingThreadCount == 0)
+	{
+		gRecordingThreadCount = TaskSystem::GetDefaultWorkerCount() + 1;
+	}
+	if (gRecordingTaskCount == 0)
+	{
+		gRecordingTaskCount = gRecordingThreadCount;
+	}
+	gTaskSystem = std::make_unique<TaskSystem>(gRecordingThreadCount - 1);
+	gCommandListDevice = std::make_unique<D3D12CommandListDevice>(gDevice.Get());
+	gCommandListPool = std::make_unique<CommandListPool<D3D12CommandListDevice>>(*gCommandListDevice, gFence, gTaskSystem->GetThreadCount());
 
 	//Everything is initialized now
 	gIsInitialized = true;
 
-	//Finally show the window 
-	::ShowWindow(ghWnd, SW_SHOW);
+	//The benchmark replaces the realtime loop, then goes through the same shutdown
+	if (gBenchRecording)
+	{
+		BenchmarkRecording();
+	}
+	else
+	{
+		//Finally show the window 
+		::ShowWindow(ghWnd, SW_SHOW);
+	}
 
 	//Enter Application realtime loop
 	
-	gAppIsRunning = true;
+	gAppIsRunning = !gBenchRecording;
 	while(gAppIsRunning) 
 	{
 		MSG Message = {};
@@ -893,10 +1152,58 @@ int CALLBACK wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR lpCmdL
 	}
 
 	// Make sure the command queue has finished all commands before closing.
-	Flush(gCommandQueue, gFence, gFenceValue, gFenceEvent);
+	gFramePacer.WaitIdle();
 
-	//Close the CPU event 
-	::CloseHandle(gFenceEvent);
+	//Keep the pipelines compiled during this run for the next one
+	gPipelineStateCache.Save();
+	{
+		const D3D12PipelineStateCacheStatistics PipelineStats = gPipelineStateCache.GetStatistics();
+		char Buffer[256];
+		sprintf_s(Buffer, "Pipeline states: %llu compiled (%.1f ms in total, %.2f ms max), %llu loaded from the library, %llu requests served by the fallback\n",
+			PipelineStats.mCompiledCount, PipelineStats.mCache.mTotalCreateMs, PipelineStats.mCache.mMaxCreateMs, PipelineStats.mLibraryHitCount, PipelineStats.mCache.mFallbackCount);
+		OutputDebugStringA(Buffer);
+	}
+	gPipelineStateCache.Destroy();
+	gTrianglePipeline = nullptr;
+	gTriangleRootSignature = nullptr;
+
+	//Release the upload heap and the descriptor heaps
+	gUploadRing.Destroy();
+	gShaderVisibleDescriptors.Destroy();
+	gRTVAllocator.reset();
+	gCBVSRVUAVAllocator.reset();
+
+	//Release the command lists and allocators, then the recording threads
+	gCommandListPool.reset();
+	gCommandListDevice.reset();
+	gTaskSystem.reset();
+
+	//Release the fence and close its CPU event 
+	gFence.Destroy();
+
+	//Dump the frame statistics
+	gFrameTimer.EndFrame();
+	{
+		std::string Summary = "Frame statistics: " + FrameStatistics::FormatSummary(gFrameStatistics.ComputeReport()) + "\n";
+		OutputDebugStringA(Summary.c_str());
+
+		const FramePacerStatistics& PacerStats = gFramePacer.GetStatistics();
+		char Buffer[256];
+		sprintf_s(Buffer, "Frame pacing: blocked on the GPU %llu/%llu frames, %.1f ms in total, %.2f ms max\n",
+			PacerStats.mBlockedFrameCount, PacerStats.mFrameCount, PacerStats.mTotalBlockedMs, PacerStats.mMaxBlockedMs);
+		OutputDebugStringA(Buffer);
+
+		sprintf_s(Buffer, "Upload ring: peak usage %llu of %llu bytes\n", gUploadRing.GetPeakUsedSize(), gUploadRing.GetSize());
+		OutputDebugStringA(Buffer);
+
+		if (!gFrameStatisticsPath.empty())
+		{
+			if (!gFrameStatistics.ExportCsv(gFrameStatisticsPath + ".csv") || !gFrameStatistics.ExportJson(gFrameStatisticsPath + ".json"))
+			{
+				OutputDebugStringA(("Failed to write the frame statistics to " + gFrameStatisticsPath + "\n").c_str());
+			}
+		}
+	}
 
 	return 0;
 }
@@ -0,0 +1,249 @@
+#include "TestHarness.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "CommandListPool.h"
+
+struct MockCommandList
+{
+	uint32_t mAllocator = 0;
+
+	bool mOpen = false;
+
+	//What was recorded since the last reset: the indices of the tasks that recorded into it
+	std::vector<uint32_t> mCommands;
+};
+
+/*
+	Device for CommandListPool without a GPU. Allocators remember the fence value of the last frame that recorded into
+	them, so resetting one the GPU may still be executing is caught, and so is any command list misuse.
+*/
+class MockDevice
+{
+public:
+
+	typedef uint32_t AllocatorHandle;
+	typedef MockCommandList* CommandListHandle;
+
+	explicit MockDevice(IGpuFence& Fence)
+		: mFence(Fence)
+	{
+	}
+
+	//Fence value the frame being recorded signals at its end
+	void SetFrameFenceValue(uint64_t Value)
+	{
+		mFrameFenceValue = Value;
+	}
+
+	AllocatorHandle CreateAllocator()
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mAllocatorFenceValues.push_back(0);
+		mAllocatorResetCounts.push_back(0);
+		return static_cast<AllocatorHandle>(mAllocatorFenceValues.size() - 1);
+	}
+
+	CommandListHandle CreateCommandList(AllocatorHandle Allocator)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mCommandLists.emplace_back(new MockCommandList());
+		mCommandLists.back()->mAllocator = Allocator;
+		return mCommandLists.back().get();
+	}
+
+	void ResetAllocator(AllocatorHandle Allocator)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		if (mFence.GetCompletedValue() < mAllocatorFenceValues.at(Allocator))
+		{
+			++mErrorCount;
+		}
+		++mAllocatorResetCounts.at(Allocator);
+	}
+
+	void ResetCommandList(CommandListHandle CommandList, AllocatorHandle Allocator)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mErrorCount += CommandList->mOpen ? 1 : 0;
+		CommandList->mOpen = true;
+		CommandList->mAllocator = Allocator;
+		CommandList->mCommands.clear();
+		mAllocatorFenceValues.at(Allocator) = mFrameFenceValue;
+	}
+
+	void CloseCommandList(CommandListHandle CommandList)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mErrorCount += CommandList->mOpen ? 0 : 1;
+		CommandList->mOpen = false;
+	}
+
+	uint32_t GetAllocatorCount()
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		return static_cast<uint32_t>(mAllocatorFenceValues.size());
+	}
+
+	uint32_t GetAllocatorResetCount(AllocatorHandle Allocator)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		return mAllocatorResetCounts.at(Allocator);
+	}
+
+	//Allocators reset while in use, command lists reset while open or closed twice
+	uint32_t GetErrorCount()
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		return mErrorCount;
+	}
+
+private:
+
+	IGpuFence& mFence;
+
+	std::mutex mMutex;
+
+	uint64_t mFrameFenceValue = 0;
+
+	std::vector<uint64_t> mAllocatorFenceValues;
+
+	std::vector<uint32_t> mAllocatorResetCounts;
+
+	std::vector<std::unique_ptr<MockCommandList>> mCommandLists;
+
+	uint32_t mErrorCount = 0;
+};
+
+//Records one command list on thread 0 for the frame signaling FenceValue, returns the allocator it used
+static uint32_t RecordFrame(CommandListPool<MockDevice>& Pool, MockDevice& Device, SoftwareGpuFence& Fence, uint64_t FenceValue)
+{
+	Device.SetFrameFenceValue(FenceValue);
+	Pool.BeginFrame(FenceValue);
+	MockCommandList* CommandList = Pool.Acquire(0);
+	Device.CloseCommandList(CommandList);
+	Pool.EndFrame();
+	Fence.Signal(FenceValue);
+	return CommandList->mAllocator;
+}
+
+TEST(AllocatorIsReusedOnlyOnceItsFenceValueCompleted)
+{
+	SoftwareGpuFence Fence;
+	MockDevice Device(Fence);
+	CommandListPool<MockDevice> Pool(Device, Fence, 1);
+
+	//The GPU is behind: every frame in flight needs an allocator of its own
+	const uint32_t First = RecordFrame(Pool, Device, Fence, 1);
+	const uint32_t Second = RecordFrame(Pool, Device, Fence, 2);
+	CHECK(First != Second);
+	CHECK_EQUAL(2u, Device.GetAllocatorCount());
+	CHECK_EQUAL(0u, Device.GetAllocatorResetCount(First));
+
+	//Frame 1 done: its allocator comes back, the one of frame 2 is still in use
+	Fence.Complete(1);
+	const uint32_t Third = RecordFrame(Pool, Device, Fence, 3);
+	CHECK_EQUAL(First, Third);
+	CHECK_EQUAL(1u, Device.GetAllocatorResetCount(First));
+	CHECK_EQUAL(0u, Device.GetAllocatorResetCount(Second));
+
+	//Frame 2 isn't done: a new allocator rather than a wait
+	const uint32_t Fourth = RecordFrame(Pool, Device, Fence, 4);
+	CHECK(Fourth != First && Fourth != Second);
+	CHECK_EQUAL(3u, Device.GetAllocatorCount());
+
+	Fence.CompleteAll();
+	CHECK_EQUAL(Second, RecordFrame(Pool, Device, Fence, 5));
+	CHECK_EQUAL(0u, Device.GetErrorCount());
+
+	const CommandListPoolStatistics Statistics = Pool.GetStatistics();
+	CHECK_EQUAL(3u, Statistics.mAllocatorsCreated);
+	CHECK_EQUAL(2u, Statistics.mAllocatorsReused);
+	CHECK_EQUAL(1u, Statistics.mCommandListsCreated);
+	CHECK_EQUAL(4u, Statistics.mCommandListsReused);
+}
+
+TEST(CompletionIsReadOncePerFrame)
+{
+	SoftwareGpuFence Fence;
+	MockDevice Device(Fence);
+	CommandListPool<MockDevice> Pool(Device, Fence, 1);
+	const uint32_t First = RecordFrame(Pool, Device, Fence, 1);
+
+	//Frame 1 completes after frame 2 began: its allocator must wait for frame 3, BeginFrame() decides for the whole frame
+	Device.SetFrameFenceValue(2);
+	Pool.BeginFrame(2);
+	Fence.Complete(1);
+	MockCommandList* CommandList = Pool.Acquire(0);
+	Device.CloseCommandList(CommandList);
+	Pool.EndFrame();
+	Fence.Signal(2);
+	CHECK(CommandList->mAllocator != First);
+
+	CHECK_EQUAL(First, RecordFrame(Pool, Device, Fence, 3));
+	CHECK_EQUAL(0u, Device.GetErrorCount());
+}
+
+TEST(RecordedListsComeBackInTaskOrder)
+{
+	SoftwareGpuFence Fence;
+	MockDevice Device(Fence);
+	TaskSystem Tasks(3);
+	CommandListPool<MockDevice> Pool(Device, Fence, Tasks.GetThreadCount());
+
+	const uint32_t TaskCount = 64;
+	for (uint64_t Frame = 1; Frame <= 4; ++Frame)
+	{
+		Device.SetFrameFenceValue(Frame);
+		Pool.BeginFrame(Frame);
+		const std::vector<MockCommandList*> CommandLists = Pool.Record(Tasks, TaskCount, [](uint32_t Task, MockCommandList* CommandList)
+		{
+			//Uneven task lengths, so that tasks finish out of order
+			std::this_thread::sleep_for(std::chrono::microseconds((Task * 7919) % 500));
+			CommandList->mCommands.push_back(Task);
+		});
+		Pool.EndFrame();
+		Fence.Signal(Frame);
+
+		REQUIRE(CommandLists.size() == TaskCount);
+		std::set<MockCommandList*> Distinct(CommandLists.begin(), CommandLists.end());
+		CHECK_EQUAL(TaskCount, Distinct.size());
+		for (uint32_t Task = 0; Task < TaskCount; ++Task)
+		{
+			CHECK(!CommandLists[Task]->mOpen);
+			REQUIRE(CommandLists[Task]->mCommands.size() == 1);
+			CHECK_EQUAL(Task, CommandLists[Task]->mCommands[0]);
+		}
+
+		//The GPU keeps one frame behind
+		Fence.Complete(Frame - 1);
+	}
+
+	//At most one allocator per thread and frame in flight (two here)
+	CHECK(Device.GetAllocatorCount() <= 2 * Tasks.GetThreadCount());
+	CHECK_EQUAL(0u, Device.GetErrorCount());
+}
+
+TEST(FrameMisuseThrows)
+{
+	SoftwareGpuFence Fence;
+	MockDevice Device(Fence);
+	CommandListPool<MockDevice> Pool(Device, Fence, 1);
+
+	CHECK_THROWS(Pool.Acquire(0), std::logic_error);
+	CHECK_THROWS(Pool.EndFrame(), std::logic_error);
+	Pool.BeginFrame(1);
+	CHECK_THROWS(Pool.BeginFrame(2), std::logic_error);
+
+	TaskSystem Tasks(3);
+	CHECK_THROWS(Pool.Record(Tasks, 1, [](uint32_t, MockCommandList*) {}), std::invalid_argument);
+}
+
+int main()
+{
+	return RunAllTests();
+}
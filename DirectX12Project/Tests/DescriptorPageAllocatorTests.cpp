@@ -0,0 +1,159 @@
+#include "TestHarness.h"
+
+#include "DescriptorPageAllocator.h"
+
+//Allocator over pages of 8 descriptors that records the pages it was asked to create
+struct PageAllocatorFixture
+{
+	std::vector<uint32_t> mCreatedPages;
+
+	DescriptorPageAllocator mAllocator;
+
+	PageAllocatorFixture()
+		: mAllocator(8, [this](uint32_t Page) { mCreatedPages.push_back(Page); })
+	{
+	}
+};
+
+static bool IsRange(const DescriptorRange& Range, uint32_t Page, uint32_t Offset, uint32_t Count)
+{
+	return Range.mPage == Page && Range.mOffset == Offset && Range.mCount == Count;
+}
+
+TEST(FirstFitPacksAllocations)
+{
+	PageAllocatorFixture Fixture;
+	DescriptorPageAllocator& Allocator = Fixture.mAllocator;
+
+	const DescriptorRange A = Allocator.Allocate(2);
+	const DescriptorRange B = Allocator.Allocate(3);
+	const DescriptorRange C = Allocator.Allocate(1);
+	CHECK(IsRange(A, 0, 0, 2));
+	CHECK(IsRange(B, 0, 2, 3));
+	CHECK(IsRange(C, 0, 5, 1));
+
+	//Two holes, [0, 2) and [5, 6): a single descriptor goes to the first one, two descriptors too
+	Allocator.FreeImmediately(A);
+	Allocator.FreeImmediately(C);
+	CHECK(IsRange(Allocator.Allocate(1), 0, 0, 1));
+	CHECK(IsRange(Allocator.Allocate(2), 0, 5, 2));
+
+	//Only [1, 2) is left before the tail [7, 8)
+	CHECK(IsRange(Allocator.Allocate(1), 0, 1, 1));
+	CHECK(IsRange(Allocator.Allocate(1), 0, 7, 1));
+
+	CHECK_EQUAL(1u, Allocator.GetPageCount());
+	CHECK_EQUAL(8u, Allocator.GetStatistics().mAllocatedCount);
+}
+
+TEST(GrowsIntoANewPageWhenNoPageHasRoom)
+{
+	PageAllocatorFixture Fixture;
+	DescriptorPageAllocator& Allocator = Fixture.mAllocator;
+
+	CHECK(IsRange(Allocator.Allocate(6), 0, 0, 6));
+	REQUIRE(Fixture.mCreatedPages.size() == 1);
+	CHECK_EQUAL(0u, Fixture.mCreatedPages[0]);
+
+	//3 don't fit in the 2 left on page 0
+	CHECK(IsRange(Allocator.Allocate(3), 1, 0, 3));
+	REQUIRE(Fixture.mCreatedPages.size() == 2);
+	CHECK_EQUAL(1u, Fixture.mCreatedPages[1]);
+
+	//But 2 still go to page 0, and a full page is created only once
+	CHECK(IsRange(Allocator.Allocate(2), 0, 6, 2));
+	CHECK(IsRange(Allocator.Allocate(5), 1, 3, 5));
+	CHECK(IsRange(Allocator.Allocate(8), 2, 0, 8));
+	CHECK_EQUAL(3u, Fixture.mCreatedPages.size());
+	CHECK_EQUAL(3u, Allocator.GetStatistics().mPageCount);
+
+	CHECK_THROWS(Allocator.Allocate(9), std::invalid_argument);
+	CHECK_THROWS(Allocator.Allocate(0), std::invalid_argument);
+}
+
+TEST(FreeMergesNeighbours)
+{
+	PageAllocatorFixture Fixture;
+	DescriptorPageAllocator& Allocator = Fixture.mAllocator;
+
+	const DescriptorRange A = Allocator.Allocate(2);
+	const DescriptorRange B = Allocator.Allocate(2);
+	const DescriptorRange C = Allocator.Allocate(2);
+	//Keeps the end of the page busy
+	Allocator.Allocate(2);
+
+	//A and C apart, then B in between: the three must end up as one free range of 6
+	Allocator.FreeImmediately(A);
+	Allocator.FreeImmediately(C);
+	CHECK_THROWS(Allocator.Allocate(9), std::invalid_argument);
+	CHECK(IsRange(Allocator.Allocate(3), 1, 0, 3));
+	Allocator.FreeImmediately(B);
+	CHECK(IsRange(Allocator.Allocate(6), 0, 0, 6));
+
+	//Merging with the next range only, then with the previous one only
+	PageAllocatorFixture Other;
+	const DescriptorRange E = Other.mAllocator.Allocate(4);
+	const DescriptorRange F = Other.mAllocator.Allocate(4);
+	Other.mAllocator.FreeImmediately(F);
+	Other.mAllocator.FreeImmediately(E);
+	CHECK(IsRange(Other.mAllocator.Allocate(8), 0, 0, 8));
+
+	const DescriptorRange G = Other.mAllocator.Allocate(4);
+	CHECK(IsRange(G, 1, 0, 4));
+	Other.mAllocator.FreeImmediately(G);
+	CHECK(IsRange(Other.mAllocator.Allocate(8), 1, 0, 8));
+	CHECK_EQUAL(2u, Other.mCreatedPages.size());
+}
+
+TEST(RetireWaitsForTheFence)
+{
+	PageAllocatorFixture Fixture;
+	DescriptorPageAllocator& Allocator = Fixture.mAllocator;
+
+	const DescriptorRange A = Allocator.Allocate(4);
+	const DescriptorRange B = Allocator.Allocate(4);
+	Allocator.Free(A, 1);
+	Allocator.Free(B, 2);
+	CHECK_EQUAL(8u, Allocator.GetStatistics().mPendingFreeCount);
+	CHECK_EQUAL(8u, Allocator.GetStatistics().mAllocatedCount);
+
+	//Still referenced by frames in flight: the page is full
+	Allocator.Retire(0);
+	CHECK(IsRange(Allocator.Allocate(4), 1, 0, 4));
+
+	//Frame 1 done: A comes back, B doesn't
+	Allocator.Retire(1);
+	CHECK_EQUAL(4u, Allocator.GetStatistics().mPendingFreeCount);
+	CHECK(IsRange(Allocator.Allocate(4), 0, 0, 4));
+	CHECK(IsRange(Allocator.Allocate(4), 1, 4, 4));
+
+	Allocator.Retire(2);
+	CHECK_EQUAL(0u, Allocator.GetStatistics().mPendingFreeCount);
+	CHECK(IsRange(Allocator.Allocate(4), 0, 4, 4));
+	CHECK_EQUAL(2u, Allocator.GetPageCount());
+
+	const DescriptorPageStatistics Statistics = Allocator.GetStatistics();
+	CHECK_EQUAL(16u, Statistics.mAllocatedCount);
+	CHECK_EQUAL(6u, Statistics.mTotalAllocations);
+	CHECK_EQUAL(2u, Statistics.mTotalFrees);
+}
+
+TEST(InvalidRangesAreIgnored)
+{
+	PageAllocatorFixture Fixture;
+	DescriptorPageAllocator& Allocator = Fixture.mAllocator;
+
+	Allocator.Free(DescriptorRange(), 1);
+	Allocator.FreeImmediately(DescriptorRange());
+	Allocator.Retire(1);
+
+	const DescriptorPageStatistics Statistics = Allocator.GetStatistics();
+	CHECK_EQUAL(0u, Statistics.mPendingFreeCount);
+	CHECK_EQUAL(0u, Statistics.mTotalFrees);
+	CHECK(Fixture.mCreatedPages.empty());
+}
+
+int main()
+{
+	return RunAllTests();
+}
@@ -0,0 +1,169 @@
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "FramePacer.h"
+
+//How long the "GPU" takes to finish a frame when the CPU has to wait for it
+static const std::chrono::milliseconds kGpuDelay(50);
+
+//Completes Value on Fence after kGpuDelay, from another thread like a real GPU would
+static std::thread CompleteLater(SoftwareGpuFence& Fence, uint64_t Value)
+{
+	return std::thread([&Fence, Value]()
+	{
+		std::this_thread::sleep_for(kGpuDelay);
+		Fence.Complete(Value);
+	});
+}
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point Start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+}
+
+TEST(FreshBuffersNeverBlock)
+{
+	SoftwareGpuFence Fence;
+	FramePacer Pacer(Fence, 3);
+
+	//The GPU doesn't complete anything, yet every buffer can be used once
+	for (uint32_t i = 0; i < Pacer.GetBufferCount(); ++i)
+	{
+		CHECK(!Pacer.IsBufferInFlight(i));
+		CHECK(Pacer.WaitForBuffer(i) == 0.0);
+		CHECK_EQUAL(i + 1, Pacer.EndFrame(i));
+	}
+
+	CHECK_EQUAL(3u, Pacer.GetFramesInFlight());
+	CHECK_EQUAL(0u, Pacer.GetStatistics().mBlockedFrameCount);
+	CHECK_EQUAL(3u, Pacer.GetStatistics().mFrameCount);
+	CHECK_EQUAL(3u, Fence.GetSignaledValue());
+}
+
+TEST(CompletedBufferDoesntBlockWhileOthersAreInFlight)
+{
+	SoftwareGpuFence Fence;
+	FramePacer Pacer(Fence, 3);
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		Pacer.WaitForBuffer(i);
+		Pacer.EndFrame(i);
+	}
+
+	//Only the oldest frame is done: its buffer is free, the two others are still in flight
+	Fence.Complete(1);
+	CHECK(!Pacer.IsBufferInFlight(0));
+	CHECK(Pacer.IsBufferInFlight(1));
+	CHECK(Pacer.IsBufferInFlight(2));
+	CHECK_EQUAL(2u, Pacer.GetFramesInFlight());
+
+	CHECK(Pacer.WaitForBuffer(0) == 0.0);
+	CHECK_EQUAL(0u, Pacer.GetStatistics().mBlockedFrameCount);
+	CHECK(Pacer.GetStatistics().mLastBlockedMs == 0.0);
+}
+
+TEST(BlocksOnlyWhenEveryBufferIsInFlight)
+{
+	SoftwareGpuFence Fence;
+	FramePacer Pacer(Fence, 2);
+	Pacer.WaitForBuffer(0);
+	Pacer.EndFrame(0);
+	Pacer.WaitForBuffer(1);
+	Pacer.EndFrame(1);
+	REQUIRE(Pacer.IsBufferInFlight(0));
+
+	//Buffer 0 comes back once the GPU finishes frame 1: the wait must last until then, and not past frame 1
+	std::thread Gpu = CompleteLater(Fence, 1);
+	Pacer.WaitForBuffer(0);
+	Gpu.join();
+
+	CHECK(!Pacer.IsBufferInFlight(0));
+	CHECK(Pacer.IsBufferInFlight(1));
+	CHECK_EQUAL(1u, Fence.GetCompletedValue());
+	CHECK_EQUAL(1u, Pacer.GetStatistics().mBlockedFrameCount);
+}
+
+TEST(ReportsTheTimeSpentBlocked)
+{
+	SoftwareGpuFence Fence;
+	FramePacer Pacer(Fence, 1);
+	Pacer.EndFrame(0);
+
+	const auto Start = std::chrono::steady_clock::now();
+	std::thread Gpu = CompleteLater(Fence, 1);
+	const double BlockedMs = Pacer.WaitForBuffer(0);
+	const double ElapsedMs = MillisecondsSince(Start);
+	Gpu.join();
+
+	//At least most of the GPU delay (the pacer starts its clock a bit after the "GPU"), never more than the caller saw
+	CHECK(BlockedMs >= kGpuDelay.count() * 0.8);
+	CHECK(BlockedMs <= ElapsedMs);
+
+	const FramePacerStatistics& Statistics = Pacer.GetStatistics();
+	CHECK_EQUAL(1u, Statistics.mBlockedFrameCount);
+	CHECK(Statistics.mLastBlockedMs == BlockedMs);
+	CHECK(Statistics.mTotalBlockedMs == BlockedMs);
+	CHECK(Statistics.mMaxBlockedMs == BlockedMs);
+}
+
+TEST(AccumulatesBlockedTimeOverFrames)
+{
+	SoftwareGpuFence Fence;
+	FramePacer Pacer(Fence, 1);
+
+	double TotalMs = 0.0;
+	double MaxMs = 0.0;
+	for (uint64_t Frame = 1; Frame <= 3; ++Frame)
+	{
+		Pacer.EndFrame(0);
+		std::thread Gpu = CompleteLater(Fence, Frame);
+		const double BlockedMs = Pacer.WaitForBuffer(0);
+		Gpu.join();
+
+		TotalMs += BlockedMs;
+		MaxMs = std::max(MaxMs, BlockedMs);
+		CHECK(Pacer.GetStatistics().mLastBlockedMs == BlockedMs);
+	}
+
+	//Then a frame the GPU is already done with: nothing to wait for, and the last blocked time goes back to 0
+	Pacer.EndFrame(0);
+	Fence.CompleteAll();
+	CHECK(Pacer.WaitForBuffer(0) == 0.0);
+
+	const FramePacerStatistics& Statistics = Pacer.GetStatistics();
+	CHECK_EQUAL(4u, Statistics.mFrameCount);
+	CHECK_EQUAL(3u, Statistics.mBlockedFrameCount);
+	CHECK(Statistics.mLastBlockedMs == 0.0);
+	CHECK(std::fabs(Statistics.mTotalBlockedMs - TotalMs) < 1e-9);
+	CHECK(Statistics.mMaxBlockedMs == MaxMs);
+}
+
+TEST(WaitIdleWaitsForTheLastFrame)
+{
+	SoftwareGpuFence Fence;
+	FramePacer Pacer(Fence, 2);
+	Pacer.EndFrame(0);
+	Pacer.EndFrame(1);
+
+	std::thread Gpu = CompleteLater(Fence, 2);
+	Pacer.WaitIdle();
+	Gpu.join();
+
+	CHECK_EQUAL(0u, Pacer.GetFramesInFlight());
+	CHECK(!Pacer.IsBufferInFlight(0));
+	CHECK(!Pacer.IsBufferInFlight(1));
+}
+
+TEST(RejectsZeroBuffers)
+{
+	SoftwareGpuFence Fence;
+	CHECK_THROWS(FramePacer(Fence, 0), std::invalid_argument);
+}
+
+int main()
+{
+	return RunAllTests();
+}
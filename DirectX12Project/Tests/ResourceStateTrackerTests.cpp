@@ -0,0 +1,126 @@
+#include "TestHarness.h"
+
+#include "ResourceStateTracker.h"
+
+//A state where writing always takes a barrier, even to the same state, like a Vulkan write after write
+struct TestState
+{
+	int mValue = 0;
+
+	bool mWrite = false;
+
+	bool operator==(const TestState& Other) const
+	{
+		return mValue == Other.mValue && mWrite == Other.mWrite;
+	}
+};
+
+struct TestStateTraits
+{
+	static bool NeedsBarrier(const TestState& Before, const TestState& After)
+	{
+		return !(Before == After) || Before.mWrite || After.mWrite;
+	}
+};
+
+typedef ResourceStateTracker<TestState, TestStateTraits> TestTracker;
+
+const TestState kRead = { 1, false };
+const TestState kOtherRead = { 2, false };
+const TestState kWrite = { 3, true };
+
+TEST(TransitionsOfABatchAreMerged)
+{
+	TestTracker Tracker;
+	Tracker.Register(1, 1, kRead);
+
+	//Read -> OtherRead -> Read ends where it started
+	Tracker.Transition(1, kOtherRead);
+	Tracker.Transition(1, kRead);
+	CHECK(!Tracker.HasPendingBarriers());
+
+	//Read -> OtherRead -> Write is a single Read -> Write
+	Tracker.Transition(1, kOtherRead);
+	Tracker.Transition(1, kWrite);
+	std::vector<TestTracker::TransitionType> Batch = Tracker.Flush();
+	REQUIRE(Batch.size() == 1);
+	CHECK(Batch[0].mBefore == kRead);
+	CHECK(Batch[0].mAfter == kWrite);
+	CHECK(Batch[0].mKind == BarrierKind::Full);
+
+	//Write after write still takes a barrier
+	Tracker.Transition(1, kWrite);
+	CHECK_EQUAL(1u, Tracker.Flush().size());
+}
+
+TEST(SplitTransitionEndsWithTheTransitionToItsTarget)
+{
+	TestTracker Tracker;
+	Tracker.Register(1, 1, kRead);
+
+	Tracker.BeginTransition(1, kWrite);
+	std::vector<TestTracker::TransitionType> Batch = Tracker.Flush();
+	REQUIRE(Batch.size() == 1);
+	CHECK(Batch[0].mKind == BarrierKind::Begin);
+
+	//The state only changes with the End half
+	CHECK(Tracker.GetState(1) == kRead);
+
+	//The End half is the whole transition, even for a state that needs a barrier to itself
+	Tracker.Transition(1, kWrite);
+	Batch = Tracker.Flush();
+	REQUIRE(Batch.size() == 1);
+	CHECK(Batch[0].mKind == BarrierKind::End);
+	CHECK(Batch[0].mBefore == kRead);
+	CHECK(Batch[0].mAfter == kWrite);
+	CHECK(Tracker.GetState(1) == kWrite);
+}
+
+TEST(SplitTransitionOverriddenByAnotherState)
+{
+	TestTracker Tracker;
+	Tracker.Register(1, 1, kRead);
+	Tracker.BeginTransition(1, kOtherRead);
+	Tracker.Flush();
+
+	//The split still ends, then the resource goes on to the state actually asked for
+	Tracker.Transition(1, kWrite);
+	std::vector<TestTracker::TransitionType> Batch = Tracker.Flush();
+	REQUIRE(Batch.size() == 2);
+	CHECK(Batch[0].mKind == BarrierKind::End);
+	CHECK(Batch[0].mAfter == kOtherRead);
+	CHECK(Batch[1].mKind == BarrierKind::Full);
+	CHECK(Batch[1].mBefore == kOtherRead);
+	CHECK(Batch[1].mAfter == kWrite);
+}
+
+TEST(SubresourcesSplitAndCollapse)
+{
+	TestTracker Tracker;
+	Tracker.Register(1, 2, kRead);
+
+	Tracker.Transition(1, kOtherRead, 1);
+	CHECK(Tracker.GetState(1, 0) == kRead);
+	CHECK(Tracker.GetState(1, 1) == kOtherRead);
+	CHECK_EQUAL(1u, Tracker.Flush()[0].mSubresource);
+
+	//Transitioning the whole resource needs one barrier per subresource that isn't there yet
+	Tracker.Transition(1, kOtherRead);
+	std::vector<TestTracker::TransitionType> Batch = Tracker.Flush();
+	REQUIRE(Batch.size() == 1);
+	CHECK_EQUAL(0u, Batch[0].mSubresource);
+
+	//Collapsed again: the next whole resource transition is a single barrier
+	Tracker.Transition(1, kRead);
+	Batch = Tracker.Flush();
+	REQUIRE(Batch.size() == 1);
+	CHECK_EQUAL(TestTracker::kAllSubresources, Batch[0].mSubresource);
+
+	CHECK_THROWS(Tracker.Transition(1, kRead, 2), std::out_of_range);
+	CHECK_THROWS(Tracker.Transition(2, kRead), std::invalid_argument);
+}
+
+int main()
+{
+	return RunAllTests();
+}
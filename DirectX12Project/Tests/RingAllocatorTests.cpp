@@ -0,0 +1,129 @@
+#include "TestHarness.h"
+
+#include "RingAllocator.h"
+
+TEST(AllocationsAreAlignedAndPacked)
+{
+	RingAllocator Ring(1024);
+	CHECK_EQUAL(0u, Ring.Allocate(10));
+	CHECK_EQUAL(16u, Ring.Allocate(8, 16));
+	CHECK_EQUAL(24u, Ring.Allocate(4, 4));
+
+	//Padding counts as used
+	CHECK_EQUAL(28u, Ring.GetUsedSize());
+	CHECK_EQUAL(28u, Ring.GetPeakUsedSize());
+}
+
+TEST(AlignmentNeedNotBeAPowerOfTwo)
+{
+	//R32G32B32 texel blocks: offsets must be multiples of lcm(12, 4)
+	RingAllocator Ring(1024);
+	CHECK_EQUAL(0u, Ring.Allocate(5));
+	CHECK_EQUAL(12u, Ring.Allocate(36, 12));
+	CHECK_EQUAL(48u, Ring.Allocate(1, 12));
+	CHECK_EQUAL(60u, Ring.Allocate(1, 12));
+
+	CHECK_EQUAL(0u, RingAllocator::AlignUp(0, 12));
+	CHECK_EQUAL(12u, RingAllocator::AlignUp(1, 12));
+	CHECK_EQUAL(24u, RingAllocator::AlignUp(24, 12));
+	CHECK_EQUAL(256u, RingAllocator::AlignUp(129, 256));
+}
+
+TEST(InvalidRequestsFail)
+{
+	RingAllocator Ring(256);
+	CHECK_EQUAL(RingAllocator::kInvalidOffset, Ring.Allocate(0));
+	CHECK_EQUAL(RingAllocator::kInvalidOffset, Ring.Allocate(257));
+	CHECK_EQUAL(RingAllocator::kInvalidOffset, Ring.Allocate(16, 0));
+	CHECK_EQUAL(0u, Ring.GetUsedSize());
+
+	CHECK_THROWS(Ring.Reset(0), std::runtime_error);
+}
+
+TEST(FullRingFailsUntilTheGpuRetiresAFrame)
+{
+	RingAllocator Ring(256);
+	CHECK_EQUAL(0u, Ring.Allocate(128));
+	Ring.FinishFrame(1);
+	CHECK_EQUAL(128u, Ring.Allocate(128));
+	Ring.FinishFrame(2);
+
+	CHECK_EQUAL(RingAllocator::kInvalidOffset, Ring.Allocate(1));
+
+	//Nothing completed yet
+	Ring.Retire(0);
+	CHECK_EQUAL(RingAllocator::kInvalidOffset, Ring.Allocate(1));
+
+	//Frame 1 done: its half comes back, and only that
+	Ring.Retire(1);
+	CHECK_EQUAL(128u, Ring.GetUsedSize());
+	CHECK_EQUAL(0u, Ring.Allocate(128));
+	CHECK_EQUAL(RingAllocator::kInvalidOffset, Ring.Allocate(1));
+	CHECK_EQUAL(256u, Ring.GetPeakUsedSize());
+}
+
+TEST(WrapChargesTheSkippedEndToTheFrame)
+{
+	RingAllocator Ring(256);
+	CHECK_EQUAL(0u, Ring.Allocate(100));
+	Ring.FinishFrame(1);
+	CHECK_EQUAL(100u, Ring.Allocate(100));
+	Ring.FinishFrame(2);
+	Ring.Retire(1);
+
+	//56 bytes left at the end, not enough: restart at 0 and charge the 56 to this frame
+	CHECK_EQUAL(0u, Ring.Allocate(80));
+	CHECK_EQUAL(100u + 56u + 80u, Ring.GetUsedSize());
+	Ring.FinishFrame(3);
+
+	//Frame 2 retires, then frame 3 with the skipped end: the ring is empty again
+	Ring.Retire(2);
+	CHECK_EQUAL(56u + 80u, Ring.GetUsedSize());
+	Ring.Retire(3);
+	CHECK_EQUAL(0u, Ring.GetUsedSize());
+
+	//Empty, so the whole ring is contiguous again
+	CHECK_EQUAL(0u, Ring.Allocate(256));
+}
+
+TEST(EmptyFramesArentTracked)
+{
+	RingAllocator Ring(64);
+	Ring.FinishFrame(1);
+	CHECK_EQUAL(0u, Ring.Allocate(64));
+	Ring.FinishFrame(2);
+	Ring.FinishFrame(3);
+
+	//Frame 2 held everything, 3 had nothing
+	Ring.Retire(2);
+	CHECK_EQUAL(0u, Ring.GetUsedSize());
+}
+
+TEST(AllocateOrWaitWaitsForTheOldestFrames)
+{
+	RingAllocator Ring(256);
+	for (uint64_t Frame = 1; Frame <= 4; ++Frame)
+	{
+		CHECK(Ring.Allocate(64) != RingAllocator::kInvalidOffset);
+		Ring.FinishFrame(Frame);
+	}
+
+	//Full: 96 bytes take the two oldest frames, waited for in order
+	std::vector<uint64_t> WaitedValues;
+	const uint64_t Offset = Ring.AllocateOrWait(96, 16, [&WaitedValues](uint64_t Value) { WaitedValues.push_back(Value); });
+	CHECK_EQUAL(0u, Offset);
+	REQUIRE(WaitedValues.size() == 2);
+	CHECK_EQUAL(1u, WaitedValues[0]);
+	CHECK_EQUAL(2u, WaitedValues[1]);
+
+	//Bigger than the ring: fails right away, without waiting for the frames in flight
+	WaitedValues.clear();
+	Ring.FinishFrame(5);
+	CHECK_EQUAL(RingAllocator::kInvalidOffset, Ring.AllocateOrWait(512, 16, [&WaitedValues](uint64_t Value) { WaitedValues.push_back(Value); }));
+	CHECK(WaitedValues.empty());
+}
+
+int main()
+{
+	return RunAllTests();
+}
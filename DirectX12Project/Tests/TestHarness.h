@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+	Bare bones test runner for the platform neutral code of Common: TEST(Name) { ... } registers a test, CHECK(...)
+	reports a failure and goes on, REQUIRE(...) also ends the test. Each test program defines main() as RunAllTests().
+*/
+struct TestCase
+{
+	const char* mName;
+
+	std::function<void()> mBody;
+};
+
+struct TestAbort
+{
+};
+
+inline std::vector<TestCase>& GetTestCases()
+{
+	static std::vector<TestCase> TestCases;
+	return TestCases;
+}
+
+inline uint32_t& GetTestFailureCount()
+{
+	static uint32_t FailureCount = 0;
+	return FailureCount;
+}
+
+struct TestRegistration
+{
+	TestRegistration(const char* Name, std::function<void()> Body)
+	{
+		GetTestCases().push_back({ Name, std::move(Body) });
+	}
+};
+
+inline void ReportTestFailure(const char* File, int Line, const std::string& Message)
+{
+	++GetTestFailureCount();
+	std::cerr << File << "(" << Line << "): " << Message << std::endl;
+}
+
+inline int RunAllTests()
+{
+	uint32_t FailedTestCount = 0;
+	for (const TestCase& Test : GetTestCases())
+	{
+		const uint32_t FailuresBefore = GetTestFailureCount();
+		try
+		{
+			Test.mBody();
+		}
+		catch (const TestAbort&)
+		{
+		}
+		catch (const std::exception& Exception)
+		{
+			ReportTestFailure(Test.mName, 0, std::string("unexpected exception: ") + Exception.what());
+		}
+
+		const bool Passed = GetTestFailureCount() == FailuresBefore;
+		FailedTestCount += Passed ? 0 : 1;
+		std::cout << (Passed ? "[  OK  ] " : "[FAILED] ") << Test.mName << std::endl;
+	}
+
+	std::cout << GetTestCases().size() - FailedTestCount << "/" << GetTestCases().size() << " tests passed" << std::endl;
+	return FailedTestCount == 0 ? 0 : 1;
+}
+
+#define TEST_CONCAT_IMPL(A, B) A##B
+#define TEST_CONCAT(A, B) TEST_CONCAT_IMPL(A, B)
+
+#define TEST(Name) \
+	static void Name(); \
+	static TestRegistration TEST_CONCAT(Name, Registration)(#Name, Name); \
+	static void Name()
+
+#define CHECK(Condition) \
+	do { if (!(Condition)) { ReportTestFailure(__FILE__, __LINE__, "CHECK(" #Condition ") failed"); } } while (false)
+
+#define REQUIRE(Condition) \
+	do { if (!(Condition)) { ReportTestFailure(__FILE__, __LINE__, "REQUIRE(" #Condition ") failed"); throw TestAbort(); } } while (false)
+
+#define CHECK_EQUAL(Expected, Actual) \
+	do { if (!((Expected) == (Actual))) { ReportTestFailure(__FILE__, __LINE__, "CHECK_EQUAL(" #Expected ", " #Actual ") failed: " + \
+		std::to_string(Expected) + " != " + std::to_string(Actual)); } } while (false)
+
+#define CHECK_THROWS(Expression, ExceptionType) \
+	do { bool Thrown = false; try { Expression; } catch (const ExceptionType&) { Thrown = true; } \
+		if (!Thrown) { ReportTestFailure(__FILE__, __LINE__, "CHECK_THROWS(" #Expression ") didn't throw " #ExceptionType); } } while (false)
@@ -0,0 +1,362 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+#include "DeviceMemoryAllocator.h"
+#include "FrameScheduler.h"
+#include "StagingRing.h"
+
+struct BufferStreamerStatistics
+{
+	uint64_t mUploadedBytes = 0;
+
+	uint64_t mBatchCount = 0;
+};
+
+/*
+	Streams data into device local buffers (vertices, indices ...) from the transfer queue, so big uploads run on the copy
+	engines alongside rendering instead of taking time out of the graphics queue.
+
+	Uploads are gathered in a batch, copied out of a staging ring of its own and submitted by Flush(), which signals a
+	transfer timeline semaphore (a second FrameScheduler: one value per batch, retiring the staging space and the command
+	buffers). On the graphics side, AcquireOnGraphicsQueue() records whatever the flushed uploads need before they are read
+	and returns the timeline value the graphics submission has to wait for.
+
+	With a dedicated transfer family the buffers are EXCLUSIVE to one family at a time, so every upload releases its buffer
+	range from the transfer family (on the transfer queue) and acquires it on the graphics family (in the frame's command
+	buffer): the two halves of a queue family ownership transfer, ordered by the semaphore. Without one, the graphics
+	queue is used and the semaphore wait alone makes the copies visible.
+
+	Not thread safe: uploads, flushes and acquires come from the thread that submits.
+*/
+class BufferStreamer
+{
+public:
+
+	BufferStreamer() = default;
+
+	BufferStreamer(const BufferStreamer&) = delete;
+	BufferStreamer& operator=(const BufferStreamer&) = delete;
+
+	void Create(VkDevice Device, DeviceMemoryAllocator& Allocator, VkQueue TransferQueue, uint32_t TransferFamily, uint32_t GraphicsFamily, VkDeviceSize StagingSize)
+	{
+		mDevice = Device;
+		mTransferQueue = TransferQueue;
+		mTransferFamily = TransferFamily;
+		mGraphicsFamily = GraphicsFamily;
+
+		//A batch never takes more than half the ring and an upload is split in chunks of an eighth of it, so a chunk always
+		//fits once the batches before the current one have retired (whatever the wrap around wasted)
+		mBatchLimit = StagingSize / 2;
+		mChunkSize = StagingSize / 8;
+
+		mTimeline.Create(mDevice, 1);
+		mStaging.Create(mDevice, Allocator, mTimeline, StagingSize);
+
+		VkCommandPoolCreateInfo PoolInfo = {};
+		PoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		PoolInfo.queueFamilyIndex = mTransferFamily;
+		PoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		if (vkCreateCommandPool(mDevice, &PoolInfo, nullptr, &mCommandPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create the transfer command pool!");
+		}
+	}
+
+	void Destroy()
+	{
+		if (mCommandPool == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		WaitIdle();
+
+		vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
+		mCommandPool = VK_NULL_HANDLE;
+		mStaging.Destroy();
+		mTimeline.Destroy();
+	}
+
+	bool HasDedicatedTransferQueue() const
+	{
+		return mTransferFamily != mGraphicsFamily;
+	}
+
+	//Copy Data into Destination at DestinationOffset. It becomes readable by the graphics queue at DestinationStage with
+	//DestinationAccess once the batch has been flushed and acquired.
+	void UploadBuffer(VkBuffer Destination, VkDeviceSize DestinationOffset, const void* Data, VkDeviceSize Size,
+		VkPipelineStageFlags DestinationStage, VkAccessFlags DestinationAccess)
+	{
+		const char* Bytes = static_cast<const char*>(Data);
+		for (VkDeviceSize Done = 0; Done < Size;)
+		{
+			const VkDeviceSize ChunkSize = std::min(mChunkSize, Size - Done);
+			if (mBatchBytes + ChunkSize > mBatchLimit)
+			{
+				Flush();
+			}
+
+			mStaging.UploadBuffer(BeginBatch(), Destination, DestinationOffset + Done, Bytes + Done, ChunkSize);
+			mBatchBytes += ChunkSize;
+			Done += ChunkSize;
+		}
+
+		PendingAcquire Acquire;
+		Acquire.mBuffer = Destination;
+		Acquire.mOffset = DestinationOffset;
+		Acquire.mSize = Size;
+		Acquire.mStage = DestinationStage;
+		Acquire.mAccess = DestinationAccess;
+		mBatchAcquires.push_back(Acquire);
+
+		mStatistics.mUploadedBytes += Size;
+	}
+
+	//Submit the uploads recorded so far. Returns the timeline value signaled once they're done (0 if there was nothing).
+	uint64_t Flush()
+	{
+		if (mBatchCommandBuffer == VK_NULL_HANDLE)
+		{
+			return 0;
+		}
+
+		//Release half of the ownership transfers: only the source access matters here
+		if (HasDedicatedTransferQueue())
+		{
+			std::vector<VkBufferMemoryBarrier> Releases;
+			for (const auto& Acquire : mBatchAcquires)
+			{
+				VkBufferMemoryBarrier Barrier = MakeOwnershipBarrier(Acquire);
+				Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				Releases.push_back(Barrier);
+			}
+			vkCmdPipelineBarrier(mBatchCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+				0, nullptr, static_cast<uint32_t>(Releases.size()), Releases.data(), 0, nullptr);
+		}
+
+		if (vkEndCommandBuffer(mBatchCommandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to record the transfer command buffer!");
+		}
+
+		const uint64_t Value = mTimeline.GetNextFrameValue();
+		VkSemaphore Semaphore = mTimeline.GetSemaphore();
+
+		VkTimelineSemaphoreSubmitInfoKHR TimelineInfo = {};
+		TimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		TimelineInfo.signalSemaphoreValueCount = 1;
+		TimelineInfo.pSignalSemaphoreValues = &Value;
+
+		VkSubmitInfo SubmitInfo = {};
+		SubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		SubmitInfo.pNext = &TimelineInfo;
+		SubmitInfo.commandBufferCount = 1;
+		SubmitInfo.pCommandBuffers = &mBatchCommandBuffer;
+		SubmitInfo.signalSemaphoreCount = 1;
+		SubmitInfo.pSignalSemaphores = &Semaphore;
+
+		//The staging space of the batch is in use until Value
+		mStaging.EndFrame();
+		if (vkQueueSubmit(mTransferQueue, 1, &SubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit the transfer command buffer!");
+		}
+		mTimeline.MarkSubmitted();
+
+		mBatches.push_back({ Value, mBatchCommandBuffer });
+		for (auto& Acquire : mBatchAcquires)
+		{
+			Acquire.mValue = Value;
+			mFlushedAcquires.push_back(Acquire);
+		}
+		mBatchAcquires.clear();
+		mBatchCommandBuffer = VK_NULL_HANDLE;
+		mBatchBytes = 0;
+		++mStatistics.mBatchCount;
+		return Value;
+	}
+
+	//Record the graphics side of every upload flushed since the last call into CommandBuffer (which must run on the
+	//graphics queue). Returns the timeline value that submission must wait for at GetGraphicsWaitStages(), or 0 if there
+	//is nothing to wait for.
+	uint64_t AcquireOnGraphicsQueue(VkCommandBuffer CommandBuffer)
+	{
+		RetireBatches();
+		if (mFlushedAcquires.empty())
+		{
+			return 0;
+		}
+
+		uint64_t WaitValue = 0;
+		VkPipelineStageFlags Stages = 0;
+		std::vector<VkBufferMemoryBarrier> Acquires;
+		for (const auto& Acquire : mFlushedAcquires)
+		{
+			WaitValue = std::max(WaitValue, Acquire.mValue);
+			Stages |= Acquire.mStage;
+
+			VkBufferMemoryBarrier Barrier = MakeOwnershipBarrier(Acquire);
+			Barrier.dstAccessMask = Acquire.mAccess;
+			Acquires.push_back(Barrier);
+		}
+		mFlushedAcquires.clear();
+
+		//The source stages are the ones the semaphore wait blocks: the acquire (and its layout-free ownership transfer)
+		//only chains after the release through that wait if its first scope includes them
+		if (HasDedicatedTransferQueue())
+		{
+			vkCmdPipelineBarrier(CommandBuffer, GetGraphicsWaitStages(), Stages, 0,
+				0, nullptr, static_cast<uint32_t>(Acquires.size()), Acquires.data(), 0, nullptr);
+		}
+
+		//Waited for even when the host saw it complete already: the acquire needs the release ordered before it on the GPU
+		return WaitValue;
+	}
+
+	//Flush, then block until the transfer queue has completed every upload
+	void WaitIdle()
+	{
+		Flush();
+		mTimeline.WaitIdle();
+		RetireBatches();
+	}
+
+	//Buffer is about to be destroyed without the graphics queue ever acquiring it (its copies must be complete, see
+	//WaitIdle()): forget its pending acquires
+	void DiscardPendingAcquires(VkBuffer Buffer)
+	{
+		auto IsBuffer = [Buffer](const PendingAcquire& Acquire) { return Acquire.mBuffer == Buffer; };
+		mBatchAcquires.erase(std::remove_if(mBatchAcquires.begin(), mBatchAcquires.end(), IsBuffer), mBatchAcquires.end());
+		mFlushedAcquires.erase(std::remove_if(mFlushedAcquires.begin(), mFlushedAcquires.end(), IsBuffer), mFlushedAcquires.end());
+	}
+
+	//Wait stages of the graphics submission waiting on the value AcquireOnGraphicsQueue() returned
+	VkPipelineStageFlags GetGraphicsWaitStages() const
+	{
+		return VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+	}
+
+	VkSemaphore GetSemaphore() const
+	{
+		return mTimeline.GetSemaphore();
+	}
+
+	const BufferStreamerStatistics& GetStatistics() const
+	{
+		return mStatistics;
+	}
+
+private:
+
+	struct PendingAcquire
+	{
+		VkBuffer mBuffer = VK_NULL_HANDLE;
+		VkDeviceSize mOffset = 0;
+		VkDeviceSize mSize = 0;
+		VkPipelineStageFlags mStage = 0;
+		VkAccessFlags mAccess = 0;
+
+		//Timeline value of the batch that uploaded it
+		uint64_t mValue = 0;
+	};
+
+	struct Batch
+	{
+		uint64_t mValue = 0;
+		VkCommandBuffer mCommandBuffer = VK_NULL_HANDLE;
+	};
+
+	//Command buffer of the batch being recorded, started if needed
+	VkCommandBuffer BeginBatch()
+	{
+		if (mBatchCommandBuffer != VK_NULL_HANDLE)
+		{
+			return mBatchCommandBuffer;
+		}
+
+		RetireBatches();
+		mStaging.BeginFrame();
+
+		VkCommandBufferAllocateInfo AllocInfo = {};
+		AllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		AllocInfo.commandPool = mCommandPool;
+		AllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		AllocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(mDevice, &AllocInfo, &mBatchCommandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate the transfer command buffer!");
+		}
+
+		VkCommandBufferBeginInfo BeginInfo = {};
+		BeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (vkBeginCommandBuffer(mBatchCommandBuffer, &BeginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to begin recording the transfer command buffer!");
+		}
+		return mBatchCommandBuffer;
+	}
+
+	//Free the command buffers of the batches the transfer queue is done with
+	void RetireBatches()
+	{
+		while (!mBatches.empty() && mTimeline.IsValueCompleted(mBatches.front().mValue))
+		{
+			vkFreeCommandBuffers(mDevice, mCommandPool, 1, &mBatches.front().mCommandBuffer);
+			mBatches.pop_front();
+		}
+	}
+
+	//Both halves of an ownership transfer must name the same families and range
+	VkBufferMemoryBarrier MakeOwnershipBarrier(const PendingAcquire& Acquire) const
+	{
+		VkBufferMemoryBarrier Barrier = {};
+		Barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		Barrier.srcQueueFamilyIndex = mTransferFamily;
+		Barrier.dstQueueFamilyIndex = mGraphicsFamily;
+		Barrier.buffer = Acquire.mBuffer;
+		Barrier.offset = Acquire.mOffset;
+		Barrier.size = Acquire.mSize;
+		return Barrier;
+	}
+
+	VkDevice mDevice = VK_NULL_HANDLE;
+
+	VkQueue mTransferQueue = VK_NULL_HANDLE;
+
+	uint32_t mTransferFamily = 0;
+
+	uint32_t mGraphicsFamily = 0;
+
+	VkCommandPool mCommandPool = VK_NULL_HANDLE;
+
+	//One value per submitted batch
+	FrameScheduler mTimeline;
+
+	StagingRing mStaging;
+
+	VkDeviceSize mBatchLimit = 0;
+
+	VkDeviceSize mChunkSize = 0;
+
+	//Batch being recorded
+	VkCommandBuffer mBatchCommandBuffer = VK_NULL_HANDLE;
+	VkDeviceSize mBatchBytes = 0;
+	std::vector<PendingAcquire> mBatchAcquires;
+
+	//Submitted batches not known to be complete yet
+	std::deque<Batch> mBatches;
+
+	//Uploads submitted but not acquired by the graphics queue yet
+	std::vector<PendingAcquire> mFlushedAcquires;
+
+	BufferStreamerStatistics mStatistics;
+};
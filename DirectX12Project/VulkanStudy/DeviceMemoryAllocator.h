@@ -0,0 +1,552 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+#include "../Common/BuddyAllocator.h"
+
+//What a piece of memory is going to be bound to. Linear resources (buffers, linear images) and optimal tiled images
+//must be kept bufferImageGranularity bytes apart when they share a VkDeviceMemory, so we give them separate blocks.
+enum class AllocationKind
+{
+	Linear,
+	Optimal
+};
+
+//A range of device memory handed out by the DeviceMemoryAllocator
+struct DeviceAllocation
+{
+	VkDeviceMemory mMemory = VK_NULL_HANDLE;
+
+	VkDeviceSize mOffset = 0;
+
+	//Size that was requested (the allocator may reserve more than this)
+	VkDeviceSize mSize = 0;
+
+	//CPU address of mOffset for host visible memory, nullptr otherwise
+	void* mMappedData = nullptr;
+
+	uint32_t mMemoryTypeIndex = 0;
+
+	//Owning block, or kDedicated for allocations that got their own VkDeviceMemory
+	uint32_t mBlockIndex = 0;
+
+	static constexpr uint32_t kDedicated = ~0u;
+
+	bool IsValid() const
+	{
+		return mMemory != VK_NULL_HANDLE;
+	}
+};
+
+struct DeviceMemoryStatistics
+{
+	//Number of VkDeviceMemory objects alive (blocks plus dedicated allocations)
+	uint32_t mDeviceMemoryCount = 0;
+
+	uint32_t mBlockCount = 0;
+
+	uint32_t mDedicatedAllocationCount = 0;
+
+	//Live suballocations
+	uint32_t mAllocationCount = 0;
+
+	//Bytes allocated from the driver
+	VkDeviceSize mReservedBytes = 0;
+
+	//Bytes taken by live allocations, including buddy rounding
+	VkDeviceSize mUsedBytes = 0;
+
+	//Bytes the callers actually asked for
+	VkDeviceSize mRequestedBytes = 0;
+
+	//Biggest free range across all the blocks
+	VkDeviceSize mLargestFreeRange = 0;
+
+	//Lifetime counters
+	uint64_t mTotalAllocations = 0;
+	uint64_t mTotalFrees = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& Stream, const DeviceMemoryStatistics& Stats)
+{
+	const double MB = 1024.0 * 1024.0;
+	Stream << Stats.mAllocationCount << " allocations in " << Stats.mBlockCount << " blocks + " << Stats.mDedicatedAllocationCount
+		<< " dedicated (" << Stats.mDeviceMemoryCount << " VkDeviceMemory), "
+		<< Stats.mRequestedBytes / MB << " MB requested, " << Stats.mUsedBytes / MB << " MB used, " << Stats.mReservedBytes / MB << " MB reserved, "
+		<< "largest free range " << Stats.mLargestFreeRange / MB << " MB";
+	return Stream;
+}
+
+/*
+	Device memory suballocator.
+
+	vkAllocateMemory is slow, and the number of live allocations is capped by maxMemoryAllocationCount (as low as 4096 on
+	some drivers), so resources must not get one VkDeviceMemory each. Instead we allocate big blocks per memory type and
+	carve them with a buddy allocator. Requests bigger than half a block get a dedicated VkDeviceMemory.
+
+	Host visible blocks are persistently mapped once, allocations out of them get their CPU pointer for free.
+	Empty blocks are released, except one per memory type and kind which is kept around to avoid allocation ping-pong.
+	All the methods are thread safe.
+*/
+class DeviceMemoryAllocator
+{
+public:
+
+	static constexpr VkDeviceSize kDefaultBlockSize = 64ull * 1024 * 1024;
+
+	//Nothing smaller than this gets handed out (a few small uniform buffers would otherwise blow up the number of levels)
+	static constexpr VkDeviceSize kMinAllocationSize = 256;
+
+	DeviceMemoryAllocator() = default;
+
+	~DeviceMemoryAllocator() = default;
+
+	DeviceMemoryAllocator(const DeviceMemoryAllocator&) = delete;
+	DeviceMemoryAllocator& operator=(const DeviceMemoryAllocator&) = delete;
+
+	//BlockSize is rounded up to a power of two
+	void Create(VkDevice Device, VkPhysicalDevice PhysicalDevice, VkDeviceSize BlockSize = kDefaultBlockSize)
+	{
+		mDevice = Device;
+		mBlockSize = BuddyAllocator::NextPowerOfTwo(BlockSize);
+
+		vkGetPhysicalDeviceMemoryProperties(PhysicalDevice, &mMemoryProperties);
+
+		VkPhysicalDeviceProperties DeviceProperties;
+		vkGetPhysicalDeviceProperties(PhysicalDevice, &DeviceProperties);
+		mBufferImageGranularity = DeviceProperties.limits.bufferImageGranularity;
+		mNonCoherentAtomSize = DeviceProperties.limits.nonCoherentAtomSize;
+	}
+
+	//Find a memory type that is allowed by TypeFilter and has all the requested properties
+	uint32_t FindMemoryType(uint32_t TypeFilter, VkMemoryPropertyFlags Properties) const
+	{
+		for (uint32_t i = 0; i < mMemoryProperties.memoryTypeCount; ++i)
+		{
+			if ((TypeFilter & (1 << i)) && (mMemoryProperties.memoryTypes[i].propertyFlags & Properties) == Properties)
+			{
+				return i;
+			}
+		}
+
+		throw std::runtime_error("Failed to find a suitable memory type!");
+	}
+
+	DeviceAllocation Allocate(const VkMemoryRequirements& Requirements, VkMemoryPropertyFlags Properties, AllocationKind Kind)
+	{
+		const uint32_t MemoryTypeIndex = FindMemoryType(Requirements.memoryTypeBits, Properties);
+
+		//No granularity constraint means linear and optimal resources can live side by side
+		if (mBufferImageGranularity <= 1)
+		{
+			Kind = AllocationKind::Linear;
+		}
+
+		std::lock_guard<std::mutex> Lock(mMutex);
+
+		++mTotalAllocations;
+
+		if (Requirements.size > mBlockSize / 2)
+		{
+			return AllocateDedicated(Requirements.size, MemoryTypeIndex);
+		}
+
+		const VkDeviceSize Size = std::max(Requirements.size, kMinAllocationSize);
+		const VkDeviceSize Alignment = std::max<VkDeviceSize>(Requirements.alignment, 1);
+
+		for (uint32_t BlockIndex = 0; BlockIndex < mBlocks.size(); ++BlockIndex)
+		{
+			Block* CurrentBlock = mBlocks[BlockIndex].get();
+			if (CurrentBlock == nullptr || CurrentBlock->mMemoryTypeIndex != MemoryTypeIndex || CurrentBlock->mKind != Kind)
+			{
+				continue;
+			}
+
+			VkDeviceSize Offset = CurrentBlock->mBuddy.Allocate(Size, Alignment);
+			if (Offset != BuddyAllocator::kInvalidOffset)
+			{
+				return MakeAllocation(*CurrentBlock, BlockIndex, Offset, Requirements.size);
+			}
+		}
+
+		//Every compatible block is full
+		uint32_t BlockIndex = CreateBlock(MemoryTypeIndex, Kind);
+		Block& NewBlock = *mBlocks[BlockIndex];
+		VkDeviceSize Offset = NewBlock.mBuddy.Allocate(Size, Alignment);
+		return MakeAllocation(NewBlock, BlockIndex, Offset, Requirements.size);
+	}
+
+	void Free(DeviceAllocation& Allocation)
+	{
+		if (!Allocation.IsValid())
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> Lock(mMutex);
+
+		++mTotalFrees;
+
+		if (Allocation.mBlockIndex == DeviceAllocation::kDedicated)
+		{
+			vkFreeMemory(mDevice, Allocation.mMemory, nullptr);
+			mDedicatedBytes -= Allocation.mSize;
+			--mDedicatedCount;
+		}
+		else
+		{
+			Block& OwnerBlock = *mBlocks[Allocation.mBlockIndex];
+			OwnerBlock.mBuddy.Free(Allocation.mOffset);
+			OwnerBlock.mRequestedBytes -= Allocation.mSize;
+
+			if (OwnerBlock.mBuddy.IsEmpty() && HasOtherEmptyBlock(Allocation.mBlockIndex))
+			{
+				DestroyBlock(Allocation.mBlockIndex);
+			}
+		}
+
+		Allocation = DeviceAllocation();
+	}
+
+	//Allocate memory for a buffer and bind it
+	DeviceAllocation AllocateForBuffer(VkBuffer Buffer, VkMemoryPropertyFlags Properties)
+	{
+		VkMemoryRequirements Requirements;
+		vkGetBufferMemoryRequirements(mDevice, Buffer, &Requirements);
+
+		DeviceAllocation Allocation = Allocate(Requirements, Properties, AllocationKind::Linear);
+		if (vkBindBufferMemory(mDevice, Buffer, Allocation.mMemory, Allocation.mOffset) != VK_SUCCESS)
+		{
+			Free(Allocation);
+			throw std::runtime_error("Failed to bind buffer memory!");
+		}
+		return Allocation;
+	}
+
+	//Allocate memory for an image and bind it
+	DeviceAllocation AllocateForImage(VkImage Image, VkImageTiling Tiling, VkMemoryPropertyFlags Properties)
+	{
+		VkMemoryRequirements Requirements;
+		vkGetImageMemoryRequirements(mDevice, Image, &Requirements);
+
+		DeviceAllocation Allocation = Allocate(Requirements, Properties, Tiling == VK_IMAGE_TILING_OPTIMAL ? AllocationKind::Optimal : AllocationKind::Linear);
+		if (vkBindImageMemory(mDevice, Image, Allocation.mMemory, Allocation.mOffset) != VK_SUCCESS)
+		{
+			Free(Allocation);
+			throw std::runtime_error("Failed to bind image memory!");
+		}
+		return Allocation;
+	}
+
+	DeviceMemoryStatistics GetStatistics() const
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+
+		DeviceMemoryStatistics Stats;
+		for (const auto& CurrentBlock : mBlocks)
+		{
+			if (CurrentBlock == nullptr)
+			{
+				continue;
+			}
+			++Stats.mBlockCount;
+			Stats.mAllocationCount += CurrentBlock->mBuddy.GetAllocationCount();
+			Stats.mReservedBytes += CurrentBlock->mBuddy.GetSize();
+			Stats.mUsedBytes += CurrentBlock->mBuddy.GetUsedSize();
+			Stats.mRequestedBytes += CurrentBlock->mRequestedBytes;
+			Stats.mLargestFreeRange = std::max(Stats.mLargestFreeRange, CurrentBlock->mBuddy.GetLargestFreeBlock());
+		}
+
+		Stats.mDedicatedAllocationCount = mDedicatedCount;
+		Stats.mAllocationCount += mDedicatedCount;
+		Stats.mReservedBytes += mDedicatedBytes;
+		Stats.mUsedBytes += mDedicatedBytes;
+		Stats.mRequestedBytes += mDedicatedBytes;
+		Stats.mDeviceMemoryCount = Stats.mBlockCount + mDedicatedCount;
+		Stats.mTotalAllocations = mTotalAllocations;
+		Stats.mTotalFrees = mTotalFrees;
+		return Stats;
+	}
+
+	VkDeviceSize GetBlockSize() const
+	{
+		return mBlockSize;
+	}
+
+	VkDeviceSize GetNonCoherentAtomSize() const
+	{
+		return mNonCoherentAtomSize;
+	}
+
+	//Release every block. Every allocation must have been freed (or must not be used anymore) at this point.
+	void Destroy()
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+
+		for (uint32_t BlockIndex = 0; BlockIndex < mBlocks.size(); ++BlockIndex)
+		{
+			if (mBlocks[BlockIndex] != nullptr)
+			{
+				DestroyBlock(BlockIndex);
+			}
+		}
+		mBlocks.clear();
+	}
+
+private:
+
+	struct Block
+	{
+		VkDeviceMemory mMemory = VK_NULL_HANDLE;
+
+		BuddyAllocator mBuddy;
+
+		//Persistent mapping of the whole block (host visible memory only)
+		void* mMappedData = nullptr;
+
+		uint32_t mMemoryTypeIndex = 0;
+
+		AllocationKind mKind = AllocationKind::Linear;
+
+		VkDeviceSize mRequestedBytes = 0;
+	};
+
+	bool IsHostVisible(uint32_t MemoryTypeIndex) const
+	{
+		return (mMemoryProperties.memoryTypes[MemoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+	}
+
+	VkDeviceMemory AllocateDeviceMemory(VkDeviceSize Size, uint32_t MemoryTypeIndex, void** MappedData)
+	{
+		VkMemoryAllocateInfo AllocInfo = {};
+		AllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		AllocInfo.allocationSize = Size;
+		AllocInfo.memoryTypeIndex = MemoryTypeIndex;
+
+		VkDeviceMemory Memory;
+		if (vkAllocateMemory(mDevice, &AllocInfo, nullptr, &Memory) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate device memory!");
+		}
+
+		*MappedData = nullptr;
+		if (IsHostVisible(MemoryTypeIndex) && vkMapMemory(mDevice, Memory, 0, VK_WHOLE_SIZE, 0, MappedData) != VK_SUCCESS)
+		{
+			vkFreeMemory(mDevice, Memory, nullptr);
+			throw std::runtime_error("Failed to map device memory!");
+		}
+		return Memory;
+	}
+
+	DeviceAllocation AllocateDedicated(VkDeviceSize Size, uint32_t MemoryTypeIndex)
+	{
+		DeviceAllocation Allocation;
+		Allocation.mMemory = AllocateDeviceMemory(Size, MemoryTypeIndex, &Allocation.mMappedData);
+		Allocation.mSize = Size;
+		Allocation.mMemoryTypeIndex = MemoryTypeIndex;
+		Allocation.mBlockIndex = DeviceAllocation::kDedicated;
+
+		mDedicatedBytes += Size;
+		++mDedicatedCount;
+		return Allocation;
+	}
+
+	uint32_t CreateBlock(uint32_t MemoryTypeIndex, AllocationKind Kind)
+	{
+		auto NewBlock = std::make_unique<Block>();
+		NewBlock->mMemory = AllocateDeviceMemory(mBlockSize, MemoryTypeIndex, &NewBlock->mMappedData);
+		NewBlock->mBuddy.Reset(mBlockSize, kMinAllocationSize);
+		NewBlock->mMemoryTypeIndex = MemoryTypeIndex;
+		NewBlock->mKind = Kind;
+
+		//Reuse the slot of a released block so that block indices stay small
+		for (uint32_t BlockIndex = 0; BlockIndex < mBlocks.size(); ++BlockIndex)
+		{
+			if (mBlocks[BlockIndex] == nullptr)
+			{
+				mBlocks[BlockIndex] = std::move(NewBlock);
+				return BlockIndex;
+			}
+		}
+		mBlocks.push_back(std::move(NewBlock));
+		return static_cast<uint32_t>(mBlocks.size() - 1);
+	}
+
+	void DestroyBlock(uint32_t BlockIndex)
+	{
+		Block& OldBlock = *mBlocks[BlockIndex];
+		if (OldBlock.mMappedData != nullptr)
+		{
+			vkUnmapMemory(mDevice, OldBlock.mMemory);
+		}
+		vkFreeMemory(mDevice, OldBlock.mMemory, nullptr);
+		mBlocks[BlockIndex].reset();
+	}
+
+	//True if another empty block could serve the same requests as BlockIndex
+	bool HasOtherEmptyBlock(uint32_t BlockIndex) const
+	{
+		const Block& Reference = *mBlocks[BlockIndex];
+		for (uint32_t Other = 0; Other < mBlocks.size(); ++Other)
+		{
+			if (Other != BlockIndex && mBlocks[Other] != nullptr && mBlocks[Other]->mBuddy.IsEmpty() &&
+				mBlocks[Other]->mMemoryTypeIndex == Reference.mMemoryTypeIndex && mBlocks[Other]->mKind == Reference.mKind)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	DeviceAllocation MakeAllocation(Block& OwnerBlock, uint32_t BlockIndex, VkDeviceSize Offset, VkDeviceSize Size)
+	{
+		OwnerBlock.mRequestedBytes += Size;
+
+		DeviceAllocation Allocation;
+		Allocation.mMemory = OwnerBlock.mMemory;
+		Allocation.mOffset = Offset;
+		Allocation.mSize = Size;
+		Allocation.mMemoryTypeIndex = OwnerBlock.mMemoryTypeIndex;
+		Allocation.mBlockIndex = BlockIndex;
+		if (OwnerBlock.mMappedData != nullptr)
+		{
+			Allocation.mMappedData = static_cast<char*>(OwnerBlock.mMappedData) + Offset;
+		}
+		return Allocation;
+	}
+
+	VkDevice mDevice = VK_NULL_HANDLE;
+
+	VkPhysicalDeviceMemoryProperties mMemoryProperties = {};
+
+	VkDeviceSize mBufferImageGranularity = 1;
+
+	VkDeviceSize mNonCoherentAtomSize = 1;
+
+	VkDeviceSize mBlockSize = kDefaultBlockSize;
+
+	//Blocks are heap allocated and released blocks leave a null slot, so block indices stored in allocations stay valid
+	std::vector<std::unique_ptr<Block>> mBlocks;
+
+	VkDeviceSize mDedicatedBytes = 0;
+
+	uint32_t mDedicatedCount = 0;
+
+	uint64_t mTotalAllocations = 0;
+
+	uint64_t mTotalFrees = 0;
+
+	mutable std::mutex mMutex;
+};
+
+/*
+	Linear (bump pointer) allocator for transient per-frame data: constants, dynamic vertices, staging ...
+
+	It owns one range of a DeviceMemoryAllocator and hands out consecutive pieces of it; nothing is ever freed
+	individually, the whole range is recycled by Reset() once the GPU is done with the frame that used it.
+	Use one per frame in flight. Only meant for buffers, so it doesn't care about bufferImageGranularity.
+*/
+class LinearDeviceAllocator
+{
+public:
+
+	LinearDeviceAllocator() = default;
+
+	LinearDeviceAllocator(const LinearDeviceAllocator&) = delete;
+	LinearDeviceAllocator& operator=(const LinearDeviceAllocator&) = delete;
+
+	//MemoryTypeBits is the memoryTypeBits of the buffers that will be placed in here (they usually all agree for a given usage)
+	void Create(DeviceMemoryAllocator& Allocator, VkDeviceSize Capacity, uint32_t MemoryTypeBits, VkMemoryPropertyFlags Properties)
+	{
+		mAllocator = &Allocator;
+
+		VkMemoryRequirements Requirements = {};
+		Requirements.size = Capacity;
+		Requirements.alignment = Allocator.GetNonCoherentAtomSize();
+		Requirements.memoryTypeBits = MemoryTypeBits;
+		mRange = Allocator.Allocate(Requirements, Properties, AllocationKind::Linear);
+		mHead = 0;
+		mHighWaterMark = 0;
+	}
+
+	//Returns an invalid allocation when the range is full: callers fall back to the general allocator or grow the capacity
+	DeviceAllocation Allocate(const VkMemoryRequirements& Requirements)
+	{
+		if ((Requirements.memoryTypeBits & (1u << mRange.mMemoryTypeIndex)) == 0)
+		{
+			throw std::runtime_error("Linear allocator memory type doesn't fit the resource!");
+		}
+
+		const VkDeviceSize Alignment = std::max<VkDeviceSize>(Requirements.alignment, 1);
+
+		//Align the absolute offset, the range itself may start anywhere inside its block
+		VkDeviceSize Offset = mRange.mOffset + mHead;
+		Offset = (Offset + Alignment - 1) / Alignment * Alignment;
+		if (Offset + Requirements.size > mRange.mOffset + mRange.mSize)
+		{
+			return DeviceAllocation();
+		}
+		mHead = Offset + Requirements.size - mRange.mOffset;
+		mHighWaterMark = std::max(mHighWaterMark, mHead);
+
+		DeviceAllocation Allocation;
+		Allocation.mMemory = mRange.mMemory;
+		Allocation.mOffset = Offset;
+		Allocation.mSize = Requirements.size;
+		Allocation.mMemoryTypeIndex = mRange.mMemoryTypeIndex;
+		Allocation.mBlockIndex = mRange.mBlockIndex;
+		if (mRange.mMappedData != nullptr)
+		{
+			Allocation.mMappedData = static_cast<char*>(mRange.mMappedData) + (Offset - mRange.mOffset);
+		}
+		return Allocation;
+	}
+
+	//Recycle everything at once. The GPU must be done with every allocation made since the previous Reset().
+	void Reset()
+	{
+		mHead = 0;
+	}
+
+	VkDeviceSize GetUsedSize() const
+	{
+		return mHead;
+	}
+
+	//Peak usage since creation, handy to tune the capacity
+	VkDeviceSize GetHighWaterMark() const
+	{
+		return mHighWaterMark;
+	}
+
+	VkDeviceSize GetCapacity() const
+	{
+		return mRange.mSize;
+	}
+
+	void Destroy()
+	{
+		if (mAllocator != nullptr)
+		{
+			mAllocator->Free(mRange);
+			mAllocator = nullptr;
+		}
+	}
+
+private:
+
+	DeviceMemoryAllocator* mAllocator = nullptr;
+
+	DeviceAllocation mRange;
+
+	VkDeviceSize mHead = 0;
+
+	VkDeviceSize mHighWaterMark = 0;
+};
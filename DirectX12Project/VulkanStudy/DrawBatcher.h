@@ -0,0 +1,340 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "DeviceMemoryAllocator.h"
+
+//Per object data, read by the vertex shaders from the instance buffer (std430: InstanceBuffer { InstanceData Instances[]; })
+struct InstanceData
+{
+	//Column major, object space to world space
+	float mTransform[16];
+};
+
+//What a draw needs bound besides the pipeline: its vertex streams, indices and push constants
+struct DrawGeometry
+{
+	static constexpr uint32_t kMaxVertexStreams = 4;
+
+	VkBuffer mVertexBuffers[kMaxVertexStreams] = {};
+	VkDeviceSize mVertexOffsets[kMaxVertexStreams] = {};
+	uint32_t mVertexStreamCount = 0;
+
+	VkBuffer mIndexBuffer = VK_NULL_HANDLE;
+	VkDeviceSize mIndexOffset = 0;
+	VkIndexType mIndexType = VK_INDEX_TYPE_UINT16;
+	uint32_t mIndexCount = 0;
+
+	//Pushed once per batch (none if null), must stay valid until the batches are recorded
+	const void* mPushConstants = nullptr;
+	uint32_t mPushConstantSize = 0;
+	VkShaderStageFlags mPushConstantStages = 0;
+};
+
+//A visible object of the frame
+struct DrawObject
+{
+	VkPipeline mPipeline = VK_NULL_HANDLE;
+
+	//Its set 0 must be the instance buffer
+	VkPipelineLayout mLayout = VK_NULL_HANDLE;
+
+	//Objects pointing to the same geometry get instanced together
+	const DrawGeometry* mGeometry = nullptr;
+
+	InstanceData mInstance;
+};
+
+//One instanced draw: InstanceCount objects, whose data starts at FirstInstance in the instance buffer
+struct DrawBatch
+{
+	VkPipeline mPipeline = VK_NULL_HANDLE;
+	VkPipelineLayout mLayout = VK_NULL_HANDLE;
+	const DrawGeometry* mGeometry = nullptr;
+
+	uint32_t mFirstInstance = 0;
+	uint32_t mInstanceCount = 0;
+};
+
+struct DrawBatcherStatistics
+{
+	//Last frame
+	uint32_t mObjectCount = 0;
+	uint32_t mDrawCount = 0;
+
+	//Every frame so far
+	uint32_t mFrameCount = 0;
+	uint64_t mTotalObjectCount = 0;
+	uint64_t mTotalDrawCount = 0;
+
+	//Draws instancing spared: one per object otherwise
+	uint64_t GetDrawsSaved() const
+	{
+		return mTotalObjectCount - mTotalDrawCount;
+	}
+};
+
+/*
+	Instanced draw submission. The visible objects of a frame get sorted by pipeline and geometry, their instance data is
+	packed in that order into the frame's instance buffer (host visible storage buffer, one per frame in flight so the
+	GPU never reads what the CPU is writing), and every run of objects sharing pipeline and geometry becomes one
+	instanced draw. Vertex shaders find their object at Instances[gl_InstanceIndex]: firstInstance is where the run starts.
+
+		Batcher.BeginFrame(Slot);                          //after waiting for the frame slot
+		Batcher.Add(Object);                               //every visible object, in any order
+		Batcher.Build();                                   //sort, pack, batch
+		Batcher.Record(CommandBuffer, First, Count);       //any slice of GetBatches(), from any thread
+
+	With instancing off every object is a batch of its own (still reading its data from the instance buffer): the
+	baseline the statistics count the draws saved against.
+*/
+class DrawBatcher
+{
+public:
+
+	DrawBatcher() = default;
+
+	DrawBatcher(const DrawBatcher&) = delete;
+	DrawBatcher& operator=(const DrawBatcher&) = delete;
+
+	//SetLayout: set 0 of the pipelines, a single storage buffer at binding 0
+	void Create(VkDevice Device, DeviceMemoryAllocator& Allocator, VkDescriptorSetLayout SetLayout, uint32_t FrameCount, uint32_t MaxInstanceCount, bool Instancing)
+	{
+		mDevice = Device;
+		mAllocator = &Allocator;
+		mMaxInstanceCount = std::max(MaxInstanceCount, 1u);
+		mInstancing = Instancing;
+
+		VkDescriptorPoolSize PoolSize = {};
+		PoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		PoolSize.descriptorCount = FrameCount;
+
+		VkDescriptorPoolCreateInfo PoolInfo = {};
+		PoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		PoolInfo.maxSets = FrameCount;
+		PoolInfo.poolSizeCount = 1;
+		PoolInfo.pPoolSizes = &PoolSize;
+		if (vkCreateDescriptorPool(mDevice, &PoolInfo, nullptr, &mDescriptorPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create the instance buffer descriptor pool!");
+		}
+
+		mFrames.resize(FrameCount);
+		for (Frame& CurrentFrame : mFrames)
+		{
+			VkBufferCreateInfo BufferInfo = {};
+			BufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			BufferInfo.size = sizeof(InstanceData) * mMaxInstanceCount;
+			BufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+			BufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			if (vkCreateBuffer(mDevice, &BufferInfo, nullptr, &CurrentFrame.mBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create an instance buffer!");
+			}
+
+			//Coherent, so the writes don't need flushing before the submission
+			CurrentFrame.mAllocation = mAllocator->AllocateForBuffer(CurrentFrame.mBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			if (CurrentFrame.mAllocation.mMappedData == nullptr)
+			{
+				throw std::runtime_error("Instance buffer memory isn't mapped!");
+			}
+
+			VkDescriptorSetAllocateInfo AllocInfo = {};
+			AllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			AllocInfo.descriptorPool = mDescriptorPool;
+			AllocInfo.descriptorSetCount = 1;
+			AllocInfo.pSetLayouts = &SetLayout;
+			if (vkAllocateDescriptorSets(mDevice, &AllocInfo, &CurrentFrame.mDescriptorSet) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate an instance buffer descriptor set!");
+			}
+
+			VkDescriptorBufferInfo DescriptorBufferInfo = {};
+			DescriptorBufferInfo.buffer = CurrentFrame.mBuffer;
+			DescriptorBufferInfo.offset = 0;
+			DescriptorBufferInfo.range = VK_WHOLE_SIZE;
+
+			VkWriteDescriptorSet Write = {};
+			Write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			Write.dstSet = CurrentFrame.mDescriptorSet;
+			Write.dstBinding = 0;
+			Write.descriptorCount = 1;
+			Write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			Write.pBufferInfo = &DescriptorBufferInfo;
+			vkUpdateDescriptorSets(mDevice, 1, &Write, 0, nullptr);
+		}
+	}
+
+	//The GPU must be done with every frame
+	void Destroy()
+	{
+		for (Frame& CurrentFrame : mFrames)
+		{
+			vkDestroyBuffer(mDevice, CurrentFrame.mBuffer, nullptr);
+			mAllocator->Free(CurrentFrame.mAllocation);
+		}
+		mFrames.clear();
+
+		//Its sets go with it
+		vkDestroyDescriptorPool(mDevice, mDescriptorPool, nullptr);
+		mDescriptorPool = VK_NULL_HANDLE;
+	}
+
+	//The GPU must be done with the frame that last used Slot
+	void BeginFrame(uint32_t Slot)
+	{
+		mCurrentFrame = Slot;
+		mObjects.clear();
+		mBatches.clear();
+	}
+
+	void Add(const DrawObject& Object)
+	{
+		if (mObjects.size() == mMaxInstanceCount)
+		{
+			throw std::runtime_error("Too many objects for the instance buffer!");
+		}
+		mObjects.push_back(Object);
+	}
+
+	const std::vector<DrawBatch>& Build()
+	{
+		//Stable, so objects of a batch keep the order they were added in
+		mOrder.resize(mObjects.size());
+		std::iota(mOrder.begin(), mOrder.end(), 0u);
+		std::stable_sort(mOrder.begin(), mOrder.end(), [this](uint32_t A, uint32_t B)
+		{
+			const DrawObject& First = mObjects[A];
+			const DrawObject& Second = mObjects[B];
+			if (First.mPipeline != Second.mPipeline)
+			{
+				return std::less<VkPipeline>()(First.mPipeline, Second.mPipeline);
+			}
+			return std::less<const DrawGeometry*>()(First.mGeometry, Second.mGeometry);
+		});
+
+		InstanceData* Instances = static_cast<InstanceData*>(mFrames[mCurrentFrame].mAllocation.mMappedData);
+		for (uint32_t Instance = 0; Instance < mOrder.size(); ++Instance)
+		{
+			const DrawObject& Object = mObjects[mOrder[Instance]];
+			std::memcpy(&Instances[Instance], &Object.mInstance, sizeof(InstanceData));
+
+			const bool SameBatch = mInstancing && !mBatches.empty() && mBatches.back().mPipeline == Object.mPipeline && mBatches.back().mGeometry == Object.mGeometry;
+			if (SameBatch)
+			{
+				++mBatches.back().mInstanceCount;
+				continue;
+			}
+
+			DrawBatch Batch;
+			Batch.mPipeline = Object.mPipeline;
+			Batch.mLayout = Object.mLayout;
+			Batch.mGeometry = Object.mGeometry;
+			Batch.mFirstInstance = Instance;
+			Batch.mInstanceCount = 1;
+			mBatches.push_back(Batch);
+		}
+
+		mStatistics.mObjectCount = static_cast<uint32_t>(mObjects.size());
+		mStatistics.mDrawCount = static_cast<uint32_t>(mBatches.size());
+		++mStatistics.mFrameCount;
+		mStatistics.mTotalObjectCount += mStatistics.mObjectCount;
+		mStatistics.mTotalDrawCount += mStatistics.mDrawCount;
+		return mBatches;
+	}
+
+	const std::vector<DrawBatch>& GetBatches() const
+	{
+		return mBatches;
+	}
+
+	//Record Count batches from First. State is only bound when it changes from a batch to the next, and the command
+	//buffer is assumed to have nothing bound yet (e.g. a fresh secondary command buffer).
+	void Record(VkCommandBuffer CommandBuffer, size_t First, size_t Count) const
+	{
+		VkPipeline BoundPipeline = VK_NULL_HANDLE;
+		VkPipelineLayout BoundLayout = VK_NULL_HANDLE;
+		const DrawGeometry* BoundGeometry = nullptr;
+		for (size_t i = First; i < First + Count; ++i)
+		{
+			const DrawBatch& Batch = mBatches[i];
+			if (Batch.mPipeline != BoundPipeline)
+			{
+				vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Batch.mPipeline);
+				BoundPipeline = Batch.mPipeline;
+			}
+
+			//Layouts with different push constants aren't compatible, so the set must be bound again with the new layout
+			if (Batch.mLayout != BoundLayout)
+			{
+				vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Batch.mLayout, 0, 1, &mFrames[mCurrentFrame].mDescriptorSet, 0, nullptr);
+				BoundLayout = Batch.mLayout;
+				BoundGeometry = nullptr;
+			}
+
+			const DrawGeometry& Geometry = *Batch.mGeometry;
+			if (&Geometry != BoundGeometry)
+			{
+				vkCmdBindVertexBuffers(CommandBuffer, 0, Geometry.mVertexStreamCount, Geometry.mVertexBuffers, Geometry.mVertexOffsets);
+				vkCmdBindIndexBuffer(CommandBuffer, Geometry.mIndexBuffer, Geometry.mIndexOffset, Geometry.mIndexType);
+				if (Geometry.mPushConstants != nullptr)
+				{
+					vkCmdPushConstants(CommandBuffer, Batch.mLayout, Geometry.mPushConstantStages, 0, Geometry.mPushConstantSize, Geometry.mPushConstants);
+				}
+				BoundGeometry = &Geometry;
+			}
+
+			vkCmdDrawIndexed(CommandBuffer, Geometry.mIndexCount, Batch.mInstanceCount, 0, 0, Batch.mFirstInstance);
+		}
+	}
+
+	bool IsInstancing() const
+	{
+		return mInstancing;
+	}
+
+	const DrawBatcherStatistics& GetStatistics() const
+	{
+		return mStatistics;
+	}
+
+private:
+
+	struct Frame
+	{
+		VkBuffer mBuffer = VK_NULL_HANDLE;
+		DeviceAllocation mAllocation;
+
+		//Points to mBuffer
+		VkDescriptorSet mDescriptorSet = VK_NULL_HANDLE;
+	};
+
+	VkDevice mDevice = VK_NULL_HANDLE;
+
+	DeviceMemoryAllocator* mAllocator = nullptr;
+
+	VkDescriptorPool mDescriptorPool = VK_NULL_HANDLE;
+
+	std::vector<Frame> mFrames;
+
+	uint32_t mCurrentFrame = 0;
+
+	uint32_t mMaxInstanceCount = 0;
+
+	bool mInstancing = true;
+
+	//This frame's objects as added, their sorted order, and the resulting batches
+	std::vector<DrawObject> mObjects;
+	std::vector<uint32_t> mOrder;
+	std::vector<DrawBatch> mBatches;
+
+	DrawBatcherStatistics mStatistics;
+};
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+/*
+	Frame pacing built on a single timeline semaphore (VK_KHR_timeline_semaphore).
+
+	Every submitted frame signals the semaphore with its own frame value (1, 2, 3 ...), so the counter value is exactly
+	"the last frame the GPU has completed". That replaces one VkFence per frame in flight:
+	- the CPU waits for a frame slot only if the frame that used it FramesInFlight frames ago is still running, and it can
+	  poll the counter instead of blocking;
+	- anything else (uploads, readbacks, deferred deletion) can wait on or test an exact GPU progress point;
+	- the number of frames in flight is just a number, not an array of fences.
+
+	Frame values are only consumed on submission, so a frame that gets dropped (e.g. out of date swap chain) doesn't leave
+	a hole in the sequence that would never be signaled.
+	Acquire/present still need binary semaphores: the WSI doesn't accept timeline semaphores.
+*/
+class FrameScheduler
+{
+public:
+
+	FrameScheduler() = default;
+
+	~FrameScheduler() = default;
+
+	FrameScheduler(const FrameScheduler&) = delete;
+	FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+	//VK_KHR_timeline_semaphore must be enabled on Device, together with the timelineSemaphore feature
+	void Create(VkDevice Device, uint32_t FramesInFlight)
+	{
+		mDevice = Device;
+		mFramesInFlight = std::max(1u, FramesInFlight);
+		mLastSubmittedValue = 0;
+		mCompletedValue = 0;
+
+		//The timeline entry points are not exported by the loader for 1.1 devices, so we go through the device dispatch
+		mGetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(mDevice, "vkGetSemaphoreCounterValueKHR");
+		mWaitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(mDevice, "vkWaitSemaphoresKHR");
+		if (mGetSemaphoreCounterValue == nullptr || mWaitSemaphores == nullptr)
+		{
+			throw std::runtime_error("Failed to load the timeline semaphore functions!");
+		}
+
+		VkSemaphoreTypeCreateInfoKHR TypeInfo = {};
+		TypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		TypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		TypeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo SemaphoreInfo = {};
+		SemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		SemaphoreInfo.pNext = &TypeInfo;
+
+		if (vkCreateSemaphore(mDevice, &SemaphoreInfo, nullptr, &mTimeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create the frame timeline semaphore!");
+		}
+	}
+
+	void Destroy()
+	{
+		if (mTimeline != VK_NULL_HANDLE)
+		{
+			vkDestroySemaphore(mDevice, mTimeline, nullptr);
+			mTimeline = VK_NULL_HANDLE;
+		}
+	}
+
+	//The semaphore every frame submission must signal with GetNextFrameValue()
+	VkSemaphore GetSemaphore() const
+	{
+		return mTimeline;
+	}
+
+	uint32_t GetFramesInFlight() const
+	{
+		return mFramesInFlight;
+	}
+
+	//Value the next submitted frame will signal
+	uint64_t GetNextFrameValue() const
+	{
+		return mLastSubmittedValue + 1;
+	}
+
+	//Slot (0 .. FramesInFlight - 1) of the per frame resources the next frame can use
+	uint32_t GetFrameSlot() const
+	{
+		return static_cast<uint32_t>(GetNextFrameValue() % mFramesInFlight);
+	}
+
+	uint64_t GetLastSubmittedValue() const
+	{
+		return mLastSubmittedValue;
+	}
+
+	//Last frame value the GPU has completed. Never blocks.
+	uint64_t GetCompletedValue()
+	{
+		uint64_t Value = 0;
+		if (mGetSemaphoreCounterValue(mDevice, mTimeline, &Value) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to read the frame timeline semaphore!");
+		}
+		mCompletedValue = std::max(mCompletedValue, Value);
+		return mCompletedValue;
+	}
+
+	bool IsValueCompleted(uint64_t Value)
+	{
+		return Value <= mCompletedValue || Value <= GetCompletedValue();
+	}
+
+	//Block until the GPU reaches Value or the timeout (in nanoseconds) expires. Returns false on timeout.
+	bool WaitForValue(uint64_t Value, uint64_t Timeout = UINT64_MAX)
+	{
+		if (Value <= mCompletedValue)
+		{
+			return true;
+		}
+
+		VkSemaphoreWaitInfoKHR WaitInfo = {};
+		WaitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+		WaitInfo.semaphoreCount = 1;
+		WaitInfo.pSemaphores = &mTimeline;
+		WaitInfo.pValues = &Value;
+
+		VkResult Result = mWaitSemaphores(mDevice, &WaitInfo, Timeout);
+		if (Result == VK_TIMEOUT)
+		{
+			return false;
+		}
+		if (Result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to wait on the frame timeline semaphore!");
+		}
+		mCompletedValue = std::max(mCompletedValue, Value);
+		return true;
+	}
+
+	//The frame that last used the next slot is done, so its resources can be reused right away
+	bool IsFrameSlotAvailable()
+	{
+		return IsValueCompleted(GetSlotRetireValue());
+	}
+
+	//Wait until the next frame slot is available. Returns false on timeout.
+	bool WaitForFrameSlot(uint64_t Timeout = UINT64_MAX)
+	{
+		return WaitForValue(GetSlotRetireValue(), Timeout);
+	}
+
+	//Call right after the queue submission that signals GetNextFrameValue(). Returns the value of the submitted frame.
+	uint64_t MarkSubmitted()
+	{
+		return ++mLastSubmittedValue;
+	}
+
+	//Block until every submitted frame has completed
+	void WaitIdle()
+	{
+		WaitForValue(mLastSubmittedValue);
+	}
+
+private:
+
+	//Value of the frame that used the next frame's slot
+	uint64_t GetSlotRetireValue() const
+	{
+		const uint64_t NextValue = GetNextFrameValue();
+		return NextValue > mFramesInFlight ? NextValue - mFramesInFlight : 0;
+	}
+
+	VkDevice mDevice = VK_NULL_HANDLE;
+
+	VkSemaphore mTimeline = VK_NULL_HANDLE;
+
+	uint32_t mFramesInFlight = 2;
+
+	uint64_t mLastSubmittedValue = 0;
+
+	//Cached counter value so that repeated queries don't hit the driver
+	uint64_t mCompletedValue = 0;
+
+	PFN_vkGetSemaphoreCounterValueKHR mGetSemaphoreCounterValue = nullptr;
+
+	PFN_vkWaitSemaphoresKHR mWaitSemaphores = nullptr;
+};
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../Common/RollingStatistics.h"
+
+/*
+	GPU timings out of timestamp queries.
+
+	Each frame in flight owns a range of a single timestamp query pool. Scopes write a timestamp when they begin and
+	one when they end; the results of a frame are read back when its slot comes around again, i.e. FramesInFlight frames
+	later, when the GPU is known to be done with it, so reading them never stalls.
+	Durations are converted to milliseconds with timestampPeriod and aggregated per scope name into a rolling window
+	(min/avg/max/p99). Scopes with the same name in a frame (e.g. one per recording thread) are summed up.
+
+	Usage per frame, on the frame's primary command buffer, before its render pass:
+		Profiler.BeginFrame(CommandBuffer, Slot);
+	then any number of
+		uint32_t Scope = Profiler.BeginScope(CommandBuffer, "Name");  ...  Profiler.EndScope(CommandBuffer, Scope);
+	(or the ScopedGpuTimer helper). BeginScope/EndScope can be called concurrently from several recording threads.
+	Scope names must be string literals (or otherwise outlive the profiler): they are stored as plain pointers.
+	If the queue doesn't support timestamps the profiler silently does nothing.
+*/
+class GpuProfiler
+{
+public:
+
+	static constexpr uint32_t kInvalidScope = ~0u;
+
+	GpuProfiler() = default;
+
+	~GpuProfiler() = default;
+
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	void Create(VkDevice Device, VkPhysicalDevice PhysicalDevice, uint32_t QueueFamilyIndex, uint32_t FramesInFlight, uint32_t MaxScopesPerFrame = 256, size_t HistoryLength = 512)
+	{
+		mDevice = Device;
+		mFramesInFlight = FramesInFlight;
+		mMaxScopesPerFrame = MaxScopesPerFrame;
+		mHistoryLength = HistoryLength;
+
+		VkPhysicalDeviceProperties Properties;
+		vkGetPhysicalDeviceProperties(PhysicalDevice, &Properties);
+		mTimestampPeriod = Properties.limits.timestampPeriod;
+
+		uint32_t QueueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &QueueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> QueueFamilies(QueueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice, &QueueFamilyCount, QueueFamilies.data());
+
+		const uint32_t ValidBits = QueueFamilies[QueueFamilyIndex].timestampValidBits;
+		if (ValidBits == 0 || mTimestampPeriod == 0.0f)
+		{
+			std::cout << "Timestamp queries not supported on this queue, GPU profiling disabled" << std::endl;
+			return;
+		}
+		mTimestampMask = ValidBits >= 64 ? ~0ull : ((1ull << ValidBits) - 1);
+
+		VkQueryPoolCreateInfo PoolInfo = {};
+		PoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		PoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		PoolInfo.queryCount = mFramesInFlight * mMaxScopesPerFrame * 2;
+
+		if (vkCreateQueryPool(mDevice, &PoolInfo, nullptr, &mQueryPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create timestamp query pool!");
+		}
+
+		mFrames.resize(mFramesInFlight);
+		for (auto& Frame : mFrames)
+		{
+			Frame.mScopeNames.resize(mMaxScopesPerFrame, nullptr);
+		}
+	}
+
+	void Destroy()
+	{
+		if (mQueryPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(mDevice, mQueryPool, nullptr);
+			mQueryPool = VK_NULL_HANDLE;
+		}
+		mFrames.clear();
+	}
+
+	bool IsEnabled() const
+	{
+		return mQueryPool != VK_NULL_HANDLE;
+	}
+
+	//Collect the results of the frame that last used Slot (it must have completed on the GPU) and reset its queries.
+	//Must be recorded outside of any render pass, before any scope of the frame.
+	void BeginFrame(VkCommandBuffer CommandBuffer, uint32_t Slot)
+	{
+		if (!IsEnabled())
+		{
+			return;
+		}
+
+		mCurrentSlot = Slot;
+		FrameQueries& Frame = mFrames[Slot];
+
+		const uint32_t ScopeCount = std::min(Frame.mScopeCount.load(), mMaxScopesPerFrame);
+		if (Frame.mPending && ScopeCount != 0)
+		{
+			CollectResults(Slot, ScopeCount);
+		}
+
+		vkCmdResetQueryPool(CommandBuffer, mQueryPool, GetFirstQuery(Slot), mMaxScopesPerFrame * 2);
+		Frame.mScopeCount = 0;
+		Frame.mPending = true;
+	}
+
+	//Returns the scope to pass to EndScope (kInvalidScope if the frame ran out of queries or profiling is disabled)
+	uint32_t BeginScope(VkCommandBuffer CommandBuffer, const char* Name)
+	{
+		if (!IsEnabled())
+		{
+			return kInvalidScope;
+		}
+
+		FrameQueries& Frame = mFrames[mCurrentSlot];
+		const uint32_t Scope = Frame.mScopeCount.fetch_add(1);
+		if (Scope >= mMaxScopesPerFrame)
+		{
+			return kInvalidScope;
+		}
+
+		Frame.mScopeNames[Scope] = Name;
+		vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mQueryPool, GetFirstQuery(mCurrentSlot) + Scope * 2);
+		return Scope;
+	}
+
+	void EndScope(VkCommandBuffer CommandBuffer, uint32_t Scope)
+	{
+		if (Scope == kInvalidScope)
+		{
+			return;
+		}
+		vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mQueryPool, GetFirstQuery(mCurrentSlot) + Scope * 2 + 1);
+	}
+
+	//Rolling statistics of a scope in milliseconds (all zeros if the scope is unknown)
+	RollingSummary GetScopeSummary(const std::string& Name) const
+	{
+		auto It = mScopes.find(Name);
+		return It != mScopes.end() ? It->second.GetSummary() : RollingSummary();
+	}
+
+	std::map<std::string, RollingSummary> GetAllSummaries() const
+	{
+		std::map<std::string, RollingSummary> Summaries;
+		for (const auto& Scope : mScopes)
+		{
+			Summaries.emplace(Scope.first, Scope.second.GetSummary());
+		}
+		return Summaries;
+	}
+
+	void Print(std::ostream& Stream) const
+	{
+		Stream << std::fixed << std::setprecision(3);
+		for (const auto& Scope : GetAllSummaries())
+		{
+			const RollingSummary& Summary = Scope.second;
+			Stream << "GPU " << Scope.first << ": avg " << Summary.mAverage << " ms, min " << Summary.mMin << " ms, max " << Summary.mMax
+				<< " ms, p99 " << Summary.mP99 << " ms (" << Summary.mSampleCount << " frames)" << std::endl;
+		}
+		Stream << std::defaultfloat;
+	}
+
+	//Dump every scope summary as JSON, e.g. to track GPU regressions per pass on CI
+	bool WriteJson(const std::string& FilePath) const
+	{
+		std::ofstream File(FilePath, std::ios::trunc);
+		if (!File.is_open())
+		{
+			std::cerr << "Failed to open " << FilePath << " for writing" << std::endl;
+			return false;
+		}
+
+		File << std::setprecision(6);
+		File << "{\n  \"timestampPeriodNs\": " << mTimestampPeriod << ",\n  \"scopes\": [";
+		bool First = true;
+		for (const auto& Scope : GetAllSummaries())
+		{
+			const RollingSummary& Summary = Scope.second;
+			File << (First ? "\n" : ",\n") << "    { \"name\": \"" << Scope.first << "\", \"samples\": " << Summary.mSampleCount
+				<< ", \"lastMs\": " << Summary.mLast << ", \"minMs\": " << Summary.mMin << ", \"avgMs\": " << Summary.mAverage
+				<< ", \"maxMs\": " << Summary.mMax << ", \"p99Ms\": " << Summary.mP99 << " }";
+			First = false;
+		}
+		File << "\n  ]\n}\n";
+		return File.good();
+	}
+
+private:
+
+	struct FrameQueries
+	{
+		//Scopes begun this frame (can go past mMaxScopesPerFrame, the extra ones are ignored)
+		std::atomic<uint32_t> mScopeCount{ 0 };
+
+		std::vector<const char*> mScopeNames;
+
+		//Queries have been written and not collected yet
+		bool mPending = false;
+
+		FrameQueries() = default;
+
+		FrameQueries(FrameQueries&& Other) noexcept
+			: mScopeCount(Other.mScopeCount.load()), mScopeNames(std::move(Other.mScopeNames)), mPending(Other.mPending)
+		{
+		}
+	};
+
+	uint32_t GetFirstQuery(uint32_t Slot) const
+	{
+		return Slot * mMaxScopesPerFrame * 2;
+	}
+
+	void CollectResults(uint32_t Slot, uint32_t ScopeCount)
+	{
+		//Value + availability for every query, so a query that somehow isn't ready is skipped instead of stalling
+		std::vector<uint64_t> Results(ScopeCount * 2 * 2);
+		vkGetQueryPoolResults(mDevice, mQueryPool, GetFirstQuery(Slot), ScopeCount * 2, Results.size() * sizeof(uint64_t), Results.data(),
+			2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+		const FrameQueries& Frame = mFrames[Slot];
+
+		//Sum the scopes sharing a name
+		std::map<std::string, double> FrameTimes;
+		for (uint32_t Scope = 0; Scope < ScopeCount; ++Scope)
+		{
+			const uint64_t* Begin = &Results[Scope * 4];
+			const uint64_t* End = &Results[Scope * 4 + 2];
+			if (Begin[1] == 0 || End[1] == 0 || Frame.mScopeNames[Scope] == nullptr)
+			{
+				continue;
+			}
+
+			const uint64_t Ticks = (End[0] - Begin[0]) & mTimestampMask;
+			FrameTimes[Frame.mScopeNames[Scope]] += Ticks * static_cast<double>(mTimestampPeriod) / 1000000.0;
+		}
+
+		for (const auto& FrameTime : FrameTimes)
+		{
+			auto It = mScopes.find(FrameTime.first);
+			if (It == mScopes.end())
+			{
+				It = mScopes.emplace(FrameTime.first, RollingStatistics(mHistoryLength)).first;
+			}
+			It->second.Add(FrameTime.second);
+		}
+	}
+
+	VkDevice mDevice = VK_NULL_HANDLE;
+
+	VkQueryPool mQueryPool = VK_NULL_HANDLE;
+
+	//Nanoseconds per timestamp tick
+	float mTimestampPeriod = 0.0f;
+
+	//Timestamps only have timestampValidBits significant bits, differences must wrap around accordingly
+	uint64_t mTimestampMask = ~0ull;
+
+	uint32_t mFramesInFlight = 0;
+
+	uint32_t mMaxScopesPerFrame = 0;
+
+	size_t mHistoryLength = 0;
+
+	uint32_t mCurrentSlot = 0;
+
+	std::vector<FrameQueries> mFrames;
+
+	//Rolling window of every scope, in milliseconds
+	std::map<std::string, RollingStatistics> mScopes;
+};
+
+//Begin/end a GPU scope for the lifetime of the object
+class ScopedGpuTimer
+{
+public:
+
+	ScopedGpuTimer(GpuProfiler& Profiler, VkCommandBuffer CommandBuffer, const char* Name)
+		: mProfiler(Profiler), mCommandBuffer(CommandBuffer), mScope(Profiler.BeginScope(CommandBuffer, Name))
+	{
+	}
+
+	~ScopedGpuTimer()
+	{
+		mProfiler.EndScope(mCommandBuffer, mScope);
+	}
+
+	ScopedGpuTimer(const ScopedGpuTimer&) = delete;
+	ScopedGpuTimer& operator=(const ScopedGpuTimer&) = delete;
+
+private:
+
+	GpuProfiler& mProfiler;
+
+	VkCommandBuffer mCommandBuffer;
+
+	uint32_t mScope;
+};
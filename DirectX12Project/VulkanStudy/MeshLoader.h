@@ -0,0 +1,169 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "../Common/MappedFile.h"
+#include "../Common/MeshFile.h"
+#include "BufferStreamer.h"
+#include "DeviceMemoryAllocator.h"
+
+//A mesh file in device local memory: all its chunks in one buffer, at the same relative offsets as in the file
+struct GpuMesh
+{
+	VkBuffer mBuffer = VK_NULL_HANDLE;
+	DeviceAllocation mAllocation;
+
+	//Offsets of the vertex streams in mBuffer (a texcoord offset of VK_WHOLE_SIZE means the mesh has none)
+	VkDeviceSize mPositionOffset = 0;
+	VkDeviceSize mNormalOffset = 0;
+	VkDeviceSize mTexCoordOffset = VK_WHOLE_SIZE;
+
+	VkDeviceSize mIndexOffset = 0;
+	VkIndexType mIndexType = VK_INDEX_TYPE_UINT16;
+	uint32_t mIndexCount = 0;
+
+	uint32_t mVertexCount = 0;
+
+	//Dequantization of the positions (see MeshFileHeader)
+	float mCenter[3] = {};
+	float mHalfExtent[3] = {};
+};
+
+struct MeshLoaderStatistics
+{
+	uint32_t mMeshCount = 0;
+
+	//Chunk bytes handed to the streamer
+	uint64_t mUploadedBytes = 0;
+};
+
+/*
+	Loads mesh files (MeshFile.h) straight from their memory mapping into device local buffers: the header and chunk
+	table are validated, then every chunk is copied from the mapped pages into the streamer's staging ring and on to
+	the GPU, with no parsing or conversion on the way.
+
+	Meshes are usable once the graphics queue has acquired the streamer's uploads (BufferStreamer::AcquireOnGraphicsQueue).
+*/
+class MeshLoader
+{
+public:
+
+	MeshLoader() = default;
+
+	MeshLoader(const MeshLoader&) = delete;
+	MeshLoader& operator=(const MeshLoader&) = delete;
+
+	void Create(VkDevice Device, DeviceMemoryAllocator& Allocator, BufferStreamer& Streamer)
+	{
+		mDevice = Device;
+		mAllocator = &Allocator;
+		mStreamer = &Streamer;
+	}
+
+	GpuMesh Load(const std::string& FileName)
+	{
+		//The mapping only has to outlive the copies into the staging ring, which happen right away
+		MappedFile File(FileName);
+		return Upload(MeshFileView(File.Data(), File.Size()));
+	}
+
+	GpuMesh Upload(const MeshFileView& View)
+	{
+		const MeshFileHeader& Header = View.GetHeader();
+
+		//The buffer mirrors the file from its first chunk on
+		uint64_t DataBegin = Header.mFileSize;
+		for (uint32_t i = 0; i < View.GetChunkCount(); ++i)
+		{
+			DataBegin = std::min(DataBegin, View.GetChunk(i).mOffset);
+		}
+
+		GpuMesh Mesh;
+		Mesh.mVertexCount = Header.mVertexCount;
+		Mesh.mIndexCount = Header.mIndexCount;
+		for (uint32_t Axis = 0; Axis < 3; ++Axis)
+		{
+			Mesh.mCenter[Axis] = Header.mCenter[Axis];
+			Mesh.mHalfExtent[Axis] = Header.mHalfExtent[Axis];
+		}
+
+		VkBufferCreateInfo BufferInfo = {};
+		BufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		BufferInfo.size = Header.mFileSize - DataBegin;
+		BufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		BufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vkCreateBuffer(mDevice, &BufferInfo, nullptr, &Mesh.mBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a mesh buffer!");
+		}
+		Mesh.mAllocation = mAllocator->AllocateForBuffer(Mesh.mBuffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		for (uint32_t i = 0; i < View.GetChunkCount(); ++i)
+		{
+			const MeshChunk& Chunk = View.GetChunk(i);
+			const VkDeviceSize Offset = Chunk.mOffset - DataBegin;
+
+			VkAccessFlags Access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+			switch (Chunk.mType)
+			{
+			case MeshChunkType::Positions:
+				Mesh.mPositionOffset = Offset;
+				break;
+			case MeshChunkType::Normals:
+				Mesh.mNormalOffset = Offset;
+				break;
+			case MeshChunkType::TexCoords:
+				Mesh.mTexCoordOffset = Offset;
+				break;
+			case MeshChunkType::Indices:
+				Mesh.mIndexOffset = Offset;
+				Mesh.mIndexType = static_cast<MeshIndexFormat>(Chunk.mFormat) == MeshIndexFormat::UInt32 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+				Access = VK_ACCESS_INDEX_READ_BIT;
+				break;
+			default:
+				//Unknown chunks are skipped, so newer files with extra data still load
+				continue;
+			}
+
+			mStreamer->UploadBuffer(Mesh.mBuffer, Offset, View.GetChunkData(Chunk), Chunk.mSize, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, Access);
+			mStatistics.mUploadedBytes += Chunk.mSize;
+		}
+
+		++mStatistics.mMeshCount;
+		return Mesh;
+	}
+
+	//The GPU must be done with the mesh, the transfer queue included
+	void Destroy(GpuMesh& Mesh)
+	{
+		if (Mesh.mBuffer == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		mStreamer->DiscardPendingAcquires(Mesh.mBuffer);
+		vkDestroyBuffer(mDevice, Mesh.mBuffer, nullptr);
+		mAllocator->Free(Mesh.mAllocation);
+		Mesh = GpuMesh();
+	}
+
+	const MeshLoaderStatistics& GetStatistics() const
+	{
+		return mStatistics;
+	}
+
+private:
+
+	VkDevice mDevice = VK_NULL_HANDLE;
+
+	DeviceMemoryAllocator* mAllocator = nullptr;
+
+	BufferStreamer* mStreamer = nullptr;
+
+	MeshLoaderStatistics mStatistics;
+};
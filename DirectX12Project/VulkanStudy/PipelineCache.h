@@ -0,0 +1,298 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../Common/Hash.h"
+
+/*
+	Persistent VkPipelineCache.
+
+	The blob returned by vkGetPipelineCacheData is only valid for the exact same GPU and driver, and drivers are not always
+	good at rejecting foreign blobs (some of them crash instead). So we wrap it in our own header that records the vendor,
+	device, driver version and pipeline cache UUID, plus a hash of the payload to catch truncated or corrupted files.
+	Anything that doesn't match is simply discarded and we start from an empty cache.
+
+	Threads that build pipelines concurrently get their own cache through CreateWorkerCache() (so they never contend on the
+	main one) and those are folded back into the main cache with vkMergePipelineCaches before saving.
+	The file is written to a temporary file first and then renamed over the old one, so a crash while saving never leaves
+	a half written cache behind.
+*/
+class PipelineCache
+{
+public:
+
+	PipelineCache() = default;
+
+	~PipelineCache() = default;
+
+	PipelineCache(const PipelineCache&) = delete;
+	PipelineCache& operator=(const PipelineCache&) = delete;
+
+	//Load the cache blob (if any) and create the main VkPipelineCache out of it
+	void Create(VkDevice Device, VkPhysicalDevice PhysicalDevice, const std::string& FilePath)
+	{
+		mDevice = Device;
+		mFilePath = FilePath;
+		vkGetPhysicalDeviceProperties(PhysicalDevice, &mDeviceProperties);
+
+		std::vector<char> InitialData = LoadFromDisk();
+
+		VkPipelineCacheCreateInfo CreateInfo = {};
+		CreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		CreateInfo.initialDataSize = InitialData.size();
+		CreateInfo.pInitialData = InitialData.empty() ? nullptr : InitialData.data();
+
+		if (vkCreatePipelineCache(mDevice, &CreateInfo, nullptr, &mPipelineCache) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline cache!");
+		}
+	}
+
+	//The cache every pipeline created on the main thread should go through
+	VkPipelineCache Get() const
+	{
+		return mPipelineCache;
+	}
+
+	//Create a cache for a worker thread. It starts as a copy of the main one, so that pipelines loaded from disk are still
+	//hits on the worker, and it will be merged back into the main one by MergeWorkerCaches() and destroyed.
+	VkPipelineCache CreateWorkerCache()
+	{
+		//Pipeline caches are internally synchronized, reading the main one from any thread is fine
+		std::vector<char> InitialData;
+		size_t DataSize = 0;
+		if (vkGetPipelineCacheData(mDevice, mPipelineCache, &DataSize, nullptr) == VK_SUCCESS && DataSize != 0)
+		{
+			InitialData.resize(DataSize);
+			if (vkGetPipelineCacheData(mDevice, mPipelineCache, &DataSize, InitialData.data()) != VK_SUCCESS)
+			{
+				DataSize = 0;
+			}
+			InitialData.resize(DataSize);
+		}
+
+		VkPipelineCacheCreateInfo CreateInfo = {};
+		CreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		CreateInfo.initialDataSize = InitialData.size();
+		CreateInfo.pInitialData = InitialData.empty() ? nullptr : InitialData.data();
+
+		VkPipelineCache WorkerCache = VK_NULL_HANDLE;
+		if (vkCreatePipelineCache(mDevice, &CreateInfo, nullptr, &WorkerCache) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create worker pipeline cache!");
+		}
+
+		std::lock_guard<std::mutex> Lock(mWorkerCachesMutex);
+		mWorkerCaches.push_back(WorkerCache);
+		return WorkerCache;
+	}
+
+	//Fold every worker cache into the main one. Worker threads must be done using their caches at this point.
+	void MergeWorkerCaches()
+	{
+		std::lock_guard<std::mutex> Lock(mWorkerCachesMutex);
+		if (mWorkerCaches.empty())
+		{
+			return;
+		}
+
+		if (vkMergePipelineCaches(mDevice, mPipelineCache, static_cast<uint32_t>(mWorkerCaches.size()), mWorkerCaches.data()) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to merge pipeline caches!");
+		}
+
+		for (auto WorkerCache : mWorkerCaches)
+		{
+			vkDestroyPipelineCache(mDevice, WorkerCache, nullptr);
+		}
+		mWorkerCaches.clear();
+	}
+
+	//Write the cache back to disk (temporary file + rename so that the update is atomic)
+	void Save()
+	{
+		MergeWorkerCaches();
+
+		size_t DataSize = 0;
+		if (vkGetPipelineCacheData(mDevice, mPipelineCache, &DataSize, nullptr) != VK_SUCCESS || DataSize == 0)
+		{
+			return;
+		}
+
+		std::vector<char> Data(DataSize);
+		if (vkGetPipelineCacheData(mDevice, mPipelineCache, &DataSize, Data.data()) != VK_SUCCESS)
+		{
+			std::cerr << "Failed to retrieve pipeline cache data, the cache won't be saved" << std::endl;
+			return;
+		}
+		Data.resize(DataSize);
+
+		FileHeader Header = MakeHeader();
+		Header.mDataSize = DataSize;
+		Header.mDataHash = HashBytes(Data.data(), Data.size());
+
+		const std::string TempPath = mFilePath + ".tmp";
+		{
+			std::ofstream File(TempPath, std::ios::binary | std::ios::trunc);
+			if (!File.is_open())
+			{
+				std::cerr << "Failed to open " << TempPath << " for writing, the pipeline cache won't be saved" << std::endl;
+				return;
+			}
+			File.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+			File.write(Data.data(), Data.size());
+			if (!File.good())
+			{
+				std::cerr << "Failed to write " << TempPath << ", the pipeline cache won't be saved" << std::endl;
+				return;
+			}
+		}
+
+		//std::filesystem::rename replaces the destination on every platform (plain std::rename fails on Windows if it exists)
+		std::error_code Error;
+		std::filesystem::rename(TempPath, mFilePath, Error);
+		if (Error)
+		{
+			std::cerr << "Failed to replace " << mFilePath << ": " << Error.message() << std::endl;
+			std::filesystem::remove(TempPath, Error);
+		}
+	}
+
+	void Destroy()
+	{
+		{
+			std::lock_guard<std::mutex> Lock(mWorkerCachesMutex);
+			for (auto WorkerCache : mWorkerCaches)
+			{
+				vkDestroyPipelineCache(mDevice, WorkerCache, nullptr);
+			}
+			mWorkerCaches.clear();
+		}
+
+		if (mPipelineCache != VK_NULL_HANDLE)
+		{
+			vkDestroyPipelineCache(mDevice, mPipelineCache, nullptr);
+			mPipelineCache = VK_NULL_HANDLE;
+		}
+	}
+
+private:
+
+	static constexpr uint32_t kMagic = 0x43504B56; // 'VKPC'
+	static constexpr uint32_t kFileVersion = 1;
+
+	//Our own header, stored in front of the driver blob
+	struct FileHeader
+	{
+		uint32_t mMagic;
+		uint32_t mFileVersion;
+		uint32_t mVendorID;
+		uint32_t mDeviceID;
+		uint32_t mDriverVersion;
+		uint8_t  mPipelineCacheUUID[VK_UUID_SIZE];
+		uint32_t mPadding;
+		uint64_t mDataSize;
+		uint64_t mDataHash;
+	};
+
+	FileHeader MakeHeader() const
+	{
+		FileHeader Header = {};
+		Header.mMagic = kMagic;
+		Header.mFileVersion = kFileVersion;
+		Header.mVendorID = mDeviceProperties.vendorID;
+		Header.mDeviceID = mDeviceProperties.deviceID;
+		Header.mDriverVersion = mDeviceProperties.driverVersion;
+		memcpy(Header.mPipelineCacheUUID, mDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+		return Header;
+	}
+
+	//Returns the driver blob if the file exists and was produced by this very device/driver, an empty vector otherwise
+	std::vector<char> LoadFromDisk() const
+	{
+		std::ifstream File(mFilePath, std::ios::ate | std::ios::binary);
+		if (!File.is_open())
+		{
+			std::cout << "No pipeline cache found at " << mFilePath << ", starting from an empty one" << std::endl;
+			return {};
+		}
+
+		size_t FileSize = (size_t)File.tellg();
+		File.seekg(0);
+
+		FileHeader Header = {};
+		if (FileSize < sizeof(Header) || !File.read(reinterpret_cast<char*>(&Header), sizeof(Header)))
+		{
+			std::cout << "Pipeline cache " << mFilePath << " is truncated, discarding it" << std::endl;
+			return {};
+		}
+
+		FileHeader Expected = MakeHeader();
+		if (Header.mMagic != Expected.mMagic || Header.mFileVersion != Expected.mFileVersion)
+		{
+			std::cout << "Pipeline cache " << mFilePath << " has an unknown format, discarding it" << std::endl;
+			return {};
+		}
+
+		if (Header.mVendorID != Expected.mVendorID || Header.mDeviceID != Expected.mDeviceID ||
+			Header.mDriverVersion != Expected.mDriverVersion ||
+			memcmp(Header.mPipelineCacheUUID, Expected.mPipelineCacheUUID, VK_UUID_SIZE) != 0)
+		{
+			std::cout << "Pipeline cache " << mFilePath << " was created by a different device or driver, discarding it" << std::endl;
+			return {};
+		}
+
+		if (Header.mDataSize != FileSize - sizeof(Header))
+		{
+			std::cout << "Pipeline cache " << mFilePath << " is truncated, discarding it" << std::endl;
+			return {};
+		}
+
+		std::vector<char> Data(static_cast<size_t>(Header.mDataSize));
+		if (!File.read(Data.data(), Data.size()) || HashBytes(Data.data(), Data.size()) != Header.mDataHash)
+		{
+			std::cout << "Pipeline cache " << mFilePath << " is corrupted, discarding it" << std::endl;
+			return {};
+		}
+
+		//Double check the header the driver itself put in front of its data
+		VkPipelineCacheHeaderVersionOne DriverHeader = {};
+		if (Data.size() < sizeof(DriverHeader))
+		{
+			return {};
+		}
+		memcpy(&DriverHeader, Data.data(), sizeof(DriverHeader));
+		if (DriverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+			DriverHeader.vendorID != Expected.mVendorID || DriverHeader.deviceID != Expected.mDeviceID ||
+			memcmp(DriverHeader.pipelineCacheUUID, Expected.mPipelineCacheUUID, VK_UUID_SIZE) != 0)
+		{
+			std::cout << "Pipeline cache " << mFilePath << " has a mismatching driver header, discarding it" << std::endl;
+			return {};
+		}
+
+		std::cout << "Loaded pipeline cache " << mFilePath << " (" << Data.size() << " bytes)" << std::endl;
+		return Data;
+	}
+
+	VkDevice mDevice = VK_NULL_HANDLE;
+
+	VkPhysicalDeviceProperties mDeviceProperties = {};
+
+	std::string mFilePath;
+
+	//Main cache
+	VkPipelineCache mPipelineCache = VK_NULL_HANDLE;
+
+	//Per worker thread caches waiting to be merged into the main one
+	std::vector<VkPipelineCache> mWorkerCaches;
+	std::mutex mWorkerCachesMutex;
+};
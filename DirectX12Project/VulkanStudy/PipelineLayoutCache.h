@@ -0,0 +1,234 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../Common/Hash.h"
+#include "SpirvReflection.h"
+
+//Everything a pipeline layout is made of, merged from the reflection of every stage of a pipeline
+struct PipelineLayoutDesc
+{
+	//Bindings of every set, sorted by binding
+	std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> mSets;
+
+	//One range covering the push constants of every stage (size 0 if there are none)
+	VkPushConstantRange mPushConstants = {};
+
+	//Add the resources of one more stage. A binding used by several stages is shared, so it must agree on type and count.
+	void Merge(const SpirvModule& Module)
+	{
+		for (const auto& Binding : Module.GetDescriptorBindings())
+		{
+			auto& Bindings = mSets[Binding.mSet];
+			auto It = Bindings.begin();
+			while (It != Bindings.end() && It->binding < Binding.mBinding.binding)
+			{
+				++It;
+			}
+
+			if (It == Bindings.end() || It->binding != Binding.mBinding.binding)
+			{
+				Bindings.insert(It, Binding.mBinding);
+			}
+			else if (It->descriptorType != Binding.mBinding.descriptorType || It->descriptorCount != Binding.mBinding.descriptorCount)
+			{
+				throw std::runtime_error("Shader stages disagree on set " + std::to_string(Binding.mSet) + " binding " + std::to_string(Binding.mBinding.binding) + "!");
+			}
+			else
+			{
+				It->stageFlags |= Binding.mBinding.stageFlags;
+			}
+		}
+
+		//Stages can't appear in two ranges, so they all share one that spans every stage's block
+		const VkPushConstantRange& Range = Module.GetPushConstantRange();
+		if (Range.size != 0)
+		{
+			if (mPushConstants.size == 0)
+			{
+				mPushConstants = Range;
+			}
+			else
+			{
+				const uint32_t Begin = std::min(mPushConstants.offset, Range.offset);
+				const uint32_t End = std::max(mPushConstants.offset + mPushConstants.size, Range.offset + Range.size);
+				mPushConstants.stageFlags |= Range.stageFlags;
+				mPushConstants.offset = Begin;
+				mPushConstants.size = End - Begin;
+			}
+		}
+	}
+};
+
+struct PipelineLayoutCacheStatistics
+{
+	uint32_t mSetLayoutCount = 0;
+	uint32_t mPipelineLayoutCount = 0;
+
+	//Requests served by a layout that existed already
+	uint32_t mHitCount = 0;
+};
+
+/*
+	Owns every descriptor set layout and pipeline layout, keyed by a hash of what they contain.
+
+	Shaders that declare the same resources end up with the very same VkDescriptorSetLayout and VkPipelineLayout handles:
+	descriptor sets stay compatible across pipelines (binding a new pipeline doesn't disturb the sets already bound) and
+	pools only need to deal with a few distinct layouts. Set numbers with no binding get an empty set layout since
+	pipeline layouts can't have holes.
+
+	Layouts live until Destroy(), so callers never destroy what they get. Thread safe.
+*/
+class PipelineLayoutCache
+{
+public:
+
+	PipelineLayoutCache() = default;
+
+	~PipelineLayoutCache() = default;
+
+	PipelineLayoutCache(const PipelineLayoutCache&) = delete;
+	PipelineLayoutCache& operator=(const PipelineLayoutCache&) = delete;
+
+	void Create(VkDevice Device)
+	{
+		mDevice = Device;
+	}
+
+	void Destroy()
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		for (const auto& Entry : mPipelineLayouts)
+		{
+			vkDestroyPipelineLayout(mDevice, Entry.second, nullptr);
+		}
+		for (const auto& Entry : mSetLayouts)
+		{
+			vkDestroyDescriptorSetLayout(mDevice, Entry.second, nullptr);
+		}
+		mPipelineLayouts.clear();
+		mSetLayouts.clear();
+		mStatistics = PipelineLayoutCacheStatistics();
+	}
+
+	//Bindings sorted by binding number, as in PipelineLayoutDesc
+	VkDescriptorSetLayout GetSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& Bindings)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		return GetSetLayoutLocked(Bindings);
+	}
+
+	VkPipelineLayout GetPipelineLayout(const PipelineLayoutDesc& Desc)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+
+		std::vector<VkDescriptorSetLayout> SetLayouts;
+		const uint32_t SetCount = Desc.mSets.empty() ? 0 : Desc.mSets.rbegin()->first + 1;
+		for (uint32_t Set = 0; Set < SetCount; ++Set)
+		{
+			auto It = Desc.mSets.find(Set);
+			SetLayouts.push_back(GetSetLayoutLocked(It != Desc.mSets.end() ? It->second : std::vector<VkDescriptorSetLayoutBinding>()));
+		}
+
+		//Set layouts are deduplicated already, so their handles identify them
+		uint64_t Hash = HashValue(SetCount);
+		for (auto SetLayout : SetLayouts)
+		{
+			Hash = HashValue(SetLayout, Hash);
+		}
+		Hash = HashCombine(Hash, HashRange(Desc.mPushConstants));
+
+		auto It = mPipelineLayouts.find(Hash);
+		if (It != mPipelineLayouts.end())
+		{
+			++mStatistics.mHitCount;
+			return It->second;
+		}
+
+		VkPipelineLayoutCreateInfo LayoutInfo = {};
+		LayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		LayoutInfo.setLayoutCount = SetCount;
+		LayoutInfo.pSetLayouts = SetLayouts.empty() ? nullptr : SetLayouts.data();
+		LayoutInfo.pushConstantRangeCount = Desc.mPushConstants.size != 0 ? 1 : 0;
+		LayoutInfo.pPushConstantRanges = Desc.mPushConstants.size != 0 ? &Desc.mPushConstants : nullptr;
+
+		VkPipelineLayout Layout = VK_NULL_HANDLE;
+		if (vkCreatePipelineLayout(mDevice, &LayoutInfo, nullptr, &Layout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline layout!");
+		}
+
+		mPipelineLayouts.emplace(Hash, Layout);
+		++mStatistics.mPipelineLayoutCount;
+		return Layout;
+	}
+
+	PipelineLayoutCacheStatistics GetStatistics()
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		return mStatistics;
+	}
+
+private:
+
+	VkDescriptorSetLayout GetSetLayoutLocked(const std::vector<VkDescriptorSetLayoutBinding>& Bindings)
+	{
+		//Field by field: the struct has padding and a pointer in it
+		uint64_t Hash = HashValue(static_cast<uint64_t>(Bindings.size()));
+		for (const auto& Binding : Bindings)
+		{
+			Hash = HashValue(Binding.binding, Hash);
+			Hash = HashValue(Binding.descriptorType, Hash);
+			Hash = HashValue(Binding.descriptorCount, Hash);
+			Hash = HashValue(Binding.stageFlags, Hash);
+		}
+
+		auto It = mSetLayouts.find(Hash);
+		if (It != mSetLayouts.end())
+		{
+			++mStatistics.mHitCount;
+			return It->second;
+		}
+
+		VkDescriptorSetLayoutCreateInfo LayoutInfo = {};
+		LayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		LayoutInfo.bindingCount = static_cast<uint32_t>(Bindings.size());
+		LayoutInfo.pBindings = Bindings.empty() ? nullptr : Bindings.data();
+
+		VkDescriptorSetLayout SetLayout = VK_NULL_HANDLE;
+		if (vkCreateDescriptorSetLayout(mDevice, &LayoutInfo, nullptr, &SetLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create descriptor set layout!");
+		}
+
+		mSetLayouts.emplace(Hash, SetLayout);
+		++mStatistics.mSetLayoutCount;
+		return SetLayout;
+	}
+
+	static uint64_t HashRange(const VkPushConstantRange& Range)
+	{
+		uint64_t Hash = HashValue(Range.stageFlags);
+		Hash = HashValue(Range.offset, Hash);
+		return HashValue(Range.size, Hash);
+	}
+
+	VkDevice mDevice = VK_NULL_HANDLE;
+
+	std::unordered_map<uint64_t, VkDescriptorSetLayout> mSetLayouts;
+
+	std::unordered_map<uint64_t, VkPipelineLayout> mPipelineLayouts;
+
+	PipelineLayoutCacheStatistics mStatistics;
+
+	std::mutex mMutex;
+};
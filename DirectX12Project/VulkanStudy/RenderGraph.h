@@ -0,0 +1,1123 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+#include "DeviceMemoryAllocator.h"
+#include "GpuProfiler.h"
+
+using RenderGraphResource = uint32_t;
+
+static constexpr RenderGraphResource kInvalidRenderGraphResource = ~0u;
+
+struct RenderGraphImageDesc
+{
+	VkFormat mFormat = VK_FORMAT_UNDEFINED;
+
+	VkExtent2D mExtent = { 0, 0 };
+
+	VkSampleCountFlagBits mSamples = VK_SAMPLE_COUNT_1_BIT;
+};
+
+class RenderGraph;
+
+//What a pass gets to record its commands
+struct RenderGraphPassContext
+{
+	VkCommandBuffer mCommandBuffer = VK_NULL_HANDLE;
+
+	//Graphics passes only (the render pass has already begun), VK_NULL_HANDLE for the others
+	VkRenderPass mRenderPass = VK_NULL_HANDLE;
+	VkFramebuffer mFramebuffer = VK_NULL_HANDLE;
+
+	//Size of the attachments of a graphics pass
+	VkExtent2D mExtent = { 0, 0 };
+
+	const RenderGraph* mGraph = nullptr;
+};
+
+struct RenderGraphStatistics
+{
+	uint32_t mPassCount = 0;
+
+	//Passes whose results nobody uses
+	uint32_t mCulledPassCount = 0;
+
+	//vkCmdPipelineBarrier calls per execution, and the image barriers in them
+	uint32_t mBarrierBatchCount = 0;
+	uint32_t mImageBarrierCount = 0;
+
+	uint32_t mTransientImageCount = 0;
+
+	//Memory backing the transient images, and what they would take without aliasing
+	VkDeviceSize mTransientMemorySize = 0;
+	VkDeviceSize mUnaliasedTransientMemorySize = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& Stream, const RenderGraphStatistics& Stats)
+{
+	const double KB = 1024.0;
+	Stream << Stats.mPassCount - Stats.mCulledPassCount << "/" << Stats.mPassCount << " passes (" << Stats.mCulledPassCount << " culled), "
+		<< Stats.mBarrierBatchCount << " barrier batches (" << Stats.mImageBarrierCount << " image barriers), "
+		<< Stats.mTransientImageCount << " transient images in " << Stats.mTransientMemorySize / KB << " KB ("
+		<< Stats.mUnaliasedTransientMemorySize / KB << " KB without aliasing)";
+	return Stream;
+}
+
+//Declares what a pass reads and writes. Returned by RenderGraph::AddPass, only valid until the graph gets compiled.
+class RenderGraphPassBuilder
+{
+public:
+
+	RenderGraphPassBuilder(RenderGraph& Graph, uint32_t PassIndex)
+		: mGraph(Graph), mPassIndex(PassIndex)
+	{
+	}
+
+	//Render into Resource as color attachment. LOAD keeps the previous content, CLEAR and DONT_CARE discard it.
+	RenderGraphPassBuilder& WriteColor(RenderGraphResource Resource, VkAttachmentLoadOp LoadOp, VkClearColorValue ClearColor = {});
+
+	RenderGraphPassBuilder& WriteDepth(RenderGraphResource Resource, VkAttachmentLoadOp LoadOp, VkClearDepthStencilValue ClearDepth = { 1.0f, 0 });
+
+	//Sample Resource from shaders
+	RenderGraphPassBuilder& ReadTexture(RenderGraphResource Resource, VkPipelineStageFlags Stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+	//Storage image access (GENERAL layout)
+	RenderGraphPassBuilder& ReadStorage(RenderGraphResource Resource, VkPipelineStageFlags Stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	RenderGraphPassBuilder& WriteStorage(RenderGraphResource Resource, VkPipelineStageFlags Stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	//Copy/blit/resolve source and destination. A destination that gets entirely overwritten should pass PreserveContent = false.
+	RenderGraphPassBuilder& ReadTransfer(RenderGraphResource Resource);
+	RenderGraphPassBuilder& WriteTransfer(RenderGraphResource Resource, bool PreserveContent = true);
+
+	//The pass does something nobody declares reading (readback, debug output ...): never cull it
+	RenderGraphPassBuilder& SetSideEffects();
+
+	//The render pass content is recorded into secondary command buffers (VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS)
+	RenderGraphPassBuilder& SetSecondaryCommandBuffers();
+
+	RenderGraphPassBuilder& SetExecute(std::function<void(const RenderGraphPassContext&)> Execute);
+
+private:
+
+	RenderGraph& mGraph;
+
+	uint32_t mPassIndex;
+};
+
+/*
+	Frame graph: passes declare the images they read and write, and the graph works out everything in between.
+
+	Compile() walks the declarations once:
+	- culls the passes whose output nobody reads (imported images, e.g. the back buffer, are what the frame produces);
+	- creates the transient images with the usage flags they are actually used with, and packs the ones whose lifetimes
+	  don't overlap at the same offsets of a shared memory range (aliasing);
+	- simulates the layout and access state of every image across the passes and derives the barriers: each pass gets a
+	  single vkCmdPipelineBarrier with all its transitions, skipped entirely when nothing needs synchronizing
+	  (e.g. read after read in the same layout), plus one final batch that puts imported images into their final layout;
+	- creates one render pass per graphics pass. Layout transitions all happen in the barriers, so the render passes have
+	  initialLayout == finalLayout, and transient attachments nobody reads afterwards are not even stored.
+	Execute() then only records: barriers, begin render pass, the pass callback, end render pass.
+
+	Typical use: declare and compile once, then every frame SetImportedImage() for the images that change (the acquired
+	swap chain image) and Execute(). Anything that changes the declarations (e.g. a resize) means building a new graph.
+	Pass names must be string literals (or otherwise outlive the graph): they are handed to the GPU profiler as is.
+*/
+class RenderGraph
+{
+public:
+
+	RenderGraph() = default;
+
+	~RenderGraph() = default;
+
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	//An image owned by someone else. Its content matters after the frame, so whoever writes it is never culled.
+	//InitialStages is where the external synchronization happens (e.g. the stage the acquire semaphore is waited at),
+	//FinalStages/FinalAccess where the next user of the image will access it in FinalLayout.
+	RenderGraphResource ImportImage(const char* Name, const RenderGraphImageDesc& Desc, VkImageLayout InitialLayout, VkPipelineStageFlags InitialStages,
+		VkImageLayout FinalLayout, VkPipelineStageFlags FinalStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VkAccessFlags FinalAccess = 0)
+	{
+		Resource NewResource;
+		NewResource.mName = Name;
+		NewResource.mDesc = Desc;
+		NewResource.mImported = true;
+		NewResource.mInitialLayout = InitialLayout;
+		NewResource.mInitialStages = InitialStages;
+		NewResource.mFinalLayout = FinalLayout;
+		NewResource.mFinalStages = FinalStages;
+		NewResource.mFinalAccess = FinalAccess;
+		mResources.push_back(NewResource);
+		return static_cast<RenderGraphResource>(mResources.size() - 1);
+	}
+
+	//An image that only lives within the frame: created (and possibly aliased) by the graph
+	RenderGraphResource CreateTransientImage(const char* Name, const RenderGraphImageDesc& Desc)
+	{
+		Resource NewResource;
+		NewResource.mName = Name;
+		NewResource.mDesc = Desc;
+		mResources.push_back(NewResource);
+		return static_cast<RenderGraphResource>(mResources.size() - 1);
+	}
+
+	RenderGraphPassBuilder AddPass(const char* Name)
+	{
+		if (mCompiled)
+		{
+			throw std::runtime_error("Render graph passes must be added before compiling!");
+		}
+		Pass NewPass;
+		NewPass.mName = Name;
+		mPasses.push_back(std::move(NewPass));
+		return RenderGraphPassBuilder(*this, static_cast<uint32_t>(mPasses.size() - 1));
+	}
+
+	//Which image an imported resource is this frame
+	void SetImportedImage(RenderGraphResource Handle, VkImage Image, VkImageView View)
+	{
+		Resource& Imported = mResources.at(Handle);
+		Imported.mImage = Image;
+		Imported.mView = View;
+	}
+
+	VkImage GetImage(RenderGraphResource Handle) const
+	{
+		return mResources.at(Handle).mImage;
+	}
+
+	VkImageView GetImageView(RenderGraphResource Handle) const
+	{
+		return mResources.at(Handle).mView;
+	}
+
+	const RenderGraphStatistics& GetStatistics() const
+	{
+		return mStatistics;
+	}
+
+	bool IsPassCulled(const char* Name) const
+	{
+		for (const Pass& CurrentPass : mPasses)
+		{
+			if (strcmp(CurrentPass.mName, Name) == 0)
+			{
+				return !CurrentPass.mLive;
+			}
+		}
+		return true;
+	}
+
+	void Compile(VkDevice Device, DeviceMemoryAllocator& Allocator)
+	{
+		if (mCompiled)
+		{
+			throw std::runtime_error("Render graph already compiled!");
+		}
+		mDevice = Device;
+		mAllocator = &Allocator;
+
+		CullPasses();
+		ComputeLifetimes();
+		CreateTransientImages();
+		BuildBarriers();
+		CreateRenderPasses();
+
+		mStatistics.mPassCount = static_cast<uint32_t>(mPasses.size());
+		mCompiled = true;
+	}
+
+	//Record the whole graph. The profiler (optional) gets a scope per pass, named after the pass.
+	void Execute(VkCommandBuffer CommandBuffer, GpuProfiler* Profiler = nullptr)
+	{
+		if (!mCompiled)
+		{
+			throw std::runtime_error("Render graph executed before being compiled!");
+		}
+
+		for (uint32_t PassIndex : mExecutionOrder)
+		{
+			Pass& CurrentPass = mPasses[PassIndex];
+			RecordBarriers(CommandBuffer, CurrentPass.mBarriers);
+
+			const uint32_t Scope = Profiler != nullptr ? Profiler->BeginScope(CommandBuffer, CurrentPass.mName) : GpuProfiler::kInvalidScope;
+
+			RenderGraphPassContext Context;
+			Context.mCommandBuffer = CommandBuffer;
+			Context.mGraph = this;
+
+			if (CurrentPass.IsGraphics())
+			{
+				Context.mRenderPass = CurrentPass.mRenderPass;
+				Context.mFramebuffer = GetFramebuffer(CurrentPass);
+				Context.mExtent = mResources[CurrentPass.mAttachments.front().mResource].mDesc.mExtent;
+
+				std::vector<VkClearValue> ClearValues;
+				for (const Attachment& CurrentAttachment : CurrentPass.mAttachments)
+				{
+					ClearValues.push_back(CurrentAttachment.mClearValue);
+				}
+
+				VkRenderPassBeginInfo BeginInfo = {};
+				BeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+				BeginInfo.renderPass = Context.mRenderPass;
+				BeginInfo.framebuffer = Context.mFramebuffer;
+				BeginInfo.renderArea.offset = { 0, 0 };
+				BeginInfo.renderArea.extent = Context.mExtent;
+				BeginInfo.clearValueCount = static_cast<uint32_t>(ClearValues.size());
+				BeginInfo.pClearValues = ClearValues.data();
+
+				vkCmdBeginRenderPass(CommandBuffer, &BeginInfo, CurrentPass.mSecondaryCommandBuffers ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+				if (CurrentPass.mExecute)
+				{
+					CurrentPass.mExecute(Context);
+				}
+				vkCmdEndRenderPass(CommandBuffer);
+			}
+			else if (CurrentPass.mExecute)
+			{
+				CurrentPass.mExecute(Context);
+			}
+
+			if (Profiler != nullptr)
+			{
+				Profiler->EndScope(CommandBuffer, Scope);
+			}
+		}
+
+		RecordBarriers(CommandBuffer, mFinalBarriers);
+	}
+
+	//Destroy everything the graph created. The GPU must be done with it.
+	void Destroy()
+	{
+		if (!mCompiled)
+		{
+			return;
+		}
+
+		for (Pass& CurrentPass : mPasses)
+		{
+			for (auto& Framebuffer : CurrentPass.mFramebuffers)
+			{
+				vkDestroyFramebuffer(mDevice, Framebuffer.second, nullptr);
+			}
+			CurrentPass.mFramebuffers.clear();
+
+			if (CurrentPass.mRenderPass != VK_NULL_HANDLE)
+			{
+				vkDestroyRenderPass(mDevice, CurrentPass.mRenderPass, nullptr);
+				CurrentPass.mRenderPass = VK_NULL_HANDLE;
+			}
+		}
+
+		for (Resource& CurrentResource : mResources)
+		{
+			if (CurrentResource.mImported)
+			{
+				continue;
+			}
+			if (CurrentResource.mView != VK_NULL_HANDLE)
+			{
+				vkDestroyImageView(mDevice, CurrentResource.mView, nullptr);
+				CurrentResource.mView = VK_NULL_HANDLE;
+			}
+			if (CurrentResource.mImage != VK_NULL_HANDLE)
+			{
+				vkDestroyImage(mDevice, CurrentResource.mImage, nullptr);
+				CurrentResource.mImage = VK_NULL_HANDLE;
+			}
+		}
+
+		for (MemoryHeap& Heap : mHeaps)
+		{
+			mAllocator->Free(Heap.mAllocation);
+		}
+		mHeaps.clear();
+	}
+
+private:
+
+	friend class RenderGraphPassBuilder;
+
+	//One access of a pass to an image (all the accesses of a pass to the same image are merged into one)
+	struct ResourceUse
+	{
+		RenderGraphResource mResource = kInvalidRenderGraphResource;
+		VkImageLayout mLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags mStages = 0;
+		VkAccessFlags mAccess = 0;
+		VkImageUsageFlags mUsage = 0;
+		bool mWrite = false;
+
+		//The pass needs the previous content of the image (reads it, or only writes part of it)
+		bool mReadsContent = false;
+	};
+
+	struct Attachment
+	{
+		RenderGraphResource mResource = kInvalidRenderGraphResource;
+		VkAttachmentLoadOp mLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		VkClearValue mClearValue = {};
+		bool mDepth = false;
+	};
+
+	struct BarrierBatch
+	{
+		VkPipelineStageFlags mSrcStages = 0;
+		VkPipelineStageFlags mDstStages = 0;
+
+		//Image handles are only filled in at record time (imported images change every frame)
+		std::vector<RenderGraphResource> mResources;
+		std::vector<VkImageMemoryBarrier> mBarriers;
+	};
+
+	struct Pass
+	{
+		const char* mName = nullptr;
+		std::vector<ResourceUse> mUses;
+		std::vector<Attachment> mAttachments;
+		std::function<void(const RenderGraphPassContext&)> mExecute;
+		bool mSideEffects = false;
+		bool mSecondaryCommandBuffers = false;
+		bool mLive = false;
+
+		BarrierBatch mBarriers;
+
+		VkRenderPass mRenderPass = VK_NULL_HANDLE;
+
+		//Keyed by attachment views, so there is one per swap chain image
+		std::map<std::vector<VkImageView>, VkFramebuffer> mFramebuffers;
+
+		bool IsGraphics() const
+		{
+			return !mAttachments.empty();
+		}
+	};
+
+	struct Resource
+	{
+		const char* mName = nullptr;
+		RenderGraphImageDesc mDesc;
+		bool mImported = false;
+
+		VkImageLayout mInitialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags mInitialStages = 0;
+		VkImageLayout mFinalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags mFinalStages = 0;
+		VkAccessFlags mFinalAccess = 0;
+
+		VkImage mImage = VK_NULL_HANDLE;
+		VkImageView mView = VK_NULL_HANDLE;
+
+		//Position of the first and last live passes using it in mExecutionOrder
+		uint32_t mFirstUse = ~0u;
+		uint32_t mLastUse = 0;
+
+		//Where a transient image lives
+		uint32_t mHeap = ~0u;
+		VkDeviceSize mOffset = 0;
+		VkDeviceSize mSize = 0;
+
+		bool IsUsed() const
+		{
+			return mFirstUse != ~0u;
+		}
+	};
+
+	//Memory shared by transient images with disjoint lifetimes
+	struct MemoryHeap
+	{
+		uint32_t mMemoryTypeBits = ~0u;
+		VkDeviceSize mAlignment = 1;
+		VkDeviceSize mSize = 0;
+		std::vector<RenderGraphResource> mResources;
+		DeviceAllocation mAllocation;
+	};
+
+	//Synchronization state of an image while simulating the passes
+	struct ResourceState
+	{
+		VkImageLayout mLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		//Last write (a layout transition counts as one, with no access to flush)
+		VkPipelineStageFlags mWriteStages = 0;
+		VkAccessFlags mWriteAccess = 0;
+
+		//Stages the last write has been made visible to, and stages that read since the last write
+		VkPipelineStageFlags mVisibleStages = 0;
+		VkPipelineStageFlags mReadStages = 0;
+	};
+
+	static bool IsDepthFormat(VkFormat Format)
+	{
+		switch (Format)
+		{
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+		case VK_FORMAT_S8_UINT:
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	static bool HasStencil(VkFormat Format)
+	{
+		return Format == VK_FORMAT_S8_UINT || Format == VK_FORMAT_D16_UNORM_S8_UINT || Format == VK_FORMAT_D24_UNORM_S8_UINT || Format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+	}
+
+	static VkImageAspectFlags GetAspect(VkFormat Format)
+	{
+		if (!IsDepthFormat(Format))
+		{
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+		}
+		VkImageAspectFlags Aspect = Format == VK_FORMAT_S8_UINT ? 0 : VK_IMAGE_ASPECT_DEPTH_BIT;
+		return HasStencil(Format) ? Aspect | VK_IMAGE_ASPECT_STENCIL_BIT : Aspect;
+	}
+
+	void AddUse(uint32_t PassIndex, const ResourceUse& Use)
+	{
+		if (Use.mResource >= mResources.size())
+		{
+			throw std::runtime_error("Invalid render graph resource!");
+		}
+
+		Pass& CurrentPass = mPasses[PassIndex];
+		for (ResourceUse& Existing : CurrentPass.mUses)
+		{
+			if (Existing.mResource != Use.mResource)
+			{
+				continue;
+			}
+			//An image can only be in one layout at a time: no sampling from the attachment being rendered to
+			if (Existing.mLayout != Use.mLayout)
+			{
+				throw std::runtime_error("Render graph pass uses an image in two different layouts!");
+			}
+			Existing.mStages |= Use.mStages;
+			Existing.mAccess |= Use.mAccess;
+			Existing.mUsage |= Use.mUsage;
+			Existing.mWrite |= Use.mWrite;
+			Existing.mReadsContent |= Use.mReadsContent;
+			return;
+		}
+		CurrentPass.mUses.push_back(Use);
+	}
+
+	//Walk the passes backwards from what the frame produces (imported images) and keep the ones that contribute to it
+	void CullPasses()
+	{
+		std::vector<bool> Needed(mResources.size(), false);
+		for (size_t i = 0; i < mResources.size(); ++i)
+		{
+			Needed[i] = mResources[i].mImported;
+		}
+
+		for (size_t PassIndex = mPasses.size(); PassIndex-- > 0;)
+		{
+			Pass& CurrentPass = mPasses[PassIndex];
+
+			CurrentPass.mLive = CurrentPass.mSideEffects;
+			for (const ResourceUse& Use : CurrentPass.mUses)
+			{
+				CurrentPass.mLive |= Use.mWrite && Needed[Use.mResource];
+			}
+			if (!CurrentPass.mLive)
+			{
+				++mStatistics.mCulledPassCount;
+				continue;
+			}
+
+			//What this pass entirely overwrites doesn't need any earlier writer, what it reads does
+			for (const ResourceUse& Use : CurrentPass.mUses)
+			{
+				if (Use.mWrite && !Use.mReadsContent)
+				{
+					Needed[Use.mResource] = false;
+				}
+			}
+			for (const ResourceUse& Use : CurrentPass.mUses)
+			{
+				if (Use.mReadsContent)
+				{
+					Needed[Use.mResource] = true;
+				}
+			}
+		}
+
+		for (uint32_t PassIndex = 0; PassIndex < mPasses.size(); ++PassIndex)
+		{
+			if (mPasses[PassIndex].mLive)
+			{
+				mExecutionOrder.push_back(PassIndex);
+			}
+		}
+	}
+
+	void ComputeLifetimes()
+	{
+		for (uint32_t Position = 0; Position < mExecutionOrder.size(); ++Position)
+		{
+			for (const ResourceUse& Use : mPasses[mExecutionOrder[Position]].mUses)
+			{
+				Resource& Used = mResources[Use.mResource];
+				Used.mFirstUse = std::min(Used.mFirstUse, Position);
+				Used.mLastUse = std::max(Used.mLastUse, Position);
+			}
+		}
+	}
+
+	static bool LifetimesOverlap(const Resource& A, const Resource& B)
+	{
+		return A.mFirstUse <= B.mLastUse && B.mFirstUse <= A.mLastUse;
+	}
+
+	static bool MemoryOverlaps(const Resource& A, const Resource& B)
+	{
+		return A.mOffset < B.mOffset + B.mSize && B.mOffset < A.mOffset + A.mSize;
+	}
+
+	void CreateTransientImages()
+	{
+		//Usage flags out of every live use
+		std::vector<VkImageUsageFlags> Usages(mResources.size(), 0);
+		for (uint32_t PassIndex : mExecutionOrder)
+		{
+			for (const ResourceUse& Use : mPasses[PassIndex].mUses)
+			{
+				Usages[Use.mResource] |= Use.mUsage;
+			}
+		}
+
+		std::vector<RenderGraphResource> Transients;
+		std::vector<VkMemoryRequirements> Requirements(mResources.size());
+		for (RenderGraphResource Handle = 0; Handle < mResources.size(); ++Handle)
+		{
+			Resource& Transient = mResources[Handle];
+			if (Transient.mImported || !Transient.IsUsed())
+			{
+				continue;
+			}
+
+			VkImageCreateInfo ImageInfo = {};
+			ImageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			ImageInfo.imageType = VK_IMAGE_TYPE_2D;
+			ImageInfo.format = Transient.mDesc.mFormat;
+			ImageInfo.extent = { Transient.mDesc.mExtent.width, Transient.mDesc.mExtent.height, 1 };
+			ImageInfo.mipLevels = 1;
+			ImageInfo.arrayLayers = 1;
+			ImageInfo.samples = Transient.mDesc.mSamples;
+			ImageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			ImageInfo.usage = Usages[Handle];
+			ImageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			ImageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			if (vkCreateImage(mDevice, &ImageInfo, nullptr, &Transient.mImage) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create render graph transient image!");
+			}
+
+			vkGetImageMemoryRequirements(mDevice, Transient.mImage, &Requirements[Handle]);
+			Transient.mSize = Requirements[Handle].size;
+			mStatistics.mUnaliasedTransientMemorySize += Transient.mSize;
+			Transients.push_back(Handle);
+		}
+		mStatistics.mTransientImageCount = static_cast<uint32_t>(Transients.size());
+
+		//Biggest first, each one at the lowest offset that doesn't collide with an image alive at the same time
+		std::sort(Transients.begin(), Transients.end(), [this](RenderGraphResource A, RenderGraphResource B)
+		{
+			return mResources[A].mSize > mResources[B].mSize;
+		});
+
+		for (RenderGraphResource Handle : Transients)
+		{
+			Resource& Transient = mResources[Handle];
+			const VkMemoryRequirements& Requirement = Requirements[Handle];
+
+			for (uint32_t HeapIndex = 0; HeapIndex <= mHeaps.size(); ++HeapIndex)
+			{
+				if (HeapIndex == mHeaps.size())
+				{
+					mHeaps.emplace_back();
+				}
+				MemoryHeap& Heap = mHeaps[HeapIndex];
+				if ((Heap.mMemoryTypeBits & Requirement.memoryTypeBits) == 0)
+				{
+					continue;
+				}
+
+				const VkDeviceSize Alignment = std::max<VkDeviceSize>(Requirement.alignment, 1);
+				std::vector<VkDeviceSize> Candidates(1, 0);
+				for (RenderGraphResource Other : Heap.mResources)
+				{
+					Candidates.push_back((mResources[Other].mOffset + mResources[Other].mSize + Alignment - 1) / Alignment * Alignment);
+				}
+				std::sort(Candidates.begin(), Candidates.end());
+
+				for (VkDeviceSize Candidate : Candidates)
+				{
+					Transient.mOffset = Candidate;
+					bool Fits = true;
+					for (RenderGraphResource Other : Heap.mResources)
+					{
+						if (LifetimesOverlap(Transient, mResources[Other]) && MemoryOverlaps(Transient, mResources[Other]))
+						{
+							Fits = false;
+							break;
+						}
+					}
+					if (Fits)
+					{
+						break;
+					}
+				}
+
+				Transient.mHeap = HeapIndex;
+				Heap.mMemoryTypeBits &= Requirement.memoryTypeBits;
+				Heap.mAlignment = std::max(Heap.mAlignment, Alignment);
+				Heap.mSize = std::max(Heap.mSize, Transient.mOffset + Transient.mSize);
+				Heap.mResources.push_back(Handle);
+				break;
+			}
+		}
+
+		for (MemoryHeap& Heap : mHeaps)
+		{
+			VkMemoryRequirements HeapRequirements = {};
+			HeapRequirements.size = Heap.mSize;
+			HeapRequirements.alignment = Heap.mAlignment;
+			HeapRequirements.memoryTypeBits = Heap.mMemoryTypeBits;
+			Heap.mAllocation = mAllocator->Allocate(HeapRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, AllocationKind::Optimal);
+			mStatistics.mTransientMemorySize += Heap.mSize;
+
+			for (RenderGraphResource Handle : Heap.mResources)
+			{
+				Resource& Transient = mResources[Handle];
+				if (vkBindImageMemory(mDevice, Transient.mImage, Heap.mAllocation.mMemory, Heap.mAllocation.mOffset + Transient.mOffset) != VK_SUCCESS)
+				{
+					throw std::runtime_error("Failed to bind render graph transient image memory!");
+				}
+
+				VkImageViewCreateInfo ViewInfo = {};
+				ViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+				ViewInfo.image = Transient.mImage;
+				ViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				ViewInfo.format = Transient.mDesc.mFormat;
+				ViewInfo.subresourceRange.aspectMask = GetAspect(Transient.mDesc.mFormat);
+				ViewInfo.subresourceRange.levelCount = 1;
+				ViewInfo.subresourceRange.layerCount = 1;
+				if (vkCreateImageView(mDevice, &ViewInfo, nullptr, &Transient.mView) != VK_SUCCESS)
+				{
+					throw std::runtime_error("Failed to create render graph transient image view!");
+				}
+			}
+		}
+	}
+
+	void AddBarrier(BarrierBatch& Batch, RenderGraphResource Handle, VkImageLayout OldLayout, VkImageLayout NewLayout,
+		VkPipelineStageFlags SrcStages, VkAccessFlags SrcAccess, VkPipelineStageFlags DstStages, VkAccessFlags DstAccess)
+	{
+		VkImageMemoryBarrier Barrier = {};
+		Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		Barrier.srcAccessMask = SrcAccess;
+		Barrier.dstAccessMask = DstAccess;
+		Barrier.oldLayout = OldLayout;
+		Barrier.newLayout = NewLayout;
+		Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		Barrier.subresourceRange.aspectMask = GetAspect(mResources[Handle].mDesc.mFormat);
+		Barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+		Barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+		Batch.mSrcStages |= SrcStages;
+		Batch.mDstStages |= DstStages;
+		Batch.mResources.push_back(Handle);
+		Batch.mBarriers.push_back(Barrier);
+	}
+
+	//Simulate the layout/access state of every image through the live passes and record the barriers they need
+	void BuildBarriers()
+	{
+		std::vector<ResourceState> States(mResources.size());
+		for (size_t i = 0; i < mResources.size(); ++i)
+		{
+			if (mResources[i].mImported)
+			{
+				States[i].mLayout = mResources[i].mInitialLayout;
+				States[i].mWriteStages = mResources[i].mInitialStages;
+			}
+		}
+
+		for (uint32_t Position = 0; Position < mExecutionOrder.size(); ++Position)
+		{
+			Pass& CurrentPass = mPasses[mExecutionOrder[Position]];
+			for (const ResourceUse& Use : CurrentPass.mUses)
+			{
+				Resource& Used = mResources[Use.mResource];
+				ResourceState& State = States[Use.mResource];
+
+				VkPipelineStageFlags SrcStages = 0;
+				VkAccessFlags SrcAccess = 0;
+
+				//First use of an aliased image: whatever used the same memory before must be done with it
+				const bool FirstAliasedUse = !Used.mImported && Used.mFirstUse == Position;
+				if (FirstAliasedUse)
+				{
+					for (RenderGraphResource Other : mHeaps[Used.mHeap].mResources)
+					{
+						const Resource& Previous = mResources[Other];
+						if (Other != Use.mResource && Previous.mLastUse < Position && MemoryOverlaps(Used, Previous))
+						{
+							SrcStages |= States[Other].mWriteStages | States[Other].mReadStages;
+							SrcAccess |= States[Other].mWriteAccess;
+						}
+					}
+				}
+
+				if (State.mLayout != Use.mLayout || FirstAliasedUse)
+				{
+					//Discarding the content lets the transition start from UNDEFINED, which is free
+					const VkImageLayout OldLayout = Use.mReadsContent ? State.mLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+					SrcStages |= State.mWriteStages | State.mReadStages;
+					SrcAccess |= State.mWriteAccess;
+					AddBarrier(CurrentPass.mBarriers, Use.mResource, OldLayout, Use.mLayout, SrcStages, SrcAccess, Use.mStages, Use.mAccess);
+
+					State.mLayout = Use.mLayout;
+					State.mWriteStages = Use.mStages;
+					State.mWriteAccess = Use.mWrite ? Use.mAccess : 0;
+					State.mVisibleStages = Use.mWrite ? 0 : Use.mStages;
+					State.mReadStages = Use.mWrite ? 0 : Use.mStages;
+				}
+				else if (Use.mWrite)
+				{
+					//Write after write, or after read: the previous accesses must be over
+					if ((State.mWriteStages | State.mReadStages) != 0)
+					{
+						AddBarrier(CurrentPass.mBarriers, Use.mResource, State.mLayout, State.mLayout, State.mWriteStages | State.mReadStages, State.mWriteAccess, Use.mStages, Use.mAccess);
+					}
+					State.mWriteStages = Use.mStages;
+					State.mWriteAccess = Use.mAccess;
+					State.mVisibleStages = 0;
+					State.mReadStages = 0;
+				}
+				else
+				{
+					//Read after write: only if the write hasn't been made visible to these stages yet. Read after read needs nothing.
+					if (State.mWriteStages != 0 && (Use.mStages & ~State.mVisibleStages) != 0)
+					{
+						AddBarrier(CurrentPass.mBarriers, Use.mResource, State.mLayout, State.mLayout, State.mWriteStages, State.mWriteAccess, Use.mStages, Use.mAccess);
+						State.mVisibleStages |= Use.mStages;
+					}
+					State.mReadStages |= Use.mStages;
+				}
+			}
+
+			CountBatch(CurrentPass.mBarriers);
+		}
+
+		//Hand the imported images over in the layout their next user expects
+		for (RenderGraphResource Handle = 0; Handle < mResources.size(); ++Handle)
+		{
+			const Resource& Imported = mResources[Handle];
+			const ResourceState& State = States[Handle];
+			if (Imported.mImported && Imported.mFinalLayout != VK_IMAGE_LAYOUT_UNDEFINED && Imported.mFinalLayout != State.mLayout)
+			{
+				AddBarrier(mFinalBarriers, Handle, State.mLayout, Imported.mFinalLayout, State.mWriteStages | State.mReadStages, State.mWriteAccess,
+					Imported.mFinalStages, Imported.mFinalAccess);
+			}
+		}
+		CountBatch(mFinalBarriers);
+	}
+
+	void CountBatch(BarrierBatch& Batch)
+	{
+		if (Batch.mBarriers.empty())
+		{
+			return;
+		}
+		Batch.mSrcStages = Batch.mSrcStages != 0 ? Batch.mSrcStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		Batch.mDstStages = Batch.mDstStages != 0 ? Batch.mDstStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		++mStatistics.mBarrierBatchCount;
+		mStatistics.mImageBarrierCount += static_cast<uint32_t>(Batch.mBarriers.size());
+	}
+
+	void CreateRenderPasses()
+	{
+		for (uint32_t Position = 0; Position < mExecutionOrder.size(); ++Position)
+		{
+			Pass& CurrentPass = mPasses[mExecutionOrder[Position]];
+			if (!CurrentPass.IsGraphics())
+			{
+				continue;
+			}
+
+			std::vector<VkAttachmentDescription> Descriptions;
+			std::vector<VkAttachmentReference> ColorReferences;
+			VkAttachmentReference DepthReference = {};
+			bool HasDepth = false;
+
+			for (const Attachment& CurrentAttachment : CurrentPass.mAttachments)
+			{
+				const Resource& Target = mResources[CurrentAttachment.mResource];
+				const VkImageLayout Layout = CurrentAttachment.mDepth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+				//Nobody reads a transient attachment after its last use, so its content never needs to leave the tile memory
+				const bool Store = Target.mImported || Target.mLastUse > Position;
+
+				VkAttachmentDescription Description = {};
+				Description.format = Target.mDesc.mFormat;
+				Description.samples = Target.mDesc.mSamples;
+				Description.loadOp = CurrentAttachment.mLoadOp;
+				Description.storeOp = Store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				Description.stencilLoadOp = HasStencil(Target.mDesc.mFormat) ? CurrentAttachment.mLoadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				Description.stencilStoreOp = HasStencil(Target.mDesc.mFormat) ? Description.storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				//The barriers before the pass already put the image in the right layout
+				Description.initialLayout = Layout;
+				Description.finalLayout = Layout;
+
+				VkAttachmentReference Reference = {};
+				Reference.attachment = static_cast<uint32_t>(Descriptions.size());
+				Reference.layout = Layout;
+				if (CurrentAttachment.mDepth)
+				{
+					DepthReference = Reference;
+					HasDepth = true;
+				}
+				else
+				{
+					ColorReferences.push_back(Reference);
+				}
+				Descriptions.push_back(Description);
+			}
+
+			VkSubpassDescription Subpass = {};
+			Subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			Subpass.colorAttachmentCount = static_cast<uint32_t>(ColorReferences.size());
+			Subpass.pColorAttachments = ColorReferences.data();
+			Subpass.pDepthStencilAttachment = HasDepth ? &DepthReference : nullptr;
+
+			VkRenderPassCreateInfo RenderPassInfo = {};
+			RenderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+			RenderPassInfo.attachmentCount = static_cast<uint32_t>(Descriptions.size());
+			RenderPassInfo.pAttachments = Descriptions.data();
+			RenderPassInfo.subpassCount = 1;
+			RenderPassInfo.pSubpasses = &Subpass;
+
+			if (vkCreateRenderPass(mDevice, &RenderPassInfo, nullptr, &CurrentPass.mRenderPass) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create render graph render pass!");
+			}
+		}
+	}
+
+	VkFramebuffer GetFramebuffer(Pass& CurrentPass)
+	{
+		std::vector<VkImageView> Views;
+		for (const Attachment& CurrentAttachment : CurrentPass.mAttachments)
+		{
+			Views.push_back(mResources[CurrentAttachment.mResource].mView);
+		}
+
+		auto It = CurrentPass.mFramebuffers.find(Views);
+		if (It != CurrentPass.mFramebuffers.end())
+		{
+			return It->second;
+		}
+
+		const VkExtent2D Extent = mResources[CurrentPass.mAttachments.front().mResource].mDesc.mExtent;
+
+		VkFramebufferCreateInfo FramebufferInfo = {};
+		FramebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		FramebufferInfo.renderPass = CurrentPass.mRenderPass;
+		FramebufferInfo.attachmentCount = static_cast<uint32_t>(Views.size());
+		FramebufferInfo.pAttachments = Views.data();
+		FramebufferInfo.width = Extent.width;
+		FramebufferInfo.height = Extent.height;
+		FramebufferInfo.layers = 1;
+
+		VkFramebuffer Framebuffer;
+		if (vkCreateFramebuffer(mDevice, &FramebufferInfo, nullptr, &Framebuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create render graph framebuffer!");
+		}
+		CurrentPass.mFramebuffers.emplace(std::move(Views), Framebuffer);
+		return Framebuffer;
+	}
+
+	void RecordBarriers(VkCommandBuffer CommandBuffer, BarrierBatch& Batch)
+	{
+		if (Batch.mBarriers.empty())
+		{
+			return;
+		}
+		for (size_t i = 0; i < Batch.mBarriers.size(); ++i)
+		{
+			Batch.mBarriers[i].image = mResources[Batch.mResources[i]].mImage;
+		}
+		vkCmdPipelineBarrier(CommandBuffer, Batch.mSrcStages, Batch.mDstStages, 0, 0, nullptr, 0, nullptr,
+			static_cast<uint32_t>(Batch.mBarriers.size()), Batch.mBarriers.data());
+	}
+
+	VkDevice mDevice = VK_NULL_HANDLE;
+
+	DeviceMemoryAllocator* mAllocator = nullptr;
+
+	std::vector<Resource> mResources;
+
+	std::vector<Pass> mPasses;
+
+	//Live passes, in declaration order
+	std::vector<uint32_t> mExecutionOrder;
+
+	std::vector<MemoryHeap> mHeaps;
+
+	//Transitions of the imported images to their final layout, after the last pass
+	BarrierBatch mFinalBarriers;
+
+	RenderGraphStatistics mStatistics;
+
+	bool mCompiled = false;
+};
+
+inline RenderGraphPassBuilder& RenderGraphPassBuilder::WriteColor(RenderGraphResource Resource, VkAttachmentLoadOp LoadOp, VkClearColorValue ClearColor)
+{
+	RenderGraph::Attachment NewAttachment;
+	NewAttachment.mResource = Resource;
+	NewAttachment.mLoadOp = LoadOp;
+	NewAttachment.mClearValue.color = ClearColor;
+	mGraph.mPasses[mPassIndex].mAttachments.push_back(NewAttachment);
+
+	RenderGraph::ResourceUse Use;
+	Use.mResource = Resource;
+	Use.mLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	Use.mStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	Use.mAccess = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | (LoadOp == VK_ATTACHMENT_LOAD_OP_LOAD ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0);
+	Use.mUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	Use.mWrite = true;
+	Use.mReadsContent = LoadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+	mGraph.AddUse(mPassIndex, Use);
+	return *this;
+}
+
+inline RenderGraphPassBuilder& RenderGraphPassBuilder::WriteDepth(RenderGraphResource Resource, VkAttachmentLoadOp LoadOp, VkClearDepthStencilValue ClearDepth)
+{
+	RenderGraph::Attachment NewAttachment;
+	NewAttachment.mResource = Resource;
+	NewAttachment.mLoadOp = LoadOp;
+	NewAttachment.mClearValue.depthStencil = ClearDepth;
+	NewAttachment.mDepth = true;
+	mGraph.mPasses[mPassIndex].mAttachments.push_back(NewAttachment);
+
+	RenderGraph::ResourceUse Use;
+	Use.mResource = Resource;
+	Use.mLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	Use.mStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	Use.mAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	Use.mUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	Use.mWrite = true;
+	Use.mReadsContent = LoadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+	mGraph.AddUse(mPassIndex, Use);
+	return *this;
+}
+
+inline RenderGraphPassBuilder& RenderGraphPassBuilder::ReadTexture(RenderGraphResource Resource, VkPipelineStageFlags Stages)
+{
+	RenderGraph::ResourceUse Use;
+	Use.mResource = Resource;
+	Use.mLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	Use.mStages = Stages;
+	Use.mAccess = VK_ACCESS_SHADER_READ_BIT;
+	Use.mUsage = VK_IMAGE_USAGE_SAMPLED_BIT;
+	Use.mReadsContent = true;
+	mGraph.AddUse(mPassIndex, Use);
+	return *this;
+}
+
+inline RenderGraphPassBuilder& RenderGraphPassBuilder::ReadStorage(RenderGraphResource Resource, VkPipelineStageFlags Stages)
+{
+	RenderGraph::ResourceUse Use;
+	Use.mResource = Resource;
+	Use.mLayout = VK_IMAGE_LAYOUT_GENERAL;
+	Use.mStages = Stages;
+	Use.mAccess = VK_ACCESS_SHADER_READ_BIT;
+	Use.mUsage = VK_IMAGE_USAGE_STORAGE_BIT;
+	Use.mReadsContent = true;
+	mGraph.AddUse(mPassIndex, Use);
+	return *this;
+}
+
+inline RenderGraphPassBuilder& RenderGraphPassBuilder::WriteStorage(RenderGraphResource Resource, VkPipelineStageFlags Stages)
+{
+	//Storage writes can be partial, so the previous content is always kept
+	RenderGraph::ResourceUse Use;
+	Use.mResource = Resource;
+	Use.mLayout = VK_IMAGE_LAYOUT_GENERAL;
+	Use.mStages = Stages;
+	Use.mAccess = VK_ACCESS_SHADER_WRITE_BIT;
+	Use.mUsage = VK_IMAGE_USAGE_STORAGE_BIT;
+	Use.mWrite = true;
+	Use.mReadsContent = true;
+	mGraph.AddUse(mPassIndex, Use);
+	return *this;
+}
+
+inline RenderGraphPassBuilder& RenderGraphPassBuilder::ReadTransfer(RenderGraphResource Resource)
+{
+	RenderGraph::ResourceUse Use;
+	Use.mResource = Resource;
+	Use.mLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	Use.mStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	Use.mAccess = VK_ACCESS_TRANSFER_READ_BIT;
+	Use.mUsage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	Use.mReadsContent = true;
+	mGraph.AddUse(mPassIndex, Use);
+	return *this;
+}
+
+inline RenderGraphPassBuilder& RenderGraphPassBuilder::WriteTransfer(RenderGraphResource Resource, bool PreserveContent)
+{
+	RenderGraph::ResourceUse Use;
+	Use.mResource = Resource;
+	Use.mLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	Use.mStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	Use.mAccess = VK_ACCESS_TRANSFER_WRITE_BIT;
+	Use.mUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	Use.mWrite = true;
+	Use.mReadsContent = PreserveContent;
+	mGraph.AddUse(mPassIndex, Use);
+	return *this;
+}
+
+inline RenderGraphPassBuilder& RenderGraphPassBuilder::SetSideEffects()
+{
+	mGraph.mPasses[mPassIndex].mSideEffects = true;
+	return *this;
+}
+
+inline RenderGraphPassBuilder& RenderGraphPassBuilder::SetSecondaryCommandBuffers()
+{
+	mGraph.mPasses[mPassIndex].mSecondaryCommandBuffers = true;
+	return *this;
+}
+
+inline RenderGraphPassBuilder& RenderGraphPassBuilder::SetExecute(std::function<void(const RenderGraphPassContext&)> Execute)
+{
+	mGraph.mPasses[mPassIndex].mExecute = std::move(Execute);
+	return *this;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "../Common/MappedFile.h"
+
+//A view of a SPIR-V module that lives inside a memory mapping. Valid until the owning cache invalidates that file.
+struct SpirvBinary
+{
+	const uint32_t* mCode = nullptr;
+
+	//Size in bytes (what VkShaderModuleCreateInfo::codeSize wants)
+	size_t mSize = 0;
+};
+
+/*
+	Keeps SPIR-V files memory mapped so that shader modules are created straight out of the mapping, and so that
+	rebuilding pipelines (swap chain recreation, hot reload ...) doesn't touch the file system again.
+
+	Every file is validated once when it gets mapped: vkCreateShaderModule requires pCode to be 4 bytes aligned and
+	codeSize to be a multiple of 4, and the module must start with the SPIR-V magic number.
+*/
+class ShaderBinaryCache
+{
+public:
+
+	static constexpr uint32_t kSpirvMagic = 0x07230203;
+
+	const SpirvBinary& Get(const std::string& FileName)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+
+		auto It = mEntries.find(FileName);
+		if (It != mEntries.end())
+		{
+			return It->second->mBinary;
+		}
+
+		auto NewEntry = std::make_unique<Entry>();
+		NewEntry->mFile.Open(FileName);
+
+		const void* Data = NewEntry->mFile.Data();
+		const size_t Size = NewEntry->mFile.Size();
+
+		if (Size < sizeof(uint32_t) || Size % sizeof(uint32_t) != 0)
+		{
+			throw std::runtime_error("Invalid SPIR-V file " + FileName + ": size is not a multiple of 4 bytes!");
+		}
+
+		//Mappings are page aligned so this should never fire, but vkCreateShaderModule would read garbage if it did
+		if (reinterpret_cast<uintptr_t>(Data) % alignof(uint32_t) != 0)
+		{
+			throw std::runtime_error("Invalid SPIR-V file " + FileName + ": code is not 4 bytes aligned!");
+		}
+
+		const uint32_t* Code = static_cast<const uint32_t*>(Data);
+		if (Code[0] != kSpirvMagic)
+		{
+			throw std::runtime_error("Invalid SPIR-V file " + FileName + ": bad magic number!");
+		}
+
+		NewEntry->mBinary.mCode = Code;
+		NewEntry->mBinary.mSize = Size;
+
+		const SpirvBinary& Binary = NewEntry->mBinary;
+		mEntries.emplace(FileName, std::move(NewEntry));
+		return Binary;
+	}
+
+	//Drop the mapping of a file (e.g. because it changed on disk). Any SpirvBinary previously returned for it becomes invalid.
+	void Invalidate(const std::string& FileName)
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mEntries.erase(FileName);
+	}
+
+	void Clear()
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		mEntries.clear();
+	}
+
+private:
+
+	struct Entry
+	{
+		MappedFile mFile;
+		SpirvBinary mBinary;
+	};
+
+	//Entries are heap allocated so that references handed out stay valid when the map rehashes
+	std::unordered_map<std::string, std::unique_ptr<Entry>> mEntries;
+
+	std::mutex mMutex;
+};
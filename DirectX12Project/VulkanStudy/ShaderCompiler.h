@@ -0,0 +1,375 @@
+#pragma once
+
+#include <glslang/Public/ShaderLang.h>
+#include <glslang/Public/ResourceLimits.h>
+#include <glslang/SPIRV/GlslangToSpv.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../Common/ContentAddressedStore.h"
+#include "../Common/Hash.h"
+#include "../Common/TaskSystem.h"
+
+//A GLSL file and the macros to compile it with. The stage comes from the extension (.vert, .frag, .comp ...).
+struct ShaderCompileRequest
+{
+	std::string mPath;
+
+	//#define Name Value, in this order
+	std::vector<std::pair<std::string, std::string>> mDefines;
+
+	std::string mEntryPoint = "main";
+};
+
+struct ShaderCompilerStatistics
+{
+	//Requests served by a SPIR-V file already in the cache
+	uint64_t mCacheHitCount = 0;
+
+	uint64_t mCompiledCount = 0;
+
+	double mTotalCompileMs = 0.0;
+};
+
+/*
+	In process GLSL to SPIR-V build stage on top of glslang, no glslangValidator involved.
+
+	Outputs are content addressed: the key hashes the compiler settings, the stage, the entry point, the defines, the
+	source and the content of every file it includes (recursively). A shader is only compiled if that exact build was
+	never done before, by this run or a previous one, and editing an include rebuilds exactly the shaders using it.
+	The SPIR-V lands in the cache directory as <key>.spv, ready to be mapped by ShaderBinaryCache.
+
+	Includes (#include "..." with GL_GOOGLE_include_directive) are resolved relative to the including file. The key is
+	computed by scanning the #include lines without preprocessing, so an include inside a disabled #if still counts: at
+	worst an edit to it triggers a rebuild that wasn't needed.
+
+	Thread safe. CompileAll() builds a batch of shaders, or variants of the same one, across the task system's threads.
+*/
+class ShaderCompiler
+{
+public:
+
+	//Bump when anything that changes the output without changing the inputs does (settings, glslang upgrade ...)
+	static constexpr uint32_t kCompilerVersion = 1;
+
+	explicit ShaderCompiler(const std::string& CacheDirectory)
+		: mStore(CacheDirectory, ".spv")
+	{
+		glslang::InitializeProcess();
+	}
+
+	~ShaderCompiler()
+	{
+		glslang::FinalizeProcess();
+	}
+
+	ShaderCompiler(const ShaderCompiler&) = delete;
+	ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+	//Path of the SPIR-V built from Request, compiled now if it isn't in the cache yet
+	std::string Compile(const ShaderCompileRequest& Request)
+	{
+		const std::string Source = ReadFile(Request.mPath);
+		const uint64_t Key = ComputeKey(Request, Source);
+		const std::string Path = mStore.GetPath(Key);
+
+		if (mStore.Contains(Key))
+		{
+			std::lock_guard<std::mutex> Lock(mMutex);
+			++mStatistics.mCacheHitCount;
+			return Path;
+		}
+
+		const auto Start = std::chrono::high_resolution_clock::now();
+		const std::vector<uint32_t> Spirv = CompileToSpirv(Request, Source);
+		const double Ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - Start).count();
+
+		if (!mStore.Store(Key, Spirv.data(), Spirv.size() * sizeof(uint32_t)))
+		{
+			throw std::runtime_error("Failed to write " + Path + "!");
+		}
+
+		std::lock_guard<std::mutex> Lock(mMutex);
+		++mStatistics.mCompiledCount;
+		mStatistics.mTotalCompileMs += Ms;
+		return Path;
+	}
+
+	//Compile a batch in parallel, identical requests only once. Paths come back in the order of the requests.
+	std::vector<std::string> CompileAll(const std::vector<ShaderCompileRequest>& Requests, TaskSystem& Tasks)
+	{
+		std::vector<std::string> Paths(Requests.size());
+		Tasks.ParallelFor(static_cast<uint32_t>(Requests.size()), [&](uint32_t i)
+		{
+			for (uint32_t j = 0; j < i; ++j)
+			{
+				if (IsSameRequest(Requests[i], Requests[j]))
+				{
+					return;
+				}
+			}
+			Paths[i] = Compile(Requests[i]);
+		});
+
+		for (size_t i = 0; i < Requests.size(); ++i)
+		{
+			for (size_t j = 0; j < i && Paths[i].empty(); ++j)
+			{
+				if (IsSameRequest(Requests[i], Requests[j]))
+				{
+					Paths[i] = Paths[j];
+				}
+			}
+		}
+		return Paths;
+	}
+
+	uint64_t ComputeKey(const ShaderCompileRequest& Request)
+	{
+		return ComputeKey(Request, ReadFile(Request.mPath));
+	}
+
+	ShaderCompilerStatistics GetStatistics()
+	{
+		std::lock_guard<std::mutex> Lock(mMutex);
+		return mStatistics;
+	}
+
+	static EShLanguage GetStage(const std::string& Path)
+	{
+		static const std::pair<const char*, EShLanguage> kExtensions[] =
+		{
+			{ ".vert", EShLangVertex },
+			{ ".tesc", EShLangTessControl },
+			{ ".tese", EShLangTessEvaluation },
+			{ ".geom", EShLangGeometry },
+			{ ".frag", EShLangFragment },
+			{ ".comp", EShLangCompute }
+		};
+
+		const size_t Dot = Path.find_last_of('.');
+		const std::string Extension = Dot != std::string::npos ? Path.substr(Dot) : std::string();
+		for (const auto& Entry : kExtensions)
+		{
+			if (Extension == Entry.first)
+			{
+				return Entry.second;
+			}
+		}
+		throw std::runtime_error("Unknown shader stage for " + Path + "!");
+	}
+
+private:
+
+	//Includes are read straight from disk, relative to the file including them
+	class FileIncluder : public glslang::TShader::Includer
+	{
+	public:
+
+		IncludeResult* includeLocal(const char* HeaderName, const char* IncluderName, size_t) override
+		{
+			const std::string Path = GetDirectory(IncluderName != nullptr ? IncluderName : "") + HeaderName;
+			std::ifstream File(Path, std::ios::binary);
+			if (!File.is_open())
+			{
+				return nullptr;
+			}
+
+			std::string* Content = new std::string(std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>());
+			return new IncludeResult(Path, Content->data(), Content->size(), Content);
+		}
+
+		IncludeResult* includeSystem(const char* HeaderName, const char* IncluderName, size_t Depth) override
+		{
+			return includeLocal(HeaderName, IncluderName, Depth);
+		}
+
+		void releaseInclude(IncludeResult* Result) override
+		{
+			if (Result != nullptr)
+			{
+				delete static_cast<std::string*>(Result->userData);
+				delete Result;
+			}
+		}
+	};
+
+	static bool IsSameRequest(const ShaderCompileRequest& A, const ShaderCompileRequest& B)
+	{
+		return A.mPath == B.mPath && A.mDefines == B.mDefines && A.mEntryPoint == B.mEntryPoint;
+	}
+
+	static std::string ReadFile(const std::string& Path)
+	{
+		std::ifstream File(Path, std::ios::binary);
+		if (!File.is_open())
+		{
+			throw std::runtime_error("Failed to open shader " + Path + "!");
+		}
+		return std::string(std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>());
+	}
+
+	static std::string GetDirectory(const std::string& Path)
+	{
+		const size_t Slash = Path.find_last_of("/\\");
+		return Slash != std::string::npos ? Path.substr(0, Slash + 1) : std::string();
+	}
+
+#ifdef NDEBUG
+	static constexpr bool kGenerateDebugInfo = false;
+#else
+	static constexpr bool kGenerateDebugInfo = true;
+#endif
+
+	uint64_t ComputeKey(const ShaderCompileRequest& Request, const std::string& Source) const
+	{
+		uint64_t Key = HashValue(kCompilerVersion);
+		Key = HashCombine(Key, kGenerateDebugInfo ? 1 : 0);
+		Key = HashCombine(Key, static_cast<uint64_t>(GetStage(Request.mPath)));
+		Key = HashString(Request.mEntryPoint, Key);
+		for (const auto& Define : Request.mDefines)
+		{
+			Key = HashString(Define.first, Key);
+			Key = HashString(Define.second, Key);
+		}
+		Key = HashString(Source, Key);
+
+		std::set<std::string> Visited;
+		HashIncludes(Source, GetDirectory(Request.mPath), Key, Visited);
+		return Key;
+	}
+
+	//Hash the name and content of every file included by Source, depth first, each file once
+	static void HashIncludes(const std::string& Source, const std::string& Directory, uint64_t& Key, std::set<std::string>& Visited)
+	{
+		size_t LineStart = 0;
+		while (LineStart < Source.size())
+		{
+			size_t LineEnd = Source.find('\n', LineStart);
+			if (LineEnd == std::string::npos)
+			{
+				LineEnd = Source.size();
+			}
+
+			std::string Name;
+			if (ParseInclude(Source, LineStart, LineEnd, Name))
+			{
+				const std::string Path = Directory + Name;
+				Key = HashString(Name, Key);
+				if (Visited.insert(Path).second)
+				{
+					std::ifstream File(Path, std::ios::binary);
+					if (File.is_open())
+					{
+						const std::string Content((std::istreambuf_iterator<char>(File)), std::istreambuf_iterator<char>());
+						Key = HashString(Content, Key);
+						HashIncludes(Content, GetDirectory(Path), Key, Visited);
+					}
+				}
+			}
+			LineStart = LineEnd + 1;
+		}
+	}
+
+	//#include "Name" or #include <Name>, with any white space in between
+	static bool ParseInclude(const std::string& Source, size_t Begin, size_t End, std::string& Name)
+	{
+		auto SkipSpaces = [&](size_t Position)
+		{
+			while (Position < End && (Source[Position] == ' ' || Source[Position] == '\t'))
+			{
+				++Position;
+			}
+			return Position;
+		};
+
+		static const std::string kInclude = "include";
+
+		size_t Position = SkipSpaces(Begin);
+		if (Position >= End || Source[Position] != '#')
+		{
+			return false;
+		}
+		Position = SkipSpaces(Position + 1);
+		if (Source.compare(Position, kInclude.size(), kInclude) != 0)
+		{
+			return false;
+		}
+		Position = SkipSpaces(Position + kInclude.size());
+		if (Position >= End || (Source[Position] != '"' && Source[Position] != '<'))
+		{
+			return false;
+		}
+
+		const char Closing = Source[Position] == '"' ? '"' : '>';
+		const size_t NameEnd = Source.find(Closing, Position + 1);
+		if (NameEnd == std::string::npos || NameEnd >= End)
+		{
+			return false;
+		}
+		Name = Source.substr(Position + 1, NameEnd - Position - 1);
+		return true;
+	}
+
+	std::vector<uint32_t> CompileToSpirv(const ShaderCompileRequest& Request, const std::string& Source) const
+	{
+		const EShLanguage Stage = GetStage(Request.mPath);
+
+		std::string Preamble;
+		for (const auto& Define : Request.mDefines)
+		{
+			Preamble += "#define " + Define.first + " " + Define.second + "\n";
+		}
+
+		glslang::TShader Shader(Stage);
+		const char* Strings[] = { Source.c_str() };
+		const int Lengths[] = { static_cast<int>(Source.size()) };
+		const char* Names[] = { Request.mPath.c_str() };
+		Shader.setStringsWithLengthsAndNames(Strings, Lengths, Names, 1);
+		Shader.setPreamble(Preamble.c_str());
+		Shader.setEntryPoint(Request.mEntryPoint.c_str());
+		Shader.setSourceEntryPoint(Request.mEntryPoint.c_str());
+		Shader.setEnvInput(glslang::EShSourceGlsl, Stage, glslang::EShClientVulkan, 100);
+		Shader.setEnvClient(glslang::EShClientVulkan, glslang::EShTargetVulkan_1_0);
+		Shader.setEnvTarget(glslang::EShTargetSpv, glslang::EShTargetSpv_1_0);
+
+		const EShMessages Messages = static_cast<EShMessages>(EShMsgSpvRules | EShMsgVulkanRules);
+		FileIncluder Includer;
+		if (!Shader.parse(GetDefaultResources(), 100, false, Messages, Includer))
+		{
+			throw std::runtime_error("Failed to compile " + Request.mPath + ":\n" + Shader.getInfoLog());
+		}
+
+		glslang::TProgram Program;
+		Program.addShader(&Shader);
+		if (!Program.link(Messages))
+		{
+			throw std::runtime_error("Failed to link " + Request.mPath + ":\n" + Program.getInfoLog());
+		}
+
+		glslang::SpvOptions Options;
+		Options.generateDebugInfo = kGenerateDebugInfo;
+		Options.disableOptimizer = kGenerateDebugInfo;
+
+		std::vector<uint32_t> Spirv;
+		glslang::GlslangToSpv(*Program.getIntermediate(Stage), Spirv, &Options);
+		return Spirv;
+	}
+
+	ContentAddressedStore mStore;
+
+	std::mutex mMutex;
+
+	ShaderCompilerStatistics mStatistics;
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//One axis of a variant space: a specialization constant (layout(constant_id = N) in GLSL) and every value worth building
+//a pipeline for. Booleans are VkBool32 (VK_FALSE / VK_TRUE), ints and uints are used as is: all of them are 4 bytes.
+struct SpecializationConstantDesc
+{
+	uint32_t mConstantId = 0;
+
+	//Name used in logs and on the command line
+	std::string mName;
+
+	std::vector<uint32_t> mValues;
+};
+
+/*
+	Every combination of a set of specialization constants, each one to be built as its own pipeline.
+
+	The driver compiles specialization constants as real constants: branches on a feature toggle disappear and loops with
+	a constant trip count get unrolled, so a variant costs nothing at run time compared to branching on uniforms. The
+	price is one pipeline per variant, which is why the space is spelled out declaratively and kept small.
+
+	Variants are numbered in mixed radix order, the first constant varying fastest. Every variant shares the same map
+	entries (constant i lives at offset 4 * i), only the data pointer differs.
+*/
+class ShaderVariantSet
+{
+public:
+
+	static constexpr uint32_t kInvalidVariant = ~0u;
+
+	explicit ShaderVariantSet(const std::vector<SpecializationConstantDesc>& Constants)
+		: mConstants(Constants)
+	{
+		uint32_t VariantCount = 1;
+		for (uint32_t i = 0; i < mConstants.size(); ++i)
+		{
+			if (mConstants[i].mValues.empty())
+			{
+				throw std::runtime_error("Specialization constant " + mConstants[i].mName + " has no value!");
+			}
+			VariantCount *= static_cast<uint32_t>(mConstants[i].mValues.size());
+
+			VkSpecializationMapEntry Entry = {};
+			Entry.constantID = mConstants[i].mConstantId;
+			Entry.offset = i * sizeof(uint32_t);
+			Entry.size = sizeof(uint32_t);
+			mMapEntries.push_back(Entry);
+		}
+
+		mValues.resize(VariantCount);
+		for (uint32_t Variant = 0; Variant < VariantCount; ++Variant)
+		{
+			uint32_t Remainder = Variant;
+			for (const auto& Constant : mConstants)
+			{
+				const uint32_t ValueCount = static_cast<uint32_t>(Constant.mValues.size());
+				mValues[Variant].push_back(Constant.mValues[Remainder % ValueCount]);
+				Remainder /= ValueCount;
+			}
+		}
+	}
+
+	uint32_t GetVariantCount() const
+	{
+		return static_cast<uint32_t>(mValues.size());
+	}
+
+	const std::vector<uint32_t>& GetValues(uint32_t Variant) const
+	{
+		return mValues[Variant];
+	}
+
+	//Points into the set: valid as long as it lives
+	VkSpecializationInfo GetSpecializationInfo(uint32_t Variant) const
+	{
+		VkSpecializationInfo Info = {};
+		Info.mapEntryCount = static_cast<uint32_t>(mMapEntries.size());
+		Info.pMapEntries = mMapEntries.data();
+		Info.dataSize = mValues[Variant].size() * sizeof(uint32_t);
+		Info.pData = mValues[Variant].data();
+		return Info;
+	}
+
+	//e.g. "GRAYSCALE=1 CONTRAST_PASSES=2"
+	std::string GetName(uint32_t Variant) const
+	{
+		std::string Name;
+		for (size_t i = 0; i < mConstants.size(); ++i)
+		{
+			Name += (i == 0 ? "" : " ") + mConstants[i].mName + "=" + std::to_string(mValues[Variant][i]);
+		}
+		return Name;
+	}
+
+	//Variant described by NAME=VALUE pairs separated by spaces or commas, constants left out take their first value.
+	//Returns kInvalidVariant if a name is unknown or a value wasn't part of the description.
+	uint32_t Find(const std::string& Description) const
+	{
+		std::vector<uint32_t> Values;
+		for (const auto& Constant : mConstants)
+		{
+			Values.push_back(Constant.mValues[0]);
+		}
+
+		std::string Pair;
+		std::istringstream Stream(Description);
+		while (std::getline(Stream, Pair, ','))
+		{
+			std::istringstream Words(Pair);
+			std::string Word;
+			while (Words >> Word)
+			{
+				const size_t Equal = Word.find('=');
+				if (Equal == std::string::npos)
+				{
+					return kInvalidVariant;
+				}
+
+				size_t Index = 0;
+				while (Index < mConstants.size() && mConstants[Index].mName != Word.substr(0, Equal))
+				{
+					++Index;
+				}
+				if (Index == mConstants.size())
+				{
+					return kInvalidVariant;
+				}
+				Values[Index] = static_cast<uint32_t>(strtoul(Word.c_str() + Equal + 1, nullptr, 10));
+			}
+		}
+
+		for (uint32_t Variant = 0; Variant < GetVariantCount(); ++Variant)
+		{
+			if (mValues[Variant] == Values)
+			{
+				return Variant;
+			}
+		}
+		return kInvalidVariant;
+	}
+
+private:
+
+	std::vector<SpecializationConstantDesc> mConstants;
+
+	std::vector<VkSpecializationMapEntry> mMapEntries;
+
+	//Constant values of every variant, in mConstants order
+	std::vector<std::vector<uint32_t>> mValues;
+};
@@ -1,4 +0,0 @@
-
-E:/VulkanSDK/1.1.97.0/Bin32/glslangValidator.exe -V Shader.vert  
-E:/VulkanSDK/1.1.97.0/Bin32/glslangValidator.exe -V Shader.frag  
-pause
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 fragNormal;
+
+layout(location = 0) out vec4 outColor;
+
+//Same block in both stages (see Mesh.vert)
+layout(push_constant) uniform MeshConstants
+{
+	mat4 ViewProjection;
+	vec4 Dequantize;
+	vec4 LightDirection;
+} Constants;
+
+//Fragment shader entry point: lambert plus some ambient, per pixel so that overdraw costs what it would with real materials
+void main() 
+{
+	float Diffuse = max(dot(normalize(fragNormal), Constants.LightDirection.xyz), 0.0);
+	outColor = vec4(vec3(0.15 + 0.85 * Diffuse), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+ out gl_PerVertex 
+ {
+	vec4 gl_Position;
+ };
+
+ //Same block in both stages (see Mesh.frag)
+ layout(push_constant) uniform MeshConstants
+ {
+	//World to clip space
+	mat4 ViewProjection;
+
+	//Quantized position to object space (MeshFileHeader half extent, normalized to a unit bounding sphere)
+	vec4 Dequantize;
+
+	//Toward the light, in world space
+	vec4 LightDirection;
+ } Constants;
+
+ //Per object data packed by the DrawBatcher (InstanceData in DrawBatcher.h)
+ struct InstanceData
+ {
+	mat4 Transform;
+ };
+
+ layout(std430, set = 0, binding = 0) readonly buffer InstanceBuffer
+ {
+	InstanceData Instances[];
+ };
+
+ //Vertex streams of a mesh file, laid out by VertexLayoutTraits<MeshPositionVertex> and <MeshNormalVertex> (MeshFile.h)
+ layout(location = 0) in vec4 inPosition;
+ layout(location = 1) in vec2 inNormal;
+
+ layout(location = 0) out vec3 fragNormal;
+
+ //Octahedral normal back to a unit vector (DecodeOctahedral() in MeshFile.h)
+ vec3 DecodeOctahedral(vec2 Encoded)
+ {
+	vec3 Normal = vec3(Encoded, 1.0 - abs(Encoded.x) - abs(Encoded.y));
+	float Fold = max(-Normal.z, 0.0);
+	Normal.xy += mix(vec2(Fold), vec2(-Fold), greaterThanEqual(Normal.xy, vec2(0.0)));
+	return normalize(Normal);
+ }
+
+ void main() 
+ {
+	mat4 Transform = Instances[gl_InstanceIndex].Transform;
+	gl_Position = Constants.ViewProjection * Transform * vec4(inPosition.xyz * Constants.Dequantize.xyz, 1.0);
+
+	//Instances are only ever moved and scaled uniformly, so the normal just needs normalizing again
+	fragNormal = mat3(Transform) * DecodeOctahedral(inNormal);
+ }
\ No newline at end of file
@@ -7,8 +7,27 @@ layout(location = 0) in vec3 fragColor;
 //Color output (i.e. like SV_Target0 in HLSL)
 layout(location = 0) out vec4 outColor;
 
+//Specialization constants: every combination listed in kFRAGMENT_VARIANTS (main.cpp) is built as its own pipeline,
+//so these are compile time constants in each of them
+layout(constant_id = 0) const bool GRAYSCALE = false;
+layout(constant_id = 1) const int CONTRAST_PASSES = 0;
+
 //Fragment shader entry point
 void main() 
 {
-	outColor = vec4(fragColor, 1.0);
+	vec3 Color = fragColor;
+
+	//Constant trip count: unrolled, or gone when 0
+	for (int i = 0; i < CONTRAST_PASSES; ++i)
+	{
+		Color = Color * Color * (3.0 - 2.0 * Color);
+	}
+
+	//Constant condition: no branch left in the variants
+	if (GRAYSCALE)
+	{
+		Color = vec3(dot(Color, vec3(0.299, 0.587, 0.114)));
+	}
+
+	outColor = vec4(Color, 1.0);
 }
\ No newline at end of file
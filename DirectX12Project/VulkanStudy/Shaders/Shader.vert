@@ -6,25 +6,25 @@
 	vec4 gl_Position;
  };
 
- layout(location = 0) out vec3 fragColor;
+ //Per object data packed by the DrawBatcher (InstanceData in DrawBatcher.h): the triangle's world is clip space
+ struct InstanceData
+ {
+	mat4 Transform;
+ };
+
+ layout(std430, set = 0, binding = 0) readonly buffer InstanceBuffer
+ {
+	InstanceData Instances[];
+ };
 
- vec2 positions[3] = vec2[]
- (
-	 vec2(0.0, -0.5),
-	 vec2(0.5, 0.5),
-	 vec2(-0.5, 0.5)
- );
+ //Vertex attributes, laid out by VertexLayoutTraits<ColoredVertex> (main.cpp)
+ layout(location = 0) in vec2 inPosition;
+ layout(location = 1) in vec3 inColor;
 
- vec3 colors[3] = vec3[]
- (
-	 vec3(1.0, 0.0, 0.0),
-	 vec3(0.0, 1.0, 0.0),
-	 vec3(0.0, 0.0, 1.0)
- );
+ layout(location = 0) out vec3 fragColor;
 
  void main() 
  {
-	gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-	fragColor = colors[gl_VertexIndex];
+	gl_Position = Instances[gl_InstanceIndex].Transform * vec4(inPosition, 0.0, 1.0);
+	fragColor = inColor;
  }
-
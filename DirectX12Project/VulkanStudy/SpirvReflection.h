@@ -0,0 +1,509 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//A binding of a descriptor set, as seen by one shader
+struct SpirvDescriptorBinding
+{
+	uint32_t mSet = 0;
+
+	//binding, type, count and stage (pImmutableSamplers is always null)
+	VkDescriptorSetLayoutBinding mBinding = {};
+};
+
+//An input of a vertex shader (layout(location = N) in ...)
+struct SpirvVertexInput
+{
+	uint32_t mLocation = 0;
+
+	VkFormat mFormat = VK_FORMAT_UNDEFINED;
+
+	//Size in bytes of one element in a tightly packed vertex
+	uint32_t mSize = 0;
+};
+
+/*
+	Reads what a pipeline needs to know about a shader straight out of its SPIR-V: the descriptor bindings, the push
+	constant block and, for vertex shaders, the vertex inputs. So layouts follow the shaders instead of being written by
+	hand next to them.
+
+	Only the handful of instructions that matter are decoded (entry point, decorations, types, constants and global
+	variables); everything else is skipped by word count. Resources declared but not used by the entry point are
+	reported as well, which at worst makes a layout a little larger than strictly needed.
+	Throws std::runtime_error on malformed modules and on what isn't supported (runtime sized arrays of descriptors,
+	matrix vertex inputs ...).
+*/
+class SpirvModule
+{
+public:
+
+	static constexpr uint32_t kSpirvMagic = 0x07230203;
+
+	//Size in bytes, as in SpirvBinary / VkShaderModuleCreateInfo
+	SpirvModule(const uint32_t* Code, size_t Size)
+	{
+		Parse(Code, Size / sizeof(uint32_t));
+	}
+
+	VkShaderStageFlagBits GetStage() const
+	{
+		return mStage;
+	}
+
+	//Sorted by set then binding
+	const std::vector<SpirvDescriptorBinding>& GetDescriptorBindings() const
+	{
+		return mDescriptorBindings;
+	}
+
+	//size is 0 if the shader has no push constants
+	const VkPushConstantRange& GetPushConstantRange() const
+	{
+		return mPushConstantRange;
+	}
+
+	//Sorted by location, empty for anything but vertex shaders
+	const std::vector<SpirvVertexInput>& GetVertexInputs() const
+	{
+		return mVertexInputs;
+	}
+
+private:
+
+	//The few opcodes, decorations and enums we care about (see the SPIR-V specification)
+	enum Op : uint32_t
+	{
+		OpEntryPoint = 15,
+		OpTypeBool = 20,
+		OpTypeInt = 21,
+		OpTypeFloat = 22,
+		OpTypeVector = 23,
+		OpTypeMatrix = 24,
+		OpTypeImage = 25,
+		OpTypeSampler = 26,
+		OpTypeSampledImage = 27,
+		OpTypeArray = 28,
+		OpTypeRuntimeArray = 29,
+		OpTypeStruct = 30,
+		OpTypePointer = 32,
+		OpConstant = 43,
+		OpSpecConstant = 50,
+		OpVariable = 59,
+		OpDecorate = 71,
+		OpMemberDecorate = 72,
+	};
+
+	enum Decoration : uint32_t
+	{
+		DecorationBlock = 2,
+		DecorationBufferBlock = 3,
+		DecorationArrayStride = 6,
+		DecorationMatrixStride = 7,
+		DecorationBuiltIn = 11,
+		DecorationLocation = 30,
+		DecorationBinding = 33,
+		DecorationDescriptorSet = 34,
+		DecorationOffset = 35,
+	};
+
+	enum StorageClass : uint32_t
+	{
+		StorageClassUniformConstant = 0,
+		StorageClassInput = 1,
+		StorageClassUniform = 2,
+		StorageClassPushConstant = 9,
+		StorageClassStorageBuffer = 12,
+	};
+
+	static constexpr uint32_t kNone = ~0u;
+
+	//Image dimensions that aren't regular images
+	static constexpr uint32_t kDimBuffer = 5;
+	static constexpr uint32_t kDimSubpassData = 6;
+
+	//Everything known about one id
+	struct Id
+	{
+		//Defining instruction (types and constants only) and its operands after the result id
+		uint32_t mOpcode = 0;
+		std::vector<uint32_t> mOperands;
+
+		uint32_t mSet = kNone;
+		uint32_t mBinding = kNone;
+		uint32_t mLocation = kNone;
+		uint32_t mArrayStride = kNone;
+		bool mBuiltIn = false;
+		bool mBlock = false;
+		bool mBufferBlock = false;
+
+		//Struct members: Offset and MatrixStride decorations
+		std::vector<uint32_t> mMemberOffsets;
+		std::vector<uint32_t> mMemberMatrixStrides;
+	};
+
+	struct Variable
+	{
+		uint32_t mId = 0;
+		uint32_t mPointerType = 0;
+		uint32_t mStorageClass = 0;
+	};
+
+	void Parse(const uint32_t* Code, size_t WordCount)
+	{
+		if (WordCount < 5 || Code[0] != kSpirvMagic)
+		{
+			throw std::runtime_error("Invalid SPIR-V module!");
+		}
+
+		mIds.resize(Code[3]);
+		bool HasEntryPoint = false;
+		std::vector<Variable> Variables;
+
+		for (size_t Word = 5; Word < WordCount;)
+		{
+			const uint32_t Opcode = Code[Word] & 0xFFFF;
+			const uint32_t Length = Code[Word] >> 16;
+			if (Length == 0 || Word + Length > WordCount)
+			{
+				throw std::runtime_error("Invalid SPIR-V module: truncated instruction!");
+			}
+			const uint32_t* Operands = Code + Word + 1;
+			const uint32_t OperandCount = Length - 1;
+
+			switch (Opcode)
+			{
+			case OpEntryPoint:
+				//The first entry point wins, our shaders have a single one
+				if (!HasEntryPoint && OperandCount >= 1)
+				{
+					mStage = ToStage(Operands[0]);
+					HasEntryPoint = true;
+				}
+				break;
+
+			case OpDecorate:
+				if (OperandCount >= 2)
+				{
+					Id& Target = GetId(Operands[0]);
+					const uint32_t Value = OperandCount >= 3 ? Operands[2] : 0;
+					switch (Operands[1])
+					{
+					case DecorationBlock: Target.mBlock = true; break;
+					case DecorationBufferBlock: Target.mBufferBlock = true; break;
+					case DecorationArrayStride: Target.mArrayStride = Value; break;
+					case DecorationBuiltIn: Target.mBuiltIn = true; break;
+					case DecorationLocation: Target.mLocation = Value; break;
+					case DecorationBinding: Target.mBinding = Value; break;
+					case DecorationDescriptorSet: Target.mSet = Value; break;
+					default: break;
+					}
+				}
+				break;
+
+			case OpMemberDecorate:
+				if (OperandCount >= 4 && (Operands[2] == DecorationOffset || Operands[2] == DecorationMatrixStride))
+				{
+					Id& Target = GetId(Operands[0]);
+					std::vector<uint32_t>& Values = Operands[2] == DecorationOffset ? Target.mMemberOffsets : Target.mMemberMatrixStrides;
+					if (Values.size() <= Operands[1])
+					{
+						Values.resize(Operands[1] + 1, kNone);
+					}
+					Values[Operands[1]] = Operands[3];
+				}
+				break;
+
+			case OpTypeBool: case OpTypeInt: case OpTypeFloat: case OpTypeVector: case OpTypeMatrix:
+			case OpTypeImage: case OpTypeSampler: case OpTypeSampledImage: case OpTypeArray:
+			case OpTypeRuntimeArray: case OpTypeStruct: case OpTypePointer:
+				if (OperandCount >= 1)
+				{
+					Id& Type = GetId(Operands[0]);
+					Type.mOpcode = Opcode;
+					Type.mOperands.assign(Operands + 1, Operands + OperandCount);
+				}
+				break;
+
+			case OpConstant: case OpSpecConstant:
+				//Result type, result id, value (low word is all an array length needs)
+				if (OperandCount >= 3)
+				{
+					Id& Constant = GetId(Operands[1]);
+					Constant.mOpcode = Opcode;
+					Constant.mOperands.assign(1, Operands[2]);
+				}
+				break;
+
+			case OpVariable:
+				if (OperandCount >= 3)
+				{
+					Variables.push_back({ Operands[1], Operands[0], Operands[2] });
+				}
+				break;
+
+			default:
+				break;
+			}
+
+			Word += Length;
+		}
+
+		if (!HasEntryPoint)
+		{
+			throw std::runtime_error("Invalid SPIR-V module: no entry point!");
+		}
+
+		for (const auto& Var : Variables)
+		{
+			ReflectVariable(Var);
+		}
+
+		std::sort(mDescriptorBindings.begin(), mDescriptorBindings.end(), [](const SpirvDescriptorBinding& A, const SpirvDescriptorBinding& B)
+		{
+			return A.mSet != B.mSet ? A.mSet < B.mSet : A.mBinding.binding < B.mBinding.binding;
+		});
+		std::sort(mVertexInputs.begin(), mVertexInputs.end(), [](const SpirvVertexInput& A, const SpirvVertexInput& B)
+		{
+			return A.mLocation < B.mLocation;
+		});
+	}
+
+	void ReflectVariable(const Variable& Var)
+	{
+		const Id& Decorations = GetId(Var.mId);
+		const Id& Pointer = GetId(Var.mPointerType);
+		if (Pointer.mOpcode != OpTypePointer || Pointer.mOperands.size() < 2)
+		{
+			return;
+		}
+		uint32_t TypeId = Pointer.mOperands[1];
+
+		switch (Var.mStorageClass)
+		{
+		case StorageClassUniformConstant:
+		case StorageClassUniform:
+		case StorageClassStorageBuffer:
+		{
+			if (Decorations.mBinding == kNone)
+			{
+				return;
+			}
+
+			//Arrays of descriptors, possibly multi dimensional
+			uint32_t Count = 1;
+			while (GetId(TypeId).mOpcode == OpTypeArray || GetId(TypeId).mOpcode == OpTypeRuntimeArray)
+			{
+				const Id& Array = GetId(TypeId);
+				if (Array.mOpcode == OpTypeRuntimeArray)
+				{
+					throw std::runtime_error("SPIR-V reflection: runtime sized descriptor arrays are not supported!");
+				}
+				Count *= GetConstant(Array.mOperands.at(1));
+				TypeId = Array.mOperands.at(0);
+			}
+
+			SpirvDescriptorBinding Binding;
+			Binding.mSet = Decorations.mSet != kNone ? Decorations.mSet : 0;
+			Binding.mBinding.binding = Decorations.mBinding;
+			Binding.mBinding.descriptorType = ToDescriptorType(Var.mStorageClass, GetId(TypeId));
+			Binding.mBinding.descriptorCount = Count;
+			Binding.mBinding.stageFlags = mStage;
+			mDescriptorBindings.push_back(Binding);
+			break;
+		}
+
+		case StorageClassPushConstant:
+		{
+			const Id& Block = GetId(TypeId);
+			if (Block.mOpcode != OpTypeStruct || Block.mOperands.empty())
+			{
+				return;
+			}
+
+			uint32_t Begin = kNone;
+			for (auto Offset : Block.mMemberOffsets)
+			{
+				Begin = std::min(Begin, Offset);
+			}
+			mPushConstantRange.stageFlags = mStage;
+			mPushConstantRange.offset = Begin != kNone ? Begin : 0;
+			mPushConstantRange.size = GetSize(TypeId) - mPushConstantRange.offset;
+			break;
+		}
+
+		case StorageClassInput:
+			//Built ins (gl_VertexIndex ...) have no location and no vertex data behind them
+			if (mStage == VK_SHADER_STAGE_VERTEX_BIT && !Decorations.mBuiltIn && Decorations.mLocation != kNone)
+			{
+				SpirvVertexInput Input;
+				Input.mLocation = Decorations.mLocation;
+				Input.mFormat = ToVertexFormat(GetId(TypeId));
+				Input.mSize = GetSize(TypeId);
+				mVertexInputs.push_back(Input);
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	//Size in bytes of a type laid out with explicit offsets and strides (push constant blocks, vertex inputs)
+	uint32_t GetSize(uint32_t TypeId, uint32_t MatrixStride = kNone) const
+	{
+		const Id& Type = GetId(TypeId);
+		switch (Type.mOpcode)
+		{
+		case OpTypeBool:
+			return 4;
+		case OpTypeInt:
+		case OpTypeFloat:
+			return Type.mOperands.at(0) / 8;
+		case OpTypeVector:
+			return Type.mOperands.at(1) * GetSize(Type.mOperands.at(0));
+		case OpTypeMatrix:
+			return Type.mOperands.at(1) * (MatrixStride != kNone ? MatrixStride : GetSize(Type.mOperands.at(0)));
+		case OpTypeArray:
+		{
+			const uint32_t Stride = Type.mArrayStride != kNone ? Type.mArrayStride : GetSize(Type.mOperands.at(0));
+			return GetConstant(Type.mOperands.at(1)) * Stride;
+		}
+		case OpTypeStruct:
+		{
+			uint32_t Size = 0;
+			uint32_t PackedOffset = 0;
+			for (size_t Member = 0; Member < Type.mOperands.size(); ++Member)
+			{
+				const uint32_t Offset = Member < Type.mMemberOffsets.size() && Type.mMemberOffsets[Member] != kNone ? Type.mMemberOffsets[Member] : PackedOffset;
+				const uint32_t Stride = Member < Type.mMemberMatrixStrides.size() ? Type.mMemberMatrixStrides[Member] : kNone;
+				PackedOffset = Offset + GetSize(Type.mOperands[Member], Stride);
+				Size = std::max(Size, PackedOffset);
+			}
+			return Size;
+		}
+		default:
+			throw std::runtime_error("SPIR-V reflection: can't size type " + std::to_string(TypeId) + "!");
+		}
+	}
+
+	uint32_t GetConstant(uint32_t ConstantId) const
+	{
+		const Id& Constant = GetId(ConstantId);
+		if ((Constant.mOpcode != OpConstant && Constant.mOpcode != OpSpecConstant) || Constant.mOperands.empty())
+		{
+			throw std::runtime_error("SPIR-V reflection: array length is not a constant!");
+		}
+		return Constant.mOperands[0];
+	}
+
+	VkDescriptorType ToDescriptorType(uint32_t StorageClass, const Id& Type) const
+	{
+		if (StorageClass == StorageClassStorageBuffer || (StorageClass == StorageClassUniform && Type.mBufferBlock))
+		{
+			return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		}
+		if (StorageClass == StorageClassUniform)
+		{
+			return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		}
+
+		switch (Type.mOpcode)
+		{
+		case OpTypeSampler:
+			return VK_DESCRIPTOR_TYPE_SAMPLER;
+		case OpTypeSampledImage:
+			return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		case OpTypeImage:
+		{
+			//Operands: sampled type, dim, depth, arrayed, multisampled, sampled (1 with a sampler, 2 for storage) ...
+			const uint32_t Dim = Type.mOperands.at(1);
+			const bool Storage = Type.mOperands.at(5) == 2;
+			if (Dim == kDimSubpassData)
+			{
+				return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			}
+			if (Dim == kDimBuffer)
+			{
+				return Storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			}
+			return Storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		}
+		default:
+			throw std::runtime_error("SPIR-V reflection: unsupported descriptor type!");
+		}
+	}
+
+	VkFormat ToVertexFormat(const Id& Type) const
+	{
+		uint32_t ComponentCount = 1;
+		const Id* Component = &Type;
+		if (Type.mOpcode == OpTypeVector)
+		{
+			ComponentCount = Type.mOperands.at(1);
+			Component = &GetId(Type.mOperands.at(0));
+		}
+
+		if ((Component->mOpcode == OpTypeFloat || Component->mOpcode == OpTypeInt) && Component->mOperands.at(0) == 32 && ComponentCount <= 4)
+		{
+			static const VkFormat kFloatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+			static const VkFormat kSintFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+			static const VkFormat kUintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+			if (Component->mOpcode == OpTypeFloat)
+			{
+				return kFloatFormats[ComponentCount - 1];
+			}
+			//OpTypeInt operands: width, signedness
+			return Component->mOperands.at(1) != 0 ? kSintFormats[ComponentCount - 1] : kUintFormats[ComponentCount - 1];
+		}
+		throw std::runtime_error("SPIR-V reflection: unsupported vertex input type!");
+	}
+
+	static VkShaderStageFlagBits ToStage(uint32_t ExecutionModel)
+	{
+		switch (ExecutionModel)
+		{
+		case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+		case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+		case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+		case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+		case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+		case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+		default: throw std::runtime_error("SPIR-V reflection: unsupported execution model!");
+		}
+	}
+
+	Id& GetId(uint32_t IdValue)
+	{
+		if (IdValue >= mIds.size())
+		{
+			throw std::runtime_error("Invalid SPIR-V module: id out of bounds!");
+		}
+		return mIds[IdValue];
+	}
+
+	const Id& GetId(uint32_t IdValue) const
+	{
+		if (IdValue >= mIds.size())
+		{
+			throw std::runtime_error("Invalid SPIR-V module: id out of bounds!");
+		}
+		return mIds[IdValue];
+	}
+
+	VkShaderStageFlagBits mStage = VK_SHADER_STAGE_VERTEX_BIT;
+
+	std::vector<Id> mIds;
+
+	std::vector<SpirvDescriptorBinding> mDescriptorBindings;
+
+	VkPushConstantRange mPushConstantRange = {};
+
+	std::vector<SpirvVertexInput> mVertexInputs;
+};
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "DeviceMemoryAllocator.h"
+#include "FrameScheduler.h"
+#include "../Common/RingAllocator.h"
+
+struct StagingAllocation
+{
+	VkBuffer mBuffer = VK_NULL_HANDLE;
+
+	VkDeviceSize mOffset = 0;
+
+	void* mMappedData = nullptr;
+};
+
+//One region of an image upload: the texels of Data go where Region says (its bufferOffset is filled in by the ring)
+struct StagingImageRegion
+{
+	const void* mData = nullptr;
+
+	VkDeviceSize mSize = 0;
+
+	VkBufferImageCopy mRegion = {};
+};
+
+/*
+	Persistent, persistently mapped staging buffer carved with a RingAllocator: the Vulkan side of D3D12UploadRing.
+
+	Allocations made while recording a frame are retired with the frame timeline value that frame's submission signals,
+	so they're reused as soon as the GPU is done with them and never need a dedicated staging buffer and fence.
+	When the ring is full the oldest frame in flight is waited for.
+
+		StagingRing.BeginFrame();       //after waiting for the frame slot
+		StagingRing.UploadBuffer(...);  //while recording
+		StagingRing.EndFrame();         //right before the submission that signals FrameScheduler::GetNextFrameValue()
+*/
+class StagingRing
+{
+public:
+
+	StagingRing() = default;
+
+	StagingRing(const StagingRing&) = delete;
+	StagingRing& operator=(const StagingRing&) = delete;
+
+	void Create(VkDevice Device, DeviceMemoryAllocator& Allocator, FrameScheduler& Scheduler, VkDeviceSize Size)
+	{
+		mDevice = Device;
+		mAllocator = &Allocator;
+		mScheduler = &Scheduler;
+		mRing.Reset(Size);
+
+		VkBufferCreateInfo BufferInfo = {};
+		BufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		BufferInfo.size = Size;
+		BufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		BufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vkCreateBuffer(mDevice, &BufferInfo, nullptr, &mBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create the staging buffer!");
+		}
+
+		//Coherent, so the writes don't need flushing before the submission
+		mAllocation = mAllocator->AllocateForBuffer(mBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		if (mAllocation.mMappedData == nullptr)
+		{
+			throw std::runtime_error("Staging buffer memory isn't mapped!");
+		}
+	}
+
+	//The GPU must be done with the ring
+	void Destroy()
+	{
+		if (mBuffer != VK_NULL_HANDLE)
+		{
+			vkDestroyBuffer(mDevice, mBuffer, nullptr);
+			mAllocator->Free(mAllocation);
+			mBuffer = VK_NULL_HANDLE;
+		}
+	}
+
+	//Give back the space of the frames the GPU has completed
+	void BeginFrame()
+	{
+		mRing.Retire(mScheduler->GetCompletedValue());
+	}
+
+	//Everything allocated since BeginFrame() belongs to the frame about to be submitted
+	void EndFrame()
+	{
+		mRing.FinishFrame(mScheduler->GetNextFrameValue());
+	}
+
+	//Size bytes aligned to Alignment, valid until the current frame completes on the GPU
+	StagingAllocation Allocate(VkDeviceSize Size, VkDeviceSize Alignment = 16)
+	{
+		const uint64_t Offset = mRing.AllocateOrWait(Size, Alignment, [this](uint64_t Value) { mScheduler->WaitForValue(Value); });
+		if (Offset == RingAllocator::kInvalidOffset)
+		{
+			throw std::runtime_error("Staging ring too small for the request!");
+		}
+
+		StagingAllocation Allocation;
+		Allocation.mBuffer = mBuffer;
+		Allocation.mOffset = Offset;
+		Allocation.mMappedData = static_cast<char*>(mAllocation.mMappedData) + Offset;
+		return Allocation;
+	}
+
+	//Copy Data into Destination at DestinationOffset
+	void UploadBuffer(VkCommandBuffer CommandBuffer, VkBuffer Destination, VkDeviceSize DestinationOffset, const void* Data, VkDeviceSize Size)
+	{
+		StagingAllocation Allocation = Allocate(Size, 4);
+		std::memcpy(Allocation.mMappedData, Data, static_cast<size_t>(Size));
+
+		VkBufferCopy Copy = {};
+		Copy.srcOffset = Allocation.mOffset;
+		Copy.dstOffset = DestinationOffset;
+		Copy.size = Size;
+		vkCmdCopyBuffer(CommandBuffer, Allocation.mBuffer, Destination, 1, &Copy);
+	}
+
+	//Upload every region (mips, layers ...) of Image, created with Format, through a single staging range and a single
+	//copy command. Image must be in DestinationLayout (TRANSFER_DST_OPTIMAL or GENERAL).
+	void UploadImage(VkCommandBuffer CommandBuffer, VkImage Image, VkFormat Format, VkImageLayout DestinationLayout, const StagingImageRegion* Regions, uint32_t RegionCount)
+	{
+		//Offsets must be multiples of the texel block size and of 4
+		const VkDeviceSize RegionAlignment = std::lcm(GetTexelBlockSize(Format), VkDeviceSize(4));
+
+		VkDeviceSize TotalSize = 0;
+		for (uint32_t i = 0; i < RegionCount; ++i)
+		{
+			TotalSize = RingAllocator::AlignUp(TotalSize, RegionAlignment) + Regions[i].mSize;
+		}
+
+		StagingAllocation Allocation = Allocate(TotalSize, RegionAlignment);
+
+		std::vector<VkBufferImageCopy> Copies(RegionCount);
+		VkDeviceSize RegionOffset = 0;
+		for (uint32_t i = 0; i < RegionCount; ++i)
+		{
+			RegionOffset = RingAllocator::AlignUp(RegionOffset, RegionAlignment);
+			std::memcpy(static_cast<char*>(Allocation.mMappedData) + RegionOffset, Regions[i].mData, static_cast<size_t>(Regions[i].mSize));
+
+			Copies[i] = Regions[i].mRegion;
+			Copies[i].bufferOffset = Allocation.mOffset + RegionOffset;
+			RegionOffset += Regions[i].mSize;
+		}
+
+		vkCmdCopyBufferToImage(CommandBuffer, Allocation.mBuffer, Image, DestinationLayout, RegionCount, Copies.data());
+	}
+
+	//Bytes of a texel, or of a compressed block. Depth/stencil formats give the size of their depth aspect (a stencil
+	//only copy is 1 byte per texel, and any depth/stencil copy needs 4 byte aligned offsets anyway).
+	static VkDeviceSize GetTexelBlockSize(VkFormat Format)
+	{
+		if (Format == VK_FORMAT_R4G4_UNORM_PACK8 || Format == VK_FORMAT_S8_UINT ||
+			(Format >= VK_FORMAT_R8_UNORM && Format <= VK_FORMAT_R8_SRGB))
+		{
+			return 1;
+		}
+		if ((Format >= VK_FORMAT_R4G4B4A4_UNORM_PACK16 && Format <= VK_FORMAT_A1R5G5B5_UNORM_PACK16) ||
+			(Format >= VK_FORMAT_R8G8_UNORM && Format <= VK_FORMAT_R8G8_SRGB) ||
+			(Format >= VK_FORMAT_R16_UNORM && Format <= VK_FORMAT_R16_SFLOAT) ||
+			Format == VK_FORMAT_D16_UNORM || Format == VK_FORMAT_D16_UNORM_S8_UINT)
+		{
+			return 2;
+		}
+		if (Format >= VK_FORMAT_R8G8B8_UNORM && Format <= VK_FORMAT_B8G8R8_SRGB)
+		{
+			return 3;
+		}
+		if ((Format >= VK_FORMAT_R8G8B8A8_UNORM && Format <= VK_FORMAT_A2B10G10R10_SINT_PACK32) ||
+			(Format >= VK_FORMAT_R16G16_UNORM && Format <= VK_FORMAT_R16G16_SFLOAT) ||
+			(Format >= VK_FORMAT_R32_UINT && Format <= VK_FORMAT_R32_SFLOAT) ||
+			Format == VK_FORMAT_B10G11R11_UFLOAT_PACK32 || Format == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32 ||
+			Format == VK_FORMAT_X8_D24_UNORM_PACK32 || Format == VK_FORMAT_D32_SFLOAT ||
+			Format == VK_FORMAT_D24_UNORM_S8_UINT || Format == VK_FORMAT_D32_SFLOAT_S8_UINT)
+		{
+			return 4;
+		}
+		if (Format >= VK_FORMAT_R16G16B16_UNORM && Format <= VK_FORMAT_R16G16B16_SFLOAT)
+		{
+			return 6;
+		}
+		if ((Format >= VK_FORMAT_R16G16B16A16_UNORM && Format <= VK_FORMAT_R16G16B16A16_SFLOAT) ||
+			(Format >= VK_FORMAT_R32G32_UINT && Format <= VK_FORMAT_R32G32_SFLOAT) ||
+			(Format >= VK_FORMAT_R64_UINT && Format <= VK_FORMAT_R64_SFLOAT) ||
+			(Format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && Format <= VK_FORMAT_BC1_RGBA_SRGB_BLOCK) ||
+			Format == VK_FORMAT_BC4_UNORM_BLOCK || Format == VK_FORMAT_BC4_SNORM_BLOCK ||
+			(Format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && Format <= VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK) ||
+			Format == VK_FORMAT_EAC_R11_UNORM_BLOCK || Format == VK_FORMAT_EAC_R11_SNORM_BLOCK)
+		{
+			return 8;
+		}
+		if (Format >= VK_FORMAT_R32G32B32_UINT && Format <= VK_FORMAT_R32G32B32_SFLOAT)
+		{
+			return 12;
+		}
+		if ((Format >= VK_FORMAT_R32G32B32A32_UINT && Format <= VK_FORMAT_R32G32B32A32_SFLOAT) ||
+			(Format >= VK_FORMAT_R64G64_UINT && Format <= VK_FORMAT_R64G64_SFLOAT) ||
+			(Format >= VK_FORMAT_BC2_UNORM_BLOCK && Format <= VK_FORMAT_BC3_SRGB_BLOCK) ||
+			(Format >= VK_FORMAT_BC5_UNORM_BLOCK && Format <= VK_FORMAT_BC7_SRGB_BLOCK) ||
+			Format == VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK || Format == VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK ||
+			Format == VK_FORMAT_EAC_R11G11_UNORM_BLOCK || Format == VK_FORMAT_EAC_R11G11_SNORM_BLOCK ||
+			(Format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && Format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK))
+		{
+			return 16;
+		}
+		if (Format >= VK_FORMAT_R64G64B64_UINT && Format <= VK_FORMAT_R64G64B64_SFLOAT)
+		{
+			return 24;
+		}
+		if (Format >= VK_FORMAT_R64G64B64A64_UINT && Format <= VK_FORMAT_R64G64B64A64_SFLOAT)
+		{
+			return 32;
+		}
+		throw std::runtime_error("Unsupported format for a staging image upload!");
+	}
+
+	VkDeviceSize GetSize() const
+	{
+		return mRing.GetSize();
+	}
+
+	VkDeviceSize GetPeakUsedSize() const
+	{
+		return mRing.GetPeakUsedSize();
+	}
+
+private:
+
+	VkDevice mDevice = VK_NULL_HANDLE;
+
+	DeviceMemoryAllocator* mAllocator = nullptr;
+
+	FrameScheduler* mScheduler = nullptr;
+
+	VkBuffer mBuffer = VK_NULL_HANDLE;
+
+	DeviceAllocation mAllocation;
+
+	RingAllocator mRing;
+};
@@ -0,0 +1,379 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../Common/ResourceStateTracker.h"
+
+//How a resource is used: the layout it must be in (images only), and the accesses and stages that touch it
+struct VulkanResourceState
+{
+	VkImageLayout mLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VkAccessFlags mAccess = 0;
+
+	VkPipelineStageFlags mStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+	bool operator==(const VulkanResourceState& Other) const
+	{
+		return mLayout == Other.mLayout && mAccess == Other.mAccess && mStages == Other.mStages;
+	}
+};
+
+/*
+	Unlike D3D12 states, the same Vulkan state may still need a barrier: a write followed by anything (even the same
+	write) is a hazard, and new readers need the data made visible to them. Only a layout that stays the same between
+	reads already covered by the previous barrier can go without one.
+*/
+struct VulkanResourceStateTraits
+{
+	static const VkAccessFlags kWriteAccess = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+	static bool NeedsBarrier(const VulkanResourceState& Before, const VulkanResourceState& After)
+	{
+		return Before.mLayout != After.mLayout ||
+			((Before.mAccess | After.mAccess) & kWriteAccess) != 0 ||
+			(After.mAccess & ~Before.mAccess) != 0 ||
+			(After.mStages & ~Before.mStages) != 0;
+	}
+};
+
+/*
+	ResourceStateTracker for Vulkan images and buffers, the counterpart of D3D12ResourceStateTracker for work that isn't
+	part of the render graph (uploads, readbacks, tools). The render graph knows every pass up front and derives its
+	barriers once at compile time, this one follows resources used as the recording goes.
+
+	Every FlushBarriers() turns the pending transitions into a single vkCmdPipelineBarrier, with the union of the source
+	and destination stages. Image subresources are indexed Mip + Layer * MipLevels, like D3D12.
+
+	Split transitions are VkEvents: the Begin half sets an event once the previous stages are done, the End half waits
+	on it with the actual barrier (vkCmdWaitEvents), then resets it for the next split. Both halves must be recorded for
+	the same queue. Without Create() there are no events: the Begin half is dropped and the End half is a full barrier.
+*/
+class VulkanResourceStateTracker
+{
+public:
+
+	typedef ResourceStateTracker<VulkanResourceState, VulkanResourceStateTraits> TrackerType;
+
+	static constexpr uint32_t kAllSubresources = TrackerType::kAllSubresources;
+
+	VulkanResourceStateTracker() = default;
+
+	~VulkanResourceStateTracker()
+	{
+		Destroy();
+	}
+
+	VulkanResourceStateTracker(const VulkanResourceStateTracker&) = delete;
+	VulkanResourceStateTracker& operator=(const VulkanResourceStateTracker&) = delete;
+
+	//Device the split transition events are created on
+	void Create(VkDevice Device)
+	{
+		mDevice = Device;
+	}
+
+	//The GPU must be done with the recorded barriers
+	void Destroy()
+	{
+		if (mDevice == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		for (auto& Split : mSplitEvents)
+		{
+			mFreeEvents.push_back(Split.second);
+		}
+		mFreeEvents.insert(mFreeEvents.end(), mAbandonedEvents.begin(), mAbandonedEvents.end());
+		for (VkEvent Event : mFreeEvents)
+		{
+			vkDestroyEvent(mDevice, Event, nullptr);
+		}
+		mSplitEvents.clear();
+		mAbandonedEvents.clear();
+		mFreeEvents.clear();
+		mDevice = VK_NULL_HANDLE;
+	}
+
+	void RegisterImage(VkImage Image, VkImageAspectFlags Aspect, uint32_t MipLevels, uint32_t ArrayLayers, const VulkanResourceState& InitialState)
+	{
+		const uint64_t Key = GetKey(Image);
+		ResourceInfo& Info = mResources[Key];
+		Info.mImage = Image;
+		Info.mBuffer = VK_NULL_HANDLE;
+		Info.mAspect = Aspect;
+		Info.mMipLevels = MipLevels;
+		mTracker.Register(Key, MipLevels * ArrayLayers, InitialState);
+	}
+
+	void RegisterBuffer(VkBuffer Buffer, const VulkanResourceState& InitialState)
+	{
+		const uint64_t Key = GetKey(Buffer);
+		ResourceInfo& Info = mResources[Key];
+		Info.mImage = VK_NULL_HANDLE;
+		Info.mBuffer = Buffer;
+		mTracker.Register(Key, 1, InitialState);
+	}
+
+	template <typename HandleType>
+	void Unregister(HandleType Handle)
+	{
+		const uint64_t Key = GetKey(Handle);
+		mTracker.Unregister(Key);
+		mResources.erase(Key);
+
+		//A split left open may have its event set: it can't be waited on by another split, only destroyed
+		for (auto It = mSplitEvents.begin(); It != mSplitEvents.end();)
+		{
+			if (It->first.first == Key)
+			{
+				mAbandonedEvents.push_back(It->second);
+				It = mSplitEvents.erase(It);
+			}
+			else
+			{
+				++It;
+			}
+		}
+	}
+
+	template <typename HandleType>
+	void Transition(HandleType Handle, const VulkanResourceState& After, uint32_t Subresource = kAllSubresources)
+	{
+		mTracker.Transition(GetKey(Handle), After, Subresource);
+	}
+
+	template <typename HandleType>
+	void BeginTransition(HandleType Handle, const VulkanResourceState& After, uint32_t Subresource = kAllSubresources)
+	{
+		mTracker.BeginTransition(GetKey(Handle), After, Subresource);
+	}
+
+	template <typename HandleType>
+	VulkanResourceState GetState(HandleType Handle, uint32_t Subresource = 0) const
+	{
+		return mTracker.GetState(GetKey(Handle), Subresource);
+	}
+
+	uint32_t GetSubresource(VkImage Image, uint32_t Mip, uint32_t Layer) const
+	{
+		return Mip + Layer * GetInfo(GetKey(Image)).mMipLevels;
+	}
+
+	//Record the pending transitions as one vkCmdPipelineBarrier (nothing if there are none), plus the event waits and
+	//sets of the split transitions ending and beginning in this batch
+	void FlushBarriers(VkCommandBuffer CommandBuffer)
+	{
+		BarrierBatch Barriers;
+		BarrierBatch Waits;
+		std::vector<VkEvent> WaitEvents;
+		std::vector<std::pair<VkEvent, VkPipelineStageFlags>> SetEvents;
+
+		for (const auto& Transition : mTracker.Flush())
+		{
+			const auto SplitKey = std::make_pair(Transition.mResource, Transition.mSubresource);
+			if (Transition.mKind == BarrierKind::Begin)
+			{
+				//No events: the End half does the whole barrier
+				if (mDevice != VK_NULL_HANDLE)
+				{
+					const VkEvent Event = AcquireEvent();
+					mSplitEvents[SplitKey] = Event;
+					SetEvents.push_back(std::make_pair(Event, Transition.mBefore.mStages));
+				}
+				continue;
+			}
+
+			auto Split = Transition.mKind == BarrierKind::End ? mSplitEvents.find(SplitKey) : mSplitEvents.end();
+			if (Split == mSplitEvents.end())
+			{
+				AddBarrier(Barriers, Transition);
+				continue;
+			}
+
+			//Begun in this very batch: the event isn't set yet, a regular barrier does it
+			const VkEvent Event = Split->second;
+			mSplitEvents.erase(Split);
+			auto SetInBatch = std::find_if(SetEvents.begin(), SetEvents.end(), [Event](const std::pair<VkEvent, VkPipelineStageFlags>& Set) { return Set.first == Event; });
+			if (SetInBatch != SetEvents.end())
+			{
+				SetEvents.erase(SetInBatch);
+				mFreeEvents.push_back(Event);
+				AddBarrier(Barriers, Transition);
+				continue;
+			}
+
+			AddBarrier(Waits, Transition);
+			WaitEvents.push_back(Event);
+		}
+
+		//Split transitions ending here come first, a regular transition of the same resource may continue from them
+		if (!WaitEvents.empty())
+		{
+			vkCmdWaitEvents(CommandBuffer, static_cast<uint32_t>(WaitEvents.size()), WaitEvents.data(),
+				Waits.GetSrcStages(), Waits.GetDstStages(), 0, nullptr,
+				static_cast<uint32_t>(Waits.mBufferBarriers.size()), Waits.mBufferBarriers.data(),
+				static_cast<uint32_t>(Waits.mImageBarriers.size()), Waits.mImageBarriers.data());
+
+			//Once the waiting stages are through, the events can serve another split
+			for (VkEvent Event : WaitEvents)
+			{
+				vkCmdResetEvent(CommandBuffer, Event, Waits.GetDstStages());
+				mFreeEvents.push_back(Event);
+			}
+		}
+
+		if (!Barriers.mImageBarriers.empty() || !Barriers.mBufferBarriers.empty())
+		{
+			vkCmdPipelineBarrier(CommandBuffer, Barriers.GetSrcStages(), Barriers.GetDstStages(), 0, 0, nullptr,
+				static_cast<uint32_t>(Barriers.mBufferBarriers.size()), Barriers.mBufferBarriers.data(),
+				static_cast<uint32_t>(Barriers.mImageBarriers.size()), Barriers.mImageBarriers.data());
+		}
+
+		//Split transitions beginning here: the event is set once the stages of the previous use are done
+		for (const auto& Set : SetEvents)
+		{
+			vkCmdSetEvent(CommandBuffer, Set.first, Set.second);
+		}
+	}
+
+private:
+
+	struct BarrierBatch
+	{
+		std::vector<VkImageMemoryBarrier> mImageBarriers;
+
+		std::vector<VkBufferMemoryBarrier> mBufferBarriers;
+
+		VkPipelineStageFlags mSrcStages = 0;
+
+		VkPipelineStageFlags mDstStages = 0;
+
+		VkPipelineStageFlags GetSrcStages() const
+		{
+			return mSrcStages != 0 ? mSrcStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		}
+
+		VkPipelineStageFlags GetDstStages() const
+		{
+			return mDstStages != 0 ? mDstStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		}
+	};
+
+	struct ResourceInfo
+	{
+		VkImage mImage = VK_NULL_HANDLE;
+
+		VkBuffer mBuffer = VK_NULL_HANDLE;
+
+		VkImageAspectFlags mAspect = 0;
+
+		uint32_t mMipLevels = 1;
+	};
+
+	//Non dispatchable handles are 64 bit values or pointers depending on the platform
+	template <typename HandleType>
+	static uint64_t GetKey(HandleType Handle)
+	{
+		return (uint64_t)(Handle);
+	}
+
+	const ResourceInfo& GetInfo(uint64_t Key) const
+	{
+		auto It = mResources.find(Key);
+		if (It == mResources.end())
+		{
+			throw std::runtime_error("Resource isn't registered in the state tracker!");
+		}
+		return It->second;
+	}
+
+	void AddBarrier(BarrierBatch& Batch, const TrackerType::TransitionType& Transition) const
+	{
+		Batch.mSrcStages |= Transition.mBefore.mStages;
+		Batch.mDstStages |= Transition.mAfter.mStages;
+
+		const ResourceInfo& Info = GetInfo(Transition.mResource);
+		if (Info.mImage != VK_NULL_HANDLE)
+		{
+			VkImageMemoryBarrier Barrier = {};
+			Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			Barrier.srcAccessMask = Transition.mBefore.mAccess;
+			Barrier.dstAccessMask = Transition.mAfter.mAccess;
+			Barrier.oldLayout = Transition.mBefore.mLayout;
+			Barrier.newLayout = Transition.mAfter.mLayout;
+			Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			Barrier.image = Info.mImage;
+			Barrier.subresourceRange.aspectMask = Info.mAspect;
+			if (Transition.mSubresource == kAllSubresources)
+			{
+				Barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+				Barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+			}
+			else
+			{
+				Barrier.subresourceRange.baseMipLevel = Transition.mSubresource % Info.mMipLevels;
+				Barrier.subresourceRange.baseArrayLayer = Transition.mSubresource / Info.mMipLevels;
+				Barrier.subresourceRange.levelCount = 1;
+				Barrier.subresourceRange.layerCount = 1;
+			}
+			Batch.mImageBarriers.push_back(Barrier);
+		}
+		else
+		{
+			VkBufferMemoryBarrier Barrier = {};
+			Barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			Barrier.srcAccessMask = Transition.mBefore.mAccess;
+			Barrier.dstAccessMask = Transition.mAfter.mAccess;
+			Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			Barrier.buffer = Info.mBuffer;
+			Barrier.size = VK_WHOLE_SIZE;
+			Batch.mBufferBarriers.push_back(Barrier);
+		}
+	}
+
+	VkEvent AcquireEvent()
+	{
+		if (!mFreeEvents.empty())
+		{
+			const VkEvent Event = mFreeEvents.back();
+			mFreeEvents.pop_back();
+			return Event;
+		}
+
+		VkEventCreateInfo EventInfo = {};
+		EventInfo.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO;
+		VkEvent Event = VK_NULL_HANDLE;
+		if (vkCreateEvent(mDevice, &EventInfo, nullptr, &Event) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create split barrier event!");
+		}
+		return Event;
+	}
+
+	std::unordered_map<uint64_t, ResourceInfo> mResources;
+
+	TrackerType mTracker;
+
+	VkDevice mDevice = VK_NULL_HANDLE;
+
+	//Split transitions begun and not ended yet: (resource, subresource) -> the event set by their Begin half
+	std::map<std::pair<uint64_t, uint32_t>, VkEvent> mSplitEvents;
+
+	//Reset, ready for another split
+	std::vector<VkEvent> mFreeEvents;
+
+	//Left set by splits of unregistered resources, only destroyed
+	std::vector<VkEvent> mAbandonedEvents;
+};
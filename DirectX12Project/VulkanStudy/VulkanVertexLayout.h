@@ -0,0 +1,129 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/glm/vec2.hpp>
+#include <glm/glm/vec3.hpp>
+#include <glm/glm/vec4.hpp>
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../Common/VertexLayout.h"
+#include "SpirvReflection.h"
+
+template<> struct VertexFormatOf<glm::vec2> { static constexpr VertexFormat kFormat = VertexFormat::Float2; };
+template<> struct VertexFormatOf<glm::vec3> { static constexpr VertexFormat kFormat = VertexFormat::Float3; };
+template<> struct VertexFormatOf<glm::vec4> { static constexpr VertexFormat kFormat = VertexFormat::Float4; };
+
+constexpr VkFormat ToVkFormat(VertexFormat Format)
+{
+	switch (Format)
+	{
+	case VertexFormat::Float1: return VK_FORMAT_R32_SFLOAT;
+	case VertexFormat::Float2: return VK_FORMAT_R32G32_SFLOAT;
+	case VertexFormat::Float3: return VK_FORMAT_R32G32B32_SFLOAT;
+	case VertexFormat::Float4: return VK_FORMAT_R32G32B32A32_SFLOAT;
+	case VertexFormat::Half2: return VK_FORMAT_R16G16_SFLOAT;
+	case VertexFormat::Half4: return VK_FORMAT_R16G16B16A16_SFLOAT;
+	case VertexFormat::UNorm8x4: return VK_FORMAT_R8G8B8A8_UNORM;
+	case VertexFormat::SNorm8x4: return VK_FORMAT_R8G8B8A8_SNORM;
+	case VertexFormat::UInt8x4: return VK_FORMAT_R8G8B8A8_UINT;
+	case VertexFormat::UNorm16x2: return VK_FORMAT_R16G16_UNORM;
+	case VertexFormat::SNorm16x2: return VK_FORMAT_R16G16_SNORM;
+	case VertexFormat::SNorm16x4: return VK_FORMAT_R16G16B16A16_SNORM;
+	case VertexFormat::UInt1: return VK_FORMAT_R32_UINT;
+	case VertexFormat::SInt1: return VK_FORMAT_R32_SINT;
+	}
+	return VK_FORMAT_UNDEFINED;
+}
+
+//Vertex buffer binding of Vertex: one vertex (or instance) every sizeof(Vertex) bytes
+template<typename Vertex>
+constexpr VkVertexInputBindingDescription GetVertexBindingDescription(uint32_t Binding, VkVertexInputRate InputRate = VK_VERTEX_INPUT_RATE_VERTEX)
+{
+	return VkVertexInputBindingDescription{ Binding, static_cast<uint32_t>(sizeof(Vertex)), InputRate };
+}
+
+template<typename Vertex>
+constexpr std::array<VkVertexInputAttributeDescription, GetVertexAttributeCount<Vertex>()> GetVertexAttributeDescriptions(uint32_t Binding)
+{
+	static_assert(IsVertexLayoutValid<Vertex>(), "Vertex attributes overlap, share a location or don't fit in the vertex");
+
+	constexpr size_t Count = GetVertexAttributeCount<Vertex>();
+	const std::array<VertexAttributeDesc, Count> Attributes = VertexLayoutTraits<Vertex>::GetAttributes();
+	std::array<VkVertexInputAttributeDescription, Count> Descriptions = {};
+	for (size_t i = 0; i < Count; ++i)
+	{
+		Descriptions[i] = VkVertexInputAttributeDescription{ Attributes[i].mLocation, Binding, ToVkFormat(Attributes[i].mFormat), Attributes[i].mOffset };
+	}
+	return Descriptions;
+}
+
+//Throws if the vertex shader reads a location the layout doesn't provide, or reads it as another kind of number (float,
+//signed or unsigned integer). Component counts may differ: missing ones read as 0 (1 for w), extra ones are dropped.
+inline void ValidateVertexShaderInputs(const std::vector<SpirvVertexInput>& Inputs, const std::vector<VertexAttributeDesc>& Attributes)
+{
+	for (const auto& Input : Inputs)
+	{
+		auto It = std::find_if(Attributes.begin(), Attributes.end(), [&](const VertexAttributeDesc& Attribute) { return Attribute.mLocation == Input.mLocation; });
+		if (It == Attributes.end())
+		{
+			throw std::runtime_error("Vertex shader input at location " + std::to_string(Input.mLocation) + " is missing from the vertex layout!");
+		}
+
+		VertexFormatClass InputClass = VertexFormatClass::Float;
+		switch (Input.mFormat)
+		{
+		case VK_FORMAT_R32_UINT: case VK_FORMAT_R32G32_UINT: case VK_FORMAT_R32G32B32_UINT: case VK_FORMAT_R32G32B32A32_UINT:
+			InputClass = VertexFormatClass::UInt;
+			break;
+		case VK_FORMAT_R32_SINT: case VK_FORMAT_R32G32_SINT: case VK_FORMAT_R32G32B32_SINT: case VK_FORMAT_R32G32B32A32_SINT:
+			InputClass = VertexFormatClass::SInt;
+			break;
+		default:
+			break;
+		}
+
+		if (GetVertexFormatClass(It->mFormat) != InputClass)
+		{
+			throw std::runtime_error(std::string("Vertex attribute ") + It->mSemantic + " doesn't match the type the vertex shader reads!");
+		}
+	}
+}
+
+template<typename Vertex>
+void ValidateVertexShaderInputs(const std::vector<SpirvVertexInput>& Inputs)
+{
+	const auto Attributes = VertexLayoutTraits<Vertex>::GetAttributes();
+	ValidateVertexShaderInputs(Inputs, std::vector<VertexAttributeDesc>(Attributes.begin(), Attributes.end()));
+}
+
+//Vertex input state of a pipeline reading one vertex buffer per struct (split streams): binding N for the Nth struct
+struct VertexInputDesc
+{
+	std::vector<VkVertexInputBindingDescription> mBindings;
+	std::vector<VkVertexInputAttributeDescription> mAttributes;
+
+	//Attributes of all the structs, to validate the vertex shader against
+	std::vector<VertexAttributeDesc> mLayoutAttributes;
+};
+
+template<typename... Vertices>
+VertexInputDesc GetVertexInputDesc()
+{
+	VertexInputDesc Desc;
+	uint32_t Binding = 0;
+	auto AddStream = [&](auto Descriptions, VkVertexInputBindingDescription BindingDescription, const auto& Attributes)
+	{
+		Desc.mBindings.push_back(BindingDescription);
+		Desc.mAttributes.insert(Desc.mAttributes.end(), Descriptions.begin(), Descriptions.end());
+		Desc.mLayoutAttributes.insert(Desc.mLayoutAttributes.end(), Attributes.begin(), Attributes.end());
+		++Binding;
+	};
+	(AddStream(GetVertexAttributeDescriptions<Vertices>(Binding), GetVertexBindingDescription<Vertices>(Binding), VertexLayoutTraits<Vertices>::GetAttributes()), ...);
+	return Desc;
+}
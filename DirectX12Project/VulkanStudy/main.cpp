@@ -9,51 +9,121 @@
 #include <glm/glm/mat4x4.hpp>
 
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
 #include <vector>
 #include <set>
+#include <sstream>
+
+#include "BufferStreamer.h"
+#include "DeviceMemoryAllocator.h"
+#include "DrawBatcher.h"
+#include "FrameScheduler.h"
+#include "GpuProfiler.h"
+#include "MeshLoader.h"
+#include "PipelineCache.h"
+#include "PipelineLayoutCache.h"
+#include "RenderGraph.h"
+#include "ShaderBinaryCache.h"
+#include "ShaderCompiler.h"
+#include "ShaderVariants.h"
+#include "VulkanResourceStateTracker.h"
+#include "VulkanVertexLayout.h"
+
+#include "../Common/DeferredDeletionQueue.h"
+#include "../Common/FileWatcher.h"
+#include "../Common/FrameStatistics.h"
+#include "../Common/MeshImport.h"
+#include "../Common/MeshOptimizer.h"
+#include "../Common/RollingStatistics.h"
+#include "../Common/TaskSystem.h"
+
+
+//Frames the CPU can get ahead of the GPU by default (--frames-in-flight overrides it)
+const uint32_t kDEFAULT_FRAMES_IN_FLIGHT = 2;
+
+//Deepest pipelining allowed
+const uint32_t kMAX_FRAMES_IN_FLIGHT = 8;
+
+//How long the windowed loop waits for a frame slot before going back to pump window messages (nanoseconds)
+const uint64_t kFRAME_SLOT_POLL_TIMEOUT = 1000000;
+
+//Number of frames rendered in headless mode when no explicit frame count is given
+const uint32_t kDEFAULT_HEADLESS_FRAME_COUNT = 1000;
+
+//Where the pipeline cache gets persisted between runs
+static const char* kPIPELINE_CACHE_FILE = "PipelineCache.bin";
+
+//GLSL sources of the graphics pipeline, watched for changes in windowed mode
+static const char* kSHADER_DIRECTORY = "Shaders";
+
+//Fragment shader variants (specialization constants of Shader.frag): one graphics pipeline per combination, built up front
+static const std::vector<SpecializationConstantDesc> kFRAGMENT_VARIANTS =
+{
+	{ 0, "GRAYSCALE", { VK_FALSE, VK_TRUE } },
+	{ 1, "CONTRAST_PASSES", { 0, 1, 2, 4 } },
+};
 
+//Vertex of the triangle: the color is quantized to 8 bits per channel, the shader still reads a normalized vec3
+struct ColoredVertex
+{
+	glm::vec2 mPosition;
+	UNorm8x4 mColor;
+};
 
-const int kMAX_FRAMES_IN_FLIGHT = 2;
-
+template<>
+struct VertexLayoutTraits<ColoredVertex>
+{
+	static constexpr std::array<VertexAttributeDesc, 2> GetAttributes()
+	{
+		return { { VERTEX_ATTRIBUTE(ColoredVertex, mPosition, "POSITION", 0), VERTEX_ATTRIBUTE(ColoredVertex, mColor, "COLOR", 1) } };
+	}
+};
 
-static const std::string red("\033[0;31m");
-static const std::string green("\033[1;32m");
-static const std::string yellow("\033[1;33m");
-static const std::string cyan("\033[0;36m");
-static const std::string magenta("\033[0;35m");
-static const std::string reset("\033[0m");
+static const ColoredVertex kTRIANGLE_VERTICES[] =
+{
+	{ { 0.0f, -0.5f }, { 255, 0, 0, 255 } },
+	{ { 0.5f, 0.5f }, { 0, 255, 0, 255 } },
+	{ { -0.5f, 0.5f }, { 0, 0, 255, 255 } },
+};
 
+static const uint16_t kTRIANGLE_INDICES[] = { 0, 1, 2 };
 
-static std::vector<char> ReadFile(const std::string& FileName)
-{
-	//Open a binary file and put the file cursor at the end of the file itself. 
-	std::ifstream File(FileName,std::ios::ate | std::ios::binary);
+//Where compiled shaders are kept, named after the hash of their sources, includes and defines
+static const char* kSHADER_CACHE_DIRECTORY = "ShaderCache";
 
-	//If we failed in opening the file, we assert
-	if (!File.is_open()) 
-	{
-		 throw std::runtime_error("Failed to open file!");	
-	}
+//Host visible memory of the uploads streamed from the transfer queue (vertex and index buffers)
+const VkDeviceSize kSTREAMING_RING_SIZE = 32 * 1024 * 1024;
 
-	//Get the file size by asking the cursor position in bytes
-	size_t FileSize = (size_t)File.tellg();
-	//Allocate a byte buffer
-	std::vector<char> Buffer(FileSize);
+//Loads of each kind the mesh load benchmark times
+const uint32_t kMESH_BENCHMARK_ITERATIONS = 10;
 
-	//Go the beginning of the file
-	File.seekg(0);
-	//Read FileSize bytes and store them in the previously allocated buffer
-	File.read(Buffer.data(),FileSize);
+//Frames the mesh optimizer benchmark renders with each optimization level (when no explicit frame count is given)
+const uint32_t kMESH_OPTIMIZER_BENCHMARK_FRAMES = 200;
 
-	//Done, close the file
-	File.close();
+//Mesh view: fixed orientation (radians) and light direction (view space), so that every run draws the same pixels
+const float kMESH_VIEW_YAW = 0.6f;
+const float kMESH_VIEW_PITCH = 0.4f;
+static const float kMESH_LIGHT_DIRECTION[3] = { 0.4f, 0.6f, 0.7f };
 
-	//Return the buffer
-	return Buffer;
-}
 
+static const std::string red("\033[0;31m");
+static const std::string green("\033[1;32m");
+static const std::string yellow("\033[1;33m");
+static const std::string cyan("\033[0;36m");
+static const std::string magenta("\033[0;35m");
+static const std::string reset("\033[0m");
 
 
 VkResult CreateDebugUtilsMessengerEXT(VkInstance Instance, 
@@ -88,8 +158,116 @@ class MyApplication
 {
 public:
 
+	//Options selected on the command line
+	struct LaunchOptions
+	{
+		//Render into offscreen images without any window, surface or swap chain (e.g. CI machines running a software driver like lavapipe)
+		bool mHeadless = false;
+
+		//Number of frames to render before exiting (0 means until the window gets closed, or kDEFAULT_HEADLESS_FRAME_COUNT in headless mode)
+		uint32_t mFrameCount = 0;
+
+		//Number of objects drawn every frame
+		uint32_t mDrawCount = 1;
+
+		//Draw all the objects sharing pipeline and geometry with one instanced draw (false: one draw per object)
+		bool mInstancing = true;
+
+		//Number of threads recording secondary command buffers (0 means one per hardware thread)
+		uint32_t mRecordingThreadCount = 0;
+
+		//Run the device memory allocator benchmark with this many iterations instead of rendering (0 means disabled)
+		uint32_t mAllocatorStressIterations = 0;
+
+		//Run the render graph self test instead of rendering
+		bool mRenderGraphTest = false;
+
+		//Number of frames the CPU can record and submit ahead of the GPU (1 .. kMAX_FRAMES_IN_FLIGHT)
+		uint32_t mFramesInFlight = kDEFAULT_FRAMES_IN_FLIGHT;
+
+		//Where to dump the GPU timings when exiting (empty means don't)
+		std::string mGpuProfilePath;
+
+		//Frame timings are written to <path>.csv and <path>.json when exiting (empty means don't)
+		std::string mFrameStatisticsPath;
+
+		//Fragment shader variant to draw with, as NAME=VALUE pairs (empty means the first one)
+		std::string mShaderVariant;
+
+		//Run the mesh load benchmark on this OBJ/glTF file instead of rendering (empty means disabled)
+		std::string mMeshBenchmarkSource;
+
+		//Mesh drawn instead of the triangle: a mesh file, or an OBJ/glTF file optimized and converted while loading (empty means the triangle)
+		std::string mMeshPath;
+
+		//Render this OBJ/glTF file with every level of mesh optimization instead of rendering (empty means disabled)
+		std::string mMeshOptimizerBenchmarkSource;
+	};
+
+	//Command recording resources owned by a single frame in flight.
+	//Nothing in here can be touched before the frame's fence has been signaled.
+	struct FrameCommands
+	{
+		//Pool of the primary command buffer
+		VkCommandPool mPrimaryPool = VK_NULL_HANDLE;
+
+		//Primary command buffer: begins/ends the render pass and executes the secondary command buffers
+		VkCommandBuffer mPrimaryCommandBuffer = VK_NULL_HANDLE;
+
+		//One transient pool per recording thread (command pools are externally synchronized so threads can't share them)
+		std::vector<VkCommandPool> mWorkerPools;
+
+		//One secondary command buffer per recording thread, allocated out of the matching worker pool
+		std::vector<VkCommandBuffer> mSecondaryCommandBuffers;
+	};
+
+	//Outcome of the graphics pipelines rebuilt in the background by shader hot reload
+	struct PipelineReload
+	{
+		//One per fragment shader variant
+		std::vector<VkPipeline> mPipelines;
+
+		//Reflected from the new shaders (owned by the layout cache)
+		VkPipelineLayout mLayout = VK_NULL_HANDLE;
+
+		//Compile or link error, mPipeline is null then
+		std::string mError;
+	};
+
+	//What tells the graphics pipelines apart, everything else is the same for all of them (see BuildGraphicsPipelines)
+	struct GraphicsPipelineDesc
+	{
+		//Sources in kSHADER_DIRECTORY
+		const char* mVertexShader = nullptr;
+		const char* mFragmentShader = nullptr;
+
+		VertexInputDesc mVertexInput;
+
+		//One pipeline per combination of the fragment shader's specialization constants, or a single one without any if null
+		const ShaderVariantSet* mVariants = nullptr;
+
+		VkFrontFace mFrontFace = VK_FRONT_FACE_CLOCKWISE;
+
+		bool mDepthTest = false;
+	};
+
+	//Push constants of Mesh.vert/Mesh.frag
+	struct MeshConstants
+	{
+		//Column major, world to clip space
+		float mViewProjection[16];
+
+		//Quantized position to object space (w unused)
+		float mDequantize[4];
+
+		//Toward the light, in world space (w unused)
+		float mLightDirection[4];
+	};
+
 	MyApplication() = default;
 
+	explicit MyApplication(const LaunchOptions& Options) : mOptions(Options) {}
+
 	~MyApplication() = default;
 
 	struct SwapChainSupportDetails
@@ -105,6 +283,10 @@ public:
 
 		int32_t mPresentFamily = -1;
 
+		//Family buffer uploads are streamed from: a transfer only one (the copy engines) if the device has it, the
+		//graphics one otherwise
+		int32_t mTransferFamily = -1;
+
 		bool IsComplete()
 		{
 			return mGraphicsFamily >= 0 && mPresentFamily >= 0;
@@ -116,8 +298,8 @@ public:
 
 	const std::vector<const char*> ValidationLayers = { "VK_LAYER_LUNARG_standard_validation" };
 
-	//Device extensions (just swap chain for now)
-	const std::vector<const char*> DeviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+	//Device extensions (swap chain, which isn't needed when rendering headless, and timeline semaphores for the frame scheduler)
+	const std::vector<const char*> DeviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME };
 
 #ifdef NDEBUG
 	const bool kEnableValidationLayers = false;
@@ -127,9 +309,31 @@ public:
 
 	void Run()
 	{
-		InitWindow();
+		if (!mOptions.mHeadless)
+		{
+			InitWindow();
+		}
 		InitVulkan();
-		MainLoop();
+		if (mOptions.mAllocatorStressIterations != 0)
+		{
+			RunAllocatorStress();
+		}
+		else if (mOptions.mRenderGraphTest)
+		{
+			RunRenderGraphTest();
+		}
+		else if (!mOptions.mMeshBenchmarkSource.empty())
+		{
+			RunMeshLoadBenchmark();
+		}
+		else if (!mOptions.mMeshOptimizerBenchmarkSource.empty())
+		{
+			RunMeshOptimizerBenchmark();
+		}
+		else
+		{
+			MainLoop();
+		}
 		CleanUp();
 	}
 
@@ -165,7 +369,11 @@ private:
 	{
 		uint32_t glfwExtensionCount = 0;
 		const char** glfwExtensions = nullptr;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		//Headless rendering doesn't need any surface extension (GLFW isn't even initialized in that case)
+		if (!mOptions.mHeadless)
+		{
+			glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		}
 		std::vector<const char*> Extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
 		if (kEnableValidationLayers)
 		{
@@ -174,6 +382,15 @@ private:
 		return Extensions;
 	}
 
+	std::vector<const char*> GetRequiredDeviceExtensions()
+	{
+		if (mOptions.mHeadless)
+		{
+			return { VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME };
+		}
+		return DeviceExtensions;
+	}
+
 	void InitWindow()
 	{
 		//Init GLFW
@@ -182,11 +399,21 @@ private:
 		//Disable the OpenGL context creation
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
-		//Disable the window resizing capability
-		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+		//The window can be resized: the swap chain gets recreated on the fly when that happens
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
 		//Create a window
 		mWindow = glfwCreateWindow(kScreenWidth, kScreenHeight, "Vulkan", nullptr, nullptr);
+
+		//Get notified of resizes (some drivers don't report VK_ERROR_OUT_OF_DATE_KHR reliably when the window changes size)
+		glfwSetWindowUserPointer(mWindow, this);
+		glfwSetFramebufferSizeCallback(mWindow, FramebufferResizeCallback);
+	}
+
+	static void FramebufferResizeCallback(GLFWwindow* Window, int /*Width*/, int /*Height*/)
+	{
+		auto App = reinterpret_cast<MyApplication*>(glfwGetWindowUserPointer(Window));
+		App->mFramebufferResized = true;
 	}
 
 	static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT MessageSeverity,
@@ -248,7 +475,8 @@ private:
 		AppInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		AppInfo.pEngineName = "No Engine";
 		AppInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		AppInfo.apiVersion = VK_API_VERSION_1_0;
+		//1.1 for vkGetPhysicalDeviceFeatures2 and feature structs chained at device creation (needed by VK_KHR_timeline_semaphore)
+		AppInfo.apiVersion = VK_API_VERSION_1_1;
 
 		//A struct that will hold info used to create the vulkan instance based on the application info struct and the supported extensions
 		VkInstanceCreateInfo CreateInfo = {};
@@ -286,7 +514,11 @@ private:
 
 		//Check to see whether the returned extensions from glfwGetRequiredInstanceExtensions are contained in the total enumerated extensions
 		uint32_t glfwExtensionCount = 0;
-		auto glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		const char** glfwExtensions = nullptr;
+		if (!mOptions.mHeadless)
+		{
+			glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		}
 		std::cout << yellow.c_str() << "\nExtensions returned from " << cyan.c_str() << "glfwGetRequiredInstanceExtensions(uint32_t* count) " << yellow.c_str() << "present in the enumerated list:" << reset.c_str() << std::endl;
 		uint32_t RequiredExtCount = 0;
 		for (uint32_t i = 0; i < glfwExtensionCount; ++i)
@@ -400,7 +632,12 @@ private:
 		}
 		else
 		{
-			VkExtent2D ActualExtent = { kScreenWidth, kScreenHeight };
+			//The window size is in screen coordinates, what we want here is its size in pixels
+			int Width = 0;
+			int Height = 0;
+			glfwGetFramebufferSize(mWindow, &Width, &Height);
+
+			VkExtent2D ActualExtent = { static_cast<uint32_t>(Width), static_cast<uint32_t>(Height) };
 
 			ActualExtent.width = std::max(Capabilities.minImageExtent.width, std::min(Capabilities.maxImageExtent.width, ActualExtent.width));
 
@@ -411,7 +648,8 @@ private:
 	}
 
 	//Actual swap chain creation 
-	void CreateSwapChain()
+	//When recreating, OldSwapChain is the one being replaced: the driver can hand its resources over to the new one
+	void CreateSwapChain(VkSwapchainKHR OldSwapChain = VK_NULL_HANDLE)
 	{
 		//Query for the swap chain support
 		SwapChainSupportDetails SwapChainSupport = QuerySwapChainSupport(mPhysicalDevice);
@@ -466,8 +704,9 @@ private:
 		CreateInfo.presentMode = PresentMode;
 		CreateInfo.clipped = VK_TRUE;
 
-		//this filed will get important when it'll come the time to manage window resizing, infact we must assign the old swap chain on resizing when recreating the new one
-		CreateInfo.oldSwapchain = VK_NULL_HANDLE;
+		//Passing the swap chain we're replacing lets the presentation engine keep showing its images until the new ones are ready, and reuse its resources.
+		//The old swap chain gets retired by this call, but it's still up to us to destroy it (see RecreateSwapChain)
+		CreateInfo.oldSwapchain = OldSwapChain;
 
 		//Finally we can actually create the swap chain
 		if (vkCreateSwapchainKHR(mDevice, &CreateInfo, nullptr, &mSwapChain) != VK_SUCCESS)
@@ -487,6 +726,45 @@ private:
 
 	}
 
+	//Headless counterpart of CreateSwapChain: we create our own images to render into instead of asking the swap chain for them.
+	//The rest of the renderer (image views, framebuffers, command buffers) keeps working on mSwapChainImages exactly as before.
+	void CreateOffscreenTargets()
+	{
+		//R8G8B8A8_UNORM is guaranteed to be supported as color attachment by every implementation
+		mSwapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+		mSwapChainExtent = { kScreenWidth, kScreenHeight };
+
+		//One more image than the frames in flight so we never render into an image still in use
+		const uint32_t OffscreenImageCount = mOptions.mFramesInFlight + 1;
+		mSwapChainImages.resize(OffscreenImageCount);
+		mOffscreenImageAllocations.resize(OffscreenImageCount);
+
+		for (size_t i = 0; i < mSwapChainImages.size(); ++i)
+		{
+			VkImageCreateInfo ImageInfo = {};
+			ImageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			ImageInfo.imageType = VK_IMAGE_TYPE_2D;
+			ImageInfo.format = mSwapChainImageFormat;
+			ImageInfo.extent = { mSwapChainExtent.width, mSwapChainExtent.height, 1 };
+			ImageInfo.mipLevels = 1;
+			ImageInfo.arrayLayers = 1;
+			ImageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			ImageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			//Transfer source so that the rendered frames can be read back (e.g. to dump them to disk on the farm)
+			ImageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			ImageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			ImageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			if (vkCreateImage(mDevice, &ImageInfo, nullptr, &mSwapChainImages[i]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create offscreen image!");
+			}
+
+			//All the offscreen images end up in the same memory block
+			mOffscreenImageAllocations[i] = mMemoryAllocator.AllocateForImage(mSwapChainImages[i], ImageInfo.tiling, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+	}
+
 	void CreateImageViews()
 	{
 		mSwapChainImageViews.resize(mSwapChainImages.size());
@@ -520,14 +798,14 @@ private:
 		}
 	}
 
-	//Helper to create a shader module on the fly
-	VkShaderModule CreateShaderModule(const std::vector<char>& Code)
+	//Helper to create a shader module on the fly (straight out of the memory mapped SPIR-V, no intermediate copy)
+	VkShaderModule CreateShaderModule(const SpirvBinary& Code)
 	{
 		VkShaderModuleCreateInfo CreateInfo = {};
 
 		CreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		CreateInfo.codeSize = Code.size();
-		CreateInfo.pCode = reinterpret_cast<const uint32_t*>(Code.data());
+		CreateInfo.codeSize = Code.mSize;
+		CreateInfo.pCode = Code.mCode;
 
 		VkShaderModule ShaderModule;
 		if (vkCreateShaderModule(mDevice, &CreateInfo, nullptr, &ShaderModule) != VK_SUCCESS)
@@ -537,11 +815,81 @@ private:
 		return ShaderModule;
 	}
 
+	//Build the shaders of a pipeline: only if these exact sources were never compiled before, in parallel if Tasks is given
+	//(the task system can only be driven from the main thread)
+	std::vector<std::string> CompileGraphicsShaders(const GraphicsPipelineDesc& Desc, TaskSystem* Tasks)
+	{
+		const std::string Directory = kSHADER_DIRECTORY;
+		const std::vector<ShaderCompileRequest> Requests = { { Directory + "/" + Desc.mVertexShader, {} }, { Directory + "/" + Desc.mFragmentShader, {} } };
+		if (Tasks != nullptr)
+		{
+			return mShaderCompiler.CompileAll(Requests, *Tasks);
+		}
+
+		std::vector<std::string> SpirvPaths;
+		for (const auto& Request : Requests)
+		{
+			SpirvPaths.push_back(mShaderCompiler.Compile(Request));
+		}
+		return SpirvPaths;
+	}
+
+	//The triangle: one pipeline per fragment shader variant
+	GraphicsPipelineDesc GetTrianglePipelineDesc() const
+	{
+		GraphicsPipelineDesc Desc;
+		Desc.mVertexShader = "Shader.vert";
+		Desc.mFragmentShader = "Shader.frag";
+		Desc.mVertexInput = GetVertexInputDesc<ColoredVertex>();
+		Desc.mVariants = &mFragmentVariants;
+		return Desc;
+	}
+
+	//Mesh files: quantized positions and octahedral normals in two streams (texcoords aren't used), depth tested.
+	//OBJ and glTF triangles are counter clockwise seen from the outside, which the Y flip of the mesh transform keeps as is
+	GraphicsPipelineDesc GetMeshPipelineDesc() const
+	{
+		GraphicsPipelineDesc Desc;
+		Desc.mVertexShader = "Mesh.vert";
+		Desc.mFragmentShader = "Mesh.frag";
+		Desc.mVertexInput = GetVertexInputDesc<MeshPositionVertex, MeshNormalVertex>();
+		Desc.mFrontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		Desc.mDepthTest = true;
+		return Desc;
+	}
+
 	void CreateGraphicsPipeline()
 	{
-		//We load the shader bytecode
-		auto VertexShaderCode = ReadFile("Shaders/vert.spv");
-		auto FragmentShaderCode = ReadFile("Shaders/frag.spv");
+		//Graphics Pipelines creation, every variant at once across the recording threads (through the pipeline cache, so
+		//that we don't pay the full compilation cost at every start up and swap chain recreation)
+		const GraphicsPipelineDesc TriangleDesc = GetTrianglePipelineDesc();
+		mGraphicsPipelines = BuildGraphicsPipelines(TriangleDesc, CompileGraphicsShaders(TriangleDesc, mTaskSystem.get()), mRenderPass, mTaskSystem.get(), mPipelineLayout);
+
+		//No variants, so there is only one (shader hot reload leaves it alone)
+		const GraphicsPipelineDesc MeshDesc = GetMeshPipelineDesc();
+		mMeshPipeline = BuildGraphicsPipelines(MeshDesc, CompileGraphicsShaders(MeshDesc, mTaskSystem.get()), mRenderPass, mTaskSystem.get(), mMeshPipelineLayout)[0];
+		mPipelineCache.MergeWorkerCaches();
+	}
+
+	//One pipeline per variant of Desc, spread over Tasks if given. Every batch goes through its own worker pipeline
+	//cache, left for the caller to merge once it's sure nothing uses them anymore. Layout receives the pipeline layout
+	//reflected from the shaders (owned by mLayoutCache).
+	//Doesn't touch any member but the shader, layout and pipeline caches, so hot reload can call it from another thread.
+	std::vector<VkPipeline> BuildGraphicsPipelines(const GraphicsPipelineDesc& Desc, const std::vector<std::string>& SpirvPaths, VkRenderPass RenderPass, TaskSystem* Tasks, VkPipelineLayout& Layout)
+	{
+		//We load the shader bytecode (files stay mapped, so rebuilding the pipeline later on doesn't hit the disk again)
+		const SpirvBinary& VertexShaderCode = mShaderBinaries.Get(SpirvPaths[0]);
+		const SpirvBinary& FragmentShaderCode = mShaderBinaries.Get(SpirvPaths[1]);
+
+		//PIPELINE LAYOUT
+		//Reflected from the bytecode: descriptor sets and push constants of both stages merged, then shared with every
+		//pipeline declaring the same resources
+		const SpirvModule VertexReflection(VertexShaderCode.mCode, VertexShaderCode.mSize);
+		const SpirvModule FragmentReflection(FragmentShaderCode.mCode, FragmentShaderCode.mSize);
+		PipelineLayoutDesc LayoutDesc;
+		LayoutDesc.Merge(VertexReflection);
+		LayoutDesc.Merge(FragmentReflection);
+		Layout = mLayoutCache.GetPipelineLayout(LayoutDesc);
 
 		VkShaderModule VertexShaderModule;
 		VkShaderModule FragmentShaderModule;
@@ -568,18 +916,34 @@ private:
 		FragShaderStageInfo.module = FragmentShaderModule;
 		FragShaderStageInfo.pName = "main";
 
-		//Fill shader stage array (used later in the during the actual graphics pipeline creation 
-		VkPipelineShaderStageCreateInfo ShaderStages[] = { VertShaderStageInfo, FragShaderStageInfo };
+		//Fill shader stage array (used later in the during the actual graphics pipeline creation), one per variant since the
+		//fragment stage carries the variant's specialization constants
+		const uint32_t VariantCount = Desc.mVariants != nullptr ? Desc.mVariants->GetVariantCount() : 1;
+		std::vector<VkSpecializationInfo> Specializations(VariantCount);
+		std::vector<std::array<VkPipelineShaderStageCreateInfo, 2>> ShaderStages(VariantCount);
+		for (uint32_t Variant = 0; Variant < VariantCount; ++Variant)
+		{
+			ShaderStages[Variant] = { VertShaderStageInfo, FragShaderStageInfo };
+			if (Desc.mVariants != nullptr)
+			{
+				Specializations[Variant] = Desc.mVariants->GetSpecializationInfo(Variant);
+				ShaderStages[Variant][1].pSpecializationInfo = &Specializations[Variant];
+			}
+		}
 
 		//Graphics pipeline stuff will be created here (i.e. vertex input layout structs, rasterizer structs and so on ... )
 
 		//VERTEX INPUT LAYOUT (i.e. vertex element descriptor or similar in DX12)
+		//Generated at compile time from the vertex structs, and checked against what the vertex shader actually reads
+		const VertexInputDesc& VertexInput = Desc.mVertexInput;
+		ValidateVertexShaderInputs(VertexReflection.GetVertexInputs(), VertexInput.mLayoutAttributes);
+
 		VkPipelineVertexInputStateCreateInfo VertexInputInfo = {};
 		VertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		VertexInputInfo.vertexBindingDescriptionCount = 0;
-		VertexInputInfo.pVertexBindingDescriptions = nullptr; // Optional
-		VertexInputInfo.vertexAttributeDescriptionCount = 0;
-		VertexInputInfo.pVertexAttributeDescriptions = nullptr; //Optional
+		VertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(VertexInput.mBindings.size());
+		VertexInputInfo.pVertexBindingDescriptions = VertexInput.mBindings.data();
+		VertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(VertexInput.mAttributes.size());
+		VertexInputInfo.pVertexAttributeDescriptions = VertexInput.mAttributes.data();
 
 		//INPUT ASSEMBLY (Whether we want to draw triangle list, triangle strip, lines primitives etc.)
 		VkPipelineInputAssemblyStateCreateInfo InputAssemblyInfo = {};
@@ -587,27 +951,23 @@ private:
 		InputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 		InputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
 
-		//Viewport
-		VkViewport Viewport = {};
-		Viewport.x = 0.0f;
-		Viewport.y = 0.0f;
-		Viewport.width = (float)mSwapChainExtent.width;
-		Viewport.height = (float)mSwapChainExtent.height;
-		Viewport.minDepth = 0.0f;
-		Viewport.maxDepth = 1.0f;
-
-		//Scissor rect
-		VkRect2D Scissor = {};
-		Scissor.offset = { 0, 0 };
-		Scissor.extent = mSwapChainExtent;
-
 		//VIEWPORT STATE 
+		//Viewport and scissor rect are dynamic (set while recording), so the pipeline doesn't depend on the swap chain extent
+		//and survives window resizes
 		VkPipelineViewportStateCreateInfo ViewportState = {};
 		ViewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		ViewportState.viewportCount = 1;
-		ViewportState.pViewports = &Viewport;
+		ViewportState.pViewports = nullptr;
 		ViewportState.scissorCount = 1;
-		ViewportState.pScissors = &Scissor;
+		ViewportState.pScissors = nullptr;
+
+		//DYNAMIC STATE
+		VkDynamicState DynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+		VkPipelineDynamicStateCreateInfo DynamicState = {};
+		DynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		DynamicState.dynamicStateCount = 2;
+		DynamicState.pDynamicStates = DynamicStates;
 
 		//RASTERIZER STATE
 		VkPipelineRasterizationStateCreateInfo Rasterizer = {};
@@ -617,7 +977,7 @@ private:
 		Rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
 		Rasterizer.lineWidth = 1.0f;
 		Rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-		Rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+		Rasterizer.frontFace = Desc.mFrontFace;
 		Rasterizer.depthBiasEnable = VK_FALSE;
 		Rasterizer.depthBiasConstantFactor = 0.0f; // Optional
 		Rasterizer.depthBiasClamp = 0.0f; // Optional
@@ -633,6 +993,16 @@ private:
 		Multisampling.alphaToCoverageEnable = VK_FALSE; // Optional		
 		Multisampling.alphaToOneEnable = VK_FALSE; // Optional
 
+		//DEPTH STENCIL STATE
+		//The main pass always has a depth buffer, pipelines without depth test just leave it alone
+		VkPipelineDepthStencilStateCreateInfo DepthStencil = {};
+		DepthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		DepthStencil.depthTestEnable = Desc.mDepthTest ? VK_TRUE : VK_FALSE;
+		DepthStencil.depthWriteEnable = Desc.mDepthTest ? VK_TRUE : VK_FALSE;
+		DepthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+		DepthStencil.depthBoundsTestEnable = VK_FALSE;
+		DepthStencil.stencilTestEnable = VK_FALSE;
+
 		//COLOR BLEND ATTACHMENT STATE
 		VkPipelineColorBlendAttachmentState ColorBlendAttachment = {};
 		ColorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
@@ -659,24 +1029,11 @@ private:
 		ColorBlending.blendConstants[3] = 0.0f; // Optional
 
 
-		//PIPELINE LAYOUT
-		VkPipelineLayoutCreateInfo PipelineLayoutInfo = {};
-		PipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		PipelineLayoutInfo.setLayoutCount = 0; // Optional
-		PipelineLayoutInfo.pSetLayouts = nullptr; // Optional
-		PipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-		PipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-		if (vkCreatePipelineLayout(mDevice, &PipelineLayoutInfo, nullptr, &mPipelineLayout) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create pipeline layout!");
-		}
-
-
 		//FINALLY READY TO CREATE THE GRAPHICS PIPELINE !
 		VkGraphicsPipelineCreateInfo PipelineInfo = {};
 		PipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 		PipelineInfo.stageCount = 2;
-		PipelineInfo.pStages = ShaderStages;
+		PipelineInfo.pStages = nullptr; //Set per variant below
 
 		PipelineInfo.pVertexInputState = &VertexInputInfo;
 		PipelineInfo.pInputAssemblyState = &InputAssemblyInfo;
@@ -684,31 +1041,89 @@ private:
 		PipelineInfo.pRasterizationState = &Rasterizer;
 
 		PipelineInfo.pMultisampleState = &Multisampling;
-		PipelineInfo.pDepthStencilState = nullptr; // Optional
+		PipelineInfo.pDepthStencilState = &DepthStencil;
 		PipelineInfo.pColorBlendState = &ColorBlending;
-		PipelineInfo.pDynamicState = nullptr; // Optional
+		PipelineInfo.pDynamicState = &DynamicState;
 
 		//fixed function struct refs
-		PipelineInfo.layout = mPipelineLayout;
+		PipelineInfo.layout = Layout;
 
-		PipelineInfo.renderPass = mRenderPass;
+		PipelineInfo.renderPass = RenderPass;
 		PipelineInfo.subpass = 0;
 
 		//Used for graphics pipeline derivation
 		PipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
 		PipelineInfo.basePipelineIndex = -1;              // Optional
 
-		//Graphics Pipeline creation
-		if (vkCreateGraphicsPipelines(mDevice, VK_NULL_HANDLE, 1, &PipelineInfo, nullptr, &mGraphicsPipeline) != VK_SUCCESS)
+		std::vector<VkGraphicsPipelineCreateInfo> PipelineInfos(VariantCount, PipelineInfo);
+		for (uint32_t Variant = 0; Variant < VariantCount; ++Variant)
 		{
-			throw std::runtime_error("Failed to create graphics pipeline!");
+			PipelineInfos[Variant].pStages = ShaderStages[Variant].data();
+		}
+
+		//Variants are split in one contiguous batch per thread, every batch created with a single call
+		const uint32_t BatchCount = Tasks != nullptr ? std::min(Tasks->GetThreadCount(), VariantCount) : 1;
+		std::vector<VkPipelineCache> Caches;
+		for (uint32_t Batch = 0; Batch < BatchCount; ++Batch)
+		{
+			Caches.push_back(mPipelineCache.CreateWorkerCache());
+		}
+
+		std::vector<VkPipeline> Pipelines(VariantCount, VK_NULL_HANDLE);
+		std::vector<VkResult> Results(BatchCount, VK_SUCCESS);
+		auto CreateBatch = [&](uint32_t Batch)
+		{
+			const uint32_t First = VariantCount * Batch / BatchCount;
+			const uint32_t Last = VariantCount * (Batch + 1) / BatchCount;
+			Results[Batch] = vkCreateGraphicsPipelines(mDevice, Caches[Batch], Last - First, &PipelineInfos[First], nullptr, &Pipelines[First]);
+		};
+		if (Tasks != nullptr)
+		{
+			Tasks->ParallelFor(BatchCount, CreateBatch);
+		}
+		else
+		{
+			CreateBatch(0);
 		}
 
 		//We destroy shader modules at the end of the pipeline creation
 		vkDestroyShaderModule(mDevice, FragmentShaderModule, nullptr);
 		vkDestroyShaderModule(mDevice, VertexShaderModule, nullptr);
+
+		if (std::any_of(Results.begin(), Results.end(), [](VkResult Result) { return Result != VK_SUCCESS; }))
+		{
+			//Failed creations leave a null handle, the others must go
+			DestroyPipelines(Pipelines);
+			throw std::runtime_error("Failed to create graphics pipeline!");
+		}
+		return Pipelines;
+	}
+
+	void DestroyPipelines(const std::vector<VkPipeline>& Pipelines)
+	{
+		for (auto Pipeline : Pipelines)
+		{
+			vkDestroyPipeline(mDevice, Pipeline, nullptr);
+		}
 	}
 
+	//Depth buffer format: the first of these the device can render depth to
+	VkFormat FindDepthFormat()
+	{
+		for (VkFormat Format : { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT })
+		{
+			VkFormatProperties Properties;
+			vkGetPhysicalDeviceFormatProperties(mPhysicalDevice, Format, &Properties);
+			if (Properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+			{
+				return Format;
+			}
+		}
+		throw std::runtime_error("Failed to find a depth buffer format!");
+	}
+
+	//The render graph creates the render passes the frame actually runs. This one is only there to create the pipeline against:
+	//pipelines work with any compatible render pass (same attachment formats and sample counts)
 	void CreateRenderPass()
 	{
 		//Let's create the color attachment
@@ -720,26 +1135,45 @@ private:
 		ColorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		ColorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		ColorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		ColorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		//Without a swap chain there is nothing to present: leave the image ready to be copied out instead
+		ColorAttachment.finalLayout = mOptions.mHeadless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+		//Depth attachment, right after the color one like in the render graph's main pass
+		VkAttachmentDescription DepthAttachment = {};
+		DepthAttachment.format = mDepthFormat;
+		DepthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		DepthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		DepthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		DepthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		DepthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		DepthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		DepthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		const VkAttachmentDescription Attachments[] = { ColorAttachment, DepthAttachment };
 
 		//Color attachment
 		VkAttachmentReference ColorAttachmentRef = {};
 		ColorAttachmentRef.attachment = 0;
 		ColorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+		VkAttachmentReference DepthAttachmentRef = {};
+		DepthAttachmentRef.attachment = 1;
+		DepthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
 		//Subpass
 		VkSubpassDescription Subpass = {};
 		Subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 		//The index of the attachment in this array is directly referenced from the fragment shader with the layout(location = 0) out vec4 outColor directive!
 		Subpass.colorAttachmentCount = 1;
 		Subpass.pColorAttachments = &ColorAttachmentRef;
+		Subpass.pDepthStencilAttachment = &DepthAttachmentRef;
 
 		//Render Pass creation
 		VkRenderPassCreateInfo RenderPassInfo = {};
 		RenderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
 
-		RenderPassInfo.attachmentCount = 1;
-		RenderPassInfo.pAttachments = &ColorAttachment;
+		RenderPassInfo.attachmentCount = static_cast<uint32_t>(std::size(Attachments));
+		RenderPassInfo.pAttachments = Attachments;
 		RenderPassInfo.subpassCount = 1;
 		RenderPassInfo.pSubpasses = &Subpass;
 
@@ -750,173 +1184,497 @@ private:
 
 	}
 
-	void CreateFramebuffers()
-	{
-		const auto ImageViewCount = mSwapChainImageViews.size();
-		mSwapChainFramebuffers.resize(ImageViewCount);
-
-		for (size_t i = 0; i < ImageViewCount; ++i)
-		{
-			VkImageView Attachments[] =
-			{
-				mSwapChainImageViews[i]
-			};
-			VkFramebufferCreateInfo framebufferInfo = {};
-			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			framebufferInfo.renderPass = mRenderPass;
-			framebufferInfo.attachmentCount = 1;
-			framebufferInfo.pAttachments = Attachments;
-			framebufferInfo.width = mSwapChainExtent.width;
-			framebufferInfo.height = mSwapChainExtent.height;
-			framebufferInfo.layers = 1;
-			if (vkCreateFramebuffer(mDevice, &framebufferInfo, nullptr, &mSwapChainFramebuffers[i]) != VK_SUCCESS)
-			{
-				throw std::runtime_error("Failed to create framebuffer!");
-			}
-		}
-	}
-
-	void CreateCommandPool()
+	VkCommandPool CreateTransientCommandPool(uint32_t QueueFamilyIndex)
 	{
-		QueueFamilyIndices QFIndices = FindQueueFamilies(mPhysicalDevice);
-
 		//Commnad pool info structs
 		VkCommandPoolCreateInfo PoolInfo = {};
 		PoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		PoolInfo.queueFamilyIndex = QFIndices.mGraphicsFamily;
-		PoolInfo.flags = 0; // Optional
+		PoolInfo.queueFamilyIndex = QueueFamilyIndex;
+		//Command buffers allocated from here are short lived: they get re-recorded every frame after resetting the whole pool
+		PoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
 		//Create the actual command pool
-		if (vkCreateCommandPool(mDevice, &PoolInfo, nullptr, &mCommandPool) != VK_SUCCESS)
+		VkCommandPool CommandPool;
+		if (vkCreateCommandPool(mDevice, &PoolInfo, nullptr, &CommandPool) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create command pool!");
 		}
+		return CommandPool;
 	}
 
-	void CreateCommandBuffers()
+	VkCommandBuffer AllocateCommandBuffer(VkCommandPool CommandPool, VkCommandBufferLevel Level)
 	{
-		//Allocate as many command buffers as the number of swap chain images are
-		mCommandBuffers.resize(mSwapChainFramebuffers.size());
-
 		VkCommandBufferAllocateInfo AllocInfo = {};
 		AllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		AllocInfo.commandPool = mCommandPool;
-		AllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		AllocInfo.commandBufferCount = (uint32_t)mCommandBuffers.size();
-		
-		if (vkAllocateCommandBuffers(mDevice, &AllocInfo,mCommandBuffers.data()) != VK_SUCCESS)
+		AllocInfo.commandPool = CommandPool;
+		AllocInfo.level = Level;
+		AllocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer CommandBuffer;
+		if (vkAllocateCommandBuffers(mDevice, &AllocInfo, &CommandBuffer) != VK_SUCCESS)
 		{
 			 throw std::runtime_error("Failed to allocate command buffers!");				
 		}
+		return CommandBuffer;
+	}
 
-		//Command buffers recording 
-		for (size_t i = 0; i < mCommandBuffers.size(); ++i) 
+	//Create the per frame in flight command pools and buffers. Nothing is recorded here: commands are re-recorded every frame in RecordFrameCommands()
+	void CreateFrameCommands()
+	{
+		QueueFamilyIndices QFIndices = FindQueueFamilies(mPhysicalDevice);
+
+		const uint32_t RecordingThreadCount = mTaskSystem->GetThreadCount();
+
+		mFrameCommands.resize(mOptions.mFramesInFlight);
+		for (auto& Frame : mFrameCommands)
 		{
-			//Registering i-th command buffer
-			VkCommandBufferBeginInfo BeginInfo = {};
-			BeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT; //The command buffer can be resubmitted while it is also already pending execution.
-			BeginInfo.pInheritanceInfo = nullptr; // Optional
-			
-			if(vkBeginCommandBuffer(mCommandBuffers[i], &BeginInfo) != VK_SUCCESS)
+			Frame.mPrimaryPool = CreateTransientCommandPool(QFIndices.mGraphicsFamily);
+			Frame.mPrimaryCommandBuffer = AllocateCommandBuffer(Frame.mPrimaryPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+			Frame.mWorkerPools.resize(RecordingThreadCount);
+			Frame.mSecondaryCommandBuffers.resize(RecordingThreadCount);
+			for (uint32_t i = 0; i < RecordingThreadCount; ++i)
 			{
-				throw std::runtime_error("Failed to begin recording command buffer!");
-			}	
+				Frame.mWorkerPools[i] = CreateTransientCommandPool(QFIndices.mGraphicsFamily);
+				Frame.mSecondaryCommandBuffers[i] = AllocateCommandBuffer(Frame.mWorkerPools[i], VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+			}
+		}
+	}
 
+	//Record the current frame: the render graph records the barriers and render passes, the main pass gets its draws
+	//from the recording threads (see RecordMainPass)
+	void RecordFrameCommands(uint32_t ImageIndex)
+	{
+		FrameCommands& Frame = mFrameCommands[mCurrentFrame];
 
-			//Begin rendering starts with a begin render pass
+		//The GPU is done with this frame's command buffers (DrawFrame waited for its fence), so we can recycle them all at once.
+		//Resetting the pools is cheaper than resetting the command buffers one by one
+		vkResetCommandPool(mDevice, Frame.mPrimaryPool, 0);
+		for (auto WorkerPool : Frame.mWorkerPools)
+		{
+			vkResetCommandPool(mDevice, WorkerPool, 0);
+		}
 
-			//But first we fill a render pass info struct
-			VkRenderPassBeginInfo RenderPassInfo = {};
-			RenderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			RenderPassInfo.renderPass = mRenderPass;
-			RenderPassInfo.framebuffer = mSwapChainFramebuffers[i];
+		VkCommandBuffer CommandBuffer = Frame.mPrimaryCommandBuffer;
 
-			//Render area must have the same extent of the swap chain images
-			RenderPassInfo.renderArea.offset = { 0, 0 };
-			RenderPassInfo.renderArea.extent = mSwapChainExtent;
+		VkCommandBufferBeginInfo BeginInfo = {};
+		BeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		BeginInfo.pInheritanceInfo = nullptr; // Optional
 
-			//Set the clear color
-			VkClearValue ClearColor = { 1.0f, 0.0f, 0.0f, 1.0f };
-			RenderPassInfo.clearValueCount = 1;
-			RenderPassInfo.pClearValues = &ClearColor;
+		if (vkBeginCommandBuffer(CommandBuffer, &BeginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to begin recording command buffer!");
+		}
 
-			//BEGIN RENDER PASS
-			vkCmdBeginRenderPass(mCommandBuffers[i], &RenderPassInfo,VK_SUBPASS_CONTENTS_INLINE);
+		//Collect the GPU timings of the frame that used this slot before, and get its queries ready for this frame.
+		//This must happen before any scope gets opened, secondary command buffers included
+		mGpuProfiler.BeginFrame(CommandBuffer, static_cast<uint32_t>(mCurrentFrame));
+		const uint32_t FrameScope = mGpuProfiler.BeginScope(CommandBuffer, "Frame");
 
-			//BIND THE GRAPHICS PIPELINE
-			vkCmdBindPipeline(mCommandBuffers[i],VK_PIPELINE_BIND_POINT_GRAPHICS, mGraphicsPipeline);
+		//Take ownership of the buffers the transfer queue has streamed in since the last frame; the submission then waits for
+		//the transfer timeline before its vertex input
+		mTransferWaitValue = mBufferStreamer.AcquireOnGraphicsQueue(CommandBuffer);
 
-			//Draw a triangle
-			vkCmdDraw(mCommandBuffers[i], 3, 1, 0, 0);
+		//Sort and pack the objects before the recording threads need the batches
+		BuildDrawBatches();
 
-			//END RENDER PASS
-			vkCmdEndRenderPass(mCommandBuffers[i]);
+		//The back buffer is the only thing of the graph changing from a frame to the next
+		mRenderGraph->SetImportedImage(mBackBuffer, mSwapChainImages[ImageIndex], mSwapChainImageViews[ImageIndex]);
 
-			//We've finished recording this command buffer
-			if (vkEndCommandBuffer(mCommandBuffers[i]) != VK_SUCCESS)
-			{
-				throw std::runtime_error("Failed to record command buffer!");				
-			}
+		//Every pass gets its own timing scope, written outside of its render pass (timestamps can't be written in a render pass
+		//whose content comes from secondary command buffers)
+		mRenderGraph->Execute(CommandBuffer, &mGpuProfiler);
+
+		mGpuProfiler.EndScope(CommandBuffer, FrameScope);
 
+		//We've finished recording this command buffer
+		if (vkEndCommandBuffer(CommandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to record command buffer!");				
 		}
 	}
 
-	QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice Device)
+	//Device local buffer the transfer queue streams into (exclusive: ownership moves to the graphics family with every upload)
+	VkBuffer CreateDeviceLocalBuffer(VkDeviceSize Size, VkBufferUsageFlags Usage, DeviceAllocation& Allocation)
 	{
-		QueueFamilyIndices Indices;
+		VkBufferCreateInfo BufferInfo = {};
+		BufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		BufferInfo.size = Size;
+		BufferInfo.usage = Usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		BufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkBuffer Buffer = VK_NULL_HANDLE;
+		if (vkCreateBuffer(mDevice, &BufferInfo, nullptr, &Buffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a device local buffer!");
+		}
+		Allocation = mMemoryAllocator.AllocateForBuffer(Buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		return Buffer;
+	}
 
-		uint32_t QueueFamilyCount = 0;
-		vkGetPhysicalDeviceQueueFamilyProperties(Device, &QueueFamilyCount, nullptr);
+	//Stream the triangle's vertices and indices in from the transfer queue; the first frame acquires them
+	void CreateGeometryBuffers()
+	{
+		mVertexBuffer = CreateDeviceLocalBuffer(sizeof(kTRIANGLE_VERTICES), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, mVertexBufferAllocation);
+		mIndexBuffer = CreateDeviceLocalBuffer(sizeof(kTRIANGLE_INDICES), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, mIndexBufferAllocation);
+
+		mBufferStreamer.UploadBuffer(mVertexBuffer, 0, kTRIANGLE_VERTICES, sizeof(kTRIANGLE_VERTICES), VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+		mBufferStreamer.UploadBuffer(mIndexBuffer, 0, kTRIANGLE_INDICES, sizeof(kTRIANGLE_INDICES), VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+		mBufferStreamer.Flush();
+
+		mTriangleGeometry.mVertexBuffers[0] = mVertexBuffer;
+		mTriangleGeometry.mVertexStreamCount = 1;
+		mTriangleGeometry.mIndexBuffer = mIndexBuffer;
+		mTriangleGeometry.mIndexType = VK_INDEX_TYPE_UINT16;
+		mTriangleGeometry.mIndexCount = static_cast<uint32_t>(std::size(kTRIANGLE_INDICES));
+	}
 
-		std::vector<VkQueueFamilyProperties> QueueFamilies(QueueFamilyCount);
-		vkGetPhysicalDeviceQueueFamilyProperties(Device, &QueueFamilyCount, QueueFamilies.data());
+	//Mesh view: world to clip space (rotated by the fixed view angles, orthographic, Y down, depth 0 nearest), quantized
+	//positions to a unit bounding sphere, and the light direction taken from view to world space
+	static MeshConstants ComputeMeshConstants(const GpuMesh& Mesh, float AspectRatio)
+	{
+		const float Yaw[2] = { std::cos(kMESH_VIEW_YAW), std::sin(kMESH_VIEW_YAW) };
+		const float Pitch[2] = { std::cos(kMESH_VIEW_PITCH), std::sin(kMESH_VIEW_PITCH) };
 
-		int32_t i = 0;
-		for (const auto& QueueFamily : QueueFamilies)
+		//Pitch (around X) after yaw (around Y), row major
+		const float View[3][3] =
 		{
+			{ Yaw[0], 0.0f, Yaw[1] },
+			{ Pitch[1] * Yaw[1], Pitch[0], -Pitch[1] * Yaw[0] },
+			{ -Pitch[0] * Yaw[1], Pitch[1], Pitch[0] * Yaw[0] },
+		};
 
-			VkBool32 PresentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(Device, i, mSurface,&PresentSupport);
+		//The object grid spans [-1, 1] in X and Y: everything in it is within sqrt(2) of the center, which depth must cover
+		const float Margin = 0.9f;
+		const float ClipScale[3] = { Margin / std::max(AspectRatio, 1.0f), -Margin * std::min(AspectRatio, 1.0f), -0.5f / std::sqrt(2.0f) };
 
-			//Presentation Family Queue
-			if (QueueFamily.queueCount > 0 && PresentSupport)
+		MeshConstants Constants = {};
+		for (uint32_t Column = 0; Column < 3; ++Column)
+		{
+			for (uint32_t Row = 0; Row < 3; ++Row)
 			{
-				Indices.mPresentFamily = i;
+				Constants.mViewProjection[Column * 4 + Row] = ClipScale[Row] * View[Row][Column];
 			}
+		}
+		Constants.mViewProjection[3 * 4 + 2] = 0.5f;
+		Constants.mViewProjection[3 * 4 + 3] = 1.0f;
 
-			//Graphics Family Queue
-			if (QueueFamily.queueCount > 0 && QueueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		const float Radius = std::sqrt(Mesh.mHalfExtent[0] * Mesh.mHalfExtent[0] + Mesh.mHalfExtent[1] * Mesh.mHalfExtent[1] + Mesh.mHalfExtent[2] * Mesh.mHalfExtent[2]);
+		for (uint32_t Axis = 0; Axis < 3; ++Axis)
+		{
+			Constants.mDequantize[Axis] = Radius > 0.0f ? Mesh.mHalfExtent[Axis] / Radius : 0.0f;
+		}
+
+		const float LightLength = std::sqrt(kMESH_LIGHT_DIRECTION[0] * kMESH_LIGHT_DIRECTION[0] + kMESH_LIGHT_DIRECTION[1] * kMESH_LIGHT_DIRECTION[1] + kMESH_LIGHT_DIRECTION[2] * kMESH_LIGHT_DIRECTION[2]);
+		for (uint32_t Column = 0; Column < 3; ++Column)
+		{
+			for (uint32_t Row = 0; Row < 3; ++Row)
 			{
-				Indices.mGraphicsFamily = i;				
+				Constants.mLightDirection[Column] += View[Row][Column] * kMESH_LIGHT_DIRECTION[Row] / LightLength;
 			}
+		}
+		return Constants;
+	}
 
-			if (Indices.IsComplete())
+	//Bounding sphere (world space) against the left/right/top/bottom sides of the clip volume, for an orthographic
+	//ViewProjection (column major)
+	static bool IsSphereInView(const float* ViewProjection, const float* Center, float Radius)
+	{
+		for (uint32_t Axis = 0; Axis < 2; ++Axis)
+		{
+			float Clip = ViewProjection[3 * 4 + Axis];
+			float AxisScale = 0.0f;
+			for (uint32_t Column = 0; Column < 3; ++Column)
 			{
-				break;
+				Clip += ViewProjection[Column * 4 + Axis] * Center[Column];
+				AxisScale += ViewProjection[Column * 4 + Axis] * ViewProjection[Column * 4 + Axis];
+			}
+			if (std::fabs(Clip) - Radius * std::sqrt(AxisScale) > 1.0f)
+			{
+				return false;
 			}
-
-			++i;
 		}
-
-		return Indices;
+		return true;
 	}
 
-
-	bool CheckDeviceExtensionSupport(VkPhysicalDevice Device)
+	//The frame's objects: mOptions.mDrawCount copies of the mesh (or of the triangle without one) in a grid over [-1, 1],
+	//culled against the view, then sorted and batched. Runs on the main thread before the recording threads start.
+	void BuildDrawBatches()
 	{
-		//Get the device extensions count
-		uint32_t ExtensionCount = 0;
-		vkEnumerateDeviceExtensionProperties(Device, nullptr,&ExtensionCount, nullptr);
-
-		//Allocate space to store them
-		std::vector<VkExtensionProperties> AvailableExtensions(ExtensionCount);
+		mDrawBatcher.BeginFrame(static_cast<uint32_t>(mCurrentFrame));
 
-		//Query for them again this time storing them in the previously allocated array
-		vkEnumerateDeviceExtensionProperties(Device, nullptr,&ExtensionCount, AvailableExtensions.data());
+		//The triangle's world is clip space already
+		static const float kIdentity[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+		const float* ViewProjection = kIdentity;
 
-		//Let's remove the available extensions from the list of the required ones, if the list will get empty then we'll know
-		std::set<std::string> RequiredExtensions(DeviceExtensions.begin(),DeviceExtensions.end());
+		DrawObject Object;
+		if (mMesh.mBuffer != VK_NULL_HANDLE)
+		{
+			mMeshConstants = ComputeMeshConstants(mMesh, static_cast<float>(mSwapChainExtent.width) / static_cast<float>(mSwapChainExtent.height));
+			ViewProjection = mMeshConstants.mViewProjection;
+
+			//Positions and normals are two streams of the same buffer
+			mMeshGeometry.mVertexBuffers[0] = mMesh.mBuffer;
+			mMeshGeometry.mVertexOffsets[0] = mMesh.mPositionOffset;
+			mMeshGeometry.mVertexBuffers[1] = mMesh.mBuffer;
+			mMeshGeometry.mVertexOffsets[1] = mMesh.mNormalOffset;
+			mMeshGeometry.mVertexStreamCount = 2;
+			mMeshGeometry.mIndexBuffer = mMesh.mBuffer;
+			mMeshGeometry.mIndexOffset = mMesh.mIndexOffset;
+			mMeshGeometry.mIndexType = mMesh.mIndexType;
+			mMeshGeometry.mIndexCount = mMesh.mIndexCount;
+			mMeshGeometry.mPushConstants = &mMeshConstants;
+			mMeshGeometry.mPushConstantSize = sizeof(MeshConstants);
+			mMeshGeometry.mPushConstantStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+			Object.mPipeline = mMeshPipeline;
+			Object.mLayout = mMeshPipelineLayout;
+			Object.mGeometry = &mMeshGeometry;
+		}
+		else
+		{
+			Object.mPipeline = mGraphicsPipelines[mActiveVariant];
+			Object.mLayout = mPipelineLayout;
+			Object.mGeometry = &mTriangleGeometry;
+		}
+
+		//Uniform scale and translation: a single object covers the whole grid, which leaves the triangle where it always was
+		const uint32_t ObjectCount = mOptions.mDrawCount;
+		const uint32_t Columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(ObjectCount))));
+		const float Scale = 1.0f / static_cast<float>(std::max(Columns, 1u));
+		for (uint32_t Index = 0; Index < ObjectCount; ++Index)
+		{
+			//Both the mesh and the triangle fit in a sphere of radius 1 before scaling
+			const float Center[3] = { -1.0f + (2 * (Index % Columns) + 1) * Scale, -1.0f + (2 * (Index / Columns) + 1) * Scale, 0.0f };
+			if (!IsSphereInView(ViewProjection, Center, Scale))
+			{
+				continue;
+			}
+
+			float* Transform = Object.mInstance.mTransform;
+			std::fill(Transform, Transform + 16, 0.0f);
+			Transform[0] = Scale;
+			Transform[5] = Scale;
+			Transform[10] = Scale;
+			Transform[12] = Center[0];
+			Transform[13] = Center[1];
+			Transform[14] = Center[2];
+			Transform[15] = 1.0f;
+			mDrawBatcher.Add(Object);
+		}
+
+		mDrawBatcher.Build();
+	}
+
+	//A mesh file gets uploaded as is. Sources (OBJ/glTF) are imported, optimized and converted to a mesh file in memory
+	//first: the same as the offline converter does (--convert-mesh), only at load time.
+	GpuMesh LoadMesh(const std::string& FileName, uint32_t Optimizations = kMeshOptimizeAll)
+	{
+		const size_t Dot = FileName.find_last_of('.');
+		if (Dot != std::string::npos && FileName.compare(Dot, std::string::npos, ".mesh") == 0)
+		{
+			return mMeshLoader.Load(FileName);
+		}
+
+		MeshSourceData Source = LoadMeshSource(FileName);
+		OptimizeMesh(Source, Optimizations);
+		const std::vector<uint8_t> File = BuildMeshFile(Source);
+		return mMeshLoader.Upload(MeshFileView(File.data(), File.size()));
+	}
+
+	//Main pass content: the draw batches (see BuildDrawBatches) are split across the recording threads, each one filling its
+	//own secondary command buffer, then the primary command buffer executes all of them. The render pass has already begun.
+	void RecordMainPass(const RenderGraphPassContext& Context)
+	{
+		FrameCommands& Frame = mFrameCommands[mCurrentFrame];
+
+		//Secondary command buffers recorded for a render pass must know which render pass/subpass/framebuffer they'll be executed in
+		VkCommandBufferInheritanceInfo InheritanceInfo = {};
+		InheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		InheritanceInfo.renderPass = Context.mRenderPass;
+		InheritanceInfo.subpass = 0;
+		InheritanceInfo.framebuffer = Context.mFramebuffer;
+
+		const uint32_t RecordingThreadCount = static_cast<uint32_t>(Frame.mSecondaryCommandBuffers.size());
+		const size_t BatchCount = mDrawBatcher.GetBatches().size();
+
+		mTaskSystem->ParallelFor(RecordingThreadCount, [&](uint32_t ThreadIndex)
+		{
+			VkCommandBuffer SecondaryCommandBuffer = Frame.mSecondaryCommandBuffers[ThreadIndex];
+
+			VkCommandBufferBeginInfo BeginInfo = {};
+			BeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			//Recorded once, submitted once, and entirely inside a render pass
+			BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+			BeginInfo.pInheritanceInfo = &InheritanceInfo;
+
+			if (vkBeginCommandBuffer(SecondaryCommandBuffer, &BeginInfo) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to begin recording secondary command buffer!");
+			}
+
+			//State is not inherited from the primary command buffer: the batcher binds the pipelines and buffers, and
+			//every secondary must set the dynamic state
+			VkViewport Viewport = {};
+			Viewport.x = 0.0f;
+			Viewport.y = 0.0f;
+			Viewport.width = (float)mSwapChainExtent.width;
+			Viewport.height = (float)mSwapChainExtent.height;
+			Viewport.minDepth = 0.0f;
+			Viewport.maxDepth = 1.0f;
+			vkCmdSetViewport(SecondaryCommandBuffer, 0, 1, &Viewport);
+
+			VkRect2D Scissor = {};
+			Scissor.offset = { 0, 0 };
+			Scissor.extent = mSwapChainExtent;
+			vkCmdSetScissor(SecondaryCommandBuffer, 0, 1, &Scissor);
+
+			{
+				//Scopes of every recording thread get summed up into a single "Draws" timing
+				ScopedGpuTimer DrawsTimer(mGpuProfiler, SecondaryCommandBuffer, mDrawsScopeName);
+
+				//This thread's slice of the batches (one per object without instancing)
+				const size_t FirstBatch = BatchCount * ThreadIndex / RecordingThreadCount;
+				const size_t LastBatch = BatchCount * (ThreadIndex + 1) / RecordingThreadCount;
+				mDrawBatcher.Record(SecondaryCommandBuffer, FirstBatch, LastBatch - FirstBatch);
+			}
+
+			if (vkEndCommandBuffer(SecondaryCommandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to record secondary command buffer!");
+			}
+		});
+
+		vkCmdExecuteCommands(Context.mCommandBuffer, RecordingThreadCount, Frame.mSecondaryCommandBuffers.data());
+	}
+
+	//Declare the frame: its passes and the images they read and write. Built again whenever the swap chain changes.
+	void BuildRenderGraph()
+	{
+		mRenderGraph = std::make_shared<RenderGraph>();
+
+		RenderGraphImageDesc BackBufferDesc;
+		BackBufferDesc.mFormat = mSwapChainImageFormat;
+		BackBufferDesc.mExtent = mSwapChainExtent;
+
+		//The previous content of the back buffer is never needed (UNDEFINED), and the acquire semaphore is waited at the color output stage.
+		//Without a swap chain there is nothing to present: leave the image ready to be copied out instead
+		if (mOptions.mHeadless)
+		{
+			mBackBuffer = mRenderGraph->ImportImage("BackBuffer", BackBufferDesc, VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+		}
+		else
+		{
+			mBackBuffer = mRenderGraph->ImportImage("BackBuffer", BackBufferDesc, VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		}
+
+		//Set the clear color
+		VkClearColorValue ClearColor = { { 1.0f, 0.0f, 0.0f, 1.0f } };
+
+		//Only the main pass uses it, so it never leaves the tile memory
+		RenderGraphImageDesc DepthDesc;
+		DepthDesc.mFormat = mDepthFormat;
+		DepthDesc.mExtent = mSwapChainExtent;
+		const RenderGraphResource Depth = mRenderGraph->CreateTransientImage("Depth", DepthDesc);
+
+		mRenderGraph->AddPass("MainPass")
+			.WriteColor(mBackBuffer, VK_ATTACHMENT_LOAD_OP_CLEAR, ClearColor)
+			.WriteDepth(Depth, VK_ATTACHMENT_LOAD_OP_CLEAR)
+			.SetSecondaryCommandBuffers()
+			.SetExecute([this](const RenderGraphPassContext& Context) { RecordMainPass(Context); });
+
+		mRenderGraph->Compile(mDevice, mMemoryAllocator);
+	}
+
+	QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice Device)
+	{
+		QueueFamilyIndices Indices;
+
+		uint32_t QueueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(Device, &QueueFamilyCount, nullptr);
+
+		std::vector<VkQueueFamilyProperties> QueueFamilies(QueueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(Device, &QueueFamilyCount, QueueFamilies.data());
+
+		int32_t i = 0;
+		for (const auto& QueueFamily : QueueFamilies)
+		{
+
+			VkBool32 PresentSupport = false;
+			if (mOptions.mHeadless)
+			{
+				//Nothing gets presented in headless mode, so the "present" queue is simply the graphics one
+				PresentSupport = QueueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+			}
+			else
+			{
+				vkGetPhysicalDeviceSurfaceSupportKHR(Device, i, mSurface, &PresentSupport);
+			}
+
+			//Presentation Family Queue
+			if (QueueFamily.queueCount > 0 && PresentSupport)
+			{
+				Indices.mPresentFamily = i;
+			}
+
+			//Graphics Family Queue
+			if (QueueFamily.queueCount > 0 && QueueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+			{
+				Indices.mGraphicsFamily = i;				
+			}
+
+			if (Indices.IsComplete())
+			{
+				break;
+			}
+
+			++i;
+		}
+
+		//Prefer a family that does transfers and nothing else, then one that at least doesn't do graphics
+		int32_t BestTransferScore = -1;
+		for (int32_t Family = 0; Family < static_cast<int32_t>(QueueFamilies.size()); ++Family)
+		{
+			const VkQueueFlags Flags = QueueFamilies[Family].queueFlags;
+			if (QueueFamilies[Family].queueCount == 0 || !(Flags & VK_QUEUE_TRANSFER_BIT) || (Flags & VK_QUEUE_GRAPHICS_BIT))
+			{
+				continue;
+			}
+
+			const int32_t Score = (Flags & VK_QUEUE_COMPUTE_BIT) ? 1 : 2;
+			if (Score > BestTransferScore)
+			{
+				BestTransferScore = Score;
+				Indices.mTransferFamily = Family;
+			}
+		}
+		if (Indices.mTransferFamily < 0)
+		{
+			Indices.mTransferFamily = Indices.mGraphicsFamily;
+		}
+
+		return Indices;
+	}
+
+
+	bool CheckDeviceExtensionSupport(VkPhysicalDevice Device)
+	{
+		//Get the device extensions count
+		uint32_t ExtensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(Device, nullptr,&ExtensionCount, nullptr);
+
+		//Allocate space to store them
+		std::vector<VkExtensionProperties> AvailableExtensions(ExtensionCount);
+
+		//Query for them again this time storing them in the previously allocated array
+		vkEnumerateDeviceExtensionProperties(Device, nullptr,&ExtensionCount, AvailableExtensions.data());
+
+		//Let's remove the available extensions from the list of the required ones, if the list will get empty then we'll know
+		auto DeviceExtensions = GetRequiredDeviceExtensions();
+		std::set<std::string> RequiredExtensions(DeviceExtensions.begin(),DeviceExtensions.end());
 		for (const auto& extension : AvailableExtensions) 
 		{
 			RequiredExtensions.erase(extension.extensionName);			
@@ -935,15 +1693,30 @@ private:
 		bool ExtensionsSupported = CheckDeviceExtensionSupport(Device);
 
 		//Check if the swap chain responds to the minimum requisites but only after we verified that the extensions are supported
-		bool SwapChainAdequate = false;
-		if (ExtensionsSupported) 
+		bool SwapChainAdequate = mOptions.mHeadless;
+		if (ExtensionsSupported && !mOptions.mHeadless) 
 		{			
 			SwapChainSupportDetails SwapChainSupport = QuerySwapChainSupport(Device);			
 			SwapChainAdequate = !SwapChainSupport.mFormats.empty() && !SwapChainSupport.mPresentModes.empty();			
 		}
 
+		//The extension being there doesn't mean the feature is supported
+		bool TimelineSemaphoreSupported = false;
+		if (ExtensionsSupported)
+		{
+			VkPhysicalDeviceTimelineSemaphoreFeaturesKHR TimelineFeatures = {};
+			TimelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+			VkPhysicalDeviceFeatures2 Features = {};
+			Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			Features.pNext = &TimelineFeatures;
+			vkGetPhysicalDeviceFeatures2(Device, &Features);
+
+			TimelineSemaphoreSupported = TimelineFeatures.timelineSemaphore == VK_TRUE;
+		}
+
 		//Add more features to test for in this function etc.
-		return Indices.IsComplete() && ExtensionsSupported && SwapChainAdequate;
+		return Indices.IsComplete() && ExtensionsSupported && SwapChainAdequate && TimelineSemaphoreSupported;
 	}
 
 	void PickPhysicalDevice() 
@@ -984,7 +1757,7 @@ private:
 
 		//Let's create a vector of queue for graphics and present queues respectively
 		std::vector<VkDeviceQueueCreateInfo> QueueCreateInfos;
-        std::set<int32_t> UniqueQueueFamilies = { Indices.mGraphicsFamily, Indices.mPresentFamily };
+        std::set<int32_t> UniqueQueueFamilies = { Indices.mGraphicsFamily, Indices.mPresentFamily, Indices.mTransferFamily };
 
 		float QueuePriority = 1.0f;
 		for (int queueFamily : UniqueQueueFamilies) 
@@ -1006,14 +1779,21 @@ private:
 		*/
 		VkPhysicalDeviceFeatures DeviceFeatures = {};
 
+		//Extension features are enabled by chaining their structs
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR TimelineFeatures = {};
+		TimelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		TimelineFeatures.timelineSemaphore = VK_TRUE;
+
 		VkDeviceCreateInfo CreateInfo = {};
 		CreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		CreateInfo.pNext = &TimelineFeatures;
 
 		CreateInfo.pQueueCreateInfos = QueueCreateInfos.data();
 		CreateInfo.queueCreateInfoCount = static_cast<uint32_t>(QueueCreateInfos.size());
 		CreateInfo.pEnabledFeatures = &DeviceFeatures;
 
 		//Enable extensions for this logical device 
+		auto DeviceExtensions = GetRequiredDeviceExtensions();
 		CreateInfo.enabledExtensionCount = static_cast<uint32_t>(DeviceExtensions.size());
 		CreateInfo.ppEnabledExtensionNames = DeviceExtensions.data();
 
@@ -1040,6 +1820,9 @@ private:
 		//Now we can get a handle to the present queue
 		vkGetDeviceQueue(mDevice, Indices.mPresentFamily, 0, &mPresentQueue);
 
+		//Buffer uploads are streamed from this one
+		vkGetDeviceQueue(mDevice, Indices.mTransferFamily, 0, &mTransferQueue);
+
 		/*
 			With the logical device and queue handles we can now actually start using the
 			graphics card to do things ! 
@@ -1058,54 +1841,171 @@ private:
 		}
 	}
 
+	//Called when the window surface changed (resize, minimize, monitor change ...). Headless targets never need this.
+	//No device wide wait here: the objects being replaced may still be used by frames in flight, so they go through the
+	//deferred deletion queue and get destroyed once the last frame that could reference them has completed.
 	void RecreateSwapChain() 
 	{
-		vkDeviceWaitIdle(mDevice);
-		
-		CreateSwapChain();
+		//A minimized window has a zero sized framebuffer and we can't create a swap chain for it, so just wait until it comes back
+		int Width = 0;
+		int Height = 0;
+		glfwGetFramebufferSize(mWindow, &Width, &Height);
+		while (Width == 0 || Height == 0)
+		{
+			if (glfwWindowShouldClose(mWindow))
+			{
+				return;
+			}
+			glfwWaitEvents();
+			glfwGetFramebufferSize(mWindow, &Width, &Height);
+		}
+
+		//Every frame submitted so far may still be using the current objects
+		const uint64_t RetireFrame = mFrameScheduler.GetLastSubmittedValue();
+		VkDevice Device = mDevice;
+
+		VkSwapchainKHR OldSwapChain = mSwapChain;
+		std::vector<VkImageView> OldImageViews = std::move(mSwapChainImageViews);
+		std::shared_ptr<RenderGraph> OldRenderGraph = std::move(mRenderGraph);
+		mSwapChainImageViews.clear();
+
+		const VkFormat OldFormat = mSwapChainImageFormat;
+
+		CreateSwapChain(OldSwapChain);
+
+		mDeletionQueue.Enqueue(RetireFrame, [Device, OldSwapChain, OldImageViews, OldRenderGraph]()
+		{
+			//Its framebuffers reference the old image views, and its transient images depend on the old extent
+			OldRenderGraph->Destroy();
+			for (auto ImageView : OldImageViews)
+			{
+				vkDestroyImageView(Device, ImageView, nullptr);
+			}
+			vkDestroySwapchainKHR(Device, OldSwapChain, nullptr);
+		});
+
 		CreateImageViews();
-		CreateRenderPass();
-		CreateGraphicsPipeline();
-		CreateFramebuffers();
-		CreateCommandBuffers();		
+
+		//Render pass and pipeline only depend on the image format (viewport and scissor are dynamic state), so a plain resize keeps them
+		if (mSwapChainImageFormat != OldFormat)
+		{
+			//A pipeline being hot reloaded references the render pass going away: rebuild it from scratch afterwards
+			if (CancelShaderReload())
+			{
+				mPipelineReloadPending = true;
+			}
+
+			VkRenderPass OldRenderPass = mRenderPass;
+			std::vector<VkPipeline> OldPipelines = std::move(mGraphicsPipelines);
+			OldPipelines.push_back(mMeshPipeline);
+			mDeletionQueue.Enqueue(RetireFrame, [Device, OldRenderPass, OldPipelines]()
+			{
+				for (auto OldPipeline : OldPipelines)
+				{
+					vkDestroyPipeline(Device, OldPipeline, nullptr);
+				}
+				vkDestroyRenderPass(Device, OldRenderPass, nullptr);
+			});
+
+			CreateRenderPass();
+			CreateGraphicsPipeline();
+		}
+
+		BuildRenderGraph();
 	}
 
 	void InitVulkan()
 	{
 		CreateVulkanInstance();
 		SetupDebugCallback();
-		CreateSurface();
+		if (!mOptions.mHeadless)
+		{
+			CreateSurface();
+		}
 		PickPhysicalDevice();
 		CreateLogicalDevice();
-		CreateSwapChain();
+		mMemoryAllocator.Create(mDevice, mPhysicalDevice);
+		if (mOptions.mHeadless)
+		{
+			CreateOffscreenTargets();
+		}
+		else
+		{
+			CreateSwapChain();
+		}
+		mPipelineCache.Create(mDevice, mPhysicalDevice, kPIPELINE_CACHE_FILE);
+		mLayoutCache.Create(mDevice);
+
+		//Recording threads (the calling thread counts as one of them), which also compile the shaders
+		const uint32_t RecordingThreadCount = mOptions.mRecordingThreadCount != 0 ? mOptions.mRecordingThreadCount : TaskSystem::GetDefaultWorkerCount() + 1;
+		mTaskSystem = std::make_unique<TaskSystem>(RecordingThreadCount - 1);
+
+		if (!mOptions.mShaderVariant.empty())
+		{
+			mActiveVariant = mFragmentVariants.Find(mOptions.mShaderVariant);
+			if (mActiveVariant == ShaderVariantSet::kInvalidVariant)
+			{
+				throw std::runtime_error("Unknown shader variant " + mOptions.mShaderVariant + " !");
+			}
+		}
+
 		CreateImageViews();
+		mDepthFormat = FindDepthFormat();
 		CreateRenderPass();
+		const auto PipelineStart = std::chrono::high_resolution_clock::now();
 		CreateGraphicsPipeline();
-		CreateFramebuffers();
-		CreateCommandPool();
-		CreateCommandBuffers();
+		const double PipelineMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - PipelineStart).count();
+		std::cout << "Graphics pipelines: " << mGraphicsPipelines.size() << " variants built in " << PipelineMs << " ms on " << mTaskSystem->GetThreadCount() << " threads, drawing with " << mFragmentVariants.GetName(mActiveVariant) << std::endl;
+		const ShaderCompilerStatistics ShaderStats = mShaderCompiler.GetStatistics();
+		std::cout << "Shaders: " << ShaderStats.mCompiledCount << " compiled in " << ShaderStats.mTotalCompileMs << " ms, " << ShaderStats.mCacheHitCount << " from the shader cache" << std::endl;
+		const PipelineLayoutCacheStatistics LayoutStats = mLayoutCache.GetStatistics();
+		std::cout << "Layouts: " << LayoutStats.mSetLayoutCount << " descriptor set layouts, " << LayoutStats.mPipelineLayoutCount << " pipeline layouts, " << LayoutStats.mHitCount << " shared" << std::endl;
+		BuildRenderGraph();
+		std::cout << "Render graph: " << mRenderGraph->GetStatistics() << std::endl;
+
+		CreateFrameCommands();
 		CreateSynchObjects();
+
+		QueueFamilyIndices QFIndices = FindQueueFamilies(mPhysicalDevice);
+		mBufferStreamer.Create(mDevice, mMemoryAllocator, mTransferQueue, QFIndices.mTransferFamily, QFIndices.mGraphicsFamily, kSTREAMING_RING_SIZE);
+		CreateGeometryBuffers();
+		mMeshLoader.Create(mDevice, mMemoryAllocator, mBufferStreamer);
+		std::cout << "Buffer streaming: " << (mBufferStreamer.HasDedicatedTransferQueue() ? "dedicated transfer queue family " + std::to_string(QFIndices.mTransferFamily) : std::string("graphics queue")) << std::endl;
+		if (!mOptions.mMeshPath.empty())
+		{
+			mMesh = LoadMesh(mOptions.mMeshPath);
+			mBufferStreamer.Flush();
+			std::cout << "Mesh: " << mOptions.mMeshPath << ", " << mMesh.mVertexCount << " vertices, " << mMesh.mIndexCount / 3 << " triangles" << std::endl;
+		}
+
+		mGpuProfiler.Create(mDevice, mPhysicalDevice, QFIndices.mGraphicsFamily, mOptions.mFramesInFlight);
+
+		//Set 0 of the triangle and mesh pipelines, as reflected from their vertex shaders (so the layout cache hands out the same one)
+		VkDescriptorSetLayoutBinding InstanceBinding = {};
+		InstanceBinding.binding = 0;
+		InstanceBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		InstanceBinding.descriptorCount = 1;
+		InstanceBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		mDrawBatcher.Create(mDevice, mMemoryAllocator, mLayoutCache.GetSetLayout({ InstanceBinding }), mOptions.mFramesInFlight, mOptions.mDrawCount, mOptions.mInstancing);
 	}
 
 	void CreateSynchObjects()
 	{
-		mImageAvailableSemaphores.resize(kMAX_FRAMES_IN_FLIGHT);
-		mRenderFinishedSemaphores.resize(kMAX_FRAMES_IN_FLIGHT);
-		mInFlightFences.resize(kMAX_FRAMES_IN_FLIGHT);
+		//CPU-GPU synchronization: one timeline semaphore for all the frames
+		mFrameScheduler.Create(mDevice, mOptions.mFramesInFlight);
+
+		//Acquire and present only work with binary semaphores, so we still need a pair of them per frame in flight
+		mImageAvailableSemaphores.resize(mOptions.mFramesInFlight);
+		mRenderFinishedSemaphores.resize(mOptions.mFramesInFlight);
 
 		VkSemaphoreCreateInfo SemaphoreInfo = {};
 		SemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		VkFenceCreateInfo FenceInfo = {};
-		FenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		FenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
 		//Create two semaphores
-		for (size_t i = 0; i < kMAX_FRAMES_IN_FLIGHT; i++)
+		for (size_t i = 0; i < mOptions.mFramesInFlight; i++)
 		{
 			if (vkCreateSemaphore(mDevice, &SemaphoreInfo, nullptr, &mImageAvailableSemaphores[i]) != VK_SUCCESS || 
-				vkCreateSemaphore(mDevice, &SemaphoreInfo, nullptr, &mRenderFinishedSemaphores[i]) != VK_SUCCESS ||
-				vkCreateFence(mDevice, &FenceInfo, nullptr,&mInFlightFences[i]))
+				vkCreateSemaphore(mDevice, &SemaphoreInfo, nullptr, &mRenderFinishedSemaphores[i]) != VK_SUCCESS)
 			{
 				throw std::runtime_error("Failed to create synchronization objects for a frame!");
 			}					
@@ -1115,36 +2015,91 @@ private:
 
 	void DrawFrame()
 	{
-		//Wait for the GPU to finish the rendering of the current frame
-		vkWaitForFences(mDevice, 1, &mInFlightFences[mCurrentFrame],VK_TRUE, std::numeric_limits<uint64_t>::max());
-		vkResetFences(mDevice, 1, &mInFlightFences[mCurrentFrame]);
+		//Wait for the GPU to finish the frame that last used this frame's slot (usually it already has, and this doesn't block)
+		mCurrentFrame = mFrameScheduler.GetFrameSlot();
+		mFrameTimer.BeginWait();
+		mFrameScheduler.WaitForFrameSlot();
+		mFrameTimer.EndWait();
+
+		//Release whatever the completed frames were holding on to
+		mDeletionQueue.Collect(mFrameScheduler.GetCompletedValue());
 
-		//Acquire an image from the swap chain
+		//Acquire an image from the swap chain (or just cycle through our own offscreen images when headless)
 		uint32_t ImageIndex;
-	    vkAcquireNextImageKHR(mDevice,mSwapChain,std::numeric_limits<uint64_t>::max(),mImageAvailableSemaphores[mCurrentFrame], VK_NULL_HANDLE, &ImageIndex);
+		if (mOptions.mHeadless)
+		{
+			ImageIndex = mOffscreenImageIndex;
+			mOffscreenImageIndex = (mOffscreenImageIndex + 1) % static_cast<uint32_t>(mSwapChainImages.size());
+		}
+		else
+		{
+			VkResult Result = vkAcquireNextImageKHR(mDevice,mSwapChain,std::numeric_limits<uint64_t>::max(),mImageAvailableSemaphores[mCurrentFrame], VK_NULL_HANDLE, &ImageIndex);
+			if (Result == VK_ERROR_OUT_OF_DATE_KHR)
+			{
+				//The swap chain can't be used anymore, nothing has been submitted for this frame so we just try again with a new one next time
+				RecreateSwapChain();
+				return;
+			}
+			else if (Result != VK_SUCCESS && Result != VK_SUBOPTIMAL_KHR)
+			{
+				throw std::runtime_error("Failed to acquire swap chain image!");
+			}
+		}
+
+		//Record this frame's commands from scratch
+		RecordFrameCommands(ImageIndex);
 
 		VkSubmitInfo SubmitInfo = {};
 		SubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 		
-		VkSemaphore WaitSemaphores[] = { mImageAvailableSemaphores[mCurrentFrame] };
-		VkPipelineStageFlags WaitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		SubmitInfo.waitSemaphoreCount = 1;
+		//Offscreen images are available as soon as the fence above is signaled, so there is no acquire semaphore to wait on.
+		//Buffers streamed in by the transfer queue are waited for right before the vertex input.
+		VkSemaphore WaitSemaphores[2];
+		VkPipelineStageFlags WaitStages[2];
+		uint64_t WaitValues[2] = { 0, 0 };
+		uint32_t WaitCount = 0;
+		if (!mOptions.mHeadless)
+		{
+			WaitSemaphores[WaitCount] = mImageAvailableSemaphores[mCurrentFrame];
+			WaitStages[WaitCount] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			++WaitCount;
+		}
+		if (mTransferWaitValue != 0)
+		{
+			WaitSemaphores[WaitCount] = mBufferStreamer.GetSemaphore();
+			WaitStages[WaitCount] = mBufferStreamer.GetGraphicsWaitStages();
+			WaitValues[WaitCount] = mTransferWaitValue;
+			++WaitCount;
+		}
+		SubmitInfo.waitSemaphoreCount = WaitCount;
 		SubmitInfo.pWaitSemaphores = WaitSemaphores;
 		SubmitInfo.pWaitDstStageMask = WaitStages;
 
 		//Execute the command buffer with that image as attachment in the framebuffer
 		SubmitInfo.commandBufferCount = 1;
-		SubmitInfo.pCommandBuffers = &mCommandBuffers[ImageIndex];
+		SubmitInfo.pCommandBuffers = &mFrameCommands[mCurrentFrame].mPrimaryCommandBuffer;
 
-		VkSemaphore SignalSemaphores[] = { mRenderFinishedSemaphores[mCurrentFrame] };
-		SubmitInfo.signalSemaphoreCount = 1;
+		//Signal the frame timeline with this frame's value, plus the binary semaphore present waits on (no present when headless)
+		VkSemaphore SignalSemaphores[] = { mFrameScheduler.GetSemaphore(), mRenderFinishedSemaphores[mCurrentFrame] };
+		const uint64_t SignalValues[] = { mFrameScheduler.GetNextFrameValue(), 0 };
+		SubmitInfo.signalSemaphoreCount = mOptions.mHeadless ? 1 : 2;
 		SubmitInfo.pSignalSemaphores = SignalSemaphores;
 
+		//Values for the timeline semaphores of the submission (binary ones ignore theirs)
+		VkTimelineSemaphoreSubmitInfoKHR TimelineInfo = {};
+		TimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		TimelineInfo.signalSemaphoreValueCount = SubmitInfo.signalSemaphoreCount;
+		TimelineInfo.pSignalSemaphoreValues = SignalValues;
+		TimelineInfo.waitSemaphoreValueCount = WaitCount;
+		TimelineInfo.pWaitSemaphoreValues = WaitValues;
+		SubmitInfo.pNext = &TimelineInfo;
+
 		//Submit the the command buffer to the graphics queue
-		if ( vkQueueSubmit(mGraphicsQueue, 1, &SubmitInfo, mInFlightFences[mCurrentFrame] ) != VK_SUCCESS )
+		if ( vkQueueSubmit(mGraphicsQueue, 1, &SubmitInfo, VK_NULL_HANDLE ) != VK_SUCCESS )
 		{
 			 throw std::runtime_error("Failed to submit draw command buffer!");				
 		}
+		mFrameScheduler.MarkSubmitted();
 
 		//Create subpass dependency and get ready to pass it to the render pass
 		VkSubpassDependency Dependency = {};
@@ -1160,11 +2115,17 @@ private:
 		RenderPassInfo.dependencyCount = 1;
 		RenderPassInfo.pDependencies = &Dependency;
 
+		if (mOptions.mHeadless)
+		{
+			//Nothing to present
+			return;
+		}
+
 		//Return the image to the swap chain for presentation
 		VkPresentInfoKHR PresentInfo = {};
 		PresentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 		PresentInfo.waitSemaphoreCount = 1;
-		PresentInfo.pWaitSemaphores = SignalSemaphores;
+		PresentInfo.pWaitSemaphores = &mRenderFinishedSemaphores[mCurrentFrame];
 
 		VkSwapchainKHR SwapChains[] = { mSwapChain };
 		PresentInfo.swapchainCount = 1;
@@ -1173,20 +2134,688 @@ private:
 		PresentInfo.pResults = nullptr; // Optional
 
 		//Ready To Present a frame ! FINALLY !!!!!
-		vkQueuePresentKHR(mPresentQueue, &PresentInfo);
-
-		mCurrentFrame = (mCurrentFrame + 1) % kMAX_FRAMES_IN_FLIGHT;
+		mFrameTimer.BeginPresent();
+		VkResult Result = vkQueuePresentKHR(mPresentQueue, &PresentInfo);
+		mFrameTimer.EndPresent();
+		if (Result == VK_ERROR_OUT_OF_DATE_KHR || Result == VK_SUBOPTIMAL_KHR || mFramebufferResized)
+		{
+			mFramebufferResized = false;
+			RecreateSwapChain();
+		}
+		else if (Result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to present swap chain image!");
+		}
 	}
 
 	void MainLoop()
 	{
-		while (!glfwWindowShouldClose(mWindow))
+		if (mOptions.mHeadless)
 		{
+			uint32_t FrameCount = mOptions.mFrameCount != 0 ? mOptions.mFrameCount : kDEFAULT_HEADLESS_FRAME_COUNT;
+
+			auto Start = std::chrono::high_resolution_clock::now();
+			for (uint32_t Frame = 0; Frame < FrameCount; ++Frame)
+			{
+				mFrameTimer.BeginFrame();
+				DrawFrame();
+			}
+			mFrameTimer.EndFrame();
+			//Make sure the GPU has really finished every frame before stopping the clock
+			vkDeviceWaitIdle(mDevice);
+			std::chrono::duration<double> Elapsed = std::chrono::high_resolution_clock::now() - Start;
+
+			std::cout << green.c_str() << "Headless: rendered " << FrameCount << " frames in " << Elapsed.count() << " s (" << FrameCount / Elapsed.count() << " FPS)" << reset.c_str() << std::endl;
+			ReportFrameStatistics();
+			ReportDrawStatistics();
+			ReportGpuTimings();
+			return;
+		}
+
+		StartShaderWatcher();
+
+		uint32_t Frame = 0;
+		while (!glfwWindowShouldClose(mWindow) && (mOptions.mFrameCount == 0 || Frame++ < mOptions.mFrameCount))
+		{
+			mFrameTimer.BeginFrame();
 			glfwPollEvents();
+			UpdateShaderHotReload();
+
+			//If the GPU is still behind, keep the window responsive instead of blocking inside DrawFrame until it catches up
+			mFrameTimer.BeginWait();
+			while (!mFrameScheduler.WaitForFrameSlot(kFRAME_SLOT_POLL_TIMEOUT) && !glfwWindowShouldClose(mWindow))
+			{
+				glfwPollEvents();
+			}
+			mFrameTimer.EndWait();
+
 			DrawFrame();
 		}
+		mFrameTimer.EndFrame();
 
 		//vkDeviceWaitIdle(mDevice); //<- not the optimal way of using the pipeline
+
+		ReportFrameStatistics();
+		ReportDrawStatistics();
+		ReportGpuTimings();
+	}
+
+	//Hot reload is a convenience: if the shader directory can't be watched we just go without it
+	void StartShaderWatcher()
+	{
+		try
+		{
+			mShaderWatcher = std::make_unique<FileWatcher>(kSHADER_DIRECTORY);
+			std::cout << "Watching " << kSHADER_DIRECTORY << " for shader changes" << std::endl;
+		}
+		catch (const std::exception& e)
+		{
+			std::cout << yellow.c_str() << "Shader hot reload disabled: " << e.what() << reset.c_str() << std::endl;
+		}
+	}
+
+	static bool IsShaderSource(const std::string& Path)
+	{
+		static const char* kExtensions[] = { ".vert", ".frag", ".comp", ".geom", ".tesc", ".tese", ".glsl" };
+		for (const char* Extension : kExtensions)
+		{
+			const size_t Length = strlen(Extension);
+			if (Path.size() >= Length && Path.compare(Path.size() - Length, Length, Extension) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//Runs on the reload thread: compile (serially, the task system belongs to the main thread) and build a new pipeline.
+	//The main thread keeps rendering with the current pipeline meanwhile.
+	PipelineReload RebuildGraphicsPipelines(VkRenderPass RenderPass)
+	{
+		PipelineReload Reload;
+		try
+		{
+			const GraphicsPipelineDesc Desc = GetTrianglePipelineDesc();
+			Reload.mPipelines = BuildGraphicsPipelines(Desc, CompileGraphicsShaders(Desc, nullptr), RenderPass, nullptr, Reload.mLayout);
+		}
+		catch (const std::exception& e)
+		{
+			Reload.mError = e.what();
+		}
+		return Reload;
+	}
+
+	//Called once per frame, between frames: never waits on the compiler, a rebuilt pipeline is only picked up once it's ready
+	void UpdateShaderHotReload()
+	{
+		if (!mShaderWatcher)
+		{
+			return;
+		}
+
+		for (const auto& Path : mShaderWatcher->PollChanges())
+		{
+			if (IsShaderSource(Path))
+			{
+				std::cout << cyan.c_str() << Path << " changed, rebuilding the graphics pipeline" << reset.c_str() << std::endl;
+				mPipelineReloadPending = true;
+			}
+		}
+
+		if (mPipelineReload.valid() && mPipelineReload.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			PipelineReload Reload = mPipelineReload.get();
+			mPipelineCache.MergeWorkerCaches();
+
+			if (!Reload.mError.empty())
+			{
+				//Keep the current pipeline, the next save will try again
+				std::cout << red.c_str() << "Shader hot reload failed: " << Reload.mError << reset.c_str() << std::endl;
+			}
+			else
+			{
+				//Frames in flight may still be using the current pipelines, they go once those are done
+				VkDevice Device = mDevice;
+				std::vector<VkPipeline> OldPipelines = std::move(mGraphicsPipelines);
+				mDeletionQueue.Enqueue(mFrameScheduler.GetLastSubmittedValue(), [Device, OldPipelines]()
+				{
+					for (auto OldPipeline : OldPipelines)
+					{
+						vkDestroyPipeline(Device, OldPipeline, nullptr);
+					}
+				});
+				mGraphicsPipelines = std::move(Reload.mPipelines);
+				mPipelineLayout = Reload.mLayout;
+				std::cout << green.c_str() << "Graphics pipelines reloaded (" << mGraphicsPipelines.size() << " variants)" << reset.c_str() << std::endl;
+			}
+		}
+
+		if (mPipelineReloadPending && !mPipelineReload.valid())
+		{
+			mPipelineReloadPending = false;
+			VkRenderPass RenderPass = mRenderPass;
+			mPipelineReload = std::async(std::launch::async, [this, RenderPass]()
+			{
+				return RebuildGraphicsPipelines(RenderPass);
+			});
+		}
+	}
+
+	//Wait for a background rebuild and throw its result away (its render pass is about to be destroyed).
+	//Returns true if there was one, so that the caller can start it again later.
+	bool CancelShaderReload()
+	{
+		if (!mPipelineReload.valid())
+		{
+			return false;
+		}
+
+		DestroyPipelines(mPipelineReload.get().mPipelines);
+		return true;
+	}
+
+	//Print the CPU side frame timings percentiles, and dump them to CSV/JSON files if asked to
+	void ReportFrameStatistics()
+	{
+		std::cout << "Frame statistics: " << FrameStatistics::FormatSummary(mFrameStatistics.ComputeReport()) << std::endl;
+
+		if (!mOptions.mFrameStatisticsPath.empty())
+		{
+			const std::string CsvPath = mOptions.mFrameStatisticsPath + ".csv";
+			const std::string JsonPath = mOptions.mFrameStatisticsPath + ".json";
+			if (mFrameStatistics.ExportCsv(CsvPath) && mFrameStatistics.ExportJson(JsonPath))
+			{
+				std::cout << "Frame statistics written to " << CsvPath << " and " << JsonPath << std::endl;
+			}
+			else
+			{
+				std::cerr << "Failed to write the frame statistics to " << mOptions.mFrameStatisticsPath << std::endl;
+			}
+		}
+	}
+
+	//Print how many draws the batcher submitted for how many objects, and how many draws instancing saved
+	void ReportDrawStatistics()
+	{
+		const DrawBatcherStatistics& Stats = mDrawBatcher.GetStatistics();
+		if (Stats.mFrameCount == 0)
+		{
+			return;
+		}
+
+		std::cout << "Draw batching (" << (mDrawBatcher.IsInstancing() ? "instanced" : "one draw per object") << "): " << Stats.mTotalObjectCount / Stats.mFrameCount
+			<< " objects in " << Stats.mTotalDrawCount / Stats.mFrameCount << " draws per frame, " << Stats.GetDrawsSaved() << " draws saved over " << Stats.mFrameCount
+			<< " frames" << std::endl;
+	}
+
+	//Print the GPU timings gathered so far, and dump them to a JSON file if asked to
+	void ReportGpuTimings()
+	{
+		if (!mGpuProfiler.IsEnabled())
+		{
+			return;
+		}
+
+		mGpuProfiler.Print(std::cout);
+		if (!mOptions.mGpuProfilePath.empty() && mGpuProfiler.WriteJson(mOptions.mGpuProfilePath))
+		{
+			std::cout << "GPU timings written to " << mOptions.mGpuProfilePath << std::endl;
+		}
+	}
+
+	//Device memory allocator benchmark: create and destroy random buffers, first suballocated and then with one vkAllocateMemory each.
+	//Both passes replay the very same sequence so the timings can be compared.
+	void RunAllocatorStress()
+	{
+		const uint32_t IterationCount = mOptions.mAllocatorStressIterations;
+
+		//Keeps the one allocation per buffer pass well below maxMemoryAllocationCount
+		const size_t kMaxLiveBuffers = 1024;
+
+		//Transient allocations are recycled every this many iterations, as if each batch was a frame
+		const uint32_t kIterationsPerFrame = 64;
+
+		//Template buffer to know which memory types uniform/storage buffers can live in
+		VkBufferCreateInfo BufferInfo = {};
+		BufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		BufferInfo.size = 256;
+		BufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		BufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkBuffer TemplateBuffer;
+		if (vkCreateBuffer(mDevice, &BufferInfo, nullptr, &TemplateBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create buffer!");
+		}
+		VkMemoryRequirements TemplateRequirements;
+		vkGetBufferMemoryRequirements(mDevice, TemplateBuffer, &TemplateRequirements);
+		vkDestroyBuffer(mDevice, TemplateBuffer, nullptr);
+
+		LinearDeviceAllocator FrameAllocator;
+		FrameAllocator.Create(mMemoryAllocator, 16 * 1024 * 1024, TemplateRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		for (int Pass = 0; Pass < 2; ++Pass)
+		{
+			const bool Suballocate = Pass == 0;
+
+			std::mt19937 Random(1234);
+			std::vector<std::pair<VkBuffer, DeviceAllocation>> LiveBuffers;
+			DeviceMemoryStatistics PeakStats;
+			uint32_t TransientAllocationCount = 0;
+
+			auto DestroyBuffer = [&](size_t Index)
+			{
+				vkDestroyBuffer(mDevice, LiveBuffers[Index].first, nullptr);
+				if (Suballocate)
+				{
+					mMemoryAllocator.Free(LiveBuffers[Index].second);
+				}
+				else
+				{
+					vkFreeMemory(mDevice, LiveBuffers[Index].second.mMemory, nullptr);
+				}
+				LiveBuffers[Index] = LiveBuffers.back();
+				LiveBuffers.pop_back();
+			};
+
+			auto Start = std::chrono::high_resolution_clock::now();
+			for (uint32_t Iteration = 0; Iteration < IterationCount; ++Iteration)
+			{
+				const bool Create = LiveBuffers.empty() || (LiveBuffers.size() < kMaxLiveBuffers && Random() % 3 != 0);
+				if (Create)
+				{
+					//Log distributed sizes from 256 bytes up to 4 MB: lots of small buffers and a few big ones
+					BufferInfo.size = VkDeviceSize(256) << (Random() % 15);
+					BufferInfo.size += Random() % BufferInfo.size;
+
+					VkBuffer Buffer;
+					if (vkCreateBuffer(mDevice, &BufferInfo, nullptr, &Buffer) != VK_SUCCESS)
+					{
+						throw std::runtime_error("Failed to create buffer!");
+					}
+
+					DeviceAllocation Allocation;
+					if (Suballocate)
+					{
+						Allocation = mMemoryAllocator.AllocateForBuffer(Buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+					}
+					else
+					{
+						VkMemoryRequirements MemRequirements;
+						vkGetBufferMemoryRequirements(mDevice, Buffer, &MemRequirements);
+
+						VkMemoryAllocateInfo AllocInfo = {};
+						AllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+						AllocInfo.allocationSize = MemRequirements.size;
+						AllocInfo.memoryTypeIndex = mMemoryAllocator.FindMemoryType(MemRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+						if (vkAllocateMemory(mDevice, &AllocInfo, nullptr, &Allocation.mMemory) != VK_SUCCESS)
+						{
+							throw std::runtime_error("Failed to allocate buffer memory!");
+						}
+						vkBindBufferMemory(mDevice, Buffer, Allocation.mMemory, 0);
+					}
+					LiveBuffers.emplace_back(Buffer, Allocation);
+				}
+				else
+				{
+					DestroyBuffer(Random() % LiveBuffers.size());
+				}
+
+				if (Suballocate)
+				{
+					//A few transient allocations per iteration (constants, dynamic geometry ...)
+					VkMemoryRequirements TransientRequirements = TemplateRequirements;
+					TransientRequirements.size = 256 + Random() % 4096;
+					if (FrameAllocator.Allocate(TransientRequirements).IsValid())
+					{
+						++TransientAllocationCount;
+					}
+
+					if ((Iteration + 1) % kIterationsPerFrame == 0)
+					{
+						FrameAllocator.Reset();
+					}
+
+					if (LiveBuffers.size() == kMaxLiveBuffers)
+					{
+						PeakStats = mMemoryAllocator.GetStatistics();
+					}
+				}
+			}
+
+			while (!LiveBuffers.empty())
+			{
+				DestroyBuffer(LiveBuffers.size() - 1);
+			}
+			std::chrono::duration<double> Elapsed = std::chrono::high_resolution_clock::now() - Start;
+
+			std::cout << green.c_str() << "Allocator stress (" << (Suballocate ? "suballocated" : "one allocation per buffer") << "): "
+				<< IterationCount << " iterations in " << Elapsed.count() * 1000.0 << " ms" << reset.c_str() << std::endl;
+			if (Suballocate)
+			{
+				std::cout << "  Peak: " << PeakStats << std::endl;
+				std::cout << "  Transient: " << TransientAllocationCount << " linear allocations, high water mark " << FrameAllocator.GetHighWaterMark() << " bytes of " << FrameAllocator.GetCapacity() << std::endl;
+				std::cout << "  After: " << mMemoryAllocator.GetStatistics() << std::endl;
+			}
+		}
+
+		FrameAllocator.Destroy();
+	}
+
+	//Mesh load benchmark: the source mesh (OBJ/glTF) parsed as text and uploaded as plain floats, against its converted
+	//mesh file mapped and uploaded as is. Both count until the transfer queue is done, so they're ready to draw.
+	void RunMeshLoadBenchmark()
+	{
+		const std::string& Source = mOptions.mMeshBenchmarkSource;
+		const std::string MeshFileName = Source + ".mesh";
+
+		//The offline step, not timed
+		WriteMeshFile(MeshFileName, LoadMeshSource(Source));
+
+		RollingStatistics TextTimes(kMESH_BENCHMARK_ITERATIONS);
+		RollingStatistics BinaryTimes(kMESH_BENCHMARK_ITERATIONS);
+		uint64_t TextBytes = 0;
+		for (uint32_t Iteration = 0; Iteration < kMESH_BENCHMARK_ITERATIONS; ++Iteration)
+		{
+			//TEXT: parse, then upload every attribute as floats and the indices as 32 bit
+			auto Start = std::chrono::high_resolution_clock::now();
+			{
+				const MeshSourceData Mesh = LoadMeshSource(Source);
+				const VkDeviceSize Sizes[] = { Mesh.mPositions.size() * sizeof(float), Mesh.mNormals.size() * sizeof(float), Mesh.mTexCoords.size() * sizeof(float), Mesh.mIndices.size() * sizeof(uint32_t) };
+				const void* Data[] = { Mesh.mPositions.data(), Mesh.mNormals.data(), Mesh.mTexCoords.data(), Mesh.mIndices.data() };
+
+				DeviceAllocation Allocation;
+				VkBuffer Buffer = CreateDeviceLocalBuffer(Sizes[0] + Sizes[1] + Sizes[2] + Sizes[3], VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, Allocation);
+				VkDeviceSize Offset = 0;
+				for (size_t i = 0; i < std::size(Sizes); ++i)
+				{
+					if (Sizes[i] != 0)
+					{
+						mBufferStreamer.UploadBuffer(Buffer, Offset, Data[i], Sizes[i], VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, i == 3 ? VK_ACCESS_INDEX_READ_BIT : VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+					}
+					Offset += Sizes[i];
+				}
+				mBufferStreamer.WaitIdle();
+				TextTimes.Add(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - Start).count());
+				TextBytes = Offset;
+
+				mBufferStreamer.DiscardPendingAcquires(Buffer);
+				vkDestroyBuffer(mDevice, Buffer, nullptr);
+				mMemoryAllocator.Free(Allocation);
+			}
+
+			//BINARY: map, validate, upload the chunks
+			Start = std::chrono::high_resolution_clock::now();
+			GpuMesh Mesh = mMeshLoader.Load(MeshFileName);
+			mBufferStreamer.WaitIdle();
+			BinaryTimes.Add(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - Start).count());
+			mMeshLoader.Destroy(Mesh);
+		}
+
+		const RollingSummary Text = TextTimes.GetSummary();
+		const RollingSummary Binary = BinaryTimes.GetSummary();
+		std::cout << green.c_str() << "Mesh load (" << kMESH_BENCHMARK_ITERATIONS << " iterations, min/average ms):" << reset.c_str() << std::endl;
+		std::cout << "  Text source: " << Text.mMin << " / " << Text.mAverage << ", " << TextBytes << " bytes uploaded" << std::endl;
+		std::cout << "  Mesh file:   " << Binary.mMin << " / " << Binary.mAverage << ", " << mMeshLoader.GetStatistics().mUploadedBytes / kMESH_BENCHMARK_ITERATIONS << " bytes uploaded" << std::endl;
+		std::cout << "  " << (Binary.mAverage > 0.0 ? Text.mAverage / Binary.mAverage : 0.0) << "x faster" << std::endl;
+	}
+
+	//Mesh optimizer benchmark: the same source with more and more of the optimizations, each level rendered for a while
+	//(meant for --headless, --draws multiplies the vertex work). The cache and overdraw metrics get printed next to the GPU
+	//time of the draws.
+	void RunMeshOptimizerBenchmark()
+	{
+		struct OptimizationLevel
+		{
+			//Also the GPU scope of its draws
+			const char* mName;
+			uint32_t mOptimizations;
+		};
+		static const OptimizationLevel kLevels[] =
+		{
+			{ "Unoptimized", 0 },
+			{ "VertexCache", kMeshOptimizeVertexCache },
+			{ "VertexCache+Overdraw", kMeshOptimizeVertexCache | kMeshOptimizeOverdraw },
+			{ "VertexCache+Overdraw+VertexFetch", kMeshOptimizeAll },
+		};
+
+		const MeshSourceData Source = LoadMeshSource(mOptions.mMeshOptimizerBenchmarkSource);
+		const uint32_t FrameCount = mOptions.mFrameCount != 0 ? mOptions.mFrameCount : kMESH_OPTIMIZER_BENCHMARK_FRAMES;
+		std::cout << green.c_str() << "Mesh optimizer: " << mOptions.mMeshOptimizerBenchmarkSource << ", " << Source.GetVertexCount() << " vertices, " << Source.mIndices.size() / 3
+			<< " triangles, " << FrameCount << " frames of " << mOptions.mDrawCount << " copies per level" << reset.c_str() << std::endl;
+
+		std::vector<std::string> Results;
+		for (const OptimizationLevel& Level : kLevels)
+		{
+			MeshSourceData Mesh = Source;
+			const auto Start = std::chrono::high_resolution_clock::now();
+			OptimizeMesh(Mesh, Level.mOptimizations);
+			const double OptimizeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - Start).count();
+
+			const VertexCacheStatistics Cache16 = AnalyzeVertexCache(Mesh.mIndices.data(), Mesh.mIndices.size(), Mesh.GetVertexCount(), 16);
+			const VertexCacheStatistics Cache32 = AnalyzeVertexCache(Mesh.mIndices.data(), Mesh.mIndices.size(), Mesh.GetVertexCount(), 32);
+			const OverdrawStatistics Overdraw = AnalyzeOverdraw(Mesh.mIndices.data(), Mesh.mIndices.size(), Mesh.mPositions.data(), Mesh.GetVertexCount());
+
+			const std::vector<uint8_t> File = BuildMeshFile(Mesh);
+			mMesh = mMeshLoader.Upload(MeshFileView(File.data(), File.size()));
+			mBufferStreamer.Flush();
+
+			mDrawsScopeName = Level.mName;
+			for (uint32_t Frame = 0; Frame < FrameCount; ++Frame)
+			{
+				if (!mOptions.mHeadless)
+				{
+					glfwPollEvents();
+				}
+				DrawFrame();
+			}
+
+			//Every frame of this level must be done before its mesh goes
+			vkDeviceWaitIdle(mDevice);
+			mMeshLoader.Destroy(mMesh);
+
+			std::ostringstream Result;
+			Result << "  " << Level.mName << ": ACMR " << Cache16.mAcmr << " (16 entries) / " << Cache32.mAcmr << " (32 entries), ATVR " << Cache16.mAtvr
+				<< ", overdraw " << Overdraw.mOverdraw << ", optimized in " << OptimizeMs << " ms";
+			Results.push_back(Result.str());
+		}
+
+		//The timings of a frame are only read back when its slot comes around again: go through every slot once more
+		mDrawsScopeName = "Draws";
+		for (uint32_t Frame = 0; Frame < mOptions.mFramesInFlight; ++Frame)
+		{
+			DrawFrame();
+		}
+		vkDeviceWaitIdle(mDevice);
+
+		for (size_t i = 0; i < std::size(kLevels); ++i)
+		{
+			std::cout << Results[i];
+			if (mGpuProfiler.IsEnabled())
+			{
+				const RollingSummary Draws = mGpuProfiler.GetScopeSummary(kLevels[i].mName);
+				std::cout << ", GPU draws avg " << Draws.mAverage << " ms, min " << Draws.mMin << " ms";
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	//Render graph self test (runs fine on a software driver, e.g. on CI): a small frame made of transfer and render passes, with a pass
+	//nobody needs and two transient images whose lifetimes don't overlap. It gets executed once and the result is read back and checked.
+	void RunRenderGraphTest()
+	{
+		const VkExtent2D Extent = { 64, 64 };
+		const VkFormat Format = VK_FORMAT_R8G8B8A8_UNORM;
+
+		//What the test frame produces: the left half comes from one transient image, the right half from the other
+		VkImageCreateInfo ImageInfo = {};
+		ImageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		ImageInfo.imageType = VK_IMAGE_TYPE_2D;
+		ImageInfo.format = Format;
+		ImageInfo.extent = { Extent.width, Extent.height, 1 };
+		ImageInfo.mipLevels = 1;
+		ImageInfo.arrayLayers = 1;
+		ImageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		ImageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		ImageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		ImageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		ImageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VkImage OutputImage;
+		if (vkCreateImage(mDevice, &ImageInfo, nullptr, &OutputImage) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create render graph test image!");
+		}
+		DeviceAllocation OutputAllocation = mMemoryAllocator.AllocateForImage(OutputImage, ImageInfo.tiling, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		VkBufferCreateInfo BufferInfo = {};
+		BufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		BufferInfo.size = Extent.width * Extent.height * 4;
+		BufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		BufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkBuffer ReadbackBuffer;
+		if (vkCreateBuffer(mDevice, &BufferInfo, nullptr, &ReadbackBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create render graph test readback buffer!");
+		}
+		DeviceAllocation ReadbackAllocation = mMemoryAllocator.AllocateForBuffer(ReadbackBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		const VkClearColorValue Red = { { 1.0f, 0.0f, 0.0f, 1.0f } };
+		const VkClearColorValue Green = { { 0.0f, 1.0f, 0.0f, 1.0f } };
+		const VkClearColorValue Blue = { { 0.0f, 0.0f, 1.0f, 1.0f } };
+
+		auto ClearImage = [](VkCommandBuffer CommandBuffer, VkImage Image, const VkClearColorValue& Color)
+		{
+			VkImageSubresourceRange Range = {};
+			Range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			Range.levelCount = 1;
+			Range.layerCount = 1;
+			vkCmdClearColorImage(CommandBuffer, Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &Color, 1, &Range);
+		};
+
+		auto CopyHalf = [Extent](VkCommandBuffer CommandBuffer, VkImage Source, VkImage Destination, int32_t X)
+		{
+			VkImageCopy Region = {};
+			Region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			Region.srcSubresource.layerCount = 1;
+			Region.srcOffset = { X, 0, 0 };
+			Region.dstSubresource = Region.srcSubresource;
+			Region.dstOffset = Region.srcOffset;
+			Region.extent = { Extent.width / 2, Extent.height, 1 };
+			vkCmdCopyImage(CommandBuffer, Source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, Destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &Region);
+		};
+
+		RenderGraph Graph;
+
+		RenderGraphImageDesc Desc;
+		Desc.mFormat = Format;
+		Desc.mExtent = Extent;
+
+		RenderGraphResource Output = Graph.ImportImage("Output", Desc, VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+		RenderGraphResource RedImage = Graph.CreateTransientImage("Red", Desc);
+		RenderGraphResource GreenImage = Graph.CreateTransientImage("Green", Desc);
+		RenderGraphResource UnusedImage = Graph.CreateTransientImage("Unused", Desc);
+
+		Graph.AddPass("ClearRed")
+			.WriteTransfer(RedImage, false)
+			.SetExecute([&](const RenderGraphPassContext& Context) { ClearImage(Context.mCommandBuffer, Context.mGraph->GetImage(RedImage), Red); });
+
+		Graph.AddPass("CopyRed")
+			.ReadTransfer(RedImage)
+			.WriteTransfer(Output)
+			.SetExecute([&](const RenderGraphPassContext& Context) { CopyHalf(Context.mCommandBuffer, Context.mGraph->GetImage(RedImage), Context.mGraph->GetImage(Output), 0); });
+
+		//Red is dead by now, so Green can take its memory. The render pass has no draws: its clear load op does the work
+		Graph.AddPass("ClearGreen")
+			.WriteColor(GreenImage, VK_ATTACHMENT_LOAD_OP_CLEAR, Green);
+
+		//Nobody reads what this one writes: it must get culled, and its image never created
+		Graph.AddPass("ClearUnused")
+			.WriteTransfer(UnusedImage, false)
+			.SetExecute([&](const RenderGraphPassContext& Context) { ClearImage(Context.mCommandBuffer, Context.mGraph->GetImage(UnusedImage), Blue); });
+
+		Graph.AddPass("CopyGreen")
+			.ReadTransfer(GreenImage)
+			.WriteTransfer(Output)
+			.SetExecute([&](const RenderGraphPassContext& Context) { CopyHalf(Context.mCommandBuffer, Context.mGraph->GetImage(GreenImage), Context.mGraph->GetImage(Output), static_cast<int32_t>(Extent.width / 2)); });
+
+		Graph.Compile(mDevice, mMemoryAllocator);
+		Graph.SetImportedImage(Output, OutputImage, VK_NULL_HANDLE);
+
+		QueueFamilyIndices QFIndices = FindQueueFamilies(mPhysicalDevice);
+		VkCommandPool CommandPool = CreateTransientCommandPool(QFIndices.mGraphicsFamily);
+		VkCommandBuffer CommandBuffer = AllocateCommandBuffer(CommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+		VkCommandBufferBeginInfo BeginInfo = {};
+		BeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (vkBeginCommandBuffer(CommandBuffer, &BeginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to begin recording command buffer!");
+		}
+
+		Graph.Execute(CommandBuffer);
+
+		//The graph leaves Output in TRANSFER_SRC_OPTIMAL, ready to be copied out
+		VkBufferImageCopy ReadbackRegion = {};
+		ReadbackRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		ReadbackRegion.imageSubresource.layerCount = 1;
+		ReadbackRegion.imageExtent = { Extent.width, Extent.height, 1 };
+		vkCmdCopyImageToBuffer(CommandBuffer, OutputImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, ReadbackBuffer, 1, &ReadbackRegion);
+
+		//The readback isn't part of the graph: the state tracker takes the buffer from the copy to the host
+		VulkanResourceStateTracker ReadbackStates;
+		ReadbackStates.RegisterBuffer(ReadbackBuffer, { VK_IMAGE_LAYOUT_UNDEFINED, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT });
+		ReadbackStates.Transition(ReadbackBuffer, { VK_IMAGE_LAYOUT_UNDEFINED, VK_ACCESS_HOST_READ_BIT, VK_PIPELINE_STAGE_HOST_BIT });
+		ReadbackStates.FlushBarriers(CommandBuffer);
+
+		if (vkEndCommandBuffer(CommandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to record command buffer!");
+		}
+
+		VkSubmitInfo SubmitInfo = {};
+		SubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		SubmitInfo.commandBufferCount = 1;
+		SubmitInfo.pCommandBuffers = &CommandBuffer;
+		if (vkQueueSubmit(mGraphicsQueue, 1, &SubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit render graph test command buffer!");
+		}
+		vkQueueWaitIdle(mGraphicsQueue);
+
+		//Left half red, right half green
+		const uint8_t* Pixels = static_cast<const uint8_t*>(ReadbackAllocation.mMappedData);
+		auto PixelIs = [&](uint32_t X, uint32_t Y, uint8_t R, uint8_t G, uint8_t B)
+		{
+			const uint8_t* Pixel = Pixels + (Y * Extent.width + X) * 4;
+			return Pixel[0] == R && Pixel[1] == G && Pixel[2] == B && Pixel[3] == 255;
+		};
+
+		const RenderGraphStatistics& Stats = Graph.GetStatistics();
+		const bool PixelsOk = PixelIs(0, 0, 255, 0, 0) && PixelIs(Extent.width / 2 - 1, Extent.height - 1, 255, 0, 0) &&
+			PixelIs(Extent.width / 2, 0, 0, 255, 0) && PixelIs(Extent.width - 1, Extent.height - 1, 0, 255, 0);
+		const bool CullingOk = Graph.IsPassCulled("ClearUnused") && !Graph.IsPassCulled("ClearRed") && Stats.mTransientImageCount == 2;
+		const bool AliasingOk = Stats.mTransientMemorySize < Stats.mUnaliasedTransientMemorySize;
+
+		std::cout << "Render graph test: " << Stats << std::endl;
+		std::cout << "  output " << (PixelsOk ? "ok" : "WRONG") << ", culling " << (CullingOk ? "ok" : "WRONG") << ", aliasing " << (AliasingOk ? "ok" : "WRONG") << std::endl;
+
+		Graph.Destroy();
+		vkDestroyCommandPool(mDevice, CommandPool, nullptr);
+		vkDestroyBuffer(mDevice, ReadbackBuffer, nullptr);
+		mMemoryAllocator.Free(ReadbackAllocation);
+		vkDestroyImage(mDevice, OutputImage, nullptr);
+		mMemoryAllocator.Free(OutputAllocation);
+
+		if (!PixelsOk || !CullingOk || !AliasingOk)
+		{
+			throw std::runtime_error("Render graph test failed!");
+		}
+		std::cout << green.c_str() << "Render graph test passed" << reset.c_str() << std::endl;
 	}
 
 	void CleanUp()
@@ -1194,28 +2823,54 @@ private:
 		//Wait for the device to finish any pending rendering action before to destroy any potentially in use vulkan object/resource !
 		vkDeviceWaitIdle(mDevice);
 
+		//Everything that was waiting for the GPU can go now
+		mDeletionQueue.Flush();
+
 		//Destroy the two semaphores
-		for (size_t i = 0; i < kMAX_FRAMES_IN_FLIGHT; i++) 
+		for (size_t i = 0; i < mImageAvailableSemaphores.size(); i++) 
 		{
 			vkDestroySemaphore(mDevice, mRenderFinishedSemaphores[i],nullptr);
 			vkDestroySemaphore(mDevice, mImageAvailableSemaphores[i],nullptr);
-			vkDestroyFence(mDevice, mInFlightFences[i], nullptr);
 		}
-		
-		//Destroy command pool
-		vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
 
-		//Destroy frame buffers
-		for (auto Framebuffer : mSwapChainFramebuffers) 
+		//And the frame timeline
+		mFrameScheduler.Destroy();
+
+		//And the timestamp queries
+		mGpuProfiler.Destroy();
+		
+		//Destroy the command pools (this frees their command buffers as well)
+		for (auto& Frame : mFrameCommands)
 		{
-			vkDestroyFramebuffer(mDevice, Framebuffer, nullptr);
+			vkDestroyCommandPool(mDevice, Frame.mPrimaryPool, nullptr);
+			for (auto WorkerPool : Frame.mWorkerPools)
+			{
+				vkDestroyCommandPool(mDevice, WorkerPool, nullptr);
+			}
 		}
+		mFrameCommands.clear();
+
+		//Stop the recording threads
+		mTaskSystem.reset();
 
-		//Destroy the graphics pipeline
-		vkDestroyPipeline(mDevice, mGraphicsPipeline, nullptr);
+		//Stop watching the shaders, and wait for a pipeline rebuild still running
+		mShaderWatcher.reset();
+		CancelShaderReload();
 
-		//Destroy pipeling layout
-		vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+		//Destroy the render graph (render passes, framebuffers and transient images)
+		mRenderGraph->Destroy();
+		mRenderGraph.reset();
+
+		//Destroy the graphics pipelines
+		DestroyPipelines(mGraphicsPipelines);
+		vkDestroyPipeline(mDevice, mMeshPipeline, nullptr);
+
+		//Destroy pipeline layouts and descriptor set layouts
+		mLayoutCache.Destroy();
+
+		//Persist the pipeline cache for the next run and destroy it
+		mPipelineCache.Save();
+		mPipelineCache.Destroy();
 
 		//Destroy Render pass
 		vkDestroyRenderPass(mDevice, mRenderPass, nullptr);
@@ -1226,8 +2881,30 @@ private:
 			vkDestroyImageView(mDevice,ImageView, nullptr);
 		}
 
-		//Destroy the swap chain 
-		vkDestroySwapchainKHR(mDevice,mSwapChain,nullptr);
+		//Destroy the swap chain (or the offscreen images we created ourselves when headless)
+		if (mOptions.mHeadless)
+		{
+			for (size_t i = 0; i < mSwapChainImages.size(); ++i)
+			{
+				vkDestroyImage(mDevice, mSwapChainImages[i], nullptr);
+				mMemoryAllocator.Free(mOffscreenImageAllocations[i]);
+			}
+		}
+		else
+		{
+			vkDestroySwapchainKHR(mDevice,mSwapChain,nullptr);
+		}
+
+		//Release the mesh (it may still have acquires pending in the streamer), the streamer (after its last uploads), the instance
+		//buffers and the geometry, then the device memory blocks
+		mMeshLoader.Destroy(mMesh);
+		mBufferStreamer.Destroy();
+		mDrawBatcher.Destroy();
+		vkDestroyBuffer(mDevice, mVertexBuffer, nullptr);
+		mMemoryAllocator.Free(mVertexBufferAllocation);
+		vkDestroyBuffer(mDevice, mIndexBuffer, nullptr);
+		mMemoryAllocator.Free(mIndexBufferAllocation);
+		mMemoryAllocator.Destroy();
 
 		//Destroy the Vulkan logical device
 		vkDestroyDevice(mDevice, nullptr);
@@ -1239,24 +2916,38 @@ private:
 		}
 
 		//Destroy the window surface 
-		vkDestroySurfaceKHR(mVkInstance, mSurface, nullptr);
+		if (mSurface != VK_NULL_HANDLE)
+		{
+			vkDestroySurfaceKHR(mVkInstance, mSurface, nullptr);
+		}
 
 		//Destroy the Vulkan instance 
 		vkDestroyInstance(mVkInstance, nullptr);
 
-		//Destroy the already created window 
-		glfwDestroyWindow(mWindow);
+		if (!mOptions.mHeadless)
+		{
+			//Destroy the already created window 
+			glfwDestroyWindow(mWindow);
 
-		//Terminate GLFW
-		glfwTerminate();
+			//Terminate GLFW
+			glfwTerminate();
+		}
 	}
 
+	//Options this application has been launched with
+	LaunchOptions mOptions;
+
 	//The GLFWindow to which we render into
 	GLFWwindow* mWindow = nullptr;
 
+	//Set by the framebuffer resize callback, the swap chain gets recreated at the next present
+	bool mFramebufferResized = false;
+
 	//Handle to a queue belonging to the graphics family (meaning that can hold and execute graphics commands only)
 	VkQueue mGraphicsQueue = VK_NULL_HANDLE;
 
+	VkQueue mTransferQueue = VK_NULL_HANDLE;
+
 	//Handle to a queue belonging to the presentation family of queues
 	VkQueue mPresentQueue = VK_NULL_HANDLE;
 
@@ -1270,6 +2961,9 @@ private:
 	//You can even create multiple logical devices from the same physical device if you have varying requirements.
 	VkDevice mDevice = VK_NULL_HANDLE;
 
+	//Carves big VkDeviceMemory blocks into buffers and images
+	DeviceMemoryAllocator mMemoryAllocator;
+
 	//Necessary to manage any debug callback in vulkan
 	VkDebugUtilsMessengerEXT mCallback = nullptr;
 
@@ -1280,8 +2974,15 @@ private:
 	VkSwapchainKHR mSwapChain = VK_NULL_HANDLE;
 
 	//These will be the actual images contained in the swap chain that we'll reference for any rendering operation
+	//In headless mode these are offscreen images owned by us
 	std::vector<VkImage> mSwapChainImages;
 
+	//Backing memory of the offscreen images (headless mode only)
+	std::vector<DeviceAllocation> mOffscreenImageAllocations;
+
+	//Next offscreen image to render into (headless mode only)
+	uint32_t mOffscreenImageIndex = 0;
+
 	//Swap chain image format
 	VkFormat mSwapChainImageFormat;
 
@@ -1291,23 +2992,64 @@ private:
 	//Similar to DirectX12 we need to create a view for a given render target (in Vulkan VkImage), to know how to access that image (is it a 2D texture or a depth buffer ? and so on ...)
 	std::vector<VkImageView> mSwapChainImageViews;
 
-	//Swap chain framebuffers
-	std::vector<VkFramebuffer> mSwapChainFramebuffers;
+	//The frame's passes, their render passes, framebuffers and transient images (shared so a replaced graph can be handed to the deletion queue)
+	std::shared_ptr<RenderGraph> mRenderGraph;
+
+	//The swap chain image (or offscreen image) rendered to this frame, imported into the render graph
+	RenderGraphResource mBackBuffer = kInvalidRenderGraphResource;
 
-	//Render Pass 
+	//Render Pass used to create the graphics pipeline
 	VkRenderPass mRenderPass;
 
-	//Pipeline layout
-	VkPipelineLayout mPipelineLayout;
+	//Pipeline layout of the graphics pipelines (owned by mLayoutCache)
+	VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
+
+	//Graphics pipelines, one per fragment shader variant
+	std::vector<VkPipeline> mGraphicsPipelines;
 
-	//Graphics pipeline
-	VkPipeline mGraphicsPipeline;
+	//Pipeline of the mesh files (no variants)
+	VkPipeline mMeshPipeline = VK_NULL_HANDLE;
+	VkPipelineLayout mMeshPipelineLayout = VK_NULL_HANDLE;
+
+	//Depth attachment format of the main pass
+	VkFormat mDepthFormat = VK_FORMAT_UNDEFINED;
+
+	//Specialization constant combinations the graphics pipelines are built for
+	ShaderVariantSet mFragmentVariants{ kFRAGMENT_VARIANTS };
+
+	//Variant the frame is drawn with
+	uint32_t mActiveVariant = 0;
+
+	//Pipeline cache persisted on disk
+	PipelineCache mPipelineCache;
+
+	//Descriptor set and pipeline layouts reflected from the shaders, deduplicated
+	PipelineLayoutCache mLayoutCache;
+
+	//Memory mapped SPIR-V files
+	ShaderBinaryCache mShaderBinaries;
+
+	//GLSL to SPIR-V, into the shader cache directory
+	ShaderCompiler mShaderCompiler{ kSHADER_CACHE_DIRECTORY };
+
+	//SHADER HOT RELOAD (windowed mode only)
+
+	//Reports the shader sources that got saved
+	std::unique_ptr<FileWatcher> mShaderWatcher;
+
+	//Pipeline being rebuilt on a background thread, if any
+	std::future<PipelineReload> mPipelineReload;
+
+	//Shaders changed since the last rebuild was started
+	bool mPipelineReloadPending = false;
 
 	//COMMAND BUFFERS
-	VkCommandPool mCommandPool;
 
-	//We create a list of command buffers (one for each image of the swap chain)
-	std::vector<VkCommandBuffer> mCommandBuffers;
+	//Command pools and buffers of every frame in flight (re-recorded every frame)
+	std::vector<FrameCommands> mFrameCommands;
+
+	//Threads recording the secondary command buffers
+	std::unique_ptr<TaskSystem> mTaskSystem;
 
 	//Queue operations of draw command synchronization. We synchronize them using two semaphore
 
@@ -1318,19 +3060,144 @@ private:
 	//Rendering has finished on the acquired image and is ready to be presented on screen (signal it!)	
 	std::vector<VkSemaphore> mRenderFinishedSemaphores;
 
-	//Fences are used for CPU-GPU synchronization
-	std::vector<VkFence> mInFlightFences;
+	//CPU-GPU synchronization: frame values on a timeline semaphore
+	FrameScheduler mFrameScheduler;
 
-	//Current frame to be processed
+	//Frame in flight slot of the frame being processed
 	size_t mCurrentFrame = 0;
 
+	//Objects waiting for the frames that may use them to complete before getting destroyed
+	DeferredDeletionQueue mDeletionQueue;
+
+	//Vertex and index buffers come from the transfer queue through here
+	BufferStreamer mBufferStreamer;
+
+	//Mesh files go straight from their mapping to the streamer
+	MeshLoader mMeshLoader;
+
+	//Drawn instead of the triangle when loaded (--mesh)
+	GpuMesh mMesh;
+
+	//Sorts the frame's objects into instanced draws, and owns the instance buffers
+	DrawBatcher mDrawBatcher;
+
+	//The triangle and mMesh, as the batcher binds them (the mesh's push constants are mMeshConstants, updated every frame)
+	DrawGeometry mTriangleGeometry;
+	DrawGeometry mMeshGeometry;
+	MeshConstants mMeshConstants = {};
+
+	//GPU scope of the main pass draws (a string literal, see GpuProfiler), so that benchmarks can time their runs apart
+	const char* mDrawsScopeName = "Draws";
+
+	//Transfer timeline value the frame being submitted waits for (0: none)
+	uint64_t mTransferWaitValue = 0;
+
+	//Device local geometry of the triangle, streamed in at startup
+	VkBuffer mVertexBuffer = VK_NULL_HANDLE;
+	DeviceAllocation mVertexBufferAllocation;
+	VkBuffer mIndexBuffer = VK_NULL_HANDLE;
+	DeviceAllocation mIndexBufferAllocation;
+
+	//GPU timings per pass
+	GpuProfiler mGpuProfiler;
+
+	//CPU timings per frame: total, blocked on the GPU and in present
+	FrameStatistics mFrameStatistics;
+
+	FrameTimer mFrameTimer{ mFrameStatistics };
+
 };
 
 
 
-int main() 
+int main(int argc, char** argv) 
 {
-	MyApplication App;
+	MyApplication::LaunchOptions Options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--headless") == 0)
+		{
+			Options.mHeadless = true;
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			Options.mFrameCount = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+		}
+		else if (strcmp(argv[i], "--draws") == 0 && i + 1 < argc)
+		{
+			Options.mDrawCount = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+		}
+		else if (strcmp(argv[i], "--no-instancing") == 0)
+		{
+			Options.mInstancing = false;
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			Options.mRecordingThreadCount = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+		}
+		else if (strcmp(argv[i], "--allocator-stress") == 0 && i + 1 < argc)
+		{
+			Options.mAllocatorStressIterations = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+		}
+		else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+		{
+			uint32_t FramesInFlight = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+			Options.mFramesInFlight = std::max(1u, std::min(FramesInFlight, kMAX_FRAMES_IN_FLIGHT));
+		}
+		else if (strcmp(argv[i], "--gpu-profile") == 0 && i + 1 < argc)
+		{
+			Options.mGpuProfilePath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--render-graph-test") == 0)
+		{
+			Options.mRenderGraphTest = true;
+		}
+		else if (strcmp(argv[i], "--frame-stats") == 0 && i + 1 < argc)
+		{
+			Options.mFrameStatisticsPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--shader-variant") == 0 && i + 1 < argc)
+		{
+			Options.mShaderVariant = argv[++i];
+		}
+		else if (strcmp(argv[i], "--mesh-benchmark") == 0 && i + 1 < argc)
+		{
+			Options.mMeshBenchmarkSource = argv[++i];
+		}
+		else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc)
+		{
+			Options.mMeshPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--mesh-optimizer-benchmark") == 0 && i + 1 < argc)
+		{
+			Options.mMeshOptimizerBenchmarkSource = argv[++i];
+		}
+		else if (strcmp(argv[i], "--convert-mesh") == 0 && i + 2 < argc)
+		{
+			//Offline conversion: no window nor device needed
+			const std::string Source = argv[i + 1];
+			const std::string Destination = argv[i + 2];
+			try
+			{
+				MeshSourceData Mesh = LoadMeshSource(Source);
+				const VertexCacheStatistics Before = AnalyzeVertexCache(Mesh.mIndices.data(), Mesh.mIndices.size(), Mesh.GetVertexCount());
+				OptimizeMesh(Mesh);
+				const VertexCacheStatistics After = AnalyzeVertexCache(Mesh.mIndices.data(), Mesh.mIndices.size(), Mesh.GetVertexCount());
+				WriteMeshFile(Destination, Mesh);
+				std::cout << "Converted " << Source << " to " << Destination << ": " << Mesh.GetVertexCount() << " vertices, " << Mesh.mIndices.size() / 3 << " triangles, ACMR "
+					<< Before.mAcmr << " -> " << After.mAcmr << std::endl;
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << red.c_str() << e.what() << reset.c_str() << std::endl;
+				return EXIT_FAILURE;
+			}
+			return EXIT_SUCCESS;
+		}
+	}
+
+	MyApplication App(Options);
 
 	App.Run();
 	